@@ -44,6 +44,10 @@ GENERATE_SUBDIRS(ALL_LIBRARIES ${LIBRARIES_PATH} ${PROJECT_BINARY_DIR}/libraries
 
 
 set(EXECUTABLE_OUTPUT_PATH ${PROJECT_BINARY_DIR}/bin)
+set(BENCHMARK_OUTPUT_PATH ${PROJECT_BINARY_DIR}/benchmarks)
+add_custom_target(benchmarks) # see ADD_BENCHMARK
+add_custom_target(golden_images) # see ADD_GOLDEN_IMAGE_TEST
+add_custom_target(update_golden_images)
 GENERATE_SUBDIRS(ALL_EXECUTABLES ${EXECUTABLES_PATH} ${PROJECT_BINARY_DIR}/executables)
 
 if(EXISTS ${SHADERS_PATH})
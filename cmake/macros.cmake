@@ -48,4 +48,40 @@ MACRO(VALIADATE_PATH result)
 		SET(${result} "PATH-NOTFOUND" CACHE PATH "Project specific path. Set manually if it was not found.")
 		message("ERROR: ${result} NOT FOUND")
 	ENDIF ()
-ENDMACRO()
\ No newline at end of file
+ENDMACRO()
+
+# runs an executable in benchmark mode (see Rendering/Benchmark.h), e.g. "make benchmark_fullDemo" or "make benchmarks" for all of them
+# without a GPU: LIBGL_ALWAYS_SOFTWARE=1 xvfb-run make benchmarks
+MACRO(ADD_BENCHMARK target frames)
+	add_custom_target(benchmark_${target}
+		COMMAND ${CMAKE_COMMAND} -E make_directory ${BENCHMARK_OUTPUT_PATH}
+		COMMAND $<TARGET_FILE:${target}> --benchmark ${frames} --headless --output ${BENCHMARK_OUTPUT_PATH}/${target}.json
+		DEPENDS ${target}
+		WORKING_DIRECTORY ${EXECUTABLE_OUTPUT_PATH}
+		COMMENT "Benchmark ${target}"
+	)
+	add_dependencies(benchmarks benchmark_${target})
+ENDMACRO()
+
+# renders a fixed number of frames headless and compares the targets registered with Benchmark::setGoldenImages against
+# ${GOLDEN_IMAGES_PATH}/<name>, "make golden_images" fails on a mismatch, "make update_golden_images" replaces the golden images.
+# The golden images are not part of the repository: run "make update_golden_images" once on a known good build, until then
+# targets without a golden image are skipped with a warning
+MACRO(ADD_GOLDEN_IMAGE_TEST target frames)
+	add_custom_target(golden_${target}
+		COMMAND ${CMAKE_COMMAND} -E make_directory ${BENCHMARK_OUTPUT_PATH}
+		COMMAND $<TARGET_FILE:${target}> --benchmark ${frames} --warmup 0 --headless --golden ${GOLDEN_IMAGES_PATH}/${target} --output ${BENCHMARK_OUTPUT_PATH}/${target}_golden.json
+		DEPENDS ${target}
+		WORKING_DIRECTORY ${EXECUTABLE_OUTPUT_PATH}
+		COMMENT "Golden image test ${target}"
+	)
+	add_custom_target(update_golden_${target}
+		COMMAND ${CMAKE_COMMAND} -E make_directory ${GOLDEN_IMAGES_PATH}/${target}
+		COMMAND $<TARGET_FILE:${target}> --benchmark ${frames} --warmup 0 --headless --golden ${GOLDEN_IMAGES_PATH}/${target} --update-golden --output ${BENCHMARK_OUTPUT_PATH}/${target}_golden.json
+		DEPENDS ${target}
+		WORKING_DIRECTORY ${EXECUTABLE_OUTPUT_PATH}
+		COMMENT "Update golden images of ${target}"
+	)
+	add_dependencies(golden_images golden_${target})
+	add_dependencies(update_golden_images update_golden_${target})
+ENDMACRO()
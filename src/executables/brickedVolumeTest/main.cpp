@@ -0,0 +1,92 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * checks and statistics of bricked volumes (Importer::createBrickedVolume):
+ * a synthetic CT-like volume (a noisy sphere surrounded by air, size no multiple of the brick size) is bricked,
+ * every voxel of an occupied brick must read back unchanged, every voxel of a dropped brick must be below the threshold.
+ * Prints the number of occupied bricks and the memory saved, OK / FAIL per test, exit code is the number of failed tests.
+ * usage: brickedVolumeTest
+ ****************************************/
+
+#include <iostream>
+#include <cstdlib>
+#include <climits>
+
+#include <Core/DebugLog.h>
+#include <Core/TestReport.h>
+#include <Importing/BrickedVolume.h>
+
+////////////////////// PARAMETERS /////////////////////////////
+const unsigned int VOLUME_SIZE_X = 200;
+const unsigned int VOLUME_SIZE_Y = 180;
+const unsigned int VOLUME_SIZE_Z = 150;
+const unsigned int BRICK_SIZE = 32;
+const short AIR = -1000;           // Hounsfield units
+const short EMPTY_THRESHOLD = -500;
+
+//////////////////// MISC /////////////////////////////////////
+VolumeData<short> generateVolume()
+{
+	VolumeData<short> volume;
+	volume.size_x = VOLUME_SIZE_X;
+	volume.size_y = VOLUME_SIZE_Y;
+	volume.size_z = VOLUME_SIZE_Z;
+	volume.min = SHRT_MAX;
+	volume.max = SHRT_MIN;
+	for (unsigned int z = 0; z < VOLUME_SIZE_Z; z++)
+	{
+		for (unsigned int y = 0; y < VOLUME_SIZE_Y; y++)
+		{
+			for (unsigned int x = 0; x < VOLUME_SIZE_X; x++)
+			{
+				float dx = x - 0.5f * VOLUME_SIZE_X, dy = y - 0.5f * VOLUME_SIZE_Y, dz = z - 0.5f * VOLUME_SIZE_Z;
+				bool inside = dx * dx + dy * dy + dz * dz < 0.16f * VOLUME_SIZE_Z * VOLUME_SIZE_Z;
+				short value = (short) ( (inside ? 40 + (int) (x + y + z) % 1000 : AIR) + std::rand() % 21 - 10 );
+				volume.data.push_back(value);
+				volume.min = std::min(value, volume.min);
+				volume.max = std::max(value, volume.max);
+			}
+		}
+	}
+	return volume;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	std::srand(1);
+	int numFailed = 0;
+
+	VolumeData<short> volume = generateVolume();
+	BrickedVolumeData<short> bricked = Importer::createBrickedVolume(volume, EMPTY_THRESHOLD, BRICK_SIZE);
+
+	unsigned int numOccupied = bricked.getNumOccupiedBricks();
+	unsigned int numBricks = (unsigned int) bricked.brickIndex.size();
+	numFailed += TestReport::report("occupancy", numOccupied > 0 && numOccupied < numBricks,
+		DebugLog::to_string(numOccupied) + " / " + DebugLog::to_string(numBricks) + " bricks occupied");
+	numFailed += TestReport::report("memory", bricked.atlasData.size() < volume.data.size(),
+		DebugLog::to_string((int) (bricked.atlasData.size() * sizeof(short) / 1024)) + " KiB instead of "
+		+ DebugLog::to_string((int) (volume.data.size() * sizeof(short) / 1024)) + " KiB");
+
+	unsigned int numWrong = 0, numNotEmpty = 0;
+	for (unsigned int z = 0; z < VOLUME_SIZE_Z; z++)
+	{
+		for (unsigned int y = 0; y < VOLUME_SIZE_Y; y++)
+		{
+			for (unsigned int x = 0; x < VOLUME_SIZE_X; x++)
+			{
+				short value = volume.data[((size_t) z * VOLUME_SIZE_Y + y) * VOLUME_SIZE_X + x];
+				unsigned int brick = (z / BRICK_SIZE * bricked.numBricks_y + y / BRICK_SIZE) * bricked.numBricks_x + x / BRICK_SIZE;
+				if ( bricked.brickIndex[brick] >= 0 && bricked.getValue(x, y, z) != value ) { numWrong++; }
+				if ( bricked.brickIndex[brick] < 0 && value >= EMPTY_THRESHOLD ) { numNotEmpty++; }
+				if ( value > bricked.brickMax[brick] || value < bricked.brickMin[brick] ) { numWrong++; }
+			}
+		}
+	}
+	numFailed += TestReport::report("occupied bricks", numWrong == 0, DebugLog::to_string(numWrong) + " wrong voxels");
+	numFailed += TestReport::report("dropped bricks", numNotEmpty == 0, DebugLog::to_string(numNotEmpty) + " voxels above the threshold");
+
+	return numFailed;
+}
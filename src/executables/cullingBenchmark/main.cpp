@@ -0,0 +1,252 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * CPU micro benchmark of Culling::CullingHelper:
+ * per-object tests vs. SoA batch tests (SSE / AVX)
+ * and multithreaded culling with compaction,
+ * occlusion culling against a software rasterized depth pyramid,
+ * BVH build, refit and queries for 10k, 100k and 1M objects
+ ****************************************/
+
+#include <iostream>
+#include <chrono>
+#include <cmath>
+
+#include <Rendering/CullingTools.h>
+#include <Rendering/OcclusionCulling.h>
+#include <Rendering/BoundingVolumeHierarchy.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+////////////////////// PARAMETERS /////////////////////////////
+const int NUM_OBJECTS = 100000;
+const int NUM_ITERATIONS = 50;
+const float SCENE_SIZE = 200.0f;
+const glm::ivec2 OCCLUSION_RESOLUTION = glm::ivec2(256, 192);
+const int BVH_SIZES[] = {10000, 100000, 1000000};
+const int BVH_ITERATIONS = 5;
+const int NUM_RAYS = 10000;
+
+//////////////////// MISC /////////////////////////////////////
+float randFloat(float min, float max) //!< returns a random number between min and max
+{
+	return (((float) rand() / (float) RAND_MAX) * (max - min) + min); 
+}
+
+std::vector<Culling::CullingInfo> generateInstances(int numObjects, float size)
+{
+	std::vector<Culling::CullingInfo> instances(numObjects);
+
+	for (int i = 0; i < numObjects; i++)
+	{
+		Culling::CullingInfo& info = instances[i];
+		info.boundingBox.min = glm::vec3(-0.5f);
+		info.boundingBox.max = glm::vec3( 0.5f);
+		info.boundingRadius = glm::length(glm::vec3(0.5f));
+
+		glm::vec3 position(randFloat(-size * 0.5f, size * 0.5f), randFloat(-size * 0.5f, size * 0.5f), randFloat(-size * 0.5f, size * 0.5f));
+		info.modelMatrix = glm::translate(glm::mat4(1.0f), position)
+			* glm::rotate(glm::mat4(1.0f), randFloat(0.0f, 6.28f), glm::normalize(glm::vec3(randFloat(-1.0f, 1.0f), 1.0f, randFloat(-1.0f, 1.0f))))
+			* glm::scale(glm::mat4(1.0f), glm::vec3(randFloat(0.5f, 2.0f)));
+	}
+
+	return instances;
+}
+
+template <typename Func>
+double measureMilliseconds(Func func, int numIterations = NUM_ITERATIONS)
+{
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < numIterations; i++)
+	{
+		func();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - begin).count() / (double) numIterations;
+}
+
+void logResult(std::string name, double milliseconds, int numVisible)
+{
+	DEBUGLOG->log(name); DEBUGLOG->indent();
+	DEBUGLOG->log("ms per run       : ", milliseconds);
+	DEBUGLOG->log("objects per ms   : ", (double) NUM_OBJECTS / milliseconds);
+	DEBUGLOG->log("visible objects  : ", numVisible);
+	DEBUGLOG->outdent();
+}
+
+void benchmarkBVH(int numObjects, Culling::CullingHelper& cullingHelper)
+{
+	// keep the density of the other benchmarks
+	float sceneSize = SCENE_SIZE * std::pow((float) numObjects / (float) NUM_OBJECTS, 1.0f / 3.0f);
+	std::vector<Culling::CullingInfo> instances = generateInstances(numObjects, sceneSize);
+
+	std::vector<glm::mat4> movedMatrices(numObjects);
+	for (int i = 0; i < numObjects; i++)
+	{
+		movedMatrices[i] = glm::translate(glm::mat4(1.0f), glm::vec3(randFloat(-1.0f, 1.0f), randFloat(-1.0f, 1.0f), randFloat(-1.0f, 1.0f))) * instances[i].modelMatrix;
+	}
+
+	DEBUGLOG->log("BVH, objects: ", numObjects); DEBUGLOG->indent();
+
+	Culling::BoundingVolumeHierarchy bvh;
+	double msBuild = measureMilliseconds([&](){ bvh.build(instances); }, BVH_ITERATIONS);
+	DEBUGLOG->log("nodes                       : ", (int) bvh.getNumNodes());
+	DEBUGLOG->log("build, ms                   : ", msBuild);
+
+	// every object moves, alternating between two poses
+	int iteration = 0;
+	double msRefitAll = measureMilliseconds([&](){
+		for (int i = 0; i < numObjects; i++)
+		{
+			bvh.updateModelMatrix(i, (iteration % 2 == 0) ? movedMatrices[i] : instances[i].modelMatrix);
+		}
+		bvh.refit();
+		iteration++;
+	}, BVH_ITERATIONS);
+	DEBUGLOG->log("update all + refit, ms      : ", msRefitAll);
+
+	// 1% of the objects move
+	double msRefitFew = measureMilliseconds([&](){
+		for (int i = 0; i < numObjects; i += 100)
+		{
+			bvh.updateModelMatrix(i, (iteration % 2 == 0) ? movedMatrices[i] : instances[i].modelMatrix);
+		}
+		bvh.refit();
+		iteration++;
+	}, BVH_ITERATIONS);
+	DEBUGLOG->log("update 1% + refit, ms       : ", msRefitFew);
+
+	std::vector<unsigned int> visibleObjects;
+	double msQuery = measureMilliseconds([&](){ bvh.queryFrustum(cullingHelper, visibleObjects); }, BVH_ITERATIONS);
+	DEBUGLOG->log("frustum query, ms           : ", msQuery);
+	DEBUGLOG->log("frustum query, visible      : ", (int) visibleObjects.size());
+
+	std::vector<glm::mat4> visibleMatrices(instances.size());
+	unsigned int numVisibleMatrices = 0;
+	double msLinear = measureMilliseconds([&](){ numVisibleMatrices = cullingHelper.cullAgainstFrustum(instances, &visibleMatrices[0]); }, BVH_ITERATIONS);
+	DEBUGLOG->log("linear cullAgainstFrustum, ms: ", msLinear);
+	DEBUGLOG->log("linear, visible             : ", (int) numVisibleMatrices);
+
+	std::vector<glm::vec3> rayDirections(NUM_RAYS);
+	for (auto& d : rayDirections) { d = glm::normalize(glm::vec3(randFloat(-1.0f, 1.0f), randFloat(-1.0f, 1.0f), randFloat(-1.0f, 1.0f))); }
+	int numHits = 0;
+	double msRays = measureMilliseconds([&](){
+		numHits = 0;
+		unsigned int hitObject;
+		float hitDistance;
+		for (const auto& d : rayDirections)
+		{
+			if (bvh.queryRay(glm::vec3(0.0f), d, hitObject, hitDistance)) { numHits++; }
+		}
+	}, BVH_ITERATIONS);
+	DEBUGLOG->log("rays per ms                 : ", (double) NUM_RAYS / msRays);
+	DEBUGLOG->log("rays hit                    : ", numHits);
+	DEBUGLOG->outdent();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	DEBUGLOG->setAutoPrint(true);
+
+	srand(1337);
+	std::vector<Culling::CullingInfo> instances = generateInstances(NUM_OBJECTS, SCENE_SIZE);
+
+	Camera camera;
+	camera.setPosition(0.0f, 0.0f, 0.0f);
+	camera.setDirection(glm::vec3(0.0f, 0.0f, -1.0f));
+	camera.setProjectionMatrix(glm::perspective(glm::radians(65.f), 800.0f / 600.0f, 0.1f, SCENE_SIZE * 0.5f));
+
+	Culling::CullingHelper cullingHelper(&camera);
+	cullingHelper.updateFrustum();
+
+	DEBUGLOG->log("Objects    : ", NUM_OBJECTS);
+	DEBUGLOG->log("Iterations : ", NUM_ITERATIONS);
+#if defined(__AVX__)
+	DEBUGLOG->log("SIMD       : AVX");
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	DEBUGLOG->log("SIMD       : SSE");
+#else
+	DEBUGLOG->log("SIMD       : none");
+#endif
+
+	// world space bounds only change if objects move, so the transformation is measured separately
+	Culling::CullingBatch batch;
+	double msFill = measureMilliseconds([&](){ Culling::fillCullingBatch(instances, batch); });
+	logResult("fill batch (transform bounds)", msFill, NUM_OBJECTS);
+
+	int numVisible = 0;
+	double msScalar = measureMilliseconds([&](){
+		numVisible = 0;
+		for (size_t i = 0; i < batch.size(); i++)
+		{
+			int visibility = cullingHelper.sphereInFrustum(glm::vec3(batch.centerX[i], batch.centerY[i], batch.centerZ[i]), batch.radius[i]);
+			if (visibility != Culling::CullingHelper::OUTSIDE) { numVisible++; }
+		}
+	});
+	logResult("per-object spheres", msScalar, numVisible);
+
+	std::vector<unsigned char> visibility;
+	double msSpheres = measureMilliseconds([&](){ cullingHelper.spheresInFrustum(batch, visibility); });
+	numVisible = 0;
+	for (auto v : visibility) { if (v != Culling::CullingHelper::OUTSIDE) numVisible++; }
+	logResult("batched spheres", msSpheres, numVisible);
+
+	double msBoxes = measureMilliseconds([&](){ cullingHelper.boxesInFrustum(batch, visibility); });
+	numVisible = 0;
+	for (auto v : visibility) { if (v != Culling::CullingHelper::OUTSIDE) numVisible++; }
+	logResult("batched boxes", msBoxes, numVisible);
+
+	// compaction into a pre-reserved buffer, as it would be streamed into an instance attribute buffer
+	std::vector<glm::mat4> visibleMatrices(instances.size());
+	unsigned int maxThreads = cullingHelper.getNumThreads();
+	for (unsigned int numThreads = 1; numThreads <= maxThreads; numThreads *= 2)
+	{
+		cullingHelper.setNumThreads(numThreads);
+		unsigned int numVisibleMatrices = 0;
+		double msFull = measureMilliseconds([&](){ numVisibleMatrices = cullingHelper.cullAgainstFrustum(instances, &visibleMatrices[0]); });
+		logResult("cullAgainstFrustum + compaction, threads: " + DebugLog::to_string(numThreads), msFull, (int) numVisibleMatrices);
+	}
+
+	DEBUGLOG->log("speedup batched spheres vs. per-object: ", msScalar / msSpheres);
+
+	// occlusion: a wall in front of the camera hides most of what is inside the frustum
+	Culling::DepthPyramid occlusionPyramid(OCCLUSION_RESOLUTION.x, OCCLUSION_RESOLUTION.y);
+	Culling::SoftwareRasterizer rasterizer(&occlusionPyramid);
+	double msRasterize = measureMilliseconds([&](){
+		rasterizer.setViewProjectionMatrix(camera.getProjectionMatrix() * camera.getViewMatrix());
+		rasterizer.clear();
+		rasterizer.rasterizeBox(glm::vec3(-40.0f, -30.0f, -22.0f), glm::vec3(40.0f, 30.0f, -20.0f), glm::mat4(1.0f));
+		rasterizer.finish();
+	});
+	DEBUGLOG->log("rasterize occluder + build pyramid, ms: ", msRasterize);
+
+	std::vector<Culling::CullingInfo> frustumVisibleInstances;
+	for (const auto& info : instances)
+	{
+		glm::vec3 center, extent;
+		float radius;
+		Culling::getWorldSpaceBounds(info, center, extent, radius);
+		if (cullingHelper.boxInFrustum(center - extent, center + extent) != Culling::CullingHelper::OUTSIDE) { frustumVisibleInstances.push_back(info); }
+	}
+
+	cullingHelper.setOcclusionPyramid(&occlusionPyramid);
+	std::vector<glm::mat4> unoccluded;
+	double msOcclusion = measureMilliseconds([&](){ unoccluded = cullingHelper.cullOccluded(frustumVisibleInstances); });
+	DEBUGLOG->log("occlusion culling of frustum-visible instances"); DEBUGLOG->indent();
+	DEBUGLOG->log("tested          : ", (int) frustumVisibleInstances.size());
+	DEBUGLOG->log("ms per run      : ", msOcclusion);
+	DEBUGLOG->log("objects per ms  : ", (double) frustumVisibleInstances.size() / msOcclusion);
+	DEBUGLOG->log("not occluded    : ", (int) unoccluded.size());
+	DEBUGLOG->outdent();
+
+	cullingHelper.setNumThreads(maxThreads);
+	for (int numBVHObjects : BVH_SIZES)
+	{
+		benchmarkBVH(numBVHObjects, cullingHelper);
+	}
+
+	return 0;
+}
@@ -5,6 +5,7 @@
 #include <time.h>
 
 #include <Rendering/VertexArrayObjects.h>
+#include <Rendering/Benchmark.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
@@ -36,19 +37,24 @@ std::unordered_map<aiTextureType, GLuint, AssimpTools::EnumClassHash> textures;
 static Timer s_idle_ui_timer(true);
 static Timer s_idle_movement_timer(true);
 static const double IDLE_ANIMATION_TIME_LIMIT = 20.0;
+static const double ASYNC_UPLOAD_BUDGET = 2.0; // milliseconds per frame spent on texture uploads while assets are loading
+static const unsigned int TRACE_FRAMES = 30; // frames captured by F6, see TraceRecorder
+static const char* TRACE_FILE = "fullDemo_trace.json"; // open in ui.perfetto.dev or chrome://tracing
 static bool s_idle_animation_active = false;
 static glm::mat4 s_idle_animation_rotation_matrix;
 
 //////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////// MAIN ///////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
-int main()
+int main(int argc, char** argv)
 {
 	DEBUGLOG->setAutoPrint(true);
+	TRACERECORDER->setThreadName("main");
+	Benchmark::parseArguments(argc, argv, "fullDemo");
 	// create window and opengl context
 	auto window = generateWindow(WINDOW_RESOLUTION.x,WINDOW_RESOLUTION.y);
 
-	srand(time(NULL));
+	srand(Benchmark::isEnabled() ? 0 : (unsigned int) time(NULL)); // same scene in every benchmark run
 
 	//////////////////////////////////////////////////////////////////////////////
 	/////////////////////// SETUP ////////////////////////////////////////////////
@@ -58,64 +64,78 @@ int main()
 	DEBUGLOG->log("Setup: importing assets"); DEBUGLOG->indent(); 
 	Assimp::Importer importer;
 
+	// decoded in the background, uploaded in the render loop, the handles show a placeholder until then
+	AsyncLoader* asyncLoader = new AsyncLoader(); // deletes GL objects, so it is destroyed before the window
+
 	//TODO load all models that are needed
 
 	/************ trees / branches ************/
-	loadBranchModel();
-	loadFoliageMaterial();
-	TreeAnimation::TreeRendering treeRendering;
-	generateTrees(treeRendering);
-	TreeAnimation::WindField windField(64,64);
-	windField.updateVectorTexture(0.0f);
+	requestBranchModel(*asyncLoader); // parsed while the textures below are requested
 	/******************************************/
 
 	//TODO load all material information aswell ( + textures)
 
 	/////////////////////    Import Textures    //////////////////////////////
 	DEBUGLOG->outdent(); DEBUGLOG->log("Setup: importing textures"); DEBUGLOG->indent(); 
-	
+
 	// Skybox
-	GLuint tex_cubeMap = TextureTools::loadDefaultCubemap();
+	std::vector<std::string> cubeMapFiles;
+	cubeMapFiles.push_back("cubemap/cloudtop_rt.tga");
+	cubeMapFiles.push_back("cubemap/cloudtop_lf.tga");
+	cubeMapFiles.push_back("cubemap/cloudtop_up.tga");
+	cubeMapFiles.push_back("cubemap/cloudtop_dn.tga");
+	cubeMapFiles.push_back("cubemap/cloudtop_bk.tga");
+	cubeMapFiles.push_back("cubemap/cloudtop_ft.tga");
+	GLuint tex_cubeMap = asyncLoader->loadCubemapFromResourceFolder(cubeMapFiles)->handle;
 
 
 	//TODO load all (non-material) textures that are needed
 	// Tess
 	//GLuint distortionTex = TextureTools::loadTexture( RESOURCES_PATH "/terrain_height2.png");
-	GLuint distortionTex = TextureTools::loadTexture( RESOURCES_PATH "/heightmap2.jpg");
-	GLuint terrainNormalTex = TextureTools::loadTexture( RESOURCES_PATH "/terrain_normal.png");
+	GLuint distortionTex = asyncLoader->loadTexture( RESOURCES_PATH "/heightmap2.jpg")->handle;
+	GLuint terrainNormalTex = asyncLoader->loadTexture( RESOURCES_PATH "/terrain_normal.png")->handle;
 
-	GLuint diffTex = TextureTools::loadTexture( RESOURCES_PATH "/Rocks_Seamless_1_COLOR.png");
+	GLuint diffTex = asyncLoader->loadTexture( RESOURCES_PATH "/Rocks_Seamless_1_COLOR.png")->handle;
 	OPENGLCONTEXT->bindTexture(diffTex);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-	GLuint snowTex = TextureTools::loadTexture( RESOURCES_PATH "/terrain_snow.jpg");
+	GLuint snowTex = asyncLoader->loadTexture( RESOURCES_PATH "/terrain_snow.jpg")->handle;
 	OPENGLCONTEXT->bindTexture(snowTex);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-	GLuint grassTex = TextureTools::loadTexture( RESOURCES_PATH "/terrain_grass.jpg");
+	GLuint grassTex = asyncLoader->loadTexture( RESOURCES_PATH "/terrain_grass.jpg")->handle;
 	OPENGLCONTEXT->bindTexture(grassTex);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 	
-	GLuint tex_grassQuad = TextureTools::loadTextureFromResourceFolder("grass_2.png");
+	GLuint tex_grassQuad = asyncLoader->loadTextureFromResourceFolder("grass_2.png")->handle;
 	OPENGLCONTEXT->bindTexture(tex_grassQuad);
 	// glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); 
 	// glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 2);
 
-	GLuint waterTextureHandle = TextureTools::loadTextureFromResourceFolder("water/07_DIFFUSE.jpg");
+	GLuint waterTextureHandle = asyncLoader->loadTextureFromResourceFolder("water/07_DIFFUSE.jpg")->handle;
 	OPENGLCONTEXT->bindTexture(waterTextureHandle);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-	GLuint waterNormalTextureHandle = TextureTools::loadTextureFromResourceFolder("water/07_NORMAL.jpg");
+	GLuint waterNormalTextureHandle = asyncLoader->loadTextureFromResourceFolder("water/07_NORMAL.jpg")->handle;
 	OPENGLCONTEXT->bindTexture(waterNormalTextureHandle);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
 
+	/************ trees / branches ************/
+	loadBranchModel(*asyncLoader);
+	loadFoliageMaterial();
+	TreeAnimation::TreeRendering treeRendering;
+	generateTrees(treeRendering);
+	TreeAnimation::WindField windField(64,64);
+	windField.updateVectorTexture(0.0f);
+	/******************************************/
+
 	/////////////////////    Import Stuff (Misc)    //////////////////////////
 
 	//TODO load whatever else is needed
@@ -126,6 +146,7 @@ int main()
 	mainCamera.setPosition(0.0f, 2.0f, 0.0f);
 	mainCamera.setDirection(glm::vec3(0.0f, 0.2f, 1.0f));
 	mainCamera.setProjectionMatrix( glm::perspective(glm::radians(65.f), getRatio(window), 0.5f, 100.f) );
+	Benchmark::CameraPath cameraPath = Benchmark::CameraPath::orbit(glm::vec3(7.0f, 1.25f, 5.0f), glm::vec3(0.0f, 1.75f, 5.0f), 20.0); // like the idle animation
 
 	Camera lightCamera; // used for shadow mapping
 	lightCamera.setProjectionMatrix( glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, -90.0f, 40.0f) );
@@ -235,6 +256,7 @@ int main()
 	treeRendering.branchShadowMapShader->update("projection", lightCamera.getProjectionMatrix());
 	treeRendering.foliageShadowMapShader->update("projection", lightCamera.getProjectionMatrix());
 	treeRendering.createAndConfigureUniformBlocksAndBuffers(1);
+	treeRendering.createUniformRingBuffer();
 	assignTreeMaterialTextures(treeRendering);
 	assignWindFieldUniforms(treeRendering, windField);
 	assignHeightMapUniforms(treeRendering, distortionTex, terrainRange);
@@ -497,6 +519,14 @@ int main()
 		 {
 			Settings.animate_seasons = !Settings.animate_seasons;
 		 }
+		 if ( k == GLFW_KEY_F5 && a == GLFW_PRESS )
+		 {
+			DEBUGLOG->log("shader programs reloaded: ", ShaderProgram::reloadChangedPrograms());
+		 }
+		 if ( k == GLFW_KEY_F6 && a == GLFW_PRESS )
+		 {
+			TRACERECORDER->beginCapture(TRACE_FRAMES, TRACE_FILE);
+		 }
  		 if ( k == GLFW_KEY_R && a == GLFW_PRESS)
 		 {
 			resetSettings();
@@ -567,9 +597,16 @@ int main()
 	//////////////////////////////// RENDER LOOP /////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
 	double elapsedTime = 0.0;
+	Benchmark::setProfiler(&timings);
+	if (Benchmark::isEnabled()) { asyncLoader->finish(); } // measure the loaded scene, not the upload budget
 
 	render(window, [&](double dt)
 	{
+		TRACERECORDER->nextFrame();
+
+		// upload assets that finished decoding
+		asyncLoader->update(ASYNC_UPLOAD_BUDGET);
+
 		// update timers
 		s_idle_movement_timer.update(dt);
 		s_idle_ui_timer.update(dt);
@@ -579,15 +616,14 @@ int main()
 			s_idle_animation_active = true;
 		}
 
-		timings.updateReadyTimings();
+		timings.beginFrame();
 		
 		elapsedTime += dt;
 		std::string window_header = "Lake Moedrianielrend - " + DebugLog::to_string( 1.0 / dt ) + " FPS";
 		glfwSetWindowTitle(window, window_header.c_str() );
 
 		////////////////////////////////     GUI      ////////////////////////////////
-		//timings.resetTimer("gui");
-		//timings.beginTimer("gui");
+		//timings.beginScope("gui");
 		
 		ImGuiIO& io = ImGui::GetIO();
 		ImGui_ImplGlfwGL3_NewFrame(); // tell ImGui a new frame is being rendered
@@ -675,9 +711,12 @@ int main()
 		{
 			timings.setEnabled(true);
 			timings.imguiTimings();
+			if (ImGui::Button("Capture Trace (F6)")) {
+				TRACERECORDER->beginCapture(TRACE_FRAMES, TRACE_FILE);
+			}
 			ImGui::TreePop();
 		}
-		else {timings.setEnabled(false);}
+		else {timings.setEnabled(TRACERECORDER->isCapturing() || Benchmark::isEnabled());}
 
 		if (ImGui::Button("Reset Camera")) {
 			mainCamera.setPosition(0.0f, 2.0f, 0.0f);
@@ -691,12 +730,11 @@ int main()
 			Settings.animate_seasons = !Settings.animate_seasons;
 		}
 		//TODO what you want to be able to modify, use multiple windows, collapsing headers, whatever
-		//timings.stopTimer("gui");
+		//timings.endScope();
         //////////////////////////////////////////////////////////////////////////////
 
 		///////////////////////////// VARIABLE UPDATING ///////////////////////////////
-		timings.resetTimer("varupdates");
-		timings.beginTimer("varupdates");
+		timings.beginScope("varupdates");
 
 		if (s_idle_animation_active) // update rotation matrix
 		{
@@ -707,6 +745,7 @@ int main()
 		}
 
 		mainCamera.update(dt);
+		if (Benchmark::isEnabled()) { cameraPath.apply(mainCamera, Benchmark::getTime()); }
 		updateLightCamera(mainCamera, lightCamera, - glm::vec3(WORLD_LIGHT_DIRECTION) * 15.0f);
 		
 		// if( Settings.multithreaded_windfield )
@@ -729,12 +768,11 @@ int main()
 			animateSeasons(treeRendering, sh_grassGeom, elapsedTime / 2.0f, Settings.grass_size, Settings.wind_power, Settings.foliage_size, sh_tessellation);
 		}
 		
-		timings.stopTimer("varupdates");
+		timings.endScope();
 		//////////////////////////////////////////////////////////////////////////////
 
 		////////////////////////  SHADER / UNIFORM UPDATING //////////////////////////
-		timings.resetTimer("uniformupdates");
-		timings.beginTimer("uniformupdates");
+		timings.beginScope("uniformupdates");
 
 		// update view dependent uniforms
 		sh_gbuffer.update( "view", mainCamera.getViewMatrix());
@@ -767,6 +805,7 @@ int main()
 		treeRendering.foliageShadowMapShader->update("foliageSize", Settings.foliage_size);
 		
 		treeRendering.updateActiveImguiInterfaces();
+		treeRendering.updateUniformBlocks();
 
 		// vml composition
 		sh_addTexShader.update("min", Settings.weightMin);
@@ -787,7 +826,7 @@ int main()
 		sh_gbuffer.update("time", elapsedTime);
 
 		//std::cout<<"ZEIT: "<< elapsedTime << endl;
-		timings.stopTimer("uniformupdates");
+		timings.endScope();
 		//////////////////////////////////////////////////////////////////////////////
 		
 		////////////////////////////////  RENDERING //// /////////////////////////////
@@ -796,61 +835,60 @@ int main()
 		//TODO copy stuff around that has to be copied around
 		//TODO funfunfun
 
+		timings.beginScope("rendering");
+
 		// render regular G-Buffer 
-		timings.resetTimer("gbuffer");
-		timings.beginTimer("gbuffer");
+		timings.beginScope("gbuffer");
 		r_gbuffer.render();
-		timings.stopTimer("gbuffer");
+		timings.endScope();
 		//TODO other rendering procedures that render into G-Buffer
 		
 		// render trees
-		timings.resetTimer("trees");
 		if (Settings.enableTrees)
 		{
-			timings.beginTimer("trees");
+			timings.beginScope("trees");
+			treeRendering.cullOnGPU(mainCamera.getProjectionMatrix() * mainCamera.getViewMatrix()); // no-op if compute shaders are unsupported
 			for( unsigned int i = 0; i < treeRendering.branchRenderpasses.size(); i++){
 				glUniformBlockBinding(treeRendering.branchShader->getShaderProgramHandle(), treeRendering.branchShaderUniformBlockInfoMap["Tree"].index, 2+i);
-				treeRendering.branchRenderpasses[i]->renderInstanced(NUM_TREES_PER_VARIANT);
+				treeRendering.renderBranches(i);
 			}
 			for(unsigned int i = 0; i < treeRendering.foliageRenderpasses.size(); i++)
 			{
 				glUniformBlockBinding(treeRendering.foliageShader->getShaderProgramHandle(), treeRendering.foliageShaderUniformBlockInfoMap["Tree"].index, 2+i);
-				treeRendering.foliageRenderpasses[i]->renderInstanced(NUM_TREES_PER_VARIANT);
+				treeRendering.renderFoliage(i);
 			}
-			timings.stopTimer("trees");
+			timings.endScope();
 		}
 
 
 		//TODO render tesselated mountains
 		
-		timings.resetTimer("landscape");
 		if (Settings.enableLandscape)
 		{
-			timings.beginTimer("landscape");
+			timings.beginScope("landscape");
 			r_terrain.render();
-			timings.stopTimer("landscape");
+			timings.endScope();
 		}
 
 		//render skybox
-		timings.resetTimer("skybox");
-		timings.beginTimer("skybox");
+		timings.beginScope("skybox");
 		r_skybox.render(tex_cubeMap, &fbo_gbuffer);
-		timings.stopTimer("skybox");
+		timings.endScope();
 
 		// render shadow map ( most of above again )
-		timings.resetTimer("shadowmap");
-		timings.beginTimer("shadowmap");
+		timings.beginScope("shadows");
+		timings.beginScope("shadowmap");
 		shadowMapRenderpass.render();
 		if (Settings.enableLandscape)
 		{
 			r_terrainShadowMap.render();
 		}
-		timings.stopTimer("shadowmap");
+		timings.endScope();
 
-		timings.resetTimer("treesShadow");
 		if (Settings.enableTrees)
 		{
-		timings.beginTimer("treesShadow");
+		timings.beginScope("treesShadow");
+		treeRendering.useAllInstances(); // trees outside of the view still cast shadows
 		for(unsigned int i = 0; i < treeRendering.foliageShadowMapRenderpasses.size(); i++)
 		{
 			glUniformBlockBinding(treeRendering.foliageShadowMapShader->getShaderProgramHandle(), treeRendering.foliageShadowMapShaderUniformBlockInfoMap["Tree"].index, 2+i);
@@ -861,64 +899,63 @@ int main()
 			glUniformBlockBinding(treeRendering.branchShadowMapShader->getShaderProgramHandle(), treeRendering.branchShadowMapShaderUniformBlockInfoMap["Tree"].index, 2+i);
 			treeRendering.branchShadowMapRenderpasses[i]->renderInstanced(NUM_TREES_PER_VARIANT);
 		}
-		timings.stopTimer("treesShadow");
+		timings.endScope();
 		}
+		timings.endScope(); // shadows
+
 		// render grass
-		timings.resetTimer("grass");
 		if (Settings.enableGrass) {
-			timings.beginTimer("grass");
+			timings.beginScope("grass");
 			r_grassGeom.render();
-			timings.stopTimer("grass");
+			timings.endScope();
 		}
 
 		// render regular compositing from GBuffer
-		timings.resetTimer("compositing");
-		timings.beginTimer("compositing");
+		timings.beginScope("compositing");
 		r_gbufferComp.render();
-		timings.stopTimer("compositing");
+		timings.endScope();
 
 		// ssr
-		timings.resetTimer("ssr");
 		if (Settings.enableSSR) {
-			timings.beginTimer("ssr");
+			timings.beginScope("ssr");
 			r_ssr.render();
 			copyFBOContent(&fbo_ssr, &fbo_gbufferComp, GL_COLOR_BUFFER_BIT);
-			timings.stopTimer("ssr");
+			timings.endScope();
 		}
 		
 		// volumetric lighting
-		timings.resetTimer("vml");
 		if (Settings.enableVolumetricLighting) {
-			timings.beginTimer("vml");
+			timings.beginScope("vml");
 			r_volumetricLighting._raymarchingRenderPass->render();
 
 			// overlay volumetric lighting
 			r_addTex.render();
-			timings.stopTimer("vml");
+			timings.endScope();
 		}
 		
 
 		//////////// POST-PROCESSING ////////////////////
 
 		// Depth of Field and Lens Flare
-		timings.resetTimer("dof");
+		timings.beginScope("postprocessing");
 		if (Settings.enableDepthOfField)
 		{
-			timings.beginTimer("dof");
+			timings.beginScope("dof");
 
 			r_depthOfField.execute(fbo_gbuffer.getBuffer("fragPosition"), fbo_gbufferComp.getBuffer("fragmentColor"));
 			copyFBOContent(r_depthOfField.m_dofCompFBO, &fbo_gbufferComp, GL_COLOR_BUFFER_BIT);
 
-			timings.stopTimer("dof");
+			timings.endScope();
 		}
 
-		timings.resetTimer("lensflare");
 		if(Settings.enableLenseflare)
 		{
-			timings.beginTimer("lensflare");
+			timings.beginScope("lensflare");
 			r_lensFlare.renderLensFlare( fbo_gbufferComp.getBuffer("fragmentColor"), &fbo_gbufferComp );
-			timings.stopTimer("lensflare");
+			timings.endScope();
 		}
+		timings.endScope(); // postprocessing
+		timings.endScope(); // rendering
 
 		/////////// DEBUGGING ////////////////////////////
 		r_showTex.setViewport(0,0, WINDOW_RESOLUTION.x, WINDOW_RESOLUTION.y );
@@ -961,7 +998,8 @@ int main()
 		//////////////////////////////////////////////////////////////////////////////
 	});
 
+	delete asyncLoader;
 	destroyWindow(window);
 
-	return 0;
+	return Benchmark::getExitCode();
 }
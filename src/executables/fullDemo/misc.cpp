@@ -6,13 +6,18 @@
 #include <functional>
 #include <Core/Camera.h>
 #include <Core/Timer.h>
+#include <Core/GPUProfiler.h>
+#include <Core/TraceRecorder.h>
 #include <Rendering/GLTools.h>
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <Importing/AssimpTools.h>
+#include <Importing/MeshCache.h>
+#include <Importing/AsyncLoader.h>
 
 #include <Importing/TextureTools.h>
+#include <Importing/TextureCooking.h>
 
 #include <TreeAnimation/Tree.h>
 #include <TreeAnimation/TreeRendering.h>
@@ -125,15 +130,41 @@ inline void resetSettings()
 
 
 /***********************************************/
-class ImguiTimings : public OpenGLTimings
+class ImguiTimings : public GPUProfiler
 {
 public:
 	void imguiTimings()
 	{
-		for ( auto kv : m_timers )
+		ImGui::Columns(5, "timings");
+		ImGui::Text("scope"); ImGui::NextColumn();
+		ImGui::Text("GPU avg"); ImGui::NextColumn();
+		ImGui::Text("GPU p95"); ImGui::NextColumn();
+		ImGui::Text("GPU max"); ImGui::NextColumn();
+		ImGui::Text("CPU avg"); ImGui::NextColumn();
+		ImGui::Separator();
+		imguiScopes(-1);
+		ImGui::Columns(1);
+		ImGui::Value("dropped samples", getNumDroppedSamples());
+	}
+private:
+	void imguiScopes(int parent) // depth first, so children are listed below their parent
+	{
+		for (int i = 0; i < (int) getScopes().size(); i++)
 		{
-			float time = kv.second.lastTiming;
-			ImGui::SliderFloat(kv.first.c_str(), &( time ), 0.0f , 10.0f, "%.6f");
+			const Scope& scope = getScopes()[i];
+			if ( scope.parent != parent ) { continue; }
+
+			Statistics gpu = getStatistics(i, true);
+			Statistics cpu = getStatistics(i, false);
+			bool recent = scope.lastFrame + 2 >= getFrame(); // scopes of disabled features are grayed out
+			std::string name = std::string(2 * scope.depth, ' ') + scope.name;
+			if ( recent ) { ImGui::Text("%s", name.c_str()); } else { ImGui::TextDisabled("%s", name.c_str()); }
+			ImGui::NextColumn();
+			ImGui::Text("%.3f", gpu.avg); ImGui::NextColumn();
+			ImGui::Text("%.3f", gpu.p95); ImGui::NextColumn();
+			ImGui::Text("%.3f", gpu.max); ImGui::NextColumn();
+			ImGui::Text("%.3f", cpu.avg); ImGui::NextColumn();
+			imguiScopes(i);
 		}
 	}
 };
@@ -228,26 +259,34 @@ static const int NUM_SUB_BRANCHES  = 3;
 static const int NUM_TREE_VARIANTS = 3;
 static const int NUM_TREES_PER_VARIANT = 20;
 static const int NUM_FOLIAGE_QUADS_PER_BRANCH = 5;
-static Assimp::Importer branchImporter;
-static Assimp::Importer trunkImporter;
+static AsyncLoader::MeshHandle s_branchMesh; //!< cached import of the branch models, see MeshCache
+static AsyncLoader::MeshHandle s_trunkMesh;
 static std::vector<std::unordered_map<aiTextureType, GLuint, AssimpTools::EnumClassHash>> s_tree_materials_textures; //!< mapping material texture types to texture handles
 static std::vector<AssimpTools::MaterialInfo> s_tree_material_infos; //!< mapping material texture types to texture handles
 static const glm::vec4 FORESTED_AREA = glm::vec4(-20.0f,-20.0f, 20.0f,20.0f);
-inline void loadBranchModel()
+inline void requestBranchModel(AsyncLoader& asyncLoader)
+{
+	// only the vertex data is needed, the tree entities build their own renderables
+	s_trunkMesh = asyncLoader.loadMeshFromResourceFolder("branch_detailed.dae", false);
+	s_branchMesh = asyncLoader.loadMeshFromResourceFolder("branch_simple.dae", false);
+}
+
+inline void loadBranchModel(AsyncLoader& asyncLoader)
 {
-	std::string trunkModel = "branch_detailed.dae";
-	std::string branchModel = "branch_simple.dae";
-	const aiScene* trunkScene = AssimpTools::importAssetFromResourceFolder(trunkModel, trunkImporter);
-	const aiScene* branchScene = AssimpTools::importAssetFromResourceFolder(branchModel, branchImporter);
+	asyncLoader.finish(s_trunkMesh);
+	asyncLoader.finish(s_branchMesh);
+	const MeshCache::Scene& trunkScene = *s_trunkMesh->scene;
 	std::unordered_map<aiTextureType, AssimpTools::MaterialTextureInfo, AssimpTools::EnumClassHash> branchTexturesInfo;
-	AssimpTools::MaterialInfo branchMaterialInfo = AssimpTools::getMaterialInfo(trunkScene, 0);
+	AssimpTools::MaterialInfo branchMaterialInfo;
+	branchMaterialInfo.matIdx = 0;
+	if (!trunkScene.getMaterialInfos().empty()) branchMaterialInfo = trunkScene.getMaterialInfos()[0];
 	s_tree_material_infos.push_back(branchMaterialInfo);
-	if (trunkScene != NULL) branchTexturesInfo = AssimpTools::getMaterialTexturesInfo(trunkScene, 0);
-	if (trunkScene != NULL) s_tree_materials_textures.resize(trunkScene->mNumMaterials);
+	branchTexturesInfo = branchMaterialInfo.texture;
+	s_tree_materials_textures.resize(std::max<size_t>(trunkScene.getMaterialInfos().size(), 1));
 
 	for (auto e : branchTexturesInfo)
 	{
-		GLuint texHandle = TextureTools::loadTextureFromResourceFolder(branchTexturesInfo[e.first].relativePath);
+		GLuint texHandle = TextureCooking::loadTextureFromResourceFolder(branchTexturesInfo[e.first].relativePath);
 		if (texHandle != -1){ s_tree_materials_textures[e.second.matIdx][e.first] = texHandle; }
 	}
 }
@@ -255,7 +294,7 @@ inline void loadBranchModel()
 inline void loadFoliageMaterial()
 {
 	std::string foliageTexture = "foliage_texture.png";
-	auto foliageTexHandle = TextureTools::loadTextureFromResourceFolder(foliageTexture);
+	auto foliageTexHandle = TextureCooking::loadTextureFromResourceFolder(foliageTexture);
 	std::unordered_map<aiTextureType, GLuint, AssimpTools::EnumClassHash > foliageMatTextures;
 	foliageMatTextures[aiTextureType_DIFFUSE] = foliageTexHandle;
 	s_tree_materials_textures.push_back(foliageMatTextures);
@@ -271,13 +310,15 @@ inline void generateTrees(TreeAnimation::TreeRendering& treeRendering)
 	DEBUGLOG->log("Setup: generating trees"); DEBUGLOG->indent();
 
 	// generate a forest randomly, including renderables
+	std::vector<AssimpTools::VertexData> trunkMeshes = s_trunkMesh->scene->createVertexDataInstances();
+	std::vector<AssimpTools::VertexData> branchMeshes = s_branchMesh->scene->createVertexDataInstances();
 	treeRendering.generateAndConfigureTreeEntities(
 		NUM_TREE_VARIANTS,
 		TREE_HEIGHT, TREE_WIDTH,
 		NUM_MAIN_BRANCHES, NUM_SUB_BRANCHES,
 		NUM_FOLIAGE_QUADS_PER_BRANCH,
-		trunkImporter.GetScene(),
-		branchImporter.GetScene()
+		trunkMeshes.empty() ? nullptr : &trunkMeshes[0],
+		branchMeshes.empty() ? nullptr : &branchMeshes[0]
 		);
 
 	treeRendering.generateModelMatrices(
@@ -285,6 +326,12 @@ inline void generateTrees(TreeAnimation::TreeRendering& treeRendering)
 		FORESTED_AREA.x, FORESTED_AREA.z, FORESTED_AREA.y, FORESTED_AREA.w);
 
 	treeRendering.createInstanceMatrixAttributes();
+
+	// tree.vert displaces trees by the heightmap in world space (HEIGHT_SCALE 50, HEIGHT_BIAS -2), instances are scaled in y by 0.75 .. 1.25
+	AssimpTools::BoundingBox treeBounds;
+	treeBounds.min = glm::vec3(-TREE_HEIGHT, -2.0f / 0.75f, -TREE_HEIGHT);
+	treeBounds.max = glm::vec3( TREE_HEIGHT, (2.0f * TREE_HEIGHT + 48.0f) / 0.75f, TREE_HEIGHT);
+	treeRendering.createGPUCulling(treeBounds);
 	DEBUGLOG->outdent();
 }
 inline void assignTreeMaterialTextures(TreeAnimation::TreeRendering& treeRendering)
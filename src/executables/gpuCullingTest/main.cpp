@@ -0,0 +1,249 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * compares Culling::GPUCulling against the CPU culling path:
+ * frustum culling against CullingHelper::cullAgainstFrustum,
+ * Hi-Z culling against a DepthPyramid cleared to the same depth.
+ * Prints OK / FAIL per test, exit code is the number of failed tests.
+ * Runs without a GPU through Mesa llvmpipe, e.g.
+ *   LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./gpuCullingTest
+ ****************************************/
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#include <Core/TestReport.h>
+#include <Rendering/GLTools.h>
+#include <Rendering/VertexArrayObjects.h>
+#include <Rendering/CullingTools.h>
+#include <Rendering/OcclusionCulling.h>
+#include <Rendering/GPUCulling.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+////////////////////// PARAMETERS /////////////////////////////
+const glm::ivec2 WINDOW_RESOLUTION = glm::ivec2(256, 192);
+const int GRID_SIZE = 40; // GRID_SIZE^3 instances
+const float GRID_SPACING = 3.0f;
+const float OCCLUDER_DEPTH = 0.98f; // window space depth the Hi-Z buffer is cleared to
+const float BORDER_EPSILON = 1e-4f; // instances this close to a frustum plane or the occluder depth may be classified differently
+
+//////////////////// MISC /////////////////////////////////////
+std::vector<Culling::CullingInfo> generateInstances()
+{
+	std::vector<Culling::CullingInfo> instances;
+	for (int x = 0; x < GRID_SIZE; x++) { for (int y = 0; y < GRID_SIZE; y++) { for (int z = 0; z < GRID_SIZE; z++)
+	{
+		Culling::CullingInfo info;
+		info.boundingBox.min = glm::vec3(-0.5f);
+		info.boundingBox.max = glm::vec3( 0.5f);
+		info.boundingRadius = glm::length(glm::vec3(0.5f));
+
+		glm::vec3 position = (glm::vec3(x, y, z) - glm::vec3(GRID_SIZE * 0.5f)) * GRID_SPACING;
+		info.modelMatrix = glm::translate(glm::mat4(1.0f), position)
+			* glm::rotate(glm::mat4(1.0f), (float) (x + y * z), glm::normalize(glm::vec3(1.0f, 2.0f, 0.5f)))
+			* glm::scale(glm::mat4(1.0f), glm::vec3(0.5f + 0.1f * (float) ((x * 7 + z) % 10)));
+		instances.push_back(info);
+	}}}
+	return instances;
+}
+
+bool lessPosition(const glm::vec3& a, const glm::vec3& b)
+{
+	if (a.x != b.x) { return a.x < b.x; }
+	if (a.y != b.y) { return a.y < b.y; }
+	return a.z < b.z;
+}
+
+float frustumMargin(const Culling::CullingHelper& helper, const Culling::CullingInfo& info) //!< smallest distance of the box to a plane crossing
+{
+	glm::vec3 center, extent;
+	float radius;
+	Culling::getWorldSpaceBounds(info, center, extent, radius);
+
+	float margin = FLT_MAX;
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = helper.getFrustumPlanes()[p];
+		float d = glm::dot(glm::vec3(plane), center) + plane.w;
+		float r = glm::dot(glm::abs(glm::vec3(plane)), extent);
+		margin = std::min(margin, std::abs(d + r));
+	}
+	return margin;
+}
+
+float occluderMargin(const Culling::CullingInfo& info, const glm::mat4& viewProjection) //!< distance of the nearest window space depth of the box to the occluder
+{
+	glm::vec3 center, extent;
+	float radius;
+	Culling::getWorldSpaceBounds(info, center, extent, radius);
+
+	float nearest = FLT_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner = center + extent * glm::vec3((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f);
+		glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+		nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+	}
+	return std::abs(nearest - OCCLUDER_DEPTH);
+}
+
+/** @brief compare the positions of the visible matrices written by the GPU with the expected set
+ * @return number of instances that differ and are not explained by floating point differences at the frustum border
+ */
+int compare(const std::vector<glm::mat4>& gpuVisible, const std::vector<Culling::CullingInfo>& instances, const std::vector<bool>& expected, const Culling::CullingHelper& helper, const glm::mat4* occluderViewProjection = nullptr)
+{
+	std::vector<glm::vec3> gpuPositions;
+	for (const auto& m : gpuVisible) { gpuPositions.push_back(glm::vec3(m[3])); }
+	std::sort(gpuPositions.begin(), gpuPositions.end(), lessPosition);
+
+	int numErrors = 0;
+	for (unsigned int i = 0; i < instances.size(); i++)
+	{
+		glm::vec3 position(instances[i].modelMatrix[3]);
+		bool onGPU = std::binary_search(gpuPositions.begin(), gpuPositions.end(), position, lessPosition);
+		if ( onGPU != expected[i] && frustumMargin(helper, instances[i]) > BORDER_EPSILON
+			&& (occluderViewProjection == nullptr || occluderMargin(instances[i], *occluderViewProjection) > BORDER_EPSILON) )
+		{
+			numErrors++;
+		}
+	}
+	return numErrors;
+}
+
+std::vector<glm::mat4> readVisibleMatrices(Culling::GPUCulling& gpuCulling, unsigned int count)
+{
+	std::vector<glm::mat4> matrices(count);
+	if ( count == 0 ) { return matrices; }
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gpuCulling.getVisibleMatrixBuffer());
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(glm::mat4), &matrices[0]);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return matrices;
+}
+
+bool commandsConsistent(Culling::GPUCulling& gpuCulling, unsigned int expectedCount) //!< every command must carry the visible count
+{
+	std::vector<DrawElementsIndirectCommand> commands(gpuCulling.getNumCommands());
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gpuCulling.getCommandBuffer());
+	glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), &commands[0]);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	for (const auto& c : commands)
+	{
+		if ( c.instanceCount != expectedCount ) { return false; }
+	}
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	// compute shaders need a 4.3 context, hidden since nothing is presented
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	glewExperimental = GL_TRUE;
+	auto window = generateWindow(WINDOW_RESOLUTION.x, WINDOW_RESOLUTION.y);
+
+	if ( !Culling::GPUCulling::isSupported() )
+	{
+		std::cout << "FAIL compute shaders are not supported by this context" << std::endl;
+		destroyWindow(window);
+		return 1;
+	}
+
+	std::vector<Culling::CullingInfo> instances = generateInstances();
+	std::vector<Renderable*> renderables;
+	renderables.push_back(new Sphere());
+	renderables.push_back(new TruncatedCone());
+
+	Culling::GPUCulling gpuCulling(renderables, (unsigned int) instances.size());
+	gpuCulling.setInstances(instances);
+
+	glm::mat4 view = glm::lookAt(glm::vec3(10.0f, 20.0f, 90.0f), glm::vec3(0.0f, -5.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float) WINDOW_RESOLUTION.x / (float) WINDOW_RESOLUTION.y, 0.5f, 150.0f);
+	glm::mat4 viewProjection = projection * view;
+
+	Culling::CullingHelper cullingHelper;
+	cullingHelper.setViewProjectionMatrix(viewProjection);
+
+	int numFailed = 0;
+
+	///////////////////////////// FRUSTUM ////////////////////////////////////////
+	std::vector<bool> inFrustum(instances.size());
+	unsigned int numInFrustum = 0;
+	for (unsigned int i = 0; i < instances.size(); i++)
+	{
+		glm::vec3 center, extent;
+		float radius;
+		Culling::getWorldSpaceBounds(instances[i], center, extent, radius);
+		inFrustum[i] = cullingHelper.boxInFrustum(center - extent, center + extent) != Culling::CullingHelper::OUTSIDE;
+		if (inFrustum[i]) { numInFrustum++; }
+	}
+	unsigned int numCPUVisible = (unsigned int) cullingHelper.cullAgainstFrustum(instances).size();
+	numFailed += TestReport::report("cpu reference", numCPUVisible == numInFrustum, DebugLog::to_string(numCPUVisible) + " vs. " + DebugLog::to_string(numInFrustum) + " box tests");
+
+	gpuCulling.cull(viewProjection);
+	unsigned int numGPUVisible = gpuCulling.readVisibleCount();
+	int numErrors = compare(readVisibleMatrices(gpuCulling, numGPUVisible), instances, inFrustum, cullingHelper);
+	numFailed += TestReport::report("frustum", numErrors == 0, DebugLog::to_string(numGPUVisible) + " / " + DebugLog::to_string((int) instances.size()) + " visible, cpu: " + DebugLog::to_string(numInFrustum) + ", mismatches: " + DebugLog::to_string(numErrors));
+	numFailed += TestReport::report("frustum commands", commandsConsistent(gpuCulling, numGPUVisible), DebugLog::to_string(gpuCulling.getNumCommands()) + " commands");
+
+	///////////////////////////// HI-Z //////////////////////////////////////////
+	// a depth buffer cleared to a constant acts like a wall at OCCLUDER_DEPTH
+	GLuint depthTexture;
+	glGenTextures(1, &depthTexture);
+	OPENGLCONTEXT->bindTexture(depthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, WINDOW_RESOLUTION.x, WINDOW_RESOLUTION.y);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	GLuint fbo;
+	glGenFramebuffers(1, &fbo);
+	OPENGLCONTEXT->bindFBO(fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glClearDepth(OCCLUDER_DEPTH);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glClearDepth(1.0f);
+	OPENGLCONTEXT->bindFBO(0);
+
+	Culling::HiZBuffer hiZBuffer(WINDOW_RESOLUTION.x, WINDOW_RESOLUTION.y);
+	hiZBuffer.update(depthTexture, viewProjection);
+
+	Culling::DepthPyramid pyramid(WINDOW_RESOLUTION.x, WINDOW_RESOLUTION.y);
+	pyramid.clear(OCCLUDER_DEPTH);
+	pyramid.buildMipmaps();
+	pyramid.viewProjection = viewProjection;
+
+	std::vector<bool> notOccluded(instances.size());
+	unsigned int numNotOccluded = 0;
+	for (unsigned int i = 0; i < instances.size(); i++)
+	{
+		glm::vec3 center, extent;
+		float radius;
+		Culling::getWorldSpaceBounds(instances[i], center, extent, radius);
+		notOccluded[i] = inFrustum[i] && !pyramid.isOccluded(center - extent, center + extent);
+		if (notOccluded[i]) { numNotOccluded++; }
+	}
+
+	gpuCulling.setHiZBuffer(&hiZBuffer);
+	gpuCulling.cull(viewProjection);
+	numGPUVisible = gpuCulling.readVisibleCount();
+	numErrors = compare(readVisibleMatrices(gpuCulling, numGPUVisible), instances, notOccluded, cullingHelper, &viewProjection);
+	numFailed += TestReport::report("hi-z", numErrors == 0 && numNotOccluded < numInFrustum, DebugLog::to_string(numGPUVisible) + " / " + DebugLog::to_string(numInFrustum) + " not occluded, cpu: " + DebugLog::to_string(numNotOccluded) + ", mismatches: " + DebugLog::to_string(numErrors));
+	numFailed += TestReport::report("hi-z commands", commandsConsistent(gpuCulling, numGPUVisible), DebugLog::to_string(gpuCulling.getNumCommands()) + " commands");
+
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &depthTexture);
+	for (auto r : renderables) { delete r; }
+	destroyWindow(window);
+
+	return numFailed;
+}
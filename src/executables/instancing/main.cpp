@@ -8,6 +8,13 @@
 #include <Rendering/GLTools.h>
 #include <Rendering/VertexArrayObjects.h>
 #include <Rendering/RenderPass.h>
+#include <Rendering/CullingTools.h>
+#include <Rendering/GPUCulling.h>
+#include <Rendering/RingBuffer.h>
+#include <Rendering/Benchmark.h>
+#include <Rendering/VertexFormat.h>
+
+#include <Core/GPUProfiler.h>
 
 //#include "UI/imgui/imgui.h"
 //#include <UI/imguiTools.h>
@@ -63,9 +70,10 @@ std::vector<glm::mat4 > generateModels(int numObjects, float xSize, float zSize)
 	return models;
 }
 
-int main()
+int main(int argc, char** argv)
 {
 	DEBUGLOG->setAutoPrint(true);
+	Benchmark::parseArguments(argc, argv, "instancing");
 	auto window = generateWindow(WINDOW_RESOLUTION.x,WINDOW_RESOLUTION.y);
 
 	//////////////////////////////////////////////////////////////////////////////
@@ -81,7 +89,9 @@ int main()
 	std::string modelFile = "cube.dae";
 	
 	const aiScene* scene = AssimpTools::importAssetFromResourceFolder(modelFile, importer);
-	auto renderable = AssimpTools::createSimpleRenderablesFromScene(scene);
+	VertexFormat vertexFormat; // half float uvs, packed normals and tangents: float positions keep the instance matrices valid as they are
+	auto renderable = AssimpTools::createSimpleRenderablesFromScene(scene, glm::mat4(1.0f), true, &vertexFormat);
+	if (!renderable.empty()) { DEBUGLOG->log("Bytes per vertex: ", (int) renderable[0].vertexStride); }
 	std::unordered_map<aiTextureType, AssimpTools::MaterialTextureInfo, AssimpTools::EnumClassHash> texturesInfo;
 	if (renderable.empty()) { DEBUGLOG->log("ERROR: no renderable. Going to Exit."); float wait; cin >> wait; exit(-1);}
 	if (scene != NULL) texturesInfo = AssimpTools::getMaterialTexturesInfo(scene, 0);
@@ -106,14 +116,35 @@ int main()
 	glm::vec4 eye(10.0f, 10.0f, 10.0f, 1.0f);
 	glm::vec4 center(0.0f,0.0f,0.0f,1.0f);
 	glm::mat4 view = glm::lookAt(glm::vec3(eye), glm::vec3(center), glm::vec3(0,1,0));
+	Benchmark::CameraPath cameraPath = Benchmark::CameraPath::orbit(glm::vec3(eye), glm::vec3(center));
 
 	glm::mat4 perspective = glm::perspective(glm::radians(65.f), getRatio(window), 0.5f, 100.f);
 	
 	DEBUGLOG->log("Setup: generating model matrices"); DEBUGLOG->indent();
-	srand (time(NULL));	
+	srand(Benchmark::isEnabled() ? 0 : (unsigned int) time(NULL)); // same scene in every benchmark run
 	std::vector<glm::mat4 > model = generateModels(NUM_INSTANCES, -15.0f, 15.0f);
 	DEBUGLOG->outdent();
 
+	/////////////////////   Culling Settings           //////////////////////////
+	std::vector<Culling::CullingInfo> instanceCullingInfo(NUM_INSTANCES);
+	for (int i = 0; i < NUM_INSTANCES; i++)
+	{
+		instanceCullingInfo[i] = Culling::getCullingInfo(renderable[0], model[i]).second;
+	}
+	Culling::CullingHelper cullingHelper;
+	DEBUGLOG->log("Culling threads: ", cullingHelper.getNumThreads());
+	unsigned int numVisibleInstances = NUM_INSTANCES;
+
+	// cull on the GPU if compute shaders are available, the CPU then never touches instance data after setup
+	Culling::GPUCulling* gpuCulling = nullptr;
+	if ( Culling::GPUCulling::isSupported() )
+	{
+		DEBUGLOG->log("Culling on GPU");
+		std::vector<Renderable*> culledRenderables(1, renderable[0].renderable);
+		gpuCulling = new Culling::GPUCulling(culledRenderables, NUM_INSTANCES);
+		gpuCulling->setInstances(instanceCullingInfo);
+	}
+
 	/////////////////////   Instancing Settings        //////////////////////////
 	DEBUGLOG->log("Setup: buffering model matrices"); DEBUGLOG->indent();
 	// buffer model matrices
@@ -124,7 +155,7 @@ int main()
     //glGenBuffers(1, &instanceModelBufferHandle);
     //glBindBuffer(GL_ARRAY_BUFFER, instanceModelBufferHandle);
     //glBufferData(GL_ARRAY_BUFFER, NUM_INSTANCES * sizeof(glm::mat4), &model[0], GL_STATIC_DRAW);
-	 GLuint instanceModelBufferHandle = bufferData<glm::mat4>(model, GL_STATIC_DRAW);
+	 GLuint instanceModelBufferHandle = bufferData<glm::mat4>(model, GL_STREAM_DRAW); // rewritten with visible instances every frame
     
     // mat4 Vertex Attribute == 4 x vec4 attributes (consecutively)
 	GLuint instancedAttributeLocation = 4; // beginning attribute location (0..3 are reserved for pos,uv,norm,tangents
@@ -144,6 +175,11 @@ int main()
     glVertexAttribDivisor(instancedAttributeLocation+2, 1);
     glVertexAttribDivisor(instancedAttributeLocation+3, 1);
 	renderable[0].renderable->unbind();
+
+	if ( gpuCulling != nullptr )
+	{
+		gpuCulling->attachInstanceAttribute(renderable[0].renderable, instancedAttributeLocation); // source matrices from the compacted buffer instead
+	}
 	DEBUGLOG->outdent();
 
 	/////////////////////// 	Shader     ///////////////////////////
@@ -161,13 +197,13 @@ int main()
 	ShaderProgram::updateValuesInBufferData("projection", glm::value_ptr(perspective), sizeof(glm::mat4) / sizeof(float), uniformBlockInfo, matrixData);  
 	ShaderProgram::updateValuesInBufferData("view", glm::value_ptr(view), sizeof(glm::mat4) / sizeof(float), uniformBlockInfo, matrixData);  
 
-	GLuint bindingPoint = 1, buffer, blockIndex;
+	GLuint bindingPoint = 1, blockIndex;
  
 	//blockIndex = glGetUniformBlockIndex(shaderProgram.getShaderProgramHandle(), "MatrixBlock");
 	blockIndex = uniformBlockInfo.index;
 	glUniformBlockBinding(shaderProgram.getShaderProgramHandle(), blockIndex, bindingPoint); // bind block 0 to binding point 1
  
-	buffer = ShaderProgram::createUniformBlockBuffer(matrixData, bindingPoint);
+	RingBuffer uniformRingBuffer(uniformBlockInfo.byteSize); // matrices are rewritten every frame
 
 	shaderProgram.update("color", glm::vec4(0.7,0.7,0.7,1.0));
 	DEBUGLOG->outdent();
@@ -223,11 +259,16 @@ int main()
 	//////////////////////////////// RENDER LOOP /////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
 
+	GPUProfiler profiler;
+	Benchmark::setProfiler(&profiler);
+
 	double elapsedTime = 0.0;
 	render(window, [&](double dt)
 	{
 		elapsedTime += dt;
-		std::string window_header = "Instancing Test - " + DebugLog::to_string( 1.0 / dt ) + " FPS";
+		profiler.beginFrame();
+		std::string visibleInfo = (gpuCulling != nullptr) ? std::string("GPU culled") : DebugLog::to_string( numVisibleInstances ) + " / " + DebugLog::to_string( NUM_INSTANCES ) + " visible";
+		std::string window_header = "Instancing Test - " + DebugLog::to_string( 1.0 / dt ) + " FPS - " + visibleInfo;
 		glfwSetWindowTitle(window, window_header.c_str() );
 
 		////////////////////////////////     GUI      ////////////////////////////////
@@ -241,6 +282,7 @@ int main()
 		///////////////////////////// MATRIX UPDATING ///////////////////////////////
 		glm::vec3  rotatedEye = glm::vec3(turntable.getRotationMatrix() * eye);  
 		view = glm::lookAt(glm::vec3(rotatedEye), glm::vec3(center), glm::vec3(0.0f, 1.0f, 0.0f));
+		if (Benchmark::isEnabled()) { view = cameraPath.getViewMatrix(Benchmark::getTime()); }
 		//////////////////////////////////////////////////////////////////////////////
 				
 		////////////////////////  SHADER / UNIFORM UPDATING //////////////////////////
@@ -248,10 +290,36 @@ int main()
 		//glBindBuffer(GL_UNIFORM_BUFFER, buffer);
 		//glBufferData(GL_UNIFORM_BUFFER, matrixData.size() * sizeof(glm::mat4), &matrixData[0], GL_DYNAMIC_DRAW);
 
-		ShaderProgram::updateValueInBuffer("view", glm::value_ptr(view), sizeof(glm::mat4) / sizeof(float), uniformBlockInfo, buffer);
+		ShaderProgram::updateValuesInBufferData("view", glm::value_ptr(view), sizeof(glm::mat4) / sizeof(float), uniformBlockInfo, matrixData);
+		uniformRingBuffer.beginFrame();
+		uniformRingBuffer.bindRange(bindingPoint, uniformRingBuffer.upload(&matrixData[0], uniformBlockInfo.byteSize));
+		//////////////////////////////////////////////////////////////////////////////
+
+		///////////////////////////// CULLING ////////////////////////////////////////
+		profiler.beginScope("culling");
+		if ( gpuCulling != nullptr )
+		{
+			// compute pass writes visible matrices and the indirect draw command
+			gpuCulling->cull(perspective * view);
+		}
+		else
+		{
+			// write visible instance matrices straight into the instance attribute buffer
+			cullingHelper.setViewProjectionMatrix(perspective * view);
+			glBindBuffer(GL_ARRAY_BUFFER, instanceModelBufferHandle);
+			glm::mat4* instanceMatrices = (glm::mat4*) glMapBufferRange(GL_ARRAY_BUFFER, 0, NUM_INSTANCES * sizeof(glm::mat4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (instanceMatrices != nullptr)
+			{
+				numVisibleInstances = cullingHelper.cullAgainstFrustum(instanceCullingInfo, instanceMatrices);
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		profiler.endScope();
 		//////////////////////////////////////////////////////////////////////////////
 		
 		////////////////////////////////  RENDERING //// /////////////////////////////
+		profiler.beginScope("rendering");
 		// clear stuff
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		
@@ -262,7 +330,9 @@ int main()
 		shaderProgram.use();
 
 		// render instanced
-		renderable[0].renderable->drawInstanced(NUM_INSTANCES);
+		if ( gpuCulling != nullptr ) { gpuCulling->draw(); }
+		else { renderable[0].renderable->drawInstanced(numVisibleInstances); }
+		profiler.endScope();
 	
 		// ImGui::Render();
 		// glDisable(GL_BLEND);
@@ -271,7 +341,8 @@ int main()
 
 	});
 
+	delete gpuCulling;
 	destroyWindow(window);
 
-	return 0;
+	return Benchmark::getExitCode();
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * checks and statistics of the MeshOptimization pipeline:
+ * a grid with shuffled triangles, a TruncatedCone (GL_TRIANGLES) and the meshes of a model are optimized,
+ * ACMR / ATVR before and after are printed. Each mesh must keep its triangles (same vertex attributes, same winding),
+ * be optimized to the same result twice and not get worse. 16 bit index conversion is checked as well.
+ * Prints OK / FAIL per test, exit code is the number of failed tests.
+ * usage: meshOptimizationTest [model file relative to RESOURCES_PATH]
+ ****************************************/
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include <Core/DebugLog.h>
+#include <Core/TestReport.h>
+#include <Importing/AssimpTools.h>
+#include <Importing/MeshOptimization.h>
+#include <Rendering/VertexArrayObjects.h>
+
+#include <assimp/Importer.hpp>
+
+////////////////////// PARAMETERS /////////////////////////////
+const int GRID_SIZE = 100; // quads per side
+const unsigned int CACHE_SIZE = 16;
+const std::string DEFAULT_MODEL = "cube.dae";
+
+//////////////////// MISC /////////////////////////////////////
+AssimpTools::VertexData generateShuffledGrid()
+{
+	AssimpTools::VertexData mesh;
+	for (int y = 0; y <= GRID_SIZE; y++)
+	{
+		for (int x = 0; x <= GRID_SIZE; x++)
+		{
+			mesh.positions.push_back((float) x);
+			mesh.positions.push_back((float) y);
+			mesh.positions.push_back(0.0f);
+			mesh.uvs.push_back((float) x / (float) GRID_SIZE);
+			mesh.uvs.push_back((float) y / (float) GRID_SIZE);
+		}
+	}
+
+	std::vector<unsigned int> quads(GRID_SIZE * GRID_SIZE);
+	for (unsigned int i = 0; i < quads.size(); i++) { quads[i] = i; }
+	for (unsigned int i = (unsigned int) quads.size() - 1; i > 0; i--) { std::swap(quads[i], quads[std::rand() % (i + 1)]); }
+
+	for (unsigned int i = 0; i < quads.size(); i++)
+	{
+		unsigned int x = quads[i] % GRID_SIZE, y = quads[i] / GRID_SIZE;
+		unsigned int v = y * (GRID_SIZE + 1) + x;
+		unsigned int triangles[6] = { v, v + 1, v + GRID_SIZE + 2, v, v + GRID_SIZE + 2, v + GRID_SIZE + 1 };
+		mesh.indices.insert(mesh.indices.end(), triangles, triangles + 6);
+	}
+	return mesh;
+}
+
+/// every triangle as its attribute values, starting at the smallest so rotations compare equal while the winding is kept
+std::vector<std::vector<float> > triangleSet(const AssimpTools::VertexData& mesh)
+{
+	std::vector<std::vector<float> > result;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		std::vector<float> corners[3];
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = mesh.indices[i + c];
+			corners[c].insert(corners[c].end(), mesh.positions.begin() + 3 * v, mesh.positions.begin() + 3 * v + 3);
+			if ( !mesh.normals.empty() ) { corners[c].insert(corners[c].end(), mesh.normals.begin() + 3 * v, mesh.normals.begin() + 3 * v + 3); }
+		}
+		int first = (int) (std::min_element(corners, corners + 3) - corners);
+		std::vector<float> triangle;
+		for (int c = 0; c < 3; c++) { triangle.insert(triangle.end(), corners[(first + c) % 3].begin(), corners[(first + c) % 3].end()); }
+		result.push_back(triangle);
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+bool isEqual(const AssimpTools::VertexData& a, const AssimpTools::VertexData& b)
+{
+	return a.indices == b.indices && a.positions == b.positions && a.uvs == b.uvs && a.normals == b.normals && a.tangents == b.tangents;
+}
+
+std::string toString(const MeshOptimization::CacheStatistics& statistics)
+{
+	return "ACMR " + DebugLog::to_string(statistics.acmr) + ", ATVR " + DebugLog::to_string(statistics.atvr);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	std::srand(1);
+	std::vector<std::pair<std::string, AssimpTools::VertexData> > meshes;
+	meshes.push_back(std::make_pair(std::string("shuffled grid"), generateShuffledGrid()));
+
+	// generated meshes are strips or unindexed, except for the triangle list variant of TruncatedCone
+	TruncatedCone::VertexData cone = TruncatedCone::generateVertexData(1.0f, 1.0f, 0.5f, 64, 0.0f, GL_TRIANGLES);
+	AssimpTools::VertexData coneMesh;
+	coneMesh.indices = cone.indices;
+	coneMesh.positions = cone.positions;
+	coneMesh.uvs = cone.uv_coords;
+	coneMesh.normals = cone.normals;
+	meshes.push_back(std::make_pair(std::string("truncated cone"), coneMesh));
+
+	Assimp::Importer importer;
+	const aiScene* scene = AssimpTools::importAssetFromResourceFolder( (argc > 1) ? std::string(argv[1]) : DEFAULT_MODEL, importer);
+	if ( scene != nullptr )
+	{
+		auto vertexData = AssimpTools::createVertexDataInstancesFromScene(scene);
+		for (unsigned int i = 0; i < vertexData.size(); i++)
+		{
+			meshes.push_back(std::make_pair("mesh " + DebugLog::to_string((int) i), vertexData[i]));
+		}
+	}
+
+	int numFailed = 0;
+	for (unsigned int m = 0; m < meshes.size(); m++)
+	{
+		const std::string& name = meshes[m].first;
+		AssimpTools::VertexData optimized = meshes[m].second;
+		AssimpTools::VertexData optimizedAgain = meshes[m].second;
+
+		MeshOptimization::Report statistics = MeshOptimization::optimize(optimized, CACHE_SIZE);
+		MeshOptimization::optimize(optimizedAgain, CACHE_SIZE);
+
+		numFailed += TestReport::report(name + ", statistics", statistics.after.acmr <= statistics.before.acmr,
+			"before: " + toString(statistics.before) + ", after: " + toString(statistics.after)
+			+ ", triangles: " + DebugLog::to_string((int) statistics.after.numTriangles));
+		numFailed += TestReport::report(name + ", triangles kept", triangleSet(optimized) == triangleSet(meshes[m].second), "");
+		numFailed += TestReport::report(name + ", deterministic", isEqual(optimized, optimizedAgain), "");
+
+		std::vector<unsigned short> shortIndices;
+		bool converted = MeshOptimization::toShortIndices(optimized.indices, shortIndices);
+		bool fits = optimized.positions.size() <= 3 * 65536;
+		bool ok = ( converted == fits ) && ( !converted || std::equal(shortIndices.begin(), shortIndices.end(), optimized.indices.begin()) );
+		numFailed += TestReport::report(name + ", 16 bit indices", ok, converted ? "converted" : "not converted");
+	}
+
+	return numFailed;
+}
@@ -0,0 +1,244 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * many objects sharing a few meshes from a MeshPool,
+ * drawn with one glMultiDrawElementsIndirect call per frame
+ * press M to switch between multi draw and one draw per object
+ ****************************************/
+
+#include <iostream>
+#include <time.h>
+
+#include <Rendering/GLTools.h>
+#include <Rendering/VertexArrayObjects.h>
+#include <Rendering/RenderPass.h>
+#include <Rendering/MeshPool.h>
+#include <Rendering/CullingTools.h>
+
+#include <UI/Turntable.h>
+
+#include <glm/gtx/transform.hpp>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <Importing/AssimpTools.h>
+
+////////////////////// PARAMETERS /////////////////////////////
+const glm::vec2 WINDOW_RESOLUTION = glm::vec2(800.0f, 600.0f);
+
+const int NUM_OBJECTS = 20000;
+const float SCENE_SIZE = 60.0f;
+
+static bool s_multiDraw = true;
+
+//////////////////// MISC /////////////////////////////////////
+float randFloat(float min, float max) //!< returns a random number between min and max
+{
+	return (((float) rand() / (float) RAND_MAX) * (max - min) + min); 
+}
+
+AssimpTools::VertexData coneVertexData(float radiusTop) //!< a cone as triangle list
+{
+	TruncatedCone::VertexData cone = TruncatedCone::generateVertexData(1.0f, 0.5f, radiusTop, 16, -0.5f, GL_TRIANGLES);
+	AssimpTools::VertexData result;
+	result.indices = cone.indices;
+	result.positions = cone.positions;
+	result.uvs = cone.uv_coords;
+	result.normals = cone.normals;
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	DEBUGLOG->setAutoPrint(true);
+	auto window = generateWindow(WINDOW_RESOLUTION.x,WINDOW_RESOLUTION.y);
+
+	if ( !(GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect) )
+	{
+		DEBUGLOG->log("WARNING: multi draw indirect is not supported, falling back to one draw per object");
+	}
+
+	/////////////////////    fill mesh pool             //////////////////////////
+	DEBUGLOG->log("Setup: filling mesh pool"); DEBUGLOG->indent();
+	Assimp::Importer importer;
+	const aiScene* scene = AssimpTools::importAssetFromResourceFolder("cube.dae", importer);
+	std::vector<AssimpTools::VertexData> vertexData;
+	if (scene != NULL) { vertexData = AssimpTools::createVertexDataInstancesFromScene(scene); }
+	vertexData.push_back(coneVertexData(0.0f));
+	vertexData.push_back(coneVertexData(0.25f));
+
+	MeshPool meshPool;
+	std::vector<PooledRenderable*> meshes;
+	std::vector<AssimpTools::BoundingBox> meshBounds;
+	for (auto& v : vertexData)
+	{
+		PooledRenderable* mesh = meshPool.addMesh(v);
+		if ( mesh == nullptr ) { continue; }
+		meshes.push_back(mesh);
+		meshBounds.push_back(AssimpTools::computeBoundingBox(v));
+	}
+	meshPool.upload();
+	DEBUGLOG->outdent();
+
+	/////////////////////     objects                   //////////////////////////
+	srand (time(NULL));
+	std::vector<PooledRenderable*> objectMeshes(NUM_OBJECTS);
+	std::vector<Culling::CullingInfo> objectCullingInfo(NUM_OBJECTS);
+	for (int i = 0; i < NUM_OBJECTS; i++)
+	{
+		int meshIdx = rand() % meshes.size();
+		glm::mat4 model = glm::translate(glm::vec3(randFloat(-SCENE_SIZE, SCENE_SIZE), randFloat(-5.0f, 5.0f), randFloat(-SCENE_SIZE, SCENE_SIZE)))
+			* glm::rotate(randFloat(0.0f, 6.28f), glm::vec3(0.0f, 1.0f, 0.0f))
+			* glm::scale(glm::vec3(randFloat(0.2f, 0.6f)));
+
+		objectMeshes[i] = meshes[meshIdx];
+		AssimpTools::RenderableInfo info;
+		info.renderable = meshes[meshIdx];
+		info.boundingBox = meshBounds[meshIdx];
+		objectCullingInfo[i] = Culling::getCullingInfo(info, model).second;
+	}
+
+	/////////////////////     Scene / View Settings     //////////////////////////
+	glm::vec4 eye(20.0f, 15.0f, 20.0f, 1.0f);
+	glm::vec4 center(0.0f,0.0f,0.0f,1.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(eye), glm::vec3(center), glm::vec3(0,1,0));
+	glm::mat4 perspective = glm::perspective(glm::radians(65.f), getRatio(window), 0.5f, 200.f);
+
+	Culling::CullingHelper cullingHelper;
+
+	/////////////////////// 	Shader     ///////////////////////////
+	DEBUGLOG->log("Shader Compilation: multi draw simple lighting"); DEBUGLOG->indent();
+	ShaderProgram shaderProgram("/modelSpace/multiDrawModelViewProjection.vert", "/modelSpace/simpleLighting.frag"); DEBUGLOG->outdent();
+	shaderProgram.update("projection", perspective);
+	shaderProgram.update("color", glm::vec4(0.7f, 0.7f, 0.7f, 1.0f));
+	shaderProgram.update("blendColor", 0.0f);
+
+	// per draw model matrices, indexed by draw index
+	GLuint modelMatrixBuffer;
+	glGenBuffers(1, &modelMatrixBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, modelMatrixBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_OBJECTS * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, modelMatrixBuffer);
+
+	RenderPass renderPass(&shaderProgram);
+	renderPass.addClearBit(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	renderPass.addEnable(GL_DEPTH_TEST);
+	renderPass.setMeshPool(&meshPool);
+
+	// one by one: the draw index attribute is 0, so pass the offset instead
+	int drawIndexOffset = 0;
+	std::function<void(Renderable*)> perRenderableFunction = [&](Renderable* r){
+		shaderProgram.update("drawIndexOffset", drawIndexOffset++);
+	};
+	renderPass.setPerRenderableFunction(&perRenderableFunction);
+
+	//////////////////////////////////////////////////////////////////////////////
+	///////////////////////    GUI / USER INPUT   ////////////////////////////////
+	//////////////////////////////////////////////////////////////////////////////
+
+	Turntable turntable;
+	double old_x;
+    double old_y;
+	glfwGetCursorPos(window, &old_x, &old_y);
+	
+	auto cursorPosCB = [&](double x, double y)
+	{
+		double d_x = x - old_x;
+		double d_y = y - old_y;
+
+		if ( turntable.getDragActive() )
+		{
+			turntable.dragBy(d_x, d_y, view);
+		}
+
+		old_x = x;
+		old_y = y;
+	};
+
+	auto mouseButtonCB = [&](int b, int a, int m)
+	{
+		if (b == GLFW_MOUSE_BUTTON_LEFT && a == GLFW_PRESS)
+		{
+			turntable.setDragActive(true);
+		}
+		if (b == GLFW_MOUSE_BUTTON_LEFT && a == GLFW_RELEASE)
+		{
+			turntable.setDragActive(false);
+		}
+	};
+
+	auto keyboardCB = [&](int k, int s, int a, int m)
+	{
+		if (k == GLFW_KEY_M && a == GLFW_PRESS)
+		{
+			s_multiDraw = !s_multiDraw;
+			renderPass.setMeshPool( s_multiDraw ? &meshPool : nullptr );
+		}
+	};
+
+	setCursorPosCallback(window, cursorPosCB);
+	setMouseButtonCallback(window, mouseButtonCB);
+	setKeyCallback(window, keyboardCB);
+
+	//////////////////////////////////////////////////////////////////////////////
+	//////////////////////////////// RENDER LOOP /////////////////////////////////
+	//////////////////////////////////////////////////////////////////////////////
+
+	std::vector<glm::mat4> visibleModelMatrices;
+	visibleModelMatrices.reserve(NUM_OBJECTS);
+	render(window, [&](double dt)
+	{
+		const RenderPass::SubmissionStatistics& statistics = renderPass.getSubmissionStatistics();
+		std::string window_header = "Multi Draw Indirect - " + DebugLog::to_string( 1.0 / dt ) + " FPS - "
+			+ DebugLog::to_string( (int) visibleModelMatrices.size() ) + " / " + DebugLog::to_string( NUM_OBJECTS ) + " visible - "
+			+ DebugLog::to_string( statistics.numDraws ) + " draw calls" + (s_multiDraw ? " (M: multi draw)" : " (M: one by one)");
+		glfwSetWindowTitle(window, window_header.c_str() );
+
+		///////////////////////////// MATRIX UPDATING ///////////////////////////////
+		glm::vec3 rotatedEye = glm::vec3(turntable.getRotationMatrix() * eye);  
+		view = glm::lookAt(rotatedEye, glm::vec3(center), glm::vec3(0.0f, 1.0f, 0.0f));
+		shaderProgram.update("view", view);
+		//////////////////////////////////////////////////////////////////////////////
+
+		///////////////////////////// CULLING ////////////////////////////////////////
+		// draw order of the render pass == order of the model matrices in the buffer
+		cullingHelper.setViewProjectionMatrix(perspective * view);
+		renderPass.clearRenderables();
+		visibleModelMatrices.clear();
+		glm::vec3 boundsCenter, boundsExtent;
+		float boundsRadius;
+		for (int i = 0; i < NUM_OBJECTS; i++)
+		{
+			Culling::getWorldSpaceBounds(objectCullingInfo[i], boundsCenter, boundsExtent, boundsRadius);
+			if ( cullingHelper.boxInFrustum(boundsCenter - boundsExtent, boundsCenter + boundsExtent) != Culling::CullingHelper::OUTSIDE )
+			{
+				renderPass.addRenderable(objectMeshes[i]);
+				visibleModelMatrices.push_back(objectCullingInfo[i].modelMatrix);
+			}
+		}
+
+		if ( !visibleModelMatrices.empty() )
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, modelMatrixBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_OBJECTS * sizeof(glm::mat4), NULL, GL_STREAM_DRAW); // orphan
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, visibleModelMatrices.size() * sizeof(glm::mat4), &visibleModelMatrices[0]);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+		}
+		//////////////////////////////////////////////////////////////////////////////
+		
+		////////////////////////////////  RENDERING //// /////////////////////////////
+		drawIndexOffset = 0;
+		shaderProgram.update("drawIndexOffset", 0);
+		renderPass.render();
+		//////////////////////////////////////////////////////////////////////////////
+	});
+
+	glDeleteBuffers(1, &modelMatrixBuffer);
+	destroyWindow(window);
+
+	return 0;
+}
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <time.h>
+#include <algorithm>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <Importing/AssimpTools.h>
@@ -24,7 +25,11 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <Core/Camera.h>
+#include <Core/GPUProfiler.h>
+#include <Rendering/Benchmark.h>
+#include <Rendering/GoldenImages.h>
 #include <Rendering/CullingTools.h>
+#include <Rendering/OcclusionCulling.h>
 
 ////////////////////// PARAMETERS /////////////////////////////
 const glm::vec2 WINDOW_RESOLUTION = glm::vec2(800.0f, 600.0f);
@@ -34,6 +39,8 @@ static glm::vec4 s_light_position = glm::vec4(-2.16f, 2.6f, 10.0f,1.0);
 static glm::vec3 s_scale = glm::vec3(1.0f,1.0f,1.0f);
 
 static float s_strength = 1.0f;
+static bool s_occlusionCulling = true;
+static bool s_sortedSubmission = true;
 //////////////////// MISC /////////////////////////////////////
 float randFloat(float min, float max) //!< returns a random number between min and max
 {
@@ -43,9 +50,10 @@ float randFloat(float min, float max) //!< returns a random number between min a
 //////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////// MAIN ///////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
-int main()
+int main(int argc, char** argv)
 {
 	DEBUGLOG->setAutoPrint(true);
+	Benchmark::parseArguments(argc, argv, "postprocessing");
 
 	//////////////////////////////////////////////////////////////////////////////
 	/////////////////////// INIT //////////////////////////////////
@@ -71,6 +79,7 @@ int main()
 	Camera camera;
 	camera.setProjectionMatrix(perspective);
 	Culling::CullingHelper cullingHelper(&camera);
+	Benchmark::CameraPath cameraPath = Benchmark::CameraPath::orbit(glm::vec3(0.0f, 1.0f, 9.0f), glm::vec3(0.0f), 15.0); // sun and objects come in and out of view
 
 	//objects
 	std::vector<AssimpTools::RenderableInfo > objects;
@@ -108,7 +117,7 @@ int main()
 	DEBUGLOG->outdent();
 
 	//colors
-	srand(time(NULL));
+	srand(Benchmark::isEnabled() ? 0 : (unsigned int) time(NULL)); // same scene in every benchmark run
 	std::unordered_map<Renderable*, glm::vec4> colors;
 	colors[objects[0].renderable] = glm::vec4(randFloat(0.2f,1.0f), randFloat(0.2f,1.0f), randFloat(0.2f,1.0f),1.0f);
 	colors[objects[1].renderable] = glm::vec4(randFloat(0.2f,1.0f), randFloat(0.2f,1.0f), randFloat(0.2f,1.0f),1.0f);
@@ -117,7 +126,7 @@ int main()
 	colors[objects[4].renderable] = glm::vec4(randFloat(0.2f,1.0f), randFloat(0.2f,1.0f), randFloat(0.2f,1.0f),1.0f);
 	colors[objects[5].renderable] = glm::vec4(randFloat(0.2f,1.0f), randFloat(0.2f,1.0f), randFloat(0.2f,1.0f),1.0f);
 
-	// cull info
+	// cull info, model matrices are replaced every frame by the ones used for drawing (turntable and scale)
 	std::vector< std::pair< Renderable*, Culling::CullingInfo> >cullInfo;
 	for( auto r : objects )
 	{
@@ -165,7 +174,7 @@ int main()
 
 	DEBUGLOG->log("RenderPass Creation: GBuffer"); DEBUGLOG->indent();
 	RenderPass renderGBuffer(&shaderProgram, &gbufferFBO);
-	renderGBuffer.addEnable(GL_DEPTH_TEST);	
+	renderGBuffer.setPipelineState(PipelineState().setEnabled(PipelineState::DEPTH_TEST));
 	renderGBuffer.setClearColor(0.0,0.0,0.0,0.0);
 	renderGBuffer.addClearBit(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 	for (auto r : objects){renderGBuffer.addRenderable(r.renderable);}  
@@ -186,7 +195,7 @@ int main()
 	RenderPass compositing(&compShader, &compFBO);
 	compositing.addClearBit(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	compositing.setClearColor(0.25,0.25,0.35,0.0);
-	compositing.addDisable(GL_DEPTH_TEST);
+	compositing.setPipelineState(PipelineState()); // no depth test, no blending
 	compositing.addRenderable(&quad);
 	DEBUGLOG->outdent();
 
@@ -197,20 +206,22 @@ int main()
 	PostProcessing::SunOcclusionQuery sunOcclusionQuery(gbufferFBO.getDepthTextureHandle(), glm::vec2(gbufferFBO.getWidth(), gbufferFBO.getHeight()));
 	PostProcessing::LensFlare lensFlare(gbufferFBO.getWidth() / 2, gbufferFBO.getHeight() / 2);
 
+	// occlusion culling against the previous frame's depth
+	Culling::HiZBuffer hiZBuffer(gbufferFBO.getWidth(), gbufferFBO.getHeight(), 128, &quad);
+	Culling::DepthPyramid occlusionPyramid;
+
 	// arbitrary texture display shader
 	ShaderProgram showTexShader("/screenSpace/fullscreen.vert", "/screenSpace/simpleAlphaTexture.frag");
 	RenderPass showTex(&showTexShader,0);
 	showTex.addRenderable(&quad);
-	showTex.addDisable(GL_DEPTH_TEST);
-	showTex.addDisable(GL_BLEND);
+	showTex.setPipelineState(PipelineState());
 	showTex.setViewport(0,0,WINDOW_RESOLUTION.x, WINDOW_RESOLUTION.y);
 
 	// arbitrary texture display shader
 	ShaderProgram addTexShader("/screenSpace/fullscreen.vert", "/screenSpace/postProcessAddTexture.frag");
 	RenderPass addTex(&addTexShader,0);
 	addTex.addRenderable(&quad);
-	addTex.addDisable(GL_DEPTH_TEST);
-	addTex.addDisable(GL_BLEND);
+	addTex.setPipelineState(PipelineState());
 	addTex.setViewport(0,0,WINDOW_RESOLUTION.x, WINDOW_RESOLUTION.y);
 
 	// view from top
@@ -221,7 +232,7 @@ int main()
 	FrameBufferObject topViewFBO(topViewShader.getOutputInfoMap(), WINDOW_RESOLUTION.x / 4, WINDOW_RESOLUTION.y / 4);
 	RenderPass renderTopView(&topViewShader, &topViewFBO);
 	for (auto r : objects){renderTopView.addRenderable(r.renderable);}  
-	renderTopView.addEnable(GL_DEPTH_TEST);
+	renderTopView.setPipelineState(PipelineState().setEnabled(PipelineState::DEPTH_TEST));
 	renderTopView.addClearBit(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	// Skybox
@@ -306,8 +317,17 @@ int main()
 		shaderProgram.update("color", colors[r]);
 	};
 	renderGBuffer.setPerRenderableFunction( &perRenderableFunction );
+
+	// front to back, objects have no textures
+	std::function<RenderPass::SortInfo(Renderable*)> sortInfoFunction = [&](Renderable* r){
+		RenderPass::SortInfo info = {0, 0.0f};
+		info.depth = -(camera.getViewMatrix() * turntable.getRotationMatrix() * modelMatrices[r] * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)).z;
+		return info;
+	};
+	renderGBuffer.setSortInfoFunction( &sortInfoFunction );
 	
 	std::vector<Renderable* > visibleRenderables;
+	std::vector< std::pair< Renderable*, Culling::CullingInfo> > frustumVisible; // input of occlusion culling
 	std::function<void(Renderable*)> topViewPerRenderableFunction = [&](Renderable* r){ 
 		topViewShader.update("model", turntable.getRotationMatrix() * modelMatrices[r] * glm::scale(s_scale));
 		for ( auto vR : visibleRenderables)
@@ -326,10 +346,26 @@ int main()
 	//////////////////////////////// RENDER LOOP /////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
 
+	GPUProfiler profiler;
+	Benchmark::setProfiler(&profiler);
+
+	// compared against golden images with --golden
+	GoldenImages goldenImages;
+	goldenImages.addAttachment("gbuffer_color", &gbufferFBO, "fragColor");
+	goldenImages.addAttachment("gbuffer_normal", &gbufferFBO, "fragNormal");
+	goldenImages.addAttachment("gbuffer_position", &gbufferFBO, "fragPosition");
+	goldenImages.addDepthAttachment("gbuffer_depth", &gbufferFBO);
+	goldenImages.addAttachment("compositing", &compFBO, "fragmentColor");
+	goldenImages.addAttachment("depth_of_field", depthOfField.m_dofCompFBO, "fragmentColor");
+	goldenImages.addAttachment("lens_flare_features", lensFlare.m_featuresFBO, "fResult");
+	goldenImages.addScreen("final", WINDOW_RESOLUTION.x, WINDOW_RESOLUTION.y);
+	Benchmark::setGoldenImages(&goldenImages);
+
 	double elapsedTime = 0.0;
 	render(window, [&](double dt)
 	{
 		elapsedTime += dt;
+		profiler.beginFrame();
 		std::string window_header = "Post Processing Test - " + DebugLog::to_string( 1.0 / dt ) + " FPS";
 		glfwSetWindowTitle(window, window_header.c_str() );
 
@@ -368,6 +404,7 @@ int main()
 		///////////////////////////// VARIABLE UPDATING ///////////////////////////////
 		//view = glm::lookAt(glm::vec3(eye), glm::vec3(center), glm::vec3(0.0f, 1.0f, 0.0f));
 		camera.update(dt);
+		if (Benchmark::isEnabled()) { cameraPath.apply(camera, Benchmark::getTime()); }
 		//update light data
 		glm::vec4 projectedLightPos = camera.getProjectionMatrix() * glm::mat4(glm::mat3(camera.getViewMatrix())) * s_light_position;//multiply with the view-projection matrix
 		projectedLightPos = projectedLightPos / projectedLightPos.w;//perform perspective division
@@ -376,7 +413,18 @@ int main()
 		//////////////////////////////////////////////////////////////////////////////
 		
 		/////////////////////////////   FRUSTUM CULLING    ///////////////////////////
-		visibleRenderables = cullingHelper.cullAgainstFrustum(cullInfo);
+		for (auto& info : cullInfo)
+		{
+			info.second.modelMatrix = turntable.getRotationMatrix() * modelMatrices[info.first] * glm::scale(s_scale);
+		}
+		visibleRenderables = cullingHelper.cullAgainstFrustum(cullInfo, &frustumVisible);
+
+		if ( hiZBuffer.fetchReadback(occlusionPyramid) ) { cullingHelper.setOcclusionPyramid(&occlusionPyramid); }
+		ImGui::Checkbox("occlusion culling", &s_occlusionCulling);
+		if ( s_occlusionCulling && occlusionPyramid.getNumLevels() > 0 )
+		{
+			visibleRenderables = cullingHelper.cullOccluded(frustumVisible);
+		}
 		renderGBuffer.clearRenderables();
 		for (auto r : visibleRenderables) { renderGBuffer.addRenderable(r); };
 		ImGui::Value("visible objects: ", visibleRenderables.size());
@@ -398,12 +446,21 @@ int main()
 		//////////////////////////////////////////////////////////////////////////////
 		
 		////////////////////////////////  RENDERING //// /////////////////////////////
+		ImGui::Checkbox("sorted submission", &s_sortedSubmission);
+		renderGBuffer.setSortedSubmission(s_sortedSubmission);
+		profiler.beginScope("gbuffer");
 		renderGBuffer.render();
+		profiler.endScope();
+		ImGui::Value("gbuffer VAO binds issued", renderGBuffer.getSubmissionStatistics().vaoBindsIssued);
+		ImGui::Value("gbuffer VAO binds avoided", renderGBuffer.getSubmissionStatistics().vaoBindsAvoided);
+		ImGui::Value("gbuffer uniform uploads avoided", renderGBuffer.getSubmissionStatistics().uniformUploadsAvoided);
+		hiZBuffer.update(gbufferFBO.getDepthTextureHandle(), camera.getProjectionMatrix() * camera.getViewMatrix()); // cull info is in world space
 
 		GLuint pixelCount = sunOcclusionQuery.performQuery(projectedLightPos);
 
 		// show light visibility in GUI
 		ImGui::Value("sun visibility", (float) pixelCount / 256.0f);
+		ImGui::Value("sun queries in flight", sunOcclusionQuery.getNumQueriesInFlight());
 
 		if ( s_dynamicDoF )
 		{
@@ -427,7 +484,9 @@ int main()
 		}
 
 		// aka. light pass
+		profiler.beginScope("compositing");
 		compositing.render();
+		profiler.endScope();
 
 		// copy depth buffer content to compFBO to make sure Skybox is rendered correctly
 		copyFBOContent(&gbufferFBO, &compFBO, GL_DEPTH_BUFFER_BIT);
@@ -437,10 +496,14 @@ int main()
 		skyboxRendering.render(cubeMapTexture, &gbufferFBO);
 
 		// execute on GBuffer position texture and compositing ( light pass ) image 
+		profiler.beginScope("depth of field");
 		depthOfField.execute(gbufferFBO.getBuffer("fragPosition"), compFBO.getBuffer("fragmentColor"));
+		profiler.endScope();
 
 		// do it
-		lensFlare.renderLensFlare(depthOfField.m_dofCompFBO->getBuffer("fragmentColor"), 0);
+		profiler.beginScope("lens flare");
+		lensFlare.renderLensFlare(depthOfField.m_dofCompFBO->getBuffer("fragmentColor"), 0, &sunOcclusionQuery);
+		profiler.endScope();
 
 		//addTexShader.updateAndBindTexture("tex", 0, depthOfField.m_dofCompFBO->getBuffer("fragmentColor"));
 		////addTexShader.updateAndBindTexture("addTex", 1, lensFlare.m_featuresFBO->getBuffer("fResult"));
@@ -472,11 +535,12 @@ int main()
 		ImGui::Render();
 		glDisable(GL_BLEND);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); // this is altered by ImGui::Render(), so reset it every frame
+		OPENGLCONTEXT->invalidatePipelineStateCache(); // ImGui changes state behind the context's back
 		//////////////////////////////////////////////////////////////////////////////
 
 	});
 
 	destroyWindow(window);
 
-	return 0;
+	return Benchmark::getExitCode();
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * checks the sort keys of RenderPass sorted submission without a GL context:
+ * renderables with random VAO handles and depths share a few textures, the sorted order must keep every texture together,
+ * SORT_DEPTH_FIRST must draw each texture group front-to-back, SORT_STATE_FIRST must draw each VAO once per texture group.
+ * Prints OK / FAIL per test, exit code is the number of failed tests.
+ * usage: renderSortTest
+ ****************************************/
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+
+#include <Core/DebugLog.h>
+#include <Core/TestReport.h>
+#include <Rendering/RenderPass.h>
+
+////////////////////// PARAMETERS /////////////////////////////
+const int NUM_TEXTURES = 3;
+const int NUM_VAOS = 40;
+const int NUM_RENDERABLES = 600; // several renderables per VAO
+const float MAX_DEPTH = 1000.0f;
+const float DEPTH_KEY_PRECISION = 1.0f / 2048.0f; // relative, depths closer than this may share a key
+
+//////////////////// MISC /////////////////////////////////////
+/// exposes the sorted order, no shader is set so only texture, depth and VAO are sorted
+class SortCheckPass : public RenderPass
+{
+public:
+	const std::vector< unsigned int >& sort() { sortRenderables(); return m_sortedOrder; }
+};
+
+std::vector< Renderable* > renderables;
+std::vector< RenderPass::SortInfo > sortInfos; // same indices as renderables
+
+void generateRenderables()
+{
+	for (int i = 0; i < NUM_RENDERABLES; i++)
+	{
+		Renderable* renderable = new Renderable(); // not deleted, the destructor deletes GL buffers
+		renderable->m_vao = 1 + std::rand() % NUM_VAOS;
+		renderables.push_back(renderable);
+
+		RenderPass::SortInfo sortInfo;
+		sortInfo.texture = 1 + std::rand() % NUM_TEXTURES;
+		sortInfo.depth = MAX_DEPTH * (float) std::rand() / (float) RAND_MAX;
+		sortInfos.push_back(sortInfo);
+	}
+}
+
+int checkOrder(const std::string& name, RenderPass::SortOrder sortOrder)
+{
+	std::function<RenderPass::SortInfo(Renderable*)> sortInfoFunction = [&](Renderable* r)
+	{
+		return sortInfos[std::find(renderables.begin(), renderables.end(), r) - renderables.begin()];
+	};
+
+	SortCheckPass pass;
+	pass.setSortOrder(sortOrder);
+	pass.setSortInfoFunction(&sortInfoFunction);
+	for (unsigned int i = 0; i < renderables.size(); i++) { pass.addRenderable(renderables[i]); }
+	std::vector< unsigned int > order = pass.sort();
+
+	int numFailed = 0;
+	unsigned int textureChanges = 0, vaoChanges = 0, depthInversions = 0;
+	for (unsigned int k = 1; k < order.size(); k++)
+	{
+		const RenderPass::SortInfo& prev = sortInfos[order[k - 1]];
+		const RenderPass::SortInfo& cur = sortInfos[order[k]];
+		if ( cur.texture != prev.texture ) { textureChanges++; continue; }
+		bool sameVao = renderables[order[k]]->m_vao == renderables[order[k - 1]]->m_vao;
+		if ( !sameVao ) { vaoChanges++; }
+		bool inverted = prev.depth - cur.depth > prev.depth * DEPTH_KEY_PRECISION;
+		if ( inverted && (sameVao || sortOrder == RenderPass::SORT_DEPTH_FIRST) ) { depthInversions++; }
+	}
+
+	numFailed += TestReport::report(name + " textures", order.size() == renderables.size() && textureChanges == NUM_TEXTURES - 1,
+		DebugLog::to_string((int) textureChanges) + " texture changes");
+	numFailed += TestReport::report(name + " depth", depthInversions == 0,
+		DebugLog::to_string((int) depthInversions) + " renderables drawn behind their successor");
+	if ( sortOrder == RenderPass::SORT_STATE_FIRST )
+	{
+		numFailed += TestReport::report(name + " vaos", vaoChanges <= NUM_TEXTURES * (NUM_VAOS - 1),
+			DebugLog::to_string((int) vaoChanges) + " VAO changes");
+	}
+	else
+	{
+		std::cout << "     " << name << " - " << vaoChanges << " VAO changes" << std::endl;
+	}
+	return numFailed;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	std::srand(1);
+	int numFailed = 0;
+
+	generateRenderables();
+	numFailed += checkOrder("depth first", RenderPass::SORT_DEPTH_FIRST);
+	numFailed += checkOrder("state first", RenderPass::SORT_STATE_FIRST);
+
+	return numFailed;
+}
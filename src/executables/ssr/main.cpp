@@ -7,6 +7,10 @@
 #include <Rendering/GLTools.h>
 #include <Rendering/VertexArrayObjects.h>
 #include <Rendering/RenderPass.h>
+#include <Rendering/Benchmark.h>
+#include <Rendering/GoldenImages.h>
+
+#include <Core/GPUProfiler.h>
 
 #include "UI/imgui/imgui.h"
 #include <UI/imguiTools.h>
@@ -30,9 +34,10 @@ const glm::vec2 WINDOW_RESOLUTION = glm::vec2(800.0f, 600.0f);
 ///////////////////////////////// MAIN ///////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 
-int main()
+int main(int argc, char** argv)
 {
 	DEBUGLOG->setAutoPrint(true);
+	Benchmark::parseArguments(argc, argv, "ssr");
 
 	//////////////////////////////////////////////////////////////////////////////
 	/////////////////////// INIT //////////////////////////////////
@@ -49,6 +54,7 @@ int main()
 	glm::vec4 eye(0.0f, 0.0f, 3.0f, 1.0f);
 	glm::vec4 center(0.0f,0.0f,0.0f,1.0f);
 	glm::mat4 view = glm::lookAt(glm::vec3(eye), glm::vec3(center), glm::vec3(0,1,0));
+	Benchmark::CameraPath cameraPath = Benchmark::CameraPath::orbit(glm::vec3(eye), glm::vec3(center));
 
 	// glm::mat4 perspective = glm::ortho(-2.0f, 2.0f, -2.0f, 2.0f, -1.0f, 6.0f);
 	/// perspective projection is experimental; yields weird warping effects due to vertex interpolation of uv-coordinates
@@ -255,10 +261,23 @@ int main()
 	//////////////////////////////// RENDER LOOP /////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
 
+	GPUProfiler profiler;
+	Benchmark::setProfiler(&profiler);
+
+	// compared against golden images with --golden
+	GoldenImages goldenImages;
+	goldenImages.addAttachment("gbuffer_color", &fbo, "fragColor");
+	goldenImages.addAttachment("gbuffer_normal", &fbo, "fragNormal");
+	goldenImages.addAttachment("gbuffer_position", &fbo, "fragPosition");
+	goldenImages.addTexture("ssr", ssrFBO.getColorAttachmentTextureHandle(GL_COLOR_ATTACHMENT0), ssrFBO.getWidth(), ssrFBO.getHeight());
+	goldenImages.addScreen("final", WINDOW_RESOLUTION.x, WINDOW_RESOLUTION.y);
+	Benchmark::setGoldenImages(&goldenImages);
+
 	double elapsedTime = 0.0;
 	render(window, [&](double dt)
 	{
 		elapsedTime += dt;
+		profiler.beginFrame();
 		std::string window_header = "Screen Space Reflections - " + DebugLog::to_string( 1.0 / dt ) + " FPS";
 		glfwSetWindowTitle(window, window_header.c_str() );
 
@@ -283,6 +302,7 @@ int main()
 		}
 
 		view = glm::lookAt(glm::vec3(eye), glm::vec3(center), glm::vec3(0.0f, 1.0f, 0.0f));
+		if (Benchmark::isEnabled()) { view = cameraPath.getViewMatrix(Benchmark::getTime()); }
 		//////////////////////////////////////////////////////////////////////////////
 				
 		////////////////////////  SHADER / UNIFORM UPDATING //////////////////////////
@@ -297,11 +317,17 @@ int main()
 		//////////////////////////////////////////////////////////////////////////////
 		
 		////////////////////////////////  RENDERING //// /////////////////////////////
+		profiler.beginScope("gbuffer");
 		renderPass.render();
+		profiler.endScope();
 
+		profiler.beginScope("compositing");
 		compositing.render();
+		profiler.endScope();
 
+		profiler.beginScope("ssr");
 		ssrRenderPass.render();
+		profiler.endScope();
 
 		simpleTexture.render();
 
@@ -314,5 +340,5 @@ int main()
 
 	destroyWindow(window);
 
-	return 0;
+	return Benchmark::getExitCode();
 }
\ No newline at end of file
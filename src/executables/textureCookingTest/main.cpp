@@ -0,0 +1,142 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * checks and statistics of the TextureCooking encoders:
+ * synthetic images (a noisy color gradient, the same with an alpha gradient, a normal map) and optionally an image file
+ * are compressed to BC1 / BC3 / BC5, decoded again and the PSNR per format is printed.
+ * The result must not depend on the number of threads, image sizes that are no multiple of 4 must work
+ * and the mipmap chain must go down to 1x1.
+ * Prints OK / FAIL per test, exit code is the number of failed tests.
+ * usage: textureCookingTest [image file relative to RESOURCES_PATH]
+ ****************************************/
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include <Core/DebugLog.h>
+#include <Core/TestReport.h>
+#include <Importing/TextureCooking.h>
+#include <Importing/TextureTools.h>
+
+////////////////////// PARAMETERS /////////////////////////////
+const int IMAGE_WIDTH = 256;
+const int IMAGE_HEIGHT = 256;
+const double MIN_PSNR = 30.0; // dB, over the encoded channels
+
+//////////////////// MISC /////////////////////////////////////
+std::vector<unsigned char> generateImage(int width, int height, bool withAlpha)
+{
+	std::vector<unsigned char> rgba((size_t) width * height * 4);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			unsigned char* texel = &rgba[((size_t) y * width + x) * 4];
+			int noise = std::rand() % 9 - 4;
+			texel[0] = (unsigned char) std::min(std::max(255 * x / width + noise, 0), 255);
+			texel[1] = (unsigned char) std::min(std::max(255 * y / height + noise, 0), 255);
+			texel[2] = (unsigned char) (128 + 127 * std::sin(x * 0.05) * std::cos(y * 0.05));
+			texel[3] = withAlpha ? (unsigned char) (255 * (x + y) / (width + height)) : 255;
+		}
+	}
+	return rgba;
+}
+
+std::vector<unsigned char> generateNormalMap(int width, int height)
+{
+	std::vector<unsigned char> rgba((size_t) width * height * 4);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			// bumps: n = normalize(-dh/dx, -dh/dy, 1)
+			double dx = 0.5 * std::cos(x * 0.1) * std::sin(y * 0.1), dy = 0.5 * std::sin(x * 0.1) * std::cos(y * 0.1);
+			double length = std::sqrt(dx * dx + dy * dy + 1.0);
+			unsigned char* texel = &rgba[((size_t) y * width + x) * 4];
+			texel[0] = (unsigned char) (127.5 + 127.5 * -dx / length);
+			texel[1] = (unsigned char) (127.5 + 127.5 * -dy / length);
+			texel[2] = (unsigned char) (127.5 + 127.5 / length);
+			texel[3] = 255;
+		}
+	}
+	return rgba;
+}
+
+double computePSNR(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int firstChannel, int numChannels)
+{
+	double sum = 0.0;
+	size_t count = 0;
+	for (size_t i = 0; i < a.size(); i += 4)
+	{
+		for (int c = firstChannel; c < firstChannel + numChannels; c++)
+		{
+			double d = (double) a[i + c] - (double) b[i + c];
+			sum += d * d;
+			count++;
+		}
+	}
+	double mse = sum / (double) count;
+	return ( mse == 0.0 ) ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+int testImage(const std::string& name, const std::vector<unsigned char>& rgba, int width, int height, TextureCooking::Format format, int firstChannel, int numChannels)
+{
+	int numFailed = 0;
+	TextureCooking::CompressedTexture texture = TextureCooking::compress(&rgba[0], width, height, format);
+	TextureCooking::CompressedTexture singleThreaded = TextureCooking::compress(&rgba[0], width, height, format, 1);
+
+	std::vector<unsigned char> decoded = TextureCooking::decompressLevel(&texture.levels[0][0], width, height, texture.format);
+	double psnr = computePSNR(rgba, decoded, firstChannel, numChannels);
+	size_t compressedSize = 0;
+	for (unsigned int level = 0; level < texture.levels.size(); level++) { compressedSize += texture.levels[level].size(); }
+
+	numFailed += TestReport::report(name + ", quality", psnr >= MIN_PSNR, "PSNR " + DebugLog::to_string(psnr) + " dB, "
+		+ DebugLog::to_string((int) compressedSize) + " bytes for " + DebugLog::to_string((int) texture.levels.size()) + " levels");
+	numFailed += TestReport::report(name + ", deterministic", texture.levels == singleThreaded.levels, "");
+	numFailed += TestReport::report(name + ", mipmaps", texture.levelWidths.back() == 1 && texture.levelHeights.back() == 1
+		&& texture.levels.back().size() == (size_t) TextureCooking::getBlockSize(texture.format), "");
+	return numFailed;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	std::srand(1);
+	int numFailed = 0;
+
+	std::vector<unsigned char> opaque = generateImage(IMAGE_WIDTH, IMAGE_HEIGHT, false);
+	std::vector<unsigned char> transparent = generateImage(IMAGE_WIDTH, IMAGE_HEIGHT, true);
+	std::vector<unsigned char> normals = generateNormalMap(IMAGE_WIDTH, IMAGE_HEIGHT);
+	std::vector<unsigned char> odd = generateImage(IMAGE_WIDTH - 57, IMAGE_HEIGHT - 3, false);
+
+	numFailed += testImage("gradient, BC1", opaque, IMAGE_WIDTH, IMAGE_HEIGHT, TextureCooking::BC1, 0, 3);
+	numFailed += testImage("gradient with alpha, BC3", transparent, IMAGE_WIDTH, IMAGE_HEIGHT, TextureCooking::BC3, 0, 4);
+	numFailed += testImage("normal map, BC5", normals, IMAGE_WIDTH, IMAGE_HEIGHT, TextureCooking::BC5, 0, 2);
+	numFailed += testImage("odd size, BC1", odd, IMAGE_WIDTH - 57, IMAGE_HEIGHT - 3, TextureCooking::BC1, 0, 3);
+
+	numFailed += TestReport::report("AUTO, opaque", TextureCooking::compress(&opaque[0], IMAGE_WIDTH, IMAGE_HEIGHT, TextureCooking::AUTO).format == TextureCooking::BC1, "");
+	numFailed += TestReport::report("AUTO, alpha", TextureCooking::compress(&transparent[0], IMAGE_WIDTH, IMAGE_HEIGHT, TextureCooking::AUTO).format == TextureCooking::BC3, "");
+
+	if ( argc > 1 )
+	{
+		int width, height, bytesPerPixel;
+		unsigned char* data = TextureTools::decodeImage(RESOURCES_PATH "/" + std::string(argv[1]), width, height, bytesPerPixel, false);
+		if ( data != nullptr )
+		{
+			std::vector<unsigned char> rgba = TextureCooking::toRGBA(data, width, height, bytesPerPixel);
+			TextureTools::freeImage(data);
+			bool hasAlpha = ( bytesPerPixel == 2 || bytesPerPixel == 4 );
+			numFailed += testImage(argv[1], rgba, width, height, hasAlpha ? TextureCooking::BC3 : TextureCooking::BC1, 0, hasAlpha ? 4 : 3);
+		}
+		else
+		{
+			numFailed += TestReport::report(argv[1], false, "could not be decoded");
+		}
+	}
+
+	return numFailed;
+}
@@ -6,11 +6,13 @@
 #include <time.h>
 
 #include <Core/Camera.h>
+#include <Core/GPUProfiler.h>
 
 #include <Rendering/GLTools.h>
 #include <Rendering/VertexArrayObjects.h>
 #include <Rendering/RenderPass.h>
 #include <Rendering/PostProcessing.h>
+#include <Rendering/Benchmark.h>
 
 #include "UI/imgui/imgui.h"
 #include <UI/imguiTools.h>
@@ -79,9 +81,10 @@ double log_2( double n )
 ///////////////////////////////// MAIN ///////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////
 
-int main()
+int main(int argc, char** argv)
 {
 	DEBUGLOG->setAutoPrint(true);
+	Benchmark::parseArguments(argc, argv, "treeanim");
 	auto window = generateWindow(WINDOW_RESOLUTION.x,WINDOW_RESOLUTION.y);
 
 	//////////////////////////////////////////////////////////////////////////////
@@ -119,7 +122,7 @@ int main()
 
 	/////////////////////    create Tree data           //////////////////////////
 	DEBUGLOG->log("Setup: generating trees"); DEBUGLOG->indent();
-	srand (time(NULL));	
+	srand(Benchmark::isEnabled() ? 0 : (unsigned int) time(NULL)); // same scene in every benchmark run
 
 	// generate a forest randomly, including renderables
 	TreeAnimation::TreeRendering treeRendering;
@@ -154,6 +157,7 @@ int main()
 	// Camera object
 	Camera cam;
 	cam.setProjectionMatrix(perspective); // perspective projection
+	Benchmark::CameraPath cameraPath = Benchmark::CameraPath::orbit(glm::vec3(0.0f, 6.0f, 20.0f), glm::vec3(0.0f, 2.0f, 0.0f), 20.0); // around the forest
 
 	/////////////////////// 	Renderpasses     ///////////////////////////
 	DEBUGLOG->log("Shader Compilation: BranchToGBuffer & FoliageToGBuffer"); DEBUGLOG->indent();
@@ -323,11 +327,15 @@ int main()
 	//////////////////////////////// RENDER LOOP /////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
 
+	GPUProfiler profiler;
+	Benchmark::setProfiler(&profiler);
+
 	double elapsedTime = 0.0;
 	render(window, [&](double dt)
 	{
 		elapsedTime += dt;
 		s_simulationTime = elapsedTime;
+		profiler.beginFrame();
 		std::string window_header = "Tree Animation Test - " + DebugLog::to_string( 1.0 / dt ) + " FPS";
 		glfwSetWindowTitle(window, window_header.c_str() );
 
@@ -352,6 +360,7 @@ int main()
 		///////////////////////////// MATRIX UPDATING ///////////////////////////////
 		//cam.setCenter(glm::vec3(center))); // TODO update position
 		cam.update(dt);
+		if (Benchmark::isEnabled()) { cameraPath.apply(cam, Benchmark::getTime()); }
 		windField.updateVectorTexture(s_simulationTime);
 		//////////////////////////////////////////////////////////////////////////////
 				
@@ -383,27 +392,34 @@ int main()
 		
 		////////////////////////////////  RENDERING //// /////////////////////////////
 		// render GBuffer
+		profiler.beginScope("branches");
 		for(int i = 0; i < treeRendering.branchRenderpasses.size(); i++)
 		{
 			// configure shader for this tree type
 			glUniformBlockBinding(treeRendering.branchShader->getShaderProgramHandle(), treeRendering.branchShaderUniformBlockInfoMap["Tree"].index, 2+i);
 			treeRendering.branchRenderpasses[i]->renderInstanced(NUM_TREES_PER_VARIANT);
 		}
+		profiler.endScope();
 
 		// perform compositing
+		profiler.beginScope("compositing");
 		compositing.render();
+		profiler.endScope();
 
 		// copy depth buffer to default fbo
 		copyFBOContent(&scene_gbuffer, 0, GL_DEPTH_BUFFER_BIT);
 
 		// render foliage to screen
+		profiler.beginScope("foliage");
 		for(int i = 0; i < treeRendering.foliageRenderpasses.size(); i++)
 		{
 			// change uniform block binding point
 			glUniformBlockBinding(treeRendering.foliageShader->getShaderProgramHandle(), treeRendering.foliageShaderUniformBlockInfoMap["Tree"].index, 2+i);
 			treeRendering.foliageRenderpasses[i]->renderInstanced(NUM_TREES_PER_VARIANT);
 		}
+		profiler.endScope();
 
+		profiler.beginScope("bloom");
 		copyFBOContent(0, boxBlur.m_mipmapFBOHandles[0], WINDOW_RESOLUTION, glm::vec2(boxBlur.m_width, boxBlur.m_height), GL_COLOR_BUFFER_BIT, GL_NONE, GL_LINEAR);
 
 		boxBlur.pull(); // generate mipmaps
@@ -411,6 +427,7 @@ int main()
 
 		glBlendFunc(GL_ONE, GL_ONE); // add blurred image to screen
 		bloom.render();
+		profiler.endScope();
 
 		if (showWindField) gridRenderPass.render();
 
@@ -423,5 +440,5 @@ int main()
 
 	destroyWindow(window);
 
-	return 0;
+	return Benchmark::getExitCode();
 }
\ No newline at end of file
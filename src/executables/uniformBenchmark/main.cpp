@@ -0,0 +1,88 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * micro benchmark of ShaderProgram uniform updates:
+ * 10k updates through uniform names vs. through UniformHandles,
+ * once with changing values (every update is uploaded)
+ * and once with repeated values (every update is filtered by the shadow copy)
+ ****************************************/
+
+#include <iostream>
+#include <chrono>
+
+#include <Rendering/GLTools.h>
+#include <Rendering/ShaderProgram.h>
+
+////////////////////// PARAMETERS /////////////////////////////
+const int NUM_UPDATES = 10000;
+const int NUM_ITERATIONS = 20;
+
+//////////////////// MISC /////////////////////////////////////
+template <typename Func>
+double measureMilliseconds(Func func)
+{
+	glFinish();
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < NUM_ITERATIONS; i++)
+	{
+		func(i);
+	}
+	glFinish();
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - begin).count() / (double) NUM_ITERATIONS;
+}
+
+void printResult(const std::string& name, double milliseconds)
+{
+	std::cout << name << ": " << milliseconds << " ms per " << NUM_UPDATES << " updates" << std::endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	auto window = generateWindow(64, 64);
+
+	// model, view, projection (mat4), color (vec4), blendColor (float), tex (sampler)
+	ShaderProgram shaderProgram("/modelSpace/modelViewProjection.vert", "/modelSpace/simpleLighting.frag");
+	UniformHandle model      = shaderProgram.getUniformHandle("model");
+	UniformHandle color      = shaderProgram.getUniformHandle("color");
+	UniformHandle blendColor = shaderProgram.getUniformHandle("blendColor");
+	UniformHandle tex        = shaderProgram.getUniformHandle("tex");
+
+	// every 4 consecutive updates touch 4 different uniforms, like a typical per object update.
+	// alternate == true toggles the values between 0 and 1 so every update is uploaded, else they stay 0 and are filtered
+	int counter = 0;
+	auto updateByName = [&](bool alternate)
+	{
+		for (int i = 0; i < NUM_UPDATES / 4; i++)
+		{
+			float v = alternate ? (float) (counter++ & 1) : 0.0f;
+			shaderProgram.update("model", glm::mat4(v));
+			shaderProgram.update("color", glm::vec4(v));
+			shaderProgram.update("blendColor", v);
+			shaderProgram.update("tex", (int) v);
+		}
+	};
+	auto updateByHandle = [&](bool alternate)
+	{
+		for (int i = 0; i < NUM_UPDATES / 4; i++)
+		{
+			float v = alternate ? (float) (counter++ & 1) : 0.0f;
+			shaderProgram.update(model, glm::mat4(v));
+			shaderProgram.update(color, glm::vec4(v));
+			shaderProgram.update(blendColor, v);
+			shaderProgram.update(tex, (int) v);
+		}
+	};
+
+	std::cout << "Uniform updates, " << NUM_ITERATIONS << " iterations" << std::endl;
+	printResult("changing values, names  ", measureMilliseconds([&](int){ updateByName(true); }));
+	printResult("changing values, handles", measureMilliseconds([&](int){ updateByHandle(true); }));
+	printResult("repeated values, names  ", measureMilliseconds([&](int){ updateByName(false); }));
+	printResult("repeated values, handles", measureMilliseconds([&](int){ updateByHandle(false); }));
+
+	destroyWindow(window);
+	return 0;
+}
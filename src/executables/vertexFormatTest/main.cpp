@@ -0,0 +1,163 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * round trip accuracy and memory report of the VertexFormat encodings:
+ * every format packs and unpacks a synthetic mesh (random directions, uvs in [0,1], large positions)
+ * and the meshes of a model, the decoded attributes are compared against the input.
+ * Prints OK / FAIL per test and bytes per vertex, exit code is the number of failed tests.
+ * usage: vertexFormatTest [model file relative to RESOURCES_PATH]
+ ****************************************/
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include <Core/DebugLog.h>
+#include <Core/TestReport.h>
+#include <Importing/AssimpTools.h>
+#include <Rendering/VertexFormat.h>
+
+#include <assimp/Importer.hpp>
+
+////////////////////// PARAMETERS /////////////////////////////
+const int NUM_SYNTHETIC_VERTICES = 100000;
+const float SYNTHETIC_EXTENT = 500.0f;
+const std::string DEFAULT_MODEL = "cube.dae";
+
+//////////////////// MISC /////////////////////////////////////
+struct Mesh
+{
+	std::string name;
+	std::vector<float> positions, uvs, normals, tangents;
+	int uvComponents;
+};
+
+float random(float min, float max)
+{
+	return min + (max - min) * (float) std::rand() / (float) RAND_MAX;
+}
+
+Mesh generateSyntheticMesh()
+{
+	Mesh mesh;
+	mesh.name = "synthetic";
+	mesh.uvComponents = 2;
+	for (int i = 0; i < NUM_SYNTHETIC_VERTICES; i++)
+	{
+		glm::vec3 normal = glm::normalize(glm::vec3(random(-1.0f, 1.0f), random(-1.0f, 1.0f), random(-1.0f, 1.0f)) + glm::vec3(1e-6f));
+		glm::vec3 tangent = glm::normalize(glm::cross(normal, glm::vec3(0.3f, 1.0f, 0.2f)));
+		for (int c = 0; c < 3; c++)
+		{
+			mesh.positions.push_back(random(-SYNTHETIC_EXTENT, SYNTHETIC_EXTENT) + 1000.0f);
+			mesh.normals.push_back(normal[c]);
+			mesh.tangents.push_back(tangent[c]);
+		}
+		mesh.uvs.push_back(random(0.0f, 1.0f));
+		mesh.uvs.push_back(random(0.0f, 1.0f));
+	}
+	return mesh;
+}
+
+/// largest absolute difference between two streams, relative to max(|value|, minMagnitude) if relative is set
+float maxError(const std::vector<float>& a, const std::vector<float>& b, bool relative = false, float minMagnitude = 1.0f)
+{
+	if ( a.size() != b.size() ) { return 1e30f; }
+	float error = 0.0f;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		float e = std::abs(a[i] - b[i]);
+		if ( relative ) { e /= std::max(std::abs(a[i]), minMagnitude); }
+		error = std::max(error, e);
+	}
+	return error;
+}
+
+float positionExtent(const std::vector<float>& positions) //!< half of the largest bounding box side, the quantization range
+{
+	glm::vec3 min(1e30f), max(-1e30f);
+	for (size_t i = 0; i + 2 < positions.size(); i += 3)
+	{
+		glm::vec3 p(positions[i], positions[i + 1], positions[i + 2]);
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+	glm::vec3 extent = (max - min) * 0.5f;
+	return std::max(extent.x, std::max(extent.y, extent.z));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv)
+{
+	std::srand(1);
+	std::vector<Mesh> meshes(1, generateSyntheticMesh());
+
+	// model meshes, CPU side only
+	Assimp::Importer importer;
+	const aiScene* scene = AssimpTools::importAssetFromResourceFolder( (argc > 1) ? std::string(argv[1]) : DEFAULT_MODEL, importer);
+	if ( scene != nullptr )
+	{
+		auto vertexData = AssimpTools::createVertexDataInstancesFromScene(scene);
+		for (unsigned int i = 0; i < vertexData.size(); i++)
+		{
+			Mesh mesh;
+			mesh.name = "mesh " + DebugLog::to_string((int) i);
+			mesh.positions = vertexData[i].positions;
+			mesh.normals = vertexData[i].normals;
+			mesh.tangents = vertexData[i].tangents;
+			mesh.uvComponents = ( !mesh.positions.empty() && vertexData[i].uvs.size() == mesh.positions.size() ) ? 3 : 2;
+			mesh.uvs = vertexData[i].uvs;
+			meshes.push_back(mesh);
+		}
+	}
+
+	const VertexFormat formats[] = { VertexFormat::uncompressed(), VertexFormat(), VertexFormat(VertexFormat::POSITION_SNORM16) };
+	const std::string formatNames[] = { "uncompressed", "default", "quantized" };
+	const int numFormats = 3;
+
+	int numFailed = 0;
+	size_t separateBytes = 0;
+	size_t interleavedBytes[numFormats] = { 0, 0, 0 };
+	for (unsigned int m = 0; m < meshes.size(); m++)
+	{
+		const Mesh& mesh = meshes[m];
+		separateBytes += (mesh.positions.size() + mesh.uvs.size() + mesh.normals.size() + mesh.tangents.size()) * sizeof(float);
+
+		for (int f = 0; f < numFormats; f++)
+		{
+			VertexFormat::InterleavedVertices vertices = formats[f].pack(mesh.positions, mesh.uvs, mesh.uvComponents, mesh.normals, mesh.tangents);
+			interleavedBytes[f] += vertices.data.size();
+
+			std::vector<float> positions, uvs, normals, tangents;
+			formats[f].unpack(vertices, positions, uvs, normals, tangents);
+
+			// error bounds: half a quantization step (a full step for positions to cover the float error of the dequantization), half floats keep 11 significant bits
+			float positionBound = ( formats[f].getPositionEncoding() == VertexFormat::POSITION_SNORM16 ) ? positionExtent(mesh.positions) / 32767.0f : 0.0f;
+			float uvBound = ( formats[f].getUVEncoding() == VertexFormat::UV_HALF ) ? 1.0f / 2048.0f : 0.0f;
+			float directionBound = ( formats[f].getDirectionEncoding() == VertexFormat::DIRECTION_INT_2_10_10_10 ) ? 0.5f / 511.0f + 1e-6f : 0.0f;
+
+			float positionError = maxError(mesh.positions, positions);
+			float uvError = maxError(mesh.uvs, uvs, true);
+			float normalError = maxError(mesh.normals, normals);
+			float tangentError = maxError(mesh.tangents, tangents);
+
+			bool ok = positionError <= positionBound && uvError <= uvBound && normalError <= directionBound && tangentError <= directionBound;
+			numFailed += TestReport::report(mesh.name + ", " + formatNames[f], ok,
+				"max error position: " + DebugLog::to_string(positionError) + ", uv: " + DebugLog::to_string(uvError)
+				+ ", normal: " + DebugLog::to_string(normalError) + ", tangent: " + DebugLog::to_string(tangentError)
+				+ ", stride: " + DebugLog::to_string((int) vertices.stride));
+		}
+	}
+
+	std::cout << std::endl << "Vertex memory of " << meshes.size() << " meshes" << std::endl;
+	std::cout << "separate float buffers: " << separateBytes / 1024 << " KB" << std::endl;
+	for (int f = 0; f < numFormats; f++)
+	{
+		std::cout << formatNames[f] << ": " << interleavedBytes[f] / 1024 << " KB ("
+			<< (separateBytes != 0 ? (100 * interleavedBytes[f]) / separateBytes : 0) << "%)" << std::endl;
+	}
+
+	return numFailed;
+}
@@ -1,5 +1,7 @@
 #include "DebugLog.h"
 
+#include "TraceRecorder.h"
+
 DebugLog::DebugLog(bool autoPrint)
 {
 	m_autoPrint = autoPrint;
@@ -15,10 +17,19 @@ DebugLog::~DebugLog()
 
 void DebugLog::log(std::string msg)
 {
-	m_log.push_back( createIndent() +  msg );
-	if (m_autoPrint)
 	{
-		printLast();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_log.push_back( createIndent() +  msg );
+		if (m_autoPrint)
+		{
+			std::cout << m_log.back() << std::endl;
+		}
+	}
+
+	// messages show up as markers in captured traces
+	if (TRACERECORDER->isRecording())
+	{
+		TRACERECORDER->addInstantEvent(msg, "log");
 	}
 }
 
@@ -85,11 +96,13 @@ void DebugLog::log(std::string msg, double value)
 
 void DebugLog::indent()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_indent++;
 }
 
 void DebugLog::outdent()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_indent--;
 	if(m_indent < 0)
 	{
@@ -108,6 +121,7 @@ std::string DebugLog::createIndent() const
 }
 
 void DebugLog::print() const{
+	std::lock_guard<std::mutex> lock(m_mutex);
 	for (unsigned int i = 0; i < m_log.size(); i++)
 	{
 		std::cout << m_log[i] << std::endl;
@@ -115,6 +129,7 @@ void DebugLog::print() const{
 }
 
 void DebugLog::printLast() const{
+	std::lock_guard<std::mutex> lock(m_mutex);
 	if (!m_log.empty())
 	{
 		std::cout << m_log.back() << std::endl;
@@ -123,10 +138,12 @@ void DebugLog::printLast() const{
 
 void DebugLog::clear()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_log.clear();
 }
 
 void DebugLog::setAutoPrint(bool to)
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_autoPrint = to;
 }
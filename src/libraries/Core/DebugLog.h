@@ -5,6 +5,7 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <mutex>
 
 #include <glm/glm.hpp>
 
@@ -17,7 +18,8 @@ private:
 	std::vector< std::string > m_log;
 	int  m_indent;
 	bool m_autoPrint;
-	inline std::string createIndent() const;
+	mutable std::mutex m_mutex; //!< guards m_log, m_indent and m_autoPrint, messages may come from loader threads (see AsyncLoader)
+	inline std::string createIndent() const; //!< caller holds m_mutex
 public:
 	DebugLog(bool autoPrint = false);
 	~DebugLog();
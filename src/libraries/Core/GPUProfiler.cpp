@@ -0,0 +1,252 @@
+#include "GPUProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <GL/glew.h>
+
+#include <Core/DebugLog.h>
+#include <Core/TraceRecorder.h>
+
+GPUProfiler::GPUProfiler(unsigned int framesInFlight, unsigned int historySize)
+	: m_framesInFlight(std::max(framesInFlight, 1u))
+	, m_historySize(std::max(historySize, 1u))
+	, m_frame(0)
+	, m_enabled(true)
+	, m_active(true)
+	, m_numDroppedSamples(0)
+	, m_creationTime(std::chrono::high_resolution_clock::now())
+	, m_gpuClockOffset(0.0)
+{
+}
+
+GPUProfiler::~GPUProfiler()
+{
+	for (unsigned int i = 0; i < m_scopes.size(); i++)
+	{
+		glDeleteQueries((GLsizei) m_scopes[i].queries.size(), &m_scopes[i].queries[0]);
+	}
+}
+
+double GPUProfiler::getCPUTime(const std::chrono::high_resolution_clock::time_point& time) const
+{
+	return std::chrono::duration<double, std::milli>(time - m_creationTime).count();
+}
+
+int GPUProfiler::getOrCreateScope(const std::string& name, int parent)
+{
+	std::string path = ( parent < 0 ) ? name : m_scopes[parent].path + "/" + name;
+	auto index = m_scopeIndices.find(path);
+	if ( index != m_scopeIndices.end() )
+	{
+		return index->second;
+	}
+
+	Scope scope;
+	scope.name = name;
+	scope.path = path;
+	scope.parent = parent;
+	scope.depth = ( parent < 0 ) ? 0 : m_scopes[parent].depth + 1;
+	scope.lastFrame = 0;
+	scope.queries.resize(2 * m_framesInFlight);
+	scope.pending.assign(m_framesInFlight, false);
+	scope.pendingSamples.resize(m_framesInFlight);
+	scope.pendingTraced.assign(m_framesInFlight, false);
+	scope.historyNext = 0;
+	glGenQueries((GLsizei) scope.queries.size(), &scope.queries[0]);
+
+	m_scopes.push_back(scope);
+	m_scopeIndices[path] = (int) m_scopes.size() - 1;
+	return (int) m_scopes.size() - 1;
+}
+
+void GPUProfiler::addSample(Scope& scope, const Sample& sample)
+{
+	if ( scope.history.size() < m_historySize )
+	{
+		scope.history.push_back(sample);
+	}
+	else
+	{
+		scope.history[scope.historyNext] = sample;
+	}
+	scope.historyNext = (scope.historyNext + 1) % m_historySize;
+}
+
+void GPUProfiler::collectResults(Scope& scope)
+{
+	// oldest frame slot first, so the history stays in order
+	for (unsigned int i = 1; i <= m_framesInFlight; i++)
+	{
+		unsigned int slot = (unsigned int) ((m_frame + i) % m_framesInFlight);
+		if ( !scope.pending[slot] ) { continue; }
+
+		// the stop timestamp is written after the start timestamp
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(scope.queries[2 * slot + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if ( available != GL_TRUE ) { break; }
+
+		GLuint64 start = 0, stop = 0;
+		glGetQueryObjectui64v(scope.queries[2 * slot], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(scope.queries[2 * slot + 1], GL_QUERY_RESULT, &stop);
+		scope.pending[slot] = false;
+
+		Sample sample = scope.pendingSamples[slot];
+		sample.gpuStart = start;
+		sample.gpuTime = ( stop > start ) ? (double) (stop - start) / 1000000.0 : 0.0;
+		addSample(scope, sample);
+
+		if ( scope.pendingTraced[slot] )
+		{
+			TRACERECORDER->addGPUEvent(scope.name, (double) start / 1000000.0 + m_gpuClockOffset, sample.gpuTime);
+		}
+	}
+}
+
+void GPUProfiler::beginFrame()
+{
+	if ( !m_openScopes.empty() )
+	{
+		DEBUGLOG->log("WARNING: GPUProfiler: scopes still open at the end of the frame: ", (int) m_openScopes.size());
+		while ( !m_openScopes.empty() ) { endScope(); }
+	}
+
+	// map GPU timestamps to trace time, glGetInteger64v(GL_TIMESTAMP) does not wait for the GPU
+	if ( TRACERECORDER->isCapturing() )
+	{
+		GLint64 gpuTime = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+		m_gpuClockOffset = TRACERECORDER->getTime() - (double) gpuTime / 1000000.0;
+	}
+
+	for (unsigned int i = 0; i < m_scopes.size(); i++)
+	{
+		collectResults(m_scopes[i]);
+	}
+
+	m_frame++;
+	m_active = m_enabled;
+}
+
+void GPUProfiler::beginScope(const std::string& name)
+{
+	OpenScope openScope;
+	openScope.scope = -1;
+	openScope.issued = false;
+	openScope.cpuStart = std::chrono::high_resolution_clock::now();
+
+	if ( !m_active )
+	{
+		m_openScopes.push_back(openScope); // keep begin / end balanced
+		return;
+	}
+
+	openScope.scope = getOrCreateScope(name, m_openScopes.empty() ? -1 : m_openScopes.back().scope);
+	Scope& scope = m_scopes[openScope.scope];
+	unsigned int slot = (unsigned int) (m_frame % m_framesInFlight);
+
+	// still pending: the GPU is too far behind, or the scope was already used in this frame
+	if ( scope.pending[slot] )
+	{
+		if ( scope.lastFrame != m_frame ) { m_numDroppedSamples++; }
+	}
+	else
+	{
+		glQueryCounter(scope.queries[2 * slot], GL_TIMESTAMP);
+		scope.pending[slot] = true;
+		openScope.issued = true;
+	}
+	scope.lastFrame = m_frame;
+
+	m_openScopes.push_back(openScope);
+}
+
+void GPUProfiler::endScope()
+{
+	if ( m_openScopes.empty() )
+	{
+		DEBUGLOG->log("WARNING: GPUProfiler: endScope without beginScope");
+		return;
+	}
+
+	OpenScope openScope = m_openScopes.back();
+	m_openScopes.pop_back();
+	if ( !openScope.issued ) { return; }
+
+	auto cpuStop = std::chrono::high_resolution_clock::now();
+	Scope& scope = m_scopes[openScope.scope];
+	unsigned int slot = (unsigned int) (m_frame % m_framesInFlight);
+	glQueryCounter(scope.queries[2 * slot + 1], GL_TIMESTAMP);
+
+	Sample& sample = scope.pendingSamples[slot];
+	sample.frame = m_frame;
+	sample.cpuStart = getCPUTime(openScope.cpuStart);
+	sample.cpuTime = std::chrono::duration<double, std::milli>(cpuStop - openScope.cpuStart).count();
+	sample.gpuStart = 0;
+	sample.gpuTime = 0.0;
+
+	scope.pendingTraced[slot] = TRACERECORDER->isRecording();
+	if ( scope.pendingTraced[slot] )
+	{
+		TRACERECORDER->addEvent(scope.name, "cpu", TRACERECORDER->getTime(openScope.cpuStart), sample.cpuTime);
+	}
+}
+
+void GPUProfiler::setHistorySize(unsigned int historySize)
+{
+	historySize = std::max(historySize, 1u);
+	for (unsigned int i = 0; i < m_scopes.size(); i++)
+	{
+		// unroll the ring buffer, oldest sample first
+		std::vector<Sample> history = getHistory(i);
+		if ( history.size() > historySize ) { history.erase(history.begin(), history.end() - historySize); }
+		m_scopes[i].history = history;
+		m_scopes[i].historyNext = (unsigned int) (history.size() % historySize);
+	}
+	m_historySize = historySize;
+}
+
+int GPUProfiler::getScopeIndex(const std::string& path) const
+{
+	auto index = m_scopeIndices.find(path);
+	return ( index != m_scopeIndices.end() ) ? index->second : -1;
+}
+
+std::vector<GPUProfiler::Sample> GPUProfiler::getHistory(int scope) const
+{
+	const Scope& s = m_scopes[scope];
+	std::vector<Sample> history;
+	history.reserve(s.history.size());
+	unsigned int first = ( s.history.size() < m_historySize ) ? 0 : s.historyNext;
+	for (unsigned int i = 0; i < s.history.size(); i++)
+	{
+		history.push_back(s.history[(first + i) % s.history.size()]);
+	}
+	return history;
+}
+
+GPUProfiler::Statistics GPUProfiler::getStatistics(int scope, bool gpu) const
+{
+	Statistics statistics = {0.0, 0.0, 0.0, 0.0, 0.0, 0};
+	const Scope& s = m_scopes[scope];
+	if ( s.history.empty() ) { return statistics; }
+
+	std::vector<double> values(s.history.size());
+	for (unsigned int i = 0; i < s.history.size(); i++)
+	{
+		values[i] = gpu ? s.history[i].gpuTime : s.history[i].cpuTime;
+	}
+	const Sample& last = s.history[(s.historyNext + s.history.size() - 1) % s.history.size()];
+	statistics.last = gpu ? last.gpuTime : last.cpuTime;
+
+	std::sort(values.begin(), values.end());
+	double sum = 0.0;
+	for (unsigned int i = 0; i < values.size(); i++) { sum += values[i]; }
+
+	statistics.numSamples = (unsigned int) values.size();
+	statistics.min = values.front();
+	statistics.max = values.back();
+	statistics.avg = sum / (double) values.size();
+	statistics.p95 = values[(size_t) std::ceil(0.95 * (double) values.size()) - 1];
+	return statistics;
+}
@@ -0,0 +1,107 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <chrono>
+
+/** @brief GPU and CPU timings of nested scopes, without waiting for the GPU
+ *
+ * Every scope owns a ring of timestamp query pairs, one pair per frame in flight. Results are read back in beginFrame once they
+ * are available, i.e. a few frames late, and are paired with the CPU time measured for the same scope in the same frame.
+ * If the GPU is more than framesInFlight frames behind, the measurement of that frame is dropped instead of waiting.
+ * Scopes are identified by their path ("rendering/shadows"), so a name may be used below different parents.
+ * Every scope keeps the samples of the last historySize frames it was used in, see getStatistics.
+ * While the TraceRecorder captures, the CPU and GPU times of every scope are recorded as trace events as well.
+ */
+class GPUProfiler
+{
+public:
+	struct Sample
+	{
+		unsigned long long frame;    //!< frame in which the scope was measured
+		double gpuTime;              //!< ms
+		double cpuTime;              //!< ms
+		unsigned long long gpuStart; //!< GPU timestamp in ns
+		double cpuStart;             //!< ms since the profiler was created
+	};
+
+	struct Statistics
+	{
+		double last; //!< ms, most recent sample
+		double min;
+		double avg;
+		double p95;
+		double max;
+		unsigned int numSamples; //!< 0 if none is available yet, all values are 0 then
+	};
+
+	struct Scope
+	{
+		std::string name;
+		std::string path;
+		int parent; //!< index of the parent scope, -1 for top level scopes
+		int depth;
+		unsigned long long lastFrame; //!< frame in which the scope was begun last
+
+		std::vector<unsigned int> queries; //!< start and stop timestamp query per frame slot
+		std::vector<bool> pending;         //!< per frame slot: queries issued, result not read back yet
+		std::vector<Sample> pendingSamples; //!< per frame slot: CPU part of the pending sample
+		std::vector<bool> pendingTraced;    //!< per frame slot: the GPU time goes to the TraceRecorder as well
+
+		std::vector<Sample> history; //!< ring buffer
+		unsigned int historyNext;    //!< index the next sample is written to
+	};
+
+	/**
+	 * @param framesInFlight query pairs per scope, results are read back up to framesInFlight - 1 frames late
+	 * @param historySize samples per scope used for the statistics
+	 */
+	GPUProfiler(unsigned int framesInFlight = 4, unsigned int historySize = 120);
+	~GPUProfiler();
+
+	void beginFrame(); //!< read back completed queries and start the next frame, call once per frame before any scope
+	void beginScope(const std::string& name); //!< nested in the currently open scope, use each scope at most once per frame
+	void endScope();
+
+	inline void setEnabled(bool enabled) { m_enabled = enabled; } //!< takes effect with the next beginFrame
+	inline bool isEnabled() const { return m_enabled; }
+	void setHistorySize(unsigned int historySize); //!< keeps the most recent samples
+
+	const std::vector<Scope>& getScopes() const { return m_scopes; } //!< parents come before their children
+	int getScopeIndex(const std::string& path) const; //!< -1 if unknown
+	Statistics getStatistics(int scope, bool gpu = true) const; //!< over the history of a scope, GPU or CPU times
+	std::vector<Sample> getHistory(int scope) const; //!< oldest sample first
+
+	unsigned long long getFrame() const { return m_frame; }
+	unsigned int getNumDroppedSamples() const { return m_numDroppedSamples; } //!< measurements lost because the GPU was too far behind
+
+private:
+	struct OpenScope
+	{
+		int scope; //!< -1 if the profiler is disabled in this frame
+		bool issued; //!< GPU queries issued
+		std::chrono::high_resolution_clock::time_point cpuStart;
+	};
+
+	int getOrCreateScope(const std::string& name, int parent);
+	void collectResults(Scope& scope);
+	void addSample(Scope& scope, const Sample& sample);
+	double getCPUTime(const std::chrono::high_resolution_clock::time_point& time) const; //!< ms since creation
+
+	unsigned int m_framesInFlight;
+	unsigned int m_historySize;
+	unsigned long long m_frame;
+	bool m_enabled;
+	bool m_active; //!< m_enabled at the beginning of the current frame
+	unsigned int m_numDroppedSamples;
+	std::chrono::high_resolution_clock::time_point m_creationTime;
+	double m_gpuClockOffset; //!< TraceRecorder time - GPU timestamp in ms, updated each frame while capturing
+
+	std::vector<Scope> m_scopes;
+	std::unordered_map<std::string, int> m_scopeIndices; //!< path -> index
+	std::vector<OpenScope> m_openScopes;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef TESTREPORT_H
+#define TESTREPORT_H
+
+#include <iostream>
+#include <string>
+
+/** @brief output shared by the check executables (e.g. gpuCullingTest): one OK / FAIL line per test, exit code is the number of failed tests */
+namespace TestReport
+{
+	/** @return 1 if the test failed, to be summed up into the exit code */
+	inline int report(const std::string& name, bool ok, const std::string& details)
+	{
+		std::cout << (ok ? "OK   " : "FAIL ") << name << " - " << details << std::endl;
+		return ok ? 0 : 1;
+	}
+} // namespace TestReport
+
+#endif
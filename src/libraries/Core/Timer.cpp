@@ -204,7 +204,11 @@ double OpenGLTimer::getTime()
 void OpenGLTimings::beginTimer(const std::string& timer)
 {
 	if (!m_enabled) return;
-	glGenQueries(2, &(m_timers[timer].queryID[0]) );
+	if ( m_timers.find(timer) == m_timers.end() )
+	{
+		glGenQueries(2, &(m_timers[timer].queryID[0]) );
+		m_timers[timer].lastTiming = 0.0;
+	}
 	glQueryCounter(m_timers[timer].queryID[0], GL_TIMESTAMP);
 }
 void OpenGLTimings::stopTimer(const std::string& timer)
@@ -217,8 +221,12 @@ void OpenGLTimings::updateReadyTimings()
 	if (!m_enabled) return;
 	for ( auto kv = m_timers.begin(); kv != m_timers.end(); ++kv)
 	{
-		glGetQueryObjectui64v((*kv).second.queryID[0], GL_QUERY_RESULT_NO_WAIT, &(*kv).second.startTime);
-		glGetQueryObjectui64v((*kv).second.queryID[1], GL_QUERY_RESULT_NO_WAIT, &(*kv).second.stopTime);
+		// keep the last timing while the queries are pending, see GPUProfiler for timings that are never lost
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv((*kv).second.queryID[1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if ( available != GL_TRUE ) { continue; }
+		glGetQueryObjectui64v((*kv).second.queryID[0], GL_QUERY_RESULT, &(*kv).second.startTime);
+		glGetQueryObjectui64v((*kv).second.queryID[1], GL_QUERY_RESULT, &(*kv).second.stopTime);
 		(*kv).second.lastTiming = ((*kv).second.stopTime - (*kv).second.startTime)/ 1000000.0;
 		//if (abs((*kv).second.lastTiming) > 100.0)
 		//{
@@ -0,0 +1,204 @@
+#include "TraceRecorder.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+
+#include "DebugLog.h"
+
+namespace
+{
+	std::string escapeJSON(const std::string& text)
+	{
+		std::string result;
+		result.reserve(text.size());
+		for (unsigned int i = 0; i < text.size(); i++)
+		{
+			char c = text[i];
+			if ( c == '"' || c == '\\' ) { result += '\\'; result += c; }
+			else if ( c == '\n' ) { result += "\\n"; }
+			else if ( (unsigned char) c < 0x20 ) { result += ' '; }
+			else { result += c; }
+		}
+		return result;
+	}
+
+	const int CPU_PROCESS = 1;
+	const int GPU_PROCESS = 2;
+}
+
+TraceRecorder::TraceRecorder()
+	: m_creationTime(std::chrono::high_resolution_clock::now())
+	, m_state(IDLE)
+	, m_framesLeft(0)
+	, m_flushFrames(0)
+	, m_frame(0)
+{
+}
+
+TraceRecorder::Scope::Scope(const std::string& name, const char* category)
+	: m_category(category)
+	, m_recording(TRACERECORDER->isRecording())
+{
+	if ( m_recording )
+	{
+		m_name = name;
+		m_start = std::chrono::high_resolution_clock::now();
+	}
+}
+
+TraceRecorder::Scope::~Scope()
+{
+	if ( !m_recording ) { return; }
+	auto stop = std::chrono::high_resolution_clock::now();
+	TRACERECORDER->addEvent(m_name, m_category, TRACERECORDER->getTime(m_start), std::chrono::duration<double, std::milli>(stop - m_start).count());
+}
+
+double TraceRecorder::getTime() const
+{
+	return getTime(std::chrono::high_resolution_clock::now());
+}
+
+double TraceRecorder::getTime(const std::chrono::high_resolution_clock::time_point& time) const
+{
+	return std::chrono::duration<double, std::milli>(time - m_creationTime).count();
+}
+
+void TraceRecorder::beginCapture(unsigned int numFrames, const std::string& path, unsigned int flushFrames)
+{
+	if ( m_state != IDLE )
+	{
+		DEBUGLOG->log("WARNING: TraceRecorder: capture already running, ignored: " + path);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_events.clear();
+		m_path = path;
+		m_framesLeft = std::max(numFrames, 1u);
+		m_flushFrames = flushFrames;
+	}
+	DEBUGLOG->log("TraceRecorder: capturing frames: ", (int) numFrames);
+	m_state = RECORDING;
+}
+
+void TraceRecorder::nextFrame()
+{
+	m_frame++;
+	if ( m_state == IDLE ) { return; }
+
+	if ( m_state == RECORDING )
+	{
+		if ( m_framesLeft > 0 )
+		{
+			addInstantEvent("frame " + DebugLog::to_string(m_frame), "frame");
+			m_framesLeft--;
+			return;
+		}
+
+		// all frames recorded, wait for the GPU timings that are still pending
+		m_state = FLUSHING;
+		m_framesLeft = m_flushFrames;
+	}
+
+	if ( m_framesLeft > 0 )
+	{
+		m_framesLeft--;
+		return;
+	}
+	m_state = IDLE;
+	write(m_path);
+}
+
+int TraceRecorder::getLane()
+{
+	auto lane = m_lanes.find(std::this_thread::get_id());
+	if ( lane != m_lanes.end() ) { return lane->second; }
+
+	int index = (int) m_laneNames.size();
+	m_lanes[std::this_thread::get_id()] = index;
+	m_laneNames.push_back("thread " + DebugLog::to_string(index));
+	return index;
+}
+
+void TraceRecorder::setThreadName(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_laneNames[getLane()] = name;
+}
+
+void TraceRecorder::addEvent(const Event& event)
+{
+	if ( m_state == IDLE ) { return; }
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_events.push_back(event);
+	if ( m_events.back().lane != GPU_LANE ) { m_events.back().lane = getLane(); }
+}
+
+void TraceRecorder::addEvent(const std::string& name, const char* category, double start, double duration)
+{
+	Event event = {name, category, start, duration, 0};
+	addEvent(event);
+}
+
+void TraceRecorder::addGPUEvent(const std::string& name, double start, double duration)
+{
+	Event event = {name, "gpu", start, duration, GPU_LANE};
+	addEvent(event);
+}
+
+void TraceRecorder::addInstantEvent(const std::string& name, const char* category)
+{
+	Event event = {name, category, getTime(), -1.0, 0};
+	addEvent(event);
+}
+
+bool TraceRecorder::write(const std::string& path)
+{
+	std::ofstream file(path.c_str());
+	if ( !file.good() )
+	{
+		DEBUGLOG->log("ERROR: TraceRecorder: could not write " + path);
+		return false;
+	}
+
+	unsigned int numEvents;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		numEvents = (unsigned int) m_events.size();
+
+		// lane labels
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << CPU_PROCESS << ",\"args\":{\"name\":\"CPU\"}},\n";
+		file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << GPU_PROCESS << ",\"args\":{\"name\":\"GPU\"}},\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << GPU_PROCESS << ",\"tid\":0,\"args\":{\"name\":\"OpenGL queue\"}}";
+		for (unsigned int i = 0; i < m_laneNames.size(); i++)
+		{
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << CPU_PROCESS << ",\"tid\":" << i << ",\"args\":{\"name\":\"" << escapeJSON(m_laneNames[i]) << "\"}}";
+		}
+
+		// timestamps in microseconds
+		char times[128];
+		for (unsigned int i = 0; i < m_events.size(); i++)
+		{
+			const Event& event = m_events[i];
+			bool gpu = ( event.lane == GPU_LANE );
+			file << ",\n{\"name\":\"" << escapeJSON(event.name) << "\",\"cat\":\"" << event.category << "\",\"pid\":" << (gpu ? GPU_PROCESS : CPU_PROCESS) << ",\"tid\":" << (gpu ? 0 : event.lane);
+			if ( event.duration < 0.0 )
+			{
+				std::snprintf(times, sizeof(times), ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f}", event.start * 1000.0);
+			}
+			else
+			{
+				std::snprintf(times, sizeof(times), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f}", event.start * 1000.0, event.duration * 1000.0);
+			}
+			file << times;
+		}
+		file << "\n]}\n";
+	}
+	file.close();
+
+	DEBUGLOG->log("TraceRecorder: events written to " + path + ": ", (int) numEvents);
+	return true;
+}
@@ -0,0 +1,92 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "Singleton.h"
+
+/** @brief captures CPU and GPU timelines of a few frames and writes them as Chrome trace event JSON
+ *
+ * The file can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing. Every CPU thread gets its own lane,
+ * GPU timings get a lane of their own, all times are relative to the creation of the recorder.
+ * Events come from GPUProfiler scopes (CPU and GPU), TraceRecorder::Scope (e.g. AsyncLoader jobs) and DebugLog messages
+ * (instant events). Nothing is recorded unless a capture is running.
+ * Since GPU timings are read back a few frames late, the file is written flushFrames frames after the last captured frame.
+ */
+class TraceRecorder : public Singleton<TraceRecorder>
+{
+friend class Singleton< TraceRecorder >;
+public:
+	enum Lane { GPU_LANE = -1 }; //!< lane of GPU events, CPU lanes are created per thread
+
+	/** @brief records a CPU event on the calling thread's lane for the lifetime of the object */
+	class Scope
+	{
+	public:
+		Scope(const std::string& name, const char* category = "cpu");
+		~Scope();
+	private:
+		std::string m_name;
+		const char* m_category;
+		bool m_recording;
+		std::chrono::high_resolution_clock::time_point m_start;
+	};
+
+	/** @brief record the next numFrames frames and write them to path afterwards */
+	void beginCapture(unsigned int numFrames, const std::string& path, unsigned int flushFrames = 4);
+	void nextFrame(); //!< call once per frame on the main thread, adds a frame marker
+	inline bool isRecording() const { return m_state == RECORDING; } //!< new events should be recorded
+	inline bool isCapturing() const { return m_state != IDLE; }      //!< recording or waiting for late GPU events
+
+	void setThreadName(const std::string& name); //!< label of the calling thread's lane, "thread <n>" by default
+
+	/** @param start, duration in ms, see getTime */
+	void addEvent(const std::string& name, const char* category, double start, double duration);  //!< on the calling thread's lane
+	void addGPUEvent(const std::string& name, double start, double duration);
+	void addInstantEvent(const std::string& name, const char* category); //!< now, on the calling thread's lane
+
+	double getTime() const; //!< now, in ms since creation
+	double getTime(const std::chrono::high_resolution_clock::time_point& time) const;
+
+	bool write(const std::string& path); //!< all events recorded so far
+
+private:
+	TraceRecorder();
+
+	struct Event
+	{
+		std::string name;
+		const char* category;
+		double start;    //!< ms
+		double duration; //!< ms, < 0 for instant events
+		int lane;
+	};
+
+	enum State { IDLE, RECORDING, FLUSHING };
+
+	int getLane(); //!< of the calling thread, requires m_mutex
+	void addEvent(const Event& event);
+
+	std::chrono::high_resolution_clock::time_point m_creationTime;
+	std::atomic<int> m_state;
+	unsigned int m_framesLeft;   //!< to record, or to wait for GPU events while FLUSHING
+	unsigned int m_flushFrames;
+	unsigned int m_frame;
+	std::string m_path;
+
+	mutable std::mutex m_mutex; //!< guards everything below, events may come from loader threads
+	std::vector<Event> m_events;
+	std::map<std::thread::id, int> m_lanes;
+	std::vector<std::string> m_laneNames;
+};
+
+// for convenient access
+#define TRACERECORDER TraceRecorder::getInstance()
+
+#endif
@@ -1,9 +1,11 @@
 #include "AssimpTools.h"
+#include "MeshOptimization.h"
 
 #include "Core/DebugLog.h"
 
 #include "Rendering/VertexArrayObjects.h"
 #include "Rendering/OpenGLContext.h"
+#include "Rendering/VertexFormat.h"
 
 glm::vec3 toVec3(const aiVector3D& vert)
 {
@@ -11,7 +13,7 @@ glm::vec3 toVec3(const aiVector3D& vert)
 }
 
 
-std::vector<AssimpTools::RenderableInfo > AssimpTools::createSimpleRenderablesFromScene(const aiScene* scene,const glm::mat4& vertexTransform, bool createTangentsAndBitangents)
+std::vector<AssimpTools::RenderableInfo > AssimpTools::createSimpleRenderablesFromScene(const aiScene* scene,const glm::mat4& vertexTransform, bool createTangentsAndBitangents, const VertexFormat* vertexFormat)
 {
 	std::vector<RenderableInfo >resultVector; 
 	for (unsigned int i = 0; i < scene->mNumMeshes; i++)
@@ -115,72 +117,67 @@ std::vector<AssimpTools::RenderableInfo > AssimpTools::createSimpleRenderablesFr
 				}
 			}}
 
-			// method to upload data to GPU and set as vertex attribute
-			auto createVbo = [](std::vector<float>& content, GLuint dimensions, GLuint attributeIndex)
-			{ 
-				GLuint vbo = 0;
-				glGenBuffers(1, &vbo);
-				glBindBuffer(GL_ARRAY_BUFFER, vbo);
-				glBufferData(GL_ARRAY_BUFFER, content.size() * sizeof(float), &content[0], GL_STATIC_DRAW);
-				glVertexAttribPointer(attributeIndex, dimensions, GL_FLOAT, 0, 0, 0);
-				glEnableVertexAttribArray(attributeIndex);
-				return vbo;
-			};
-
-			auto createIndexVbo = [](std::vector<unsigned int>& content) 
+			glm::mat4 dequantization(1.0f);
+			unsigned int vertexStride = 0;
+			Renderable *renderable;
+			if ( vertexFormat != nullptr )
 			{
-				GLuint vbo = 0;	
-				glGenBuffers(1, &vbo);
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo);
-				glBufferData(GL_ELEMENT_ARRAY_BUFFER, content.size() * sizeof(unsigned int), &content[0], GL_STATIC_DRAW);
-				return vbo;
-			};
-
-			// generate VAO
-			GLuint vao;
-		    glGenVertexArrays(1, &vao);
-			Renderable *renderable = new Renderable;
-			renderable->m_vao = vao;
-			OPENGLCONTEXT->bindVAO(vao);
-
-			if (m->HasPositions()){
-			renderable->m_positions.m_vboHandle = createVbo(vertices, 3, 0);
-			renderable->m_positions.m_size = vertices.size() / 3;
+				int uvComponents = (m->GetNumUVChannels() == 3) ? 3 : 2;
+				VertexFormat::InterleavedVertices interleaved = vertexFormat->pack(vertices, uvs, uvComponents, normals, tangents);
+				renderable = vertexFormat->createRenderable(interleaved, indices);
+				dequantization = interleaved.dequantization;
+				vertexStride = (unsigned int) interleaved.stride;
 			}
+			else
+			{
+				// generate VAO
+				GLuint vao;
+			    glGenVertexArrays(1, &vao);
+				renderable = new Renderable;
+				renderable->m_vao = vao;
+				OPENGLCONTEXT->bindVAO(vao);
+
+				if (m->HasPositions()){
+				renderable->m_positions.m_vboHandle = Renderable::createVbo(vertices, 3, 0);
+				renderable->m_positions.m_size = vertices.size() / 3;
+				}
 
-			if(m->HasTextureCoords(0)){
-			renderable->m_uvs.m_vboHandle = createVbo(uvs, (m->GetNumUVChannels() == 3) ? 3 : 2, 1);
-			renderable->m_uvs.m_size = (m->GetNumUVChannels() == 3) ? uvs.size() / 3 : uvs.size() / 2;
-			}
+				if(m->HasTextureCoords(0)){
+				renderable->m_uvs.m_vboHandle = Renderable::createVbo(uvs, (m->GetNumUVChannels() == 3) ? 3 : 2, 1);
+				renderable->m_uvs.m_size = (m->GetNumUVChannels() == 3) ? uvs.size() / 3 : uvs.size() / 2;
+				}
 
-			if( m->HasNormals()){
-			renderable->m_normals.m_vboHandle = createVbo(normals, 3, 2);
-			renderable->m_normals.m_size = normals.size() / 3;
-			}
+				if( m->HasNormals()){
+				renderable->m_normals.m_vboHandle = Renderable::createVbo(normals, 3, 2);
+				renderable->m_normals.m_size = normals.size() / 3;
+				}
 
-			if (m->HasTangentsAndBitangents() && createTangentsAndBitangents)
-			{
-				renderable->m_tangents.m_vboHandle = createVbo(tangents, 3, 3);
-				renderable->m_tangents.m_size = tangents.size() / 3;
-			}
+				if (m->HasTangentsAndBitangents() && createTangentsAndBitangents)
+				{
+					renderable->m_tangents.m_vboHandle = Renderable::createVbo(tangents, 3, 3);
+					renderable->m_tangents.m_size = tangents.size() / 3;
+				}
 
-			// // commented out, because, like, just compute this in the shader
-			//if (m->HasTangentsAndBitangents() && createTangentsAndBitangents)
-			//{
-			//	renderable->m_bitangents.m_vboHandle = createVbo(bitangents, 3, 4);
-			//	renderable->m_bitangents.m_size =bitangents.size() /3 ;
-			//}
+				// // commented out, because, like, just compute this in the shader
+				//if (m->HasTangentsAndBitangents() && createTangentsAndBitangents)
+				//{
+				//	renderable->m_bitangents.m_vboHandle = createVbo(bitangents, 3, 4);
+				//	renderable->m_bitangents.m_size =bitangents.size() /3 ;
+				//}
 
-			renderable->m_indices.m_vboHandle = createIndexVbo(indices);
-			renderable->m_indices.m_size = indices.size();
+				renderable->m_indices.m_vboHandle = Renderable::createIndexVbo(indices);
+				renderable->m_indices.m_size = indices.size();
 
-			renderable->setDrawMode(GL_TRIANGLES);
+				renderable->setDrawMode(GL_TRIANGLES);
 
-			OPENGLCONTEXT->bindVAO(0);
+				OPENGLCONTEXT->bindVAO(0);
+			}
 
 			// save mesh info
 			RenderableInfo renderableInfo;
 			renderableInfo.renderable = renderable;
+			renderableInfo.dequantization = dequantization;
+			renderableInfo.vertexStride = vertexStride;
 			renderableInfo.boundingBox.min = min;
 			renderableInfo.boundingBox.max = max;
 			renderableInfo.name = std::string( m->mName.C_Str() );
@@ -193,7 +190,7 @@ std::vector<AssimpTools::RenderableInfo > AssimpTools::createSimpleRenderablesFr
 	}
 }
 
-std::vector<AssimpTools::VertexData> AssimpTools::createVertexDataInstancesFromScene( const aiScene* scene, const glm::mat4& vertexTransform, bool createTangentsAndBitangents)
+std::vector<AssimpTools::VertexData> AssimpTools::createVertexDataInstancesFromScene( const aiScene* scene, const glm::mat4& vertexTransform, bool createTangentsAndBitangents, bool optimizeMeshes)
 {
 	std::vector<VertexData >resultVector;
 	resultVector.resize(scene->mNumMeshes);
@@ -308,12 +305,19 @@ std::vector<AssimpTools::VertexData> AssimpTools::createVertexDataInstancesFromS
 			resultVector[i].uvs = uvs;
 			resultVector[i].normals = normals;
 			resultVector[i].tangents = tangents;
+
+			if ( optimizeMeshes )
+			{
+				MeshOptimization::Report report = MeshOptimization::optimize(resultVector[i]);
+				DEBUGLOG->log("optimized mesh " + DebugLog::to_string((int) i) + ", ACMR: " + DebugLog::to_string(report.before.acmr) + " -> " + DebugLog::to_string(report.after.acmr)
+					+ ", ATVR: " + DebugLog::to_string(report.before.atvr) + " -> " + DebugLog::to_string(report.after.atvr));
+			}
 		}
 	}
 	return resultVector;
 }
 
-std::vector<Renderable* > AssimpTools::createSimpleRenderablesFromVertexDataInstances(std::vector<AssimpTools::VertexData>& vertexDataInstances)
+std::vector<Renderable* > AssimpTools::createSimpleRenderablesFromVertexDataInstances(std::vector<AssimpTools::VertexData>& vertexDataInstances, bool useShortIndices)
 {
 	std::vector<Renderable* > resultVector;
 	for ( int i = 0; i  < vertexDataInstances.size(); i++)
@@ -348,7 +352,16 @@ std::vector<Renderable* > AssimpTools::createSimpleRenderablesFromVertexDataInst
 
 		if (!vertexDataInstances[i].indices.empty())
 		{
-			renderable->m_indices.m_vboHandle = Renderable::createIndexVbo(vertexDataInstances[i].indices);
+			std::vector<unsigned short> shortIndices;
+			if ( useShortIndices && MeshOptimization::toShortIndices(vertexDataInstances[i].indices, shortIndices) )
+			{
+				renderable->m_indices.m_vboHandle = Renderable::createIndexVbo(shortIndices);
+				renderable->m_indexType = GL_UNSIGNED_SHORT;
+			}
+			else
+			{
+				renderable->m_indices.m_vboHandle = Renderable::createIndexVbo(vertexDataInstances[i].indices);
+			}
 			renderable->m_indices.m_size = vertexDataInstances[i].indices.size();
 		}
 
@@ -10,6 +10,7 @@
 #include <string>
 
 class Renderable;
+class VertexFormat;
 namespace Assimp{ class Importer; }
 
 namespace AssimpTools {
@@ -34,14 +35,17 @@ namespace AssimpTools {
 		BoundingBox  boundingBox;
 		std::string  name;    // name associated with this mesh
 		unsigned int meshIdx; // mesh index associated with this Renderable (to retrieve the aiMesh from the source aiScene)
+		glm::mat4    dequantization; // identity unless the vertex format quantizes positions, then multiply the model matrix with it for drawing (not for culling)
+		unsigned int vertexStride;   // bytes per vertex of the interleaved buffer, 0 if every attribute has its own buffer
 	};
 
 	/** @brief creates a Renderable for every Mesh in the scene
 	 * @details Each Renderable (hopefully) has vertices, normals, uvs and an index buffer, draw mode is GL_TRIANGLES 
 	 * @param scene imported with Assimp::Importer
 	 * @param vertexTransform transformation that will be apllied to every vertex (and normal). Default: identity
+	 * @param vertexFormat (optional) store all attributes in one interleaved, compressed buffer instead of one float buffer per attribute
 	 */
-	std::vector<RenderableInfo > createSimpleRenderablesFromScene( const aiScene* scene, const glm::mat4& vertexTransform = glm::mat4(1.0f), bool createTangentsAndBitangents = true); 
+	std::vector<RenderableInfo > createSimpleRenderablesFromScene( const aiScene* scene, const glm::mat4& vertexTransform = glm::mat4(1.0f), bool createTangentsAndBitangents = true, const VertexFormat* vertexFormat = nullptr); 
 
 	struct VertexData
 	{
@@ -51,8 +55,10 @@ namespace AssimpTools {
 		std::vector<float> normals;
 		std::vector<float> tangents;
 	};
-	std::vector<VertexData> createVertexDataInstancesFromScene( const aiScene* scene, const glm::mat4& vertexTransform = glm::mat4(1.0f), bool createTangentsAndBitangents = true);
-	std::vector<Renderable* > createSimpleRenderablesFromVertexDataInstances(std::vector<VertexData>& vertexDataInstances);
+	/** @param optimizeMeshes reorder indices and vertices for vertex cache, overdraw and fetch locality (see MeshOptimization), the ACMR before and after is logged */
+	std::vector<VertexData> createVertexDataInstancesFromScene( const aiScene* scene, const glm::mat4& vertexTransform = glm::mat4(1.0f), bool createTangentsAndBitangents = true, bool optimizeMeshes = false);
+	/** @param useShortIndices upload 16 bit indices for meshes whose indices fit (at most 65536 vertices) */
+	std::vector<Renderable* > createSimpleRenderablesFromVertexDataInstances(std::vector<VertexData>& vertexDataInstances, bool useShortIndices = false);
 
 	BoundingBox computeBoundingBox(const aiMesh* mesh); //!< computes the bounding box of the given mesh
 	BoundingBox computeBoundingBox(VertexData& mesh); //!< computes the bounding box of the given mesh
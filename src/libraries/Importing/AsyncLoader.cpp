@@ -0,0 +1,405 @@
+#include "AsyncLoader.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "Core/DebugLog.h"
+#include "Core/TraceRecorder.h"
+#include "Importing/MeshCache.h"
+#include "Rendering/OpenGLContext.h"
+#include "Rendering/GLResources.h"
+
+namespace
+{
+	typedef std::shared_ptr<unsigned char> ImagePointer; // frees with TextureTools::freeImage
+
+	ImagePointer decode(const std::string& fileName, int& width, int& height, int& bytesPerPixel, bool flipVertically)
+	{
+		width = height = bytesPerPixel = 0;
+		unsigned char* data = TextureTools::decodeImage(fileName, width, height, bytesPerPixel, flipVertically);
+		return ( data != nullptr ) ? ImagePointer(data, TextureTools::freeImage) : ImagePointer();
+	}
+
+	/// pixels may be an offset into the bound pixel unpack buffer
+	void texImage(GLenum target, int width, int height, int bytesPerPixel, const void* pixels)
+	{
+		GLenum format = ( bytesPerPixel == 3 ) ? GL_RGB : GL_RGBA;
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // rows of RGB images are not padded
+		glTexImage2D(target, 0, GLResources::getSizedInternalFormat(format), width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+}
+
+AsyncLoader::AsyncLoader(unsigned int numThreads)
+	: m_quit(false)
+	, m_numPending(0)
+	, m_usePixelBuffers(true)
+{
+	if ( numThreads == 0 )
+	{
+		unsigned int numCores = std::thread::hardware_concurrency();
+		numThreads = ( numCores > 1 ) ? numCores - 1 : 1;
+	}
+	TraceRecorder::getInstance(); // create it here, singletons are not created thread safe
+	for (unsigned int i = 0; i < numThreads; i++)
+	{
+		m_workers.push_back(std::thread(&AsyncLoader::workerLoop, this));
+	}
+}
+
+AsyncLoader::~AsyncLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_jobAvailable.notify_all();
+	for (unsigned int i = 0; i < m_workers.size(); i++) { m_workers[i].join(); }
+
+	// nobody will run these anymore, their handles must not stay LOADING
+	for (unsigned int i = 0; i < m_jobs.size(); i++) { m_jobs[i].cancel(); }
+	for (unsigned int i = 0; i < m_uploads.size(); i++) { m_uploads[i].cancel(); }
+}
+
+void AsyncLoader::workerLoop()
+{
+	TRACERECORDER->setThreadName("AsyncLoader worker");
+	while ( true )
+	{
+		Task job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ( !m_quit && m_jobs.empty() ) { m_jobAvailable.wait(lock); }
+			if ( m_quit ) { return; } // remaining jobs are cancelled by the destructor
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+		job.run();
+	}
+}
+
+void AsyncLoader::enqueueJob(const std::string& name, const std::function<void()>& job, const std::function<void()>& cancel)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Task task;
+		task.run = [=]()
+		{
+			TraceRecorder::Scope scope(name, "loader");
+			job();
+		};
+		task.cancel = cancel;
+		m_jobs.push_back(task);
+		m_numPending++;
+	}
+	m_jobAvailable.notify_one();
+}
+
+void AsyncLoader::enqueueUpload(const std::string& name, const std::function<void()>& upload, const std::function<void()>& cancel)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Task task;
+		task.run = [=]()
+		{
+			TraceRecorder::Scope scope("upload " + name, "loader");
+			upload();
+		};
+		task.cancel = cancel;
+		m_uploads.push_back(task);
+	}
+	m_uploadAvailable.notify_all();
+}
+
+int AsyncLoader::update(double budgetMilliseconds)
+{
+	auto start = std::chrono::steady_clock::now();
+	int numUploads = 0;
+	while ( true )
+	{
+		Task upload;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if ( m_uploads.empty() ) { break; }
+			upload = m_uploads.front();
+			m_uploads.pop_front();
+		}
+		upload.run();
+		numUploads++;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_numPending--;
+		}
+
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if ( elapsed >= budgetMilliseconds ) { break; }
+	}
+	return numUploads;
+}
+
+void AsyncLoader::finish()
+{
+	while ( true )
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ( m_numPending != 0 && m_uploads.empty() ) { m_uploadAvailable.wait(lock); }
+			if ( m_numPending == 0 ) { return; }
+		}
+		update(1e30);
+	}
+}
+
+void AsyncLoader::finish(const MeshHandle& mesh)
+{
+	// the state is only changed by uploads, which run on this thread
+	while ( mesh->state == LOADING )
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while ( m_uploads.empty() ) { m_uploadAvailable.wait(lock); }
+		}
+		update(1e30);
+	}
+}
+
+unsigned int AsyncLoader::getNumPending() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numPending;
+}
+
+void AsyncLoader::setUsePixelBuffers(bool use)
+{
+	m_usePixelBuffers = use;
+}
+
+GLuint AsyncLoader::createPlaceholder(GLenum target)
+{
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+
+	GLuint handle;
+	glGenTextures(1, &handle);
+	OPENGLCONTEXT->bindTexture(handle, target);
+	if ( target == GL_TEXTURE_CUBE_MAP )
+	{
+		for (GLenum face = 0; face < 6; face++) { glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey); }
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	}
+	else
+	{
+		glTexImage2D(target, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+	}
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // a single 1x1 level is a complete chain
+	OPENGLCONTEXT->bindTexture(0, target);
+	return handle;
+}
+
+void AsyncLoader::uploadImages(const std::string& name, const TextureHandle& texture, const std::vector<Image>& images, const std::function<void()>& onUploaded)
+{
+	GLenum firstTarget = ( texture->target == GL_TEXTURE_CUBE_MAP ) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : texture->target; // faces are consecutive
+	std::vector<GLsizeiptr> offsets(images.size());
+	GLsizeiptr size = 0;
+	for (unsigned int i = 0; i < images.size(); i++)
+	{
+		offsets[i] = size;
+		size += (GLsizeiptr) images[i].width * images[i].height * images[i].bytesPerPixel;
+	}
+
+	if ( m_usePixelBuffers && size > 0 )
+	{
+		// a new buffer per request, so several copies may be in flight
+		GLuint pixelBuffer;
+		glGenBuffers(1, &pixelBuffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		unsigned char* mapped = (unsigned char*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		if ( mapped != NULL )
+		{
+			std::function<void()> cancel = [=]()
+			{
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				glDeleteBuffers(1, &pixelBuffer);
+				texture->state = FAILED;
+			};
+
+			// the worker fills the mapping, the GL thread only unmaps and sources glTexImage2D from the buffer
+			enqueueJob("copy " + name, [=]()
+			{
+				for (unsigned int i = 0; i < images.size(); i++)
+				{
+					std::memcpy(mapped + offsets[i], images[i].pixels.get(), (size_t) images[i].width * images[i].height * images[i].bytesPerPixel);
+				}
+
+				enqueueUpload(name, [=]()
+				{
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+					bool intact = ( glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE ); // false if the content was lost, e.g. on a mode switch
+					OPENGLCONTEXT->bindTexture(texture->handle, texture->target);
+					for (unsigned int i = 0; i < images.size(); i++)
+					{
+						if ( intact ) { texImage(firstTarget + i, images[i].width, images[i].height, images[i].bytesPerPixel, (const GLvoid*) offsets[i]); }
+					}
+					glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+					for (unsigned int i = 0; i < images.size(); i++)
+					{
+						if ( !intact ) { texImage(firstTarget + i, images[i].width, images[i].height, images[i].bytesPerPixel, images[i].pixels.get()); }
+					}
+					OPENGLCONTEXT->bindTexture(0, texture->target);
+					glDeleteBuffers(1, &pixelBuffer); // the driver keeps it alive until the uploads have read it
+					onUploaded();
+				}, cancel);
+			}, cancel);
+			return;
+		}
+		glDeleteBuffers(1, &pixelBuffer); // could not map, upload from client memory
+	}
+
+	OPENGLCONTEXT->bindTexture(texture->handle, texture->target);
+	for (unsigned int i = 0; i < images.size(); i++)
+	{
+		texImage(firstTarget + i, images[i].width, images[i].height, images[i].bytesPerPixel, images[i].pixels.get());
+	}
+	OPENGLCONTEXT->bindTexture(0, texture->target);
+	onUploaded();
+}
+
+AsyncLoader::TextureHandle AsyncLoader::loadTexture(const std::string& fileName, Callback onReady)
+{
+	TextureHandle texture(new Texture);
+	texture->handle = createPlaceholder(GL_TEXTURE_2D);
+	texture->target = GL_TEXTURE_2D;
+	texture->info.handle = texture->handle;
+	texture->info.width = texture->info.height = texture->info.bytesPerPixel = 0;
+	texture->state = LOADING;
+	std::function<void()> cancel = [=]() { texture->state = FAILED; };
+
+	enqueueJob("decode " + fileName, [=]()
+	{
+		std::vector<Image> images(1);
+		images[0].pixels = decode(fileName, images[0].width, images[0].height, images[0].bytesPerPixel, true);
+
+		enqueueUpload(fileName, [=]()
+		{
+			if ( !images[0].pixels || images[0].bytesPerPixel < 3 )
+			{
+				DEBUGLOG->log("ERROR : Unable to open image " + fileName);
+				texture->state = FAILED;
+				if ( onReady ) { onReady(); }
+				return;
+			}
+
+			uploadImages(fileName, texture, images, [=]()
+			{
+				GLResources::generateMipmap(texture->handle);
+				texture->info.width = images[0].width;
+				texture->info.height = images[0].height;
+				texture->info.bytesPerPixel = images[0].bytesPerPixel;
+				texture->state = READY;
+				DEBUGLOG->log("SUCCESS: image loaded from " + fileName);
+				if ( onReady ) { onReady(); }
+			});
+		}, cancel);
+	}, cancel);
+	return texture;
+}
+
+AsyncLoader::TextureHandle AsyncLoader::loadTextureFromResourceFolder(const std::string& fileName, Callback onReady)
+{
+	return loadTexture(RESOURCES_PATH "/" + fileName, onReady);
+}
+
+AsyncLoader::TextureHandle AsyncLoader::loadCubemap(const std::vector<std::string>& faces, bool generateMipMaps, Callback onReady)
+{
+	TextureHandle texture(new Texture);
+	texture->handle = createPlaceholder(GL_TEXTURE_CUBE_MAP);
+	texture->target = GL_TEXTURE_CUBE_MAP;
+	texture->info.handle = texture->handle;
+	texture->info.width = texture->info.height = texture->info.bytesPerPixel = 0;
+	texture->state = LOADING;
+	if ( !generateMipMaps ) { GLResources::setTextureParameter(texture->handle, GL_TEXTURE_MIN_FILTER, GL_LINEAR, GL_TEXTURE_CUBE_MAP); }
+	std::function<void()> cancel = [=]() { texture->state = FAILED; };
+
+	// one job for all faces, they are uploaded together
+	std::string name = "cubemap " + ( faces.empty() ? std::string() : faces[0] );
+	enqueueJob("decode " + name, [=]()
+	{
+		std::vector<Image> images(faces.size());
+		for (unsigned int i = 0; i < faces.size(); i++)
+		{
+			images[i].pixels = decode(faces[i], images[i].width, images[i].height, images[i].bytesPerPixel, false);
+		}
+
+		enqueueUpload(name, [=]()
+		{
+			bool ok = ( faces.size() == 6 );
+			for (unsigned int i = 0; i < images.size(); i++)
+			{
+				if ( !images[i].pixels || images[i].bytesPerPixel < 3 )
+				{
+					DEBUGLOG->log("ERROR : Unable to open image " + faces[i]);
+					ok = false;
+				}
+			}
+			if ( !ok )
+			{
+				texture->state = FAILED;
+				if ( onReady ) { onReady(); }
+				return;
+			}
+
+			uploadImages(name, texture, images, [=]()
+			{
+				if ( generateMipMaps ) { GLResources::generateMipmap(texture->handle, GL_TEXTURE_CUBE_MAP); }
+				texture->info.width = images[0].width;
+				texture->info.height = images[0].height;
+				texture->info.bytesPerPixel = images[0].bytesPerPixel;
+				texture->state = READY;
+				if ( onReady ) { onReady(); }
+			});
+		}, cancel);
+	}, cancel);
+	return texture;
+}
+
+AsyncLoader::TextureHandle AsyncLoader::loadCubemapFromResourceFolder(std::vector<std::string> fileNames, bool generateMipMaps, Callback onReady)
+{
+	for (unsigned int i = 0; i < fileNames.size(); i++)
+	{
+		fileNames[i] = RESOURCES_PATH "/" + fileNames[i];
+	}
+	return loadCubemap(fileNames, generateMipMaps, onReady);
+}
+
+AsyncLoader::MeshHandle AsyncLoader::loadMeshFromResourceFolder(const std::string& fileName, bool createRenderables, Callback onReady)
+{
+	MeshHandle mesh(new Mesh);
+	mesh->scene.reset(new MeshCache::Scene);
+	mesh->state = LOADING;
+	std::function<void()> cancel = [=]() { mesh->state = FAILED; };
+
+	enqueueJob("decode " + fileName, [=]()
+	{
+		bool ok = mesh->scene->loadFromResourceFolder(fileName);
+
+		// the scene (and its file mapping) lives as long as the handle
+		enqueueUpload(fileName, [=]()
+		{
+			if ( ok )
+			{
+				if ( createRenderables ) { mesh->renderables = mesh->scene->createRenderables(); }
+				mesh->materials = mesh->scene->getMaterialInfos();
+			}
+			mesh->state = ok ? READY : FAILED;
+			if ( onReady ) { onReady(); }
+		}, cancel);
+	}, cancel);
+	return mesh;
+}
@@ -0,0 +1,116 @@
+#ifndef ASYNC_LOADER_H
+#define ASYNC_LOADER_H
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <GL/glew.h>
+
+#include <Importing/AssimpTools.h>
+#include <Importing/TextureTools.h>
+
+namespace MeshCache { class Scene; }
+
+/** @brief loads textures and meshes in the background
+ *
+ * File reading and decoding (stb_image, MeshCache / Assimp) runs on a pool of worker threads, the OpenGL uploads are queued and
+ * executed on the GL thread by update(), which stops as soon as its time budget is spent. With pixel buffers the workers also copy
+ * the pixels into a buffer mapped by the GL thread, which then only unmaps it and issues glTexImage2D.
+ * Every request returns a handle immediately. Texture handles own a valid texture name right away that shows a placeholder
+ * until the image is uploaded, so it may be bound to shaders and configured (glTexParameter) before it is ready.
+ * Textures loaded this way use mutable storage, since the size is not known when the name is created.
+ */
+class AsyncLoader
+{
+public:
+	enum State { LOADING, READY, FAILED };
+
+	struct Texture
+	{
+		GLuint handle;                   //!< valid immediately, placeholder content until READY
+		GLenum target;                   //!< GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+		TextureTools::TextureInfo info;  //!< valid when READY
+		State state;
+	};
+	typedef std::shared_ptr<Texture> TextureHandle;
+
+	struct Mesh
+	{
+		std::vector<AssimpTools::RenderableInfo> renderables; //!< empty until READY, or if no renderables were requested
+		std::vector<AssimpTools::MaterialInfo> materials;     //!< empty until READY
+		std::shared_ptr<MeshCache::Scene> scene;              //!< the parsed cache, do not touch until READY (e.g. for createVertexDataInstances())
+		State state;
+	};
+	typedef std::shared_ptr<Mesh> MeshHandle;
+
+	typedef std::function<void()> Callback; //!< called on the GL thread (from update()) once the asset is READY or FAILED
+
+	/** @param numThreads number of worker threads, 0 for one less than the number of cores */
+	AsyncLoader(unsigned int numThreads = 0);
+	~AsyncLoader(); //!< waits for running decodes, requests that were not done yet become FAILED. Deletes GL objects, destroy it before the context
+
+	TextureHandle loadTexture(const std::string& fileName, Callback onReady = Callback()); //!< like TextureTools::loadTexture
+	TextureHandle loadTextureFromResourceFolder(const std::string& fileName, Callback onReady = Callback());
+	TextureHandle loadCubemap(const std::vector<std::string>& faces, bool generateMipMaps = true, Callback onReady = Callback()); //!< like TextureTools::loadCubemap
+	TextureHandle loadCubemapFromResourceFolder(std::vector<std::string> fileNames, bool generateMipMaps = true, Callback onReady = Callback());
+	MeshHandle loadMeshFromResourceFolder(const std::string& fileName, bool createRenderables = true, Callback onReady = Callback()); //!< through MeshCache
+
+	/** @brief call once per frame on the GL thread: execute queued uploads until budgetMilliseconds are spent (at least one)
+	 * @return number of uploads done
+	 */
+	int update(double budgetMilliseconds = 2.0);
+	void finish(); //!< block until every request is READY or FAILED
+	void finish(const MeshHandle& mesh); //!< block until mesh is READY or FAILED, uploads of other requests that are ready meanwhile are done as well
+
+	unsigned int getNumPending() const; //!< requests not READY or FAILED yet
+	void setUsePixelBuffers(bool use); //!< upload textures through a pixel unpack buffer (default: true)
+
+private:
+	AsyncLoader(const AsyncLoader&);            // not copyable, owns threads
+	AsyncLoader& operator=(const AsyncLoader&);
+
+	struct Task //!< a job or an upload, cancel() marks its request FAILED if the loader is destroyed before it ran
+	{
+		std::function<void()> run;
+		std::function<void()> cancel;
+	};
+
+	struct Image //!< decoded by a worker
+	{
+		std::shared_ptr<unsigned char> pixels; //!< null if decoding failed
+		int width;
+		int height;
+		int bytesPerPixel;
+	};
+
+	void enqueueJob(const std::string& name, const std::function<void()>& job, const std::function<void()>& cancel);       //!< run on a worker, name labels the trace event
+	void enqueueUpload(const std::string& name, const std::function<void()>& upload, const std::function<void()>& cancel); //!< from a worker, executed by update()
+	void workerLoop();
+
+	GLuint createPlaceholder(GLenum target);
+
+	/** @brief on the GL thread: image i goes to face i of the texture (or its only face), then onUploaded is called on the GL thread
+	 *
+	 * with pixel buffers the copy into the mapped buffer is another job, so onUploaded runs in a later update()
+	 */
+	void uploadImages(const std::string& name, const TextureHandle& texture, const std::vector<Image>& images, const std::function<void()>& onUploaded);
+
+	std::vector<std::thread> m_workers;
+	std::deque<Task> m_jobs;
+	std::deque<Task> m_uploads;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_uploadAvailable;
+	bool m_quit;
+	unsigned int m_numPending;
+
+	bool m_usePixelBuffers;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef BRICKED_VOLUME_H
+#define BRICKED_VOLUME_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <Core/DebugLog.h>
+#include <Importing/Importer.h>
+
+/** @brief sparse representation of a VolumeData: the volume is split into bricks of brickSize^3 voxels, bricks whose values
+ * are all below a threshold are dropped and the remaining bricks are packed into an atlas.
+ *
+ * The brick table holds one entry per brick (x, y, z position of the brick in the atlas in bricks, -1 if dropped, and the maximum
+ * value of the brick), so it serves as indirection table and occupancy grid for empty space skipping at the same time.
+ * See loadToBrickedTextures (GLTools.h) and modelSpace/volumeBricked.frag.
+ */
+template<class T>
+struct BrickedVolumeData
+{
+	unsigned int size_x; //!< of the original volume in voxels
+	unsigned int size_y;
+	unsigned int size_z;
+
+	unsigned int brickSize;   //!< edge length of a brick in voxels
+	unsigned int numBricks_x; //!< bricks per axis of the volume, border bricks are padded with the emptyValue
+	unsigned int numBricks_y;
+	unsigned int numBricks_z;
+
+	std::vector<T> brickMin;       //!< per brick, x fastest
+	std::vector<T> brickMax;       //!< per brick, x fastest
+	std::vector<int> brickIndex;   //!< position of the brick in the atlas (x + y * atlasBricks_x + ...), -1 if the brick was dropped
+
+	unsigned int atlasBricks_x; //!< bricks per axis of the atlas
+	unsigned int atlasBricks_y;
+	unsigned int atlasBricks_z;
+	std::vector<T> atlasData;   //!< (atlasBricks_x * brickSize) * (atlasBricks_y * brickSize) * (atlasBricks_z * brickSize) voxels, x fastest
+
+	T emptyValue; //!< value of voxels in dropped bricks and of the padding (the minimum of the volume)
+
+	T min;
+	T max;
+
+	/** @brief value of a voxel, like the shader does it */
+	T getValue(unsigned int x, unsigned int y, unsigned int z) const
+	{
+		unsigned int brick = (z / brickSize * numBricks_y + y / brickSize) * numBricks_x + x / brickSize;
+		if ( brickIndex[brick] < 0 ) { return emptyValue; }
+
+		unsigned int index = (unsigned int) brickIndex[brick];
+		size_t atlasX = (index % atlasBricks_x) * brickSize + x % brickSize;
+		size_t atlasY = (index / atlasBricks_x % atlasBricks_y) * brickSize + y % brickSize;
+		size_t atlasZ = (index / (atlasBricks_x * atlasBricks_y)) * brickSize + z % brickSize;
+		return atlasData[(atlasZ * atlasBricks_y * brickSize + atlasY) * atlasBricks_x * brickSize + atlasX];
+	}
+
+	unsigned int getNumOccupiedBricks() const { return (unsigned int) std::count_if(brickIndex.begin(), brickIndex.end(), [](int i) { return i >= 0; }); }
+};
+
+namespace Importer {
+	/**
+	 * @brief split a volume into bricks and keep only those with values of at least emptyThreshold
+	 * @param brickSize edge length of a brick in voxels
+	 * @param emptyThreshold bricks with a maximum value below this are dropped, e.g. the air around a CT scan
+	 */
+	template<class T>
+	BrickedVolumeData<T> createBrickedVolume(const VolumeData<T>& volume, T emptyThreshold, unsigned int brickSize = 32)
+	{
+		BrickedVolumeData<T> result;
+		result.size_x = volume.size_x;
+		result.size_y = volume.size_y;
+		result.size_z = volume.size_z;
+		result.brickSize = brickSize;
+		result.numBricks_x = (volume.size_x + brickSize - 1) / brickSize;
+		result.numBricks_y = (volume.size_y + brickSize - 1) / brickSize;
+		result.numBricks_z = (volume.size_z + brickSize - 1) / brickSize;
+		result.emptyValue = volume.min;
+		result.min = volume.min;
+		result.max = volume.max;
+
+		unsigned int numBricks = result.numBricks_x * result.numBricks_y * result.numBricks_z;
+		result.brickMin.assign(numBricks, volume.max);
+		result.brickMax.assign(numBricks, volume.min);
+		result.brickIndex.assign(numBricks, -1);
+
+		// per brick min / max
+		for (unsigned int z = 0; z < volume.size_z; z++)
+		{
+			for (unsigned int y = 0; y < volume.size_y; y++)
+			{
+				const T* row = &volume.data[((size_t) z * volume.size_y + y) * volume.size_x];
+				unsigned int brickRow = (z / brickSize * result.numBricks_y + y / brickSize) * result.numBricks_x;
+				for (unsigned int bx = 0; bx < result.numBricks_x; bx++)
+				{
+					const T* begin = row + bx * brickSize;
+					const T* end = row + std::min((bx + 1) * brickSize, volume.size_x);
+					T& brickMin = result.brickMin[brickRow + bx];
+					T& brickMax = result.brickMax[brickRow + bx];
+					for (const T* v = begin; v != end; v++)
+					{
+						brickMin = std::min(*v, brickMin);
+						brickMax = std::max(*v, brickMax);
+					}
+				}
+			}
+		}
+
+		// assign atlas positions in brick order
+		unsigned int numOccupied = 0;
+		for (unsigned int b = 0; b < numBricks; b++)
+		{
+			if ( result.brickMax[b] >= emptyThreshold ) { result.brickIndex[b] = (int) numOccupied++; }
+		}
+
+		// roughly cubic atlas
+		result.atlasBricks_x = std::max(1u, (unsigned int) std::ceil(std::pow((double) numOccupied, 1.0 / 3.0) - 1e-9));
+		result.atlasBricks_y = std::max(1u, (unsigned int) std::ceil(std::sqrt((double) numOccupied / result.atlasBricks_x) - 1e-9));
+		result.atlasBricks_z = std::max(1u, (numOccupied + result.atlasBricks_x * result.atlasBricks_y - 1) / (result.atlasBricks_x * result.atlasBricks_y));
+
+		size_t atlasSize_x = (size_t) result.atlasBricks_x * brickSize;
+		size_t atlasSize_y = (size_t) result.atlasBricks_y * brickSize;
+		result.atlasData.assign(atlasSize_x * atlasSize_y * result.atlasBricks_z * brickSize, result.emptyValue);
+
+		// copy the occupied bricks row by row
+		for (unsigned int b = 0; b < numBricks; b++)
+		{
+			if ( result.brickIndex[b] < 0 ) { continue; }
+			unsigned int index = (unsigned int) result.brickIndex[b];
+			unsigned int bx = b % result.numBricks_x, by = b / result.numBricks_x % result.numBricks_y, bz = b / (result.numBricks_x * result.numBricks_y);
+			size_t atlasX = (index % result.atlasBricks_x) * brickSize;
+			size_t atlasY = (index / result.atlasBricks_x % result.atlasBricks_y) * brickSize;
+			size_t atlasZ = (index / (result.atlasBricks_x * result.atlasBricks_y)) * brickSize;
+
+			unsigned int width = std::min(brickSize, volume.size_x - bx * brickSize);
+			for (unsigned int z = 0; z < brickSize && bz * brickSize + z < volume.size_z; z++)
+			{
+				for (unsigned int y = 0; y < brickSize && by * brickSize + y < volume.size_y; y++)
+				{
+					const T* source = &volume.data[(((size_t) bz * brickSize + z) * volume.size_y + by * brickSize + y) * volume.size_x + bx * brickSize];
+					T* target = &result.atlasData[((atlasZ + z) * atlasSize_y + atlasY + y) * atlasSize_x + atlasX];
+					std::copy(source, source + width, target);
+				}
+			}
+		}
+
+		DEBUGLOG->log("bricked volume: occupied bricks: " + DebugLog::to_string(numOccupied) + " / " + DebugLog::to_string(numBricks)
+			+ ", voxels: " + DebugLog::to_string((unsigned int) result.atlasData.size()) + " (dense: " + DebugLog::to_string((unsigned int) volume.data.size()) + ")");
+
+		return result;
+	}
+} // namespace Importer
+
+#endif
@@ -1 +1,48 @@
-#include "Importer.h"
\ No newline at end of file
+#include "Importer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define IMPORTER_USE_SSE2
+#endif
+#if defined(__SSSE3__)
+	#include <tmmintrin.h>
+	#define IMPORTER_USE_SSSE3
+#endif
+
+void Importer::decodeSlice16(const unsigned char* input, size_t numEntries, short* target, short& min, short& max)
+{
+	size_t j = 0;
+
+#ifdef IMPORTER_USE_SSE2
+	// 8 entries at once: swap the bytes of every 16 bit lane, then keep running per-lane min / max
+	if ( numEntries >= 8 )
+	{
+#ifdef IMPORTER_USE_SSSE3
+		const __m128i swapBytes = _mm_set_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1);
+#endif
+		__m128i minValues = _mm_set1_epi16(min);
+		__m128i maxValues = _mm_set1_epi16(max);
+		for ( ; j + 8 <= numEntries; j += 8)
+		{
+			__m128i raw = _mm_loadu_si128((const __m128i*) (input + 2 * j));
+#ifdef IMPORTER_USE_SSSE3
+			__m128i values = _mm_shuffle_epi8(raw, swapBytes);
+#else
+			__m128i values = _mm_or_si128(_mm_slli_epi16(raw, 8), _mm_srli_epi16(raw, 8));
+#endif
+			_mm_storeu_si128((__m128i*) (target + j), values);
+			minValues = _mm_min_epi16(minValues, values);
+			maxValues = _mm_max_epi16(maxValues, values);
+		}
+
+		short lanes[8];
+		_mm_storeu_si128((__m128i*) lanes, minValues);
+		for (int k = 0; k < 8; k++) { min = std::min(lanes[k], min); }
+		_mm_storeu_si128((__m128i*) lanes, maxValues);
+		for (int k = 0; k < 8; k++) { max = std::max(lanes[k], max); }
+	}
+#endif
+
+	// remaining entries (or all of them without SSE2)
+	decodeSlice16<short>(input + 2 * j, numEntries - j, target + j, min, max);
+}
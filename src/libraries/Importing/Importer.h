@@ -11,6 +11,12 @@
 #include <Core/DebugLog.h>
 
 #include <algorithm>
+#include <limits>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 template<class T>
 struct VolumeData
@@ -32,15 +38,66 @@ struct VolumeData
 };
 
 namespace Importer {
+	/**
+	 * @brief decode big endian 16 bit two's complement entries, SSSE3 / SSE2 version for short volumes (see Importer.cpp)
+	 */
+	void decodeSlice16(const unsigned char* input, size_t numEntries, short* target, short& min, short& max);
+
+	/** @brief scalar version of decodeSlice16 for any other T */
+	template<class T>
+	void decodeSlice16(const unsigned char* input, size_t numEntries, T* target, T& min, T& max)
+	{
+		for (size_t j = 0; j < numEntries; j++)
+		{
+			// assemble unsigned, the conversion to short reinterprets the two's complement
+			T val = (T) (short) ( ((unsigned int) input[2 * j] << 8) | (unsigned int) input[2 * j + 1] );
+			target[j] = val;
+			min = std::min(val, min);
+			max = std::max(val, max);
+		}
+	}
+
+	/**
+	 * @brief decode big endian, two's complement entries to T and update min / max
+	 * @param input numEntries * bytesPerEntry bytes
+	 */
+	template<class T>
+	void decodeSlice(const unsigned char* input, unsigned int bytesPerEntry, size_t numEntries, T* target, T& min, T& max)
+	{
+		if ( bytesPerEntry == 2 ) // common case (16 bit CT data)
+		{
+			decodeSlice16(input, numEntries, target, min, max);
+			return;
+		}
+
+		for (size_t j = 0; j < numEntries; j++)
+		{
+			const unsigned char* entry = input + bytesPerEntry * j;
+			long long val = (signed char) entry[0];
+			for (unsigned int k = 1; k < bytesPerEntry; k++)
+			{
+				val = val * 256 + entry[k];
+			}
+			target[j] = (T) val;
+			min = std::min(target[j], min);
+			max = std::max(target[j], max);
+		}
+	}
+
 	/**
 	 * @param path to file prefix relative to resources folder file suffix is assumed to be .1 .2 .. .num_files
 	 * @param size_x of slice file
 	 * @param size_y of slice file
 	 * @param num_files of slice files. will be loaded in ascending order
+	 * @param num_bytes_per_entry entries are big endian, signed
+	 * @param onSlab (optional) called on the calling thread whenever the next slices are decoded, with the first slice and the number of slices (e.g. to upload them with glTexSubImage3D while loading continues). min and max of the volume are not valid yet
+	 * @param slabSize (optional) minimum number of slices passed to onSlab, except for the last call
+	 * @param numThreads (optional) number of threads decoding slices, 0 for one per core
 	 * @return data from files
 	 */
 	template<class T>
-	VolumeData<T> load3DData(std::string path, unsigned size_x, unsigned size_y, unsigned int num_files, unsigned int num_bytes_per_entry = 1)
+	VolumeData<T> load3DData(std::string path, unsigned size_x, unsigned size_y, unsigned int num_files, unsigned int num_bytes_per_entry = 1,
+		std::function<void(unsigned int, unsigned int, const VolumeData<T>&)> onSlab = nullptr, unsigned int slabSize = 16, unsigned int numThreads = 0)
 	{
 		DEBUGLOG->log("Loading files with prefix :" + path);
 		DEBUGLOG->log("Reading slice data...");
@@ -49,73 +106,81 @@ namespace Importer {
 		result.size_x = size_x;
 		result.size_y = size_y;
 		result.size_z = num_files;
-		result.data.clear();
-
-		T min = SHRT_MAX;
-		T max = SHRT_MIN;
-
-		//result.midSlice.resize(size_x*size_y);
-
-		DEBUGLOG->indent();
-		for (unsigned int i = 1; i <= num_files; i++)
-		{
-			std::string current_file_path = path + "." + DebugLog::to_string(i);
-
-			std::cout << ".";
 
-//			DEBUGLOG->log("current file:" + current_file_path);
+		// slices are decoded directly into place
+		const size_t sliceSize = (size_t) size_x * size_y;
+		result.data.assign(sliceSize * num_files, 0);
 
-			// read file into input vector
-			std::ifstream file( current_file_path.c_str(), std::ifstream::binary);	
-			std::vector<char> input;
+		T min = std::numeric_limits<T>::max();
+		T max = std::numeric_limits<T>::lowest();
 
-			if (file.is_open()) {
-				// get length of file:
-				file.seekg (0, file.end);
-				int length = file.tellg();
-				file.seekg (0, file.beg);
+		std::vector<char> isDecoded(num_files, 0);
+		std::atomic<unsigned int> nextSlice(0);
+		std::mutex mutex;
+		std::condition_variable sliceDecoded;
 
-				// allocate memory:
-				input.resize(length);
+		auto decodeSlices = [&]()
+		{
+			T localMin = std::numeric_limits<T>::max();
+			T localMax = std::numeric_limits<T>::lowest();
+			std::vector<unsigned char> input;  // reused for every slice of this thread
+			for (unsigned int i = nextSlice++; i < num_files; i = nextSlice++)
+			{
+				std::string current_file_path = path + "." + DebugLog::to_string(i + 1);
+
+				// read file into input vector
+				std::ifstream file( current_file_path.c_str(), std::ifstream::binary);
+				input.assign(sliceSize * num_bytes_per_entry, 0); // missing data stays 0
+				if (file.is_open()) {
+					file.read( (char*) &input[0], input.size() );
+					if ( (size_t) file.gcount() < input.size() ) { DEBUGLOG->log("WARNING: slice file is too short: " + current_file_path); }
+				}
+				else
+				{
+					DEBUGLOG->log("WARNING: could not open slice file: " + current_file_path);
+				}
 
-				// read data as a block:
-				file.read( &input[0], length );
+				decodeSlice(&input[0], num_bytes_per_entry, sliceSize, &result.data[sliceSize * i], localMin, localMax);
 
-				file.close();
+				std::lock_guard<std::mutex> lock(mutex);
+				isDecoded[i] = 1;
+				sliceDecoded.notify_one();
 			}
 
-			// create data vector for this slice
-			std::vector<T> slice(size_x * size_y, 0);
+			std::lock_guard<std::mutex> lock(mutex);
+			min = std::min(localMin, min);
+			max = std::max(localMax, max);
+		};
 
-			for(unsigned int j = 0 ; j < slice.size(); j++)
+		if ( numThreads == 0 ) { numThreads = std::max(1u, std::thread::hardware_concurrency()); }
+		std::vector<std::thread> threads;
+		for (unsigned int t = 0; t < std::min(numThreads, std::max(num_files, 1u)); t++) { threads.push_back(std::thread(decodeSlices)); }
+
+		// hand out slabs of consecutive decoded slices in order, while the workers continue
+		DEBUGLOG->indent();
+		unsigned int numDone = 0;
+		while ( numDone < num_files )
+		{
+			unsigned int numReady = 0;
 			{
-				T val = input[num_bytes_per_entry*j];
-				for (unsigned int k = 1; k < num_bytes_per_entry; k++)
-				{
-					val = (val << 8) + input[ num_bytes_per_entry*j + k];
-				}
-	    		
-				slice[j] = val;
-				
-				//if ( i == num_files / 2)
-				//{
-				//	result.midSlice[j] = val;
-				//	//DEBUGLOG->log("x: ", j - (j / size_x)*size_x);
-				//	//DEBUGLOG->log("y: ", j / size_x);
-				//	//DEBUGLOG->log("MidSlice: ", val);
-				//}
-
-				min = std::min<short>(val, min);
-				max = std::max<short>(val, max);
+				std::unique_lock<std::mutex> lock(mutex);
+				unsigned int required = std::min(std::max(slabSize, 1u), num_files - numDone);
+				sliceDecoded.wait(lock, [&]() {
+					while ( numDone + numReady < num_files && isDecoded[numDone + numReady] ) { numReady++; }
+					return numReady >= required;
+				});
 			}
 
-			// push slice to data vector
-			result.data.insert(result.data.end(), slice.begin(), slice.end());
+			for (unsigned int i = 0; i < numReady; i++) { std::cout << "."; }
+			if ( onSlab ) { onSlab(numDone, numReady, result); }
+			numDone += numReady;
 		}
 		std::cout << std::endl;
 		DEBUGLOG->outdent();
 
-		result.min = min;		
+		for (unsigned int t = 0; t < threads.size(); t++) { threads[t].join(); }
+
+		result.min = min;
 		result.max = max;
 
 		return result;
@@ -0,0 +1,550 @@
+#include "MeshCache.h"
+
+#include <cstring>
+#include <fstream>
+
+#include <assimp/Importer.hpp>
+
+#include "Core/DebugLog.h"
+#include "Rendering/VertexArrayObjects.h"
+#include "Rendering/OpenGLContext.h"
+#include "Rendering/GLResources.h"
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+	const char MAGIC[8] = { 'E', 'Z', 'R', 'M', 'E', 'S', 'H', '\0' };
+	const size_t STREAM_ALIGNMENT = 16; // every stream starts at a multiple of this, relative to the start of the file
+
+	/*
+	 * file layout, all values in native byte order:
+	 * Header
+	 * per mesh: MeshHeader, name, index stream, position, uv, normal and tangent streams (each aligned)
+	 * per material: MaterialHeader, colors (int type, vec4), scalars (int type, float), textures (TextureHeader, path)
+	 */
+	struct Header
+	{
+		char magic[8];
+		unsigned int version;
+		int steps;
+		unsigned long long sourceHash;
+		unsigned int numMeshes;
+		unsigned int numMaterials;
+	};
+
+	struct MeshHeader
+	{
+		unsigned int numIndices;
+		unsigned int numVertices;
+		unsigned int numUVFloats;
+		unsigned int numNormalFloats;
+		unsigned int numTangentFloats;
+		unsigned int materialIdx;
+		unsigned int nameLength;
+		float min[3];
+		float max[3];
+	};
+
+	struct MaterialHeader
+	{
+		int matIdx;
+		unsigned int numColors;
+		unsigned int numScalars;
+		unsigned int numTextures;
+	};
+
+	struct TextureHeader
+	{
+		int textureType; // aiTextureType
+		int matIdx;
+		int type;
+		unsigned int pathLength;
+	};
+
+	class Writer
+	{
+	public:
+		std::vector<char> data;
+
+		void write(const void* bytes, size_t size, size_t alignment = 1)
+		{
+			data.resize((data.size() + alignment - 1) / alignment * alignment, 0);
+			if ( size != 0 ) { data.insert(data.end(), (const char*) bytes, (const char*) bytes + size); }
+		}
+		template <class T> void write(const T& value) { write(&value, sizeof(T)); }
+		template <class T> void writeStream(const std::vector<T>& stream) { write(stream.empty() ? nullptr : &stream[0], stream.size() * sizeof(T), STREAM_ALIGNMENT); }
+	};
+
+	class Reader
+	{
+	public:
+		Reader(const char* data, size_t size) : m_data(data), m_size(size), m_offset(0), m_ok(true) {}
+
+		const char* readBytes(size_t size, size_t alignment = 1)
+		{
+			size_t offset = (m_offset + alignment - 1) / alignment * alignment;
+			if ( !m_ok || offset > m_size || size > m_size - offset ) { m_ok = false; return nullptr; }
+			m_offset = offset + size;
+			return m_data + offset;
+		}
+		template <class T> bool read(T& value)
+		{
+			const char* bytes = readBytes(sizeof(T));
+			if ( bytes != nullptr ) { std::memcpy(&value, bytes, sizeof(T)); }
+			return bytes != nullptr;
+		}
+		template <class T> const T* readStream(size_t count)
+		{
+			if ( count > m_size / sizeof(T) ) { m_ok = false; return nullptr; } // also guards count * sizeof(T)
+			const T* stream = (const T*) readBytes(count * sizeof(T), STREAM_ALIGNMENT); // empty streams are padded as well, see Writer
+			return (count == 0) ? nullptr : stream;
+		}
+		bool isOk() const { return m_ok; }
+		bool isAtEnd() const { return m_offset == m_size; }
+
+	private:
+		const char* m_data;
+		size_t m_size;
+		size_t m_offset;
+		bool m_ok;
+	};
+}
+
+MeshCache::MappedFile::MappedFile()
+	: m_data(nullptr)
+	, m_size(0)
+	, m_file(nullptr)
+	, m_mapping(nullptr)
+{
+}
+
+MeshCache::MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MeshCache::MappedFile::open(const std::string& path)
+{
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if ( file == INVALID_HANDLE_VALUE ) { return false; }
+	LARGE_INTEGER size;
+	if ( !GetFileSizeEx(file, &size) || size.QuadPart == 0 ) { CloseHandle(file); return false; }
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void* data = ( mapping != NULL ) ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	if ( data == NULL )
+	{
+		if ( mapping != NULL ) { CloseHandle(mapping); }
+		CloseHandle(file);
+		return false;
+	}
+	m_file = file;
+	m_mapping = mapping;
+	m_size = (size_t) size.QuadPart;
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if ( file == -1 ) { return false; }
+	struct stat info;
+	if ( fstat(file, &info) != 0 || info.st_size == 0 ) { ::close(file); return false; }
+
+	void* data = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file); // the mapping stays valid
+	if ( data == MAP_FAILED ) { return false; }
+	m_size = (size_t) info.st_size;
+#endif
+	m_data = (const char*) data;
+	return true;
+}
+
+void MeshCache::MappedFile::close()
+{
+	if ( m_data == nullptr ) { return; }
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+	CloseHandle((HANDLE) m_mapping);
+	CloseHandle((HANDLE) m_file);
+#else
+	munmap((void*) m_data, m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+	m_file = nullptr;
+	m_mapping = nullptr;
+}
+
+const char* MeshCache::MappedFile::getData() const
+{
+	return m_data;
+}
+
+size_t MeshCache::MappedFile::getSize() const
+{
+	return m_size;
+}
+
+std::string MeshCache::getCachePath(const std::string& path)
+{
+	return path + ".ezrmesh";
+}
+
+unsigned long long MeshCache::hashData(const char* data, size_t size)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= (unsigned char) data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+std::vector<char> MeshCache::serialize(std::vector<AssimpTools::VertexData>& meshes, const std::vector<std::string>& names, const std::vector<unsigned int>& materialIndices,
+	const std::vector<AssimpTools::MaterialInfo>& materials, unsigned long long sourceHash, int steps)
+{
+	Writer writer;
+	Header header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.steps = steps;
+	header.sourceHash = sourceHash;
+	header.numMeshes = (unsigned int) meshes.size();
+	header.numMaterials = (unsigned int) materials.size();
+	writer.write(header);
+
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		AssimpTools::VertexData& mesh = meshes[i];
+		AssimpTools::BoundingBox boundingBox = AssimpTools::computeBoundingBox(mesh);
+
+		MeshHeader meshHeader;
+		meshHeader.numIndices = (unsigned int) mesh.indices.size();
+		meshHeader.numVertices = (unsigned int) mesh.positions.size() / 3;
+		meshHeader.numUVFloats = (unsigned int) mesh.uvs.size();
+		meshHeader.numNormalFloats = (unsigned int) mesh.normals.size();
+		meshHeader.numTangentFloats = (unsigned int) mesh.tangents.size();
+		meshHeader.materialIdx = ( i < materialIndices.size() ) ? materialIndices[i] : 0;
+		meshHeader.nameLength = ( i < names.size() ) ? (unsigned int) names[i].size() : 0;
+		for (int c = 0; c < 3; c++) { meshHeader.min[c] = boundingBox.min[c]; meshHeader.max[c] = boundingBox.max[c]; }
+		writer.write(meshHeader);
+		writer.write(meshHeader.nameLength != 0 ? names[i].c_str() : nullptr, meshHeader.nameLength);
+
+		writer.writeStream(mesh.indices);
+		writer.writeStream(mesh.positions);
+		writer.writeStream(mesh.uvs);
+		writer.writeStream(mesh.normals);
+		writer.writeStream(mesh.tangents);
+	}
+
+	for (unsigned int i = 0; i < materials.size(); i++)
+	{
+		const AssimpTools::MaterialInfo& material = materials[i];
+		MaterialHeader materialHeader = { material.matIdx, (unsigned int) material.color.size(), (unsigned int) material.scalar.size(), (unsigned int) material.texture.size() };
+		writer.write(materialHeader);
+
+		for (auto c : material.color)
+		{
+			writer.write((int) c.first);
+			writer.write(c.second);
+		}
+		for (auto s : material.scalar)
+		{
+			writer.write((int) s.first);
+			writer.write(s.second);
+		}
+		for (auto t : material.texture)
+		{
+			TextureHeader textureHeader = { (int) t.first, t.second.matIdx, t.second.type, (unsigned int) t.second.relativePath.size() };
+			writer.write(textureHeader);
+			writer.write(t.second.relativePath.c_str(), textureHeader.pathLength);
+		}
+	}
+
+	return writer.data;
+}
+
+MeshCache::Scene::Scene()
+	: m_wasCached(false)
+{
+}
+
+bool MeshCache::Scene::loadFromResourceFolder(const std::string& filename, int steps)
+{
+	return load(RESOURCES_PATH "/" + filename, steps);
+}
+
+bool MeshCache::Scene::load(const std::string& path, int steps)
+{
+	m_meshes.clear();
+	m_materials.clear();
+	m_memory.clear();
+	m_file.close();
+	m_wasCached = false;
+
+	// the source is hashed through a mapping as well, reading it is still much cheaper than importing it
+	unsigned long long sourceHash = 0;
+	{
+		MappedFile source;
+		if ( !source.open(path) )
+		{
+			DEBUGLOG->log("ERROR: MeshCache: could not open " + path);
+			return false;
+		}
+		sourceHash = hashData(source.getData(), source.getSize());
+	}
+
+	std::string cachePath = getCachePath(path);
+	if ( m_file.open(cachePath) )
+	{
+		if ( parse(m_file.getData(), m_file.getSize(), sourceHash, steps) )
+		{
+			m_wasCached = true;
+			DEBUGLOG->log("MeshCache: loaded " + cachePath);
+			return true;
+		}
+		m_file.close();
+		DEBUGLOG->log("MeshCache: cache is outdated, importing " + path);
+	}
+
+	return importAndCache(path, cachePath, sourceHash, steps);
+}
+
+bool MeshCache::Scene::importAndCache(const std::string& path, const std::string& cachePath, unsigned long long sourceHash, int steps)
+{
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, steps);
+	if ( scene == NULL )
+	{
+		std::string errorString = importer.GetErrorString();
+		DEBUGLOG->log("ERROR: " + errorString);
+		return false;
+	}
+
+	// the reordering is paid once, every load from the cache gets the optimized streams
+	std::vector<AssimpTools::VertexData> meshes = AssimpTools::createVertexDataInstancesFromScene(scene, glm::mat4(1.0f), true, true);
+	std::vector<std::string> names;
+	std::vector<unsigned int> materialIndices;
+	for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+	{
+		names.push_back(std::string(scene->mMeshes[i]->mName.C_Str()));
+		materialIndices.push_back(scene->mMeshes[i]->mMaterialIndex);
+	}
+	std::vector<AssimpTools::MaterialInfo> materials;
+	for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+	{
+		materials.push_back(AssimpTools::getMaterialInfo(scene, (int) i));
+	}
+
+	m_memory = serialize(meshes, names, materialIndices, materials, sourceHash, steps);
+
+	std::ofstream file(cachePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if ( file.is_open() && file.write(&m_memory[0], m_memory.size()) )
+	{
+		DEBUGLOG->log("MeshCache: wrote " + cachePath);
+	}
+	else
+	{
+		DEBUGLOG->log("WARNING: MeshCache: could not write " + cachePath);
+	}
+
+	return parse(&m_memory[0], m_memory.size(), sourceHash, steps);
+}
+
+bool MeshCache::Scene::parse(const char* data, size_t size, unsigned long long sourceHash, int steps)
+{
+	m_meshes.clear();
+	m_materials.clear();
+
+	Reader reader(data, size);
+	Header header;
+	if ( !reader.read(header) || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.steps != steps || header.sourceHash != sourceHash )
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < header.numMeshes && reader.isOk(); i++)
+	{
+		MeshHeader meshHeader;
+		if ( !reader.read(meshHeader) ) { break; }
+
+		// attribute streams are either missing or hold one entry per vertex, createRenderables() relies on it
+		size_t numVertexFloats = 3 * (size_t) meshHeader.numVertices;
+		bool validUVs = meshHeader.numUVFloats == 0 || meshHeader.numUVFloats == 2 * (size_t) meshHeader.numVertices || meshHeader.numUVFloats == numVertexFloats;
+		bool validNormals = meshHeader.numNormalFloats == 0 || meshHeader.numNormalFloats == numVertexFloats;
+		bool validTangents = meshHeader.numTangentFloats == 0 || meshHeader.numTangentFloats == numVertexFloats;
+		if ( !validUVs || !validNormals || !validTangents )
+		{
+			DEBUGLOG->log("WARNING: MeshCache: stream sizes of mesh " + DebugLog::to_string(i) + " do not match its vertex count");
+			m_meshes.clear();
+			return false;
+		}
+
+		MeshView mesh;
+		const char* name = reader.readBytes(meshHeader.nameLength);
+		mesh.name = ( name != nullptr ) ? std::string(name, meshHeader.nameLength) : std::string();
+		mesh.numIndices = meshHeader.numIndices;
+		mesh.numVertices = meshHeader.numVertices;
+		mesh.uvComponents = ( meshHeader.numVertices != 0 && meshHeader.numUVFloats == 3 * meshHeader.numVertices ) ? 3 : 2;
+		mesh.materialIdx = meshHeader.materialIdx;
+		mesh.boundingBox.min = glm::vec3(meshHeader.min[0], meshHeader.min[1], meshHeader.min[2]);
+		mesh.boundingBox.max = glm::vec3(meshHeader.max[0], meshHeader.max[1], meshHeader.max[2]);
+
+		mesh.indices = reader.readStream<unsigned int>(meshHeader.numIndices);
+		mesh.positions = reader.readStream<float>(numVertexFloats);
+		mesh.uvs = reader.readStream<float>(meshHeader.numUVFloats);
+		mesh.normals = reader.readStream<float>(meshHeader.numNormalFloats);
+		mesh.tangents = reader.readStream<float>(meshHeader.numTangentFloats);
+		m_meshes.push_back(mesh);
+	}
+
+	for (unsigned int i = 0; i < header.numMaterials && reader.isOk(); i++)
+	{
+		MaterialHeader materialHeader;
+		if ( !reader.read(materialHeader) ) { break; }
+
+		AssimpTools::MaterialInfo material;
+		material.matIdx = materialHeader.matIdx;
+		for (unsigned int c = 0; c < materialHeader.numColors; c++)
+		{
+			int type = 0;
+			glm::vec4 color;
+			if ( reader.read(type) && reader.read(color) ) { material.color[(AssimpTools::ColorType) type] = color; }
+		}
+		for (unsigned int s = 0; s < materialHeader.numScalars; s++)
+		{
+			int type = 0;
+			float scalar = 0.0f;
+			if ( reader.read(type) && reader.read(scalar) ) { material.scalar[(AssimpTools::ScalarType) type] = scalar; }
+		}
+		for (unsigned int t = 0; t < materialHeader.numTextures; t++)
+		{
+			TextureHeader textureHeader;
+			if ( !reader.read(textureHeader) ) { break; }
+			const char* path = reader.readBytes(textureHeader.pathLength);
+			if ( path == nullptr ) { break; }
+
+			AssimpTools::MaterialTextureInfo texture;
+			texture.matIdx = textureHeader.matIdx;
+			texture.type = textureHeader.type;
+			texture.relativePath = std::string(path, textureHeader.pathLength);
+			material.texture[(aiTextureType) textureHeader.textureType] = texture;
+		}
+		m_materials.push_back(material);
+	}
+
+	if ( !reader.isOk() || !reader.isAtEnd() )
+	{
+		DEBUGLOG->log("WARNING: MeshCache: cache file size does not match its header");
+		m_meshes.clear();
+		m_materials.clear();
+		return false;
+	}
+	return true;
+}
+
+bool MeshCache::Scene::isLoaded() const
+{
+	return m_file.getData() != nullptr || !m_memory.empty();
+}
+
+bool MeshCache::Scene::wasCached() const
+{
+	return m_wasCached;
+}
+
+unsigned int MeshCache::Scene::getNumMeshes() const
+{
+	return (unsigned int) m_meshes.size();
+}
+
+const MeshCache::MeshView& MeshCache::Scene::getMesh(unsigned int meshIdx) const
+{
+	return m_meshes[meshIdx];
+}
+
+const std::vector<AssimpTools::MaterialInfo>& MeshCache::Scene::getMaterialInfos() const
+{
+	return m_materials;
+}
+
+std::vector<AssimpTools::RenderableInfo> MeshCache::Scene::createRenderables() const
+{
+	std::vector<AssimpTools::RenderableInfo> result;
+	for (unsigned int i = 0; i < m_meshes.size(); i++)
+	{
+		const MeshView& mesh = m_meshes[i];
+
+		GLuint vao;
+		glGenVertexArrays(1, &vao);
+		Renderable* renderable = new Renderable;
+		renderable->m_vao = vao;
+		renderable->m_indices.m_vboHandle = 0;
+		renderable->m_positions.m_vboHandle = 0;
+		renderable->m_uvs.m_vboHandle = 0;
+		renderable->m_normals.m_vboHandle = 0;
+		renderable->m_tangents.m_vboHandle = 0;
+		OPENGLCONTEXT->bindVAO(vao);
+
+		// straight from the mapping into immutable buffers
+		renderable->m_positions.m_vboHandle = Renderable::createVbo(mesh.positions, mesh.numVertices * 3 * sizeof(float), 3, 0, GL_FLOAT, false);
+		renderable->m_positions.m_size = mesh.numVertices;
+		if ( mesh.uvs != nullptr )
+		{
+			renderable->m_uvs.m_vboHandle = Renderable::createVbo(mesh.uvs, mesh.numVertices * mesh.uvComponents * sizeof(float), mesh.uvComponents, 1, GL_FLOAT, false);
+			renderable->m_uvs.m_size = mesh.numVertices;
+		}
+		if ( mesh.normals != nullptr )
+		{
+			renderable->m_normals.m_vboHandle = Renderable::createVbo(mesh.normals, mesh.numVertices * 3 * sizeof(float), 3, 2, GL_FLOAT, false);
+			renderable->m_normals.m_size = mesh.numVertices;
+		}
+		if ( mesh.tangents != nullptr )
+		{
+			renderable->m_tangents.m_vboHandle = Renderable::createVbo(mesh.tangents, mesh.numVertices * 3 * sizeof(float), 3, 3, GL_FLOAT, false);
+			renderable->m_tangents.m_size = mesh.numVertices;
+		}
+		if ( mesh.indices != nullptr )
+		{
+			renderable->m_indices.m_vboHandle = GLResources::createBuffer(mesh.numIndices * sizeof(unsigned int), mesh.indices, 0);
+			GLResources::setIndexBuffer(vao, renderable->m_indices.m_vboHandle);
+			renderable->m_indices.m_size = mesh.numIndices;
+		}
+		renderable->setDrawMode(GL_TRIANGLES);
+		OPENGLCONTEXT->bindVAO(0);
+
+		AssimpTools::RenderableInfo info;
+		info.renderable = renderable;
+		info.boundingBox = mesh.boundingBox;
+		info.name = mesh.name;
+		info.meshIdx = i;
+		info.dequantization = glm::mat4(1.0f);
+		info.vertexStride = 0;
+		result.push_back(info);
+	}
+	return result;
+}
+
+std::vector<AssimpTools::VertexData> MeshCache::Scene::createVertexDataInstances() const
+{
+	std::vector<AssimpTools::VertexData> result(m_meshes.size());
+	for (unsigned int i = 0; i < m_meshes.size(); i++)
+	{
+		const MeshView& mesh = m_meshes[i];
+		if ( mesh.indices != nullptr )   { result[i].indices.assign(mesh.indices, mesh.indices + mesh.numIndices); }
+		if ( mesh.positions != nullptr ) { result[i].positions.assign(mesh.positions, mesh.positions + 3 * mesh.numVertices); }
+		if ( mesh.uvs != nullptr )       { result[i].uvs.assign(mesh.uvs, mesh.uvs + mesh.uvComponents * mesh.numVertices); }
+		if ( mesh.normals != nullptr )   { result[i].normals.assign(mesh.normals, mesh.normals + 3 * mesh.numVertices); }
+		if ( mesh.tangents != nullptr )  { result[i].tangents.assign(mesh.tangents, mesh.tangents + 3 * mesh.numVertices); }
+	}
+	return result;
+}
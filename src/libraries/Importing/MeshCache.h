@@ -0,0 +1,108 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <vector>
+#include <string>
+
+#include <Importing/AssimpTools.h>
+
+/** @brief binary cache (.ezrmesh) of imported assets, to skip Assimp on later runs
+ *
+ * The cache stores the GPU ready vertex and index streams of every mesh as created by AssimpTools::createVertexDataInstancesFromScene
+ * (optimized for the vertex cache, see MeshOptimization),
+ * together with bounding boxes, names and the material infos. It is written next to the source file on the first import and is valid as
+ * long as format version, import flags and the hash of the source file match. Cached files are memory mapped and uploaded directly from the
+ * mapping, i.e. without copying the streams into intermediate vectors.
+ */
+namespace MeshCache {
+
+	const unsigned int VERSION = 2; //!< increase whenever the file layout or the content of the streams changes
+
+	/** @brief read-only memory mapping of a whole file */
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+
+		bool open(const std::string& path); //!< closes the current mapping first, false if the file could not be mapped
+		void close();
+
+		const char* getData() const; //!< nullptr if nothing is mapped
+		size_t getSize() const;
+
+	private:
+		MappedFile(const MappedFile&);            // not copyable
+		MappedFile& operator=(const MappedFile&);
+
+		const char* m_data;
+		size_t m_size;
+		void* m_file;    //!< platform file handle
+		void* m_mapping; //!< platform mapping handle (windows only)
+	};
+
+	/** @brief a mesh as stored in the cache, the pointers are valid as long as the owning Scene exists */
+	struct MeshView
+	{
+		const unsigned int* indices;
+		const float* positions;
+		const float* uvs;      //!< nullptr if not available
+		const float* normals;  //!< nullptr if not available
+		const float* tangents; //!< nullptr if not available
+		unsigned int numIndices;
+		unsigned int numVertices;
+		unsigned int uvComponents; //!< 2 or 3
+		unsigned int materialIdx;
+		AssimpTools::BoundingBox boundingBox;
+		std::string name;
+	};
+
+	/** @brief an asset loaded from its cache, or imported with Assimp and then cached */
+	class Scene
+	{
+	public:
+		Scene();
+
+		/** @brief load filename (relative to RESOURCES_PATH) from its cache, import and write the cache if missing or outdated
+		 * @param steps Assimp post process flags, part of the cache key
+		 */
+		bool loadFromResourceFolder(const std::string& filename, int steps = aiProcessPreset_TargetRealtime_MaxQuality);
+		bool load(const std::string& path, int steps = aiProcessPreset_TargetRealtime_MaxQuality); //!< same with the full path of the source file
+
+		bool isLoaded() const;
+		bool wasCached() const; //!< whether the last load() could use an existing cache file
+
+		unsigned int getNumMeshes() const;
+		const MeshView& getMesh(unsigned int meshIdx) const;
+		const std::vector<AssimpTools::MaterialInfo>& getMaterialInfos() const;
+
+		/** @brief one Renderable per mesh (attributes 0 - 3 and GL_TRIANGLES, like AssimpTools::createSimpleRenderablesFromScene) uploaded straight from the cache */
+		std::vector<AssimpTools::RenderableInfo> createRenderables() const;
+		std::vector<AssimpTools::VertexData> createVertexDataInstances() const; //!< copies of the streams, for further CPU processing
+
+	private:
+		Scene(const Scene&);            // not copyable, meshes point into the mapping
+		Scene& operator=(const Scene&);
+
+		bool parse(const char* data, size_t size, unsigned long long sourceHash, int steps);
+		bool importAndCache(const std::string& path, const std::string& cachePath, unsigned long long sourceHash, int steps);
+
+		MappedFile m_file;
+		std::vector<char> m_memory; //!< serialized cache if it was just created
+		std::vector<MeshView> m_meshes;
+		std::vector<AssimpTools::MaterialInfo> m_materials;
+		bool m_wasCached;
+	};
+
+	std::string getCachePath(const std::string& path); //!< path of the cache file of a source file
+	unsigned long long hashData(const char* data, size_t size); //!< 64 bit FNV-1a
+
+	/** @brief serialize meshes and materials into the cache format
+	 * @param names one per mesh
+	 * @param materialIndices one per mesh
+	 */
+	std::vector<char> serialize(std::vector<AssimpTools::VertexData>& meshes, const std::vector<std::string>& names, const std::vector<unsigned int>& materialIndices,
+		const std::vector<AssimpTools::MaterialInfo>& materials, unsigned long long sourceHash, int steps);
+}
+
+#endif
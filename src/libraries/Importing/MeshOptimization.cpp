@@ -0,0 +1,271 @@
+#include "MeshOptimization.h"
+
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "Core/DebugLog.h"
+
+namespace
+{
+	/// triangles adjacent to each vertex as one flat list with per vertex offsets
+	struct Adjacency
+	{
+		std::vector<unsigned int> offsets;   // numVertices + 1
+		std::vector<unsigned int> triangles;
+
+		Adjacency(const std::vector<unsigned int>& indices, unsigned int numVertices)
+			: offsets(numVertices + 1, 0)
+			, triangles(indices.size())
+		{
+			for (size_t i = 0; i < indices.size(); i++) { offsets[indices[i] + 1]++; }
+			for (unsigned int v = 0; v < numVertices; v++) { offsets[v + 1] += offsets[v]; }
+
+			std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++) { triangles[fill[indices[i]]++] = (unsigned int) (i / 3); }
+		}
+	};
+
+	bool isValid(const std::vector<unsigned int>& indices, unsigned int numVertices)
+	{
+		if ( indices.size() % 3 != 0 )
+		{
+			DEBUGLOG->log("WARNING: MeshOptimization: index count is not a multiple of 3, mesh is left untouched");
+			return false;
+		}
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			if ( indices[i] >= numVertices )
+			{
+				DEBUGLOG->log("WARNING: MeshOptimization: index out of range, mesh is left untouched: ", (int) indices[i]);
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+MeshOptimization::CacheStatistics MeshOptimization::analyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int numVertices, unsigned int cacheSize)
+{
+	CacheStatistics statistics = { 0.0f, 0.0f, 0, (unsigned int) indices.size() / 3, 0 };
+
+	// FIFO: a vertex is in the cache if it was inserted less than cacheSize misses ago
+	std::vector<unsigned int> insertedAt(numVertices, 0);
+	std::vector<bool> referenced(numVertices, false);
+	unsigned int time = cacheSize + 1; // all entries start out evicted
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int v = indices[i];
+		if ( v >= numVertices ) { continue; }
+		if ( time - insertedAt[v] > cacheSize )
+		{
+			insertedAt[v] = time++;
+			statistics.numMisses++;
+		}
+		if ( !referenced[v] ) { referenced[v] = true; statistics.numVertices++; }
+	}
+
+	if ( statistics.numTriangles != 0 ) { statistics.acmr = (float) statistics.numMisses / (float) statistics.numTriangles; }
+	if ( statistics.numVertices != 0 ) { statistics.atvr = (float) statistics.numMisses / (float) statistics.numVertices; }
+	return statistics;
+}
+
+std::vector<unsigned int> MeshOptimization::optimizeVertexCache(const std::vector<unsigned int>& indices, unsigned int numVertices, unsigned int cacheSize, std::vector<unsigned int>* clusters)
+{
+	if ( clusters != nullptr ) { clusters->clear(); }
+	if ( indices.empty() || !isValid(indices, numVertices) ) { return indices; }
+
+	Adjacency adjacency(indices, numVertices);
+	std::vector<unsigned int> liveTriangles(numVertices);
+	for (unsigned int v = 0; v < numVertices; v++) { liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v]; }
+
+	std::vector<unsigned int> cacheTime(numVertices, 0);
+	std::vector<bool> emitted(indices.size() / 3, false);
+	std::vector<unsigned int> deadEnd; // stack of recently used vertices
+	std::vector<unsigned int> candidates;
+	unsigned int time = cacheSize + 1;
+	unsigned int cursor = 0; // next vertex to try if the dead end stack is exhausted
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+
+	int fanning = 0;
+	while ( fanning >= 0 )
+	{
+		candidates.clear();
+		for (unsigned int a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++)
+		{
+			unsigned int t = adjacency.triangles[a];
+			if ( emitted[t] ) { continue; }
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[3 * t + c];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if ( time - cacheTime[v] > cacheSize ) { cacheTime[v] = time++; }
+			}
+			emitted[t] = true;
+		}
+
+		// next fanning vertex: the candidate that stays in cache longest while its remaining triangles are emitted
+		int next = -1;
+		int bestPriority = -1;
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			unsigned int v = candidates[i];
+			if ( liveTriangles[v] == 0 ) { continue; }
+			int priority = 0;
+			if ( time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize ) { priority = (int) (time - cacheTime[v]); }
+			if ( priority > bestPriority ) { bestPriority = priority; next = (int) v; }
+		}
+
+		if ( next == -1 ) // dead end: most recent vertex with live triangles, else the next unfinished vertex in input order
+		{
+			while ( !deadEnd.empty() && next == -1 )
+			{
+				unsigned int v = deadEnd.back();
+				deadEnd.pop_back();
+				if ( liveTriangles[v] > 0 ) { next = (int) v; }
+			}
+			while ( next == -1 && cursor < numVertices )
+			{
+				if ( liveTriangles[cursor] > 0 ) { next = (int) cursor; }
+				cursor++;
+			}
+			if ( clusters != nullptr && next != -1 ) { clusters->push_back((unsigned int) result.size()); }
+		}
+		fanning = next;
+	}
+
+	if ( clusters != nullptr ) { clusters->insert(clusters->begin(), 0); }
+	return result;
+}
+
+std::vector<unsigned int> MeshOptimization::optimizeOverdraw(const std::vector<unsigned int>& indices, const std::vector<float>& positions, const std::vector<unsigned int>& clusters)
+{
+	unsigned int numVertices = (unsigned int) positions.size() / 3;
+	if ( clusters.size() < 2 || !isValid(indices, numVertices) ) { return indices; }
+
+	auto position = [&](unsigned int v) { return glm::vec3(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]); };
+
+	// area weighted centroid of the whole mesh
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		glm::vec3 p0 = position(indices[i]), p1 = position(indices[i + 1]), p2 = position(indices[i + 2]);
+		float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+		meshCentroid += area * (p0 + p1 + p2) / 3.0f;
+		meshArea += area;
+	}
+	if ( meshArea > 0.0f ) { meshCentroid /= meshArea; }
+
+	// clusters facing away from the center are more likely to occlude the others
+	std::vector<std::pair<float, unsigned int> > order; // -sort key, cluster
+	for (unsigned int c = 0; c < clusters.size(); c++)
+	{
+		size_t begin = clusters[c];
+		size_t end = ( c + 1 < clusters.size() ) ? clusters[c + 1] : indices.size();
+
+		glm::vec3 centroid(0.0f), normal(0.0f);
+		float area = 0.0f;
+		for (size_t i = begin; i < end; i += 3)
+		{
+			glm::vec3 p0 = position(indices[i]), p1 = position(indices[i + 1]), p2 = position(indices[i + 2]);
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float a = glm::length(n);
+			centroid += a * (p0 + p1 + p2) / 3.0f;
+			normal += n;
+			area += a;
+		}
+		float key = 0.0f;
+		if ( area > 0.0f && glm::length(normal) > 0.0f )
+		{
+			key = glm::dot(centroid / area - meshCentroid, glm::normalize(normal));
+		}
+		order.push_back(std::make_pair(-key, c));
+	}
+	std::stable_sort(order.begin(), order.end());
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (size_t o = 0; o < order.size(); o++)
+	{
+		unsigned int c = order[o].second;
+		size_t begin = clusters[c];
+		size_t end = ( c + 1 < clusters.size() ) ? clusters[c + 1] : indices.size();
+		result.insert(result.end(), indices.begin() + begin, indices.begin() + end);
+	}
+	return result;
+}
+
+std::vector<unsigned int> MeshOptimization::optimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int numVertices)
+{
+	std::vector<unsigned int> remap(numVertices, ~0u);
+	if ( !isValid(indices, numVertices) )
+	{
+		for (unsigned int v = 0; v < numVertices; v++) { remap[v] = v; }
+		return remap;
+	}
+
+	unsigned int next = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int& target = remap[indices[i]];
+		if ( target == ~0u ) { target = next++; }
+		indices[i] = target;
+	}
+	return remap;
+}
+
+void MeshOptimization::remapAttribute(std::vector<float>& attribute, int components, const std::vector<unsigned int>& remap)
+{
+	if ( attribute.empty() ) { return; }
+
+	unsigned int numVertices = 0;
+	for (size_t v = 0; v < remap.size(); v++) { if ( remap[v] != ~0u ) { numVertices = std::max(numVertices, remap[v] + 1); } }
+
+	std::vector<float> result((size_t) numVertices * components);
+	for (size_t v = 0; v < remap.size() && (v + 1) * components <= attribute.size(); v++)
+	{
+		if ( remap[v] == ~0u ) { continue; }
+		std::copy(attribute.begin() + v * components, attribute.begin() + (v + 1) * components, result.begin() + (size_t) remap[v] * components);
+	}
+	attribute.swap(result);
+}
+
+MeshOptimization::Report MeshOptimization::optimize(AssimpTools::VertexData& mesh, unsigned int cacheSize, bool reorderForOverdraw)
+{
+	unsigned int numVertices = (unsigned int) mesh.positions.size() / 3;
+
+	Report report;
+	report.before = analyzeVertexCache(mesh.indices, numVertices, cacheSize);
+
+	std::vector<unsigned int> clusters;
+	mesh.indices = optimizeVertexCache(mesh.indices, numVertices, cacheSize, &clusters);
+	if ( reorderForOverdraw ) { mesh.indices = optimizeOverdraw(mesh.indices, mesh.positions, clusters); }
+
+	// uvs may have 2 or 3 components
+	int uvComponents = ( numVertices != 0 && mesh.uvs.size() == 3 * numVertices ) ? 3 : 2;
+	std::vector<unsigned int> remap = optimizeVertexFetch(mesh.indices, numVertices);
+	remapAttribute(mesh.positions, 3, remap);
+	remapAttribute(mesh.uvs, uvComponents, remap);
+	remapAttribute(mesh.normals, 3, remap);
+	remapAttribute(mesh.tangents, 3, remap);
+
+	report.after = analyzeVertexCache(mesh.indices, (unsigned int) mesh.positions.size() / 3, cacheSize);
+	return report;
+}
+
+bool MeshOptimization::toShortIndices(const std::vector<unsigned int>& indices, std::vector<unsigned short>& result)
+{
+	result.clear();
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if ( indices[i] > 0xFFFF ) { result.clear(); return false; }
+		result.push_back((unsigned short) indices[i]);
+	}
+	return true;
+}
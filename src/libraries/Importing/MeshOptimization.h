@@ -0,0 +1,63 @@
+#ifndef MESH_OPTIMIZATION_H
+#define MESH_OPTIMIZATION_H
+
+#include <vector>
+
+#include <Importing/AssimpTools.h>
+
+/** @brief offline reordering of indexed triangle lists (GL_TRIANGLES) for faster vertex processing
+ *
+ * optimize() runs the full pipeline: post-transform vertex cache order (Tipsify, Sander et al. 2007), overdraw order of the
+ * resulting clusters (outward facing clusters first) and vertex fetch order (vertices renumbered by first use).
+ * All steps are deterministic, i.e. the same input always produces the same output.
+ */
+namespace MeshOptimization {
+
+	/** @brief result of simulating a FIFO post-transform cache */
+	struct CacheStatistics
+	{
+		float acmr;               //!< average cache miss ratio: transformed vertices per triangle, 0.5 - 3.0, lower is better
+		float atvr;               //!< average transform to vertex ratio: transformed vertices per referenced vertex, 1.0 is optimal
+		unsigned int numMisses;
+		unsigned int numTriangles;
+		unsigned int numVertices; //!< referenced vertices
+	};
+
+	CacheStatistics analyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int numVertices, unsigned int cacheSize = 16);
+
+	/** @brief reorder triangles for a post-transform cache of cacheSize entries
+	 * @param clusters (optional) receives the first index of every cluster, a new cluster starts whenever the algorithm had to jump
+	 */
+	std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices, unsigned int numVertices, unsigned int cacheSize = 16, std::vector<unsigned int>* clusters = nullptr);
+
+	/** @brief reorder clusters so those facing away from the mesh center (likely in front) are drawn first
+	 * @param positions 3 floats per vertex
+	 * @param clusters as returned by optimizeVertexCache(), vertex cache locality within clusters is kept
+	 */
+	std::vector<unsigned int> optimizeOverdraw(const std::vector<unsigned int>& indices, const std::vector<float>& positions, const std::vector<unsigned int>& clusters);
+
+	/** @brief renumber vertices in the order they are first referenced, unreferenced vertices are dropped
+	 * @return remap table, old index -> new index or ~0u if dropped, apply it to every attribute with remapAttribute()
+	 */
+	std::vector<unsigned int> optimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int numVertices);
+	void remapAttribute(std::vector<float>& attribute, int components, const std::vector<unsigned int>& remap); //!< does nothing for empty attributes
+
+	/** @brief cache statistics before and after optimize() */
+	struct Report
+	{
+		CacheStatistics before;
+		CacheStatistics after;
+	};
+
+	/** @brief runs all steps on the indices and attributes of mesh
+	 * @param reorderForOverdraw skip the overdraw step, e.g. for meshes drawn with depth prepass
+	 */
+	Report optimize(AssimpTools::VertexData& mesh, unsigned int cacheSize = 16, bool reorderForOverdraw = true);
+
+	/** @brief convert to 16 bit indices for upload with Renderable::createIndexVbo
+	 * @return false (and leaves result empty) if an index does not fit into 16 bits
+	 */
+	bool toShortIndices(const std::vector<unsigned int>& indices, std::vector<unsigned short>& result);
+}
+
+#endif
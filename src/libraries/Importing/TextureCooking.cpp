@@ -0,0 +1,573 @@
+#include "TextureCooking.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+#include "Core/DebugLog.h"
+#include "Importing/MeshCache.h"
+#include "Rendering/GLResources.h"
+
+namespace
+{
+	const char MAGIC[8] = { 'E', 'Z', 'R', 'T', 'E', 'X', '\0', '\0' };
+
+	/*
+	 * file layout, all values in native byte order:
+	 * Header
+	 * per level: LevelHeader, compressed blocks
+	 */
+	struct Header
+	{
+		char magic[8];
+		unsigned int version;
+		int requestedFormat; // part of the cache key, AUTO is resolved in format
+		int format;
+		int bytesPerPixel;   // of the source image
+		unsigned long long sourceHash;
+		int width;
+		int height;
+		unsigned int numLevels;
+	};
+
+	struct LevelHeader
+	{
+		int width;
+		int height;
+		unsigned int size;
+	};
+
+	inline int clampCoordinate(int value, int size) { return std::min(std::max(value, 0), size - 1); }
+
+	/// the 4x4 texels of a block, texels outside the image repeat the border
+	void fetchBlock(const unsigned char* rgba, int width, int height, int blockX, int blockY, unsigned char block[16][4])
+	{
+		for (int y = 0; y < 4; y++)
+		{
+			for (int x = 0; x < 4; x++)
+			{
+				int sx = clampCoordinate(blockX * 4 + x, width);
+				int sy = clampCoordinate(blockY * 4 + y, height);
+				std::memcpy(block[y * 4 + x], rgba + ((size_t) sy * width + sx) * 4, 4);
+			}
+		}
+	}
+
+	inline unsigned short packColor565(const float color[3])
+	{
+		int r = (int) (std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		int g = (int) (std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+		int b = (int) (std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		return (unsigned short) ((r << 11) | (g << 5) | b);
+	}
+
+	inline void unpackColor565(unsigned short packed, int color[3])
+	{
+		int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	inline void writeLittleEndian(unsigned char* target, unsigned long long value, int numBytes)
+	{
+		for (int i = 0; i < numBytes; i++) { target[i] = (unsigned char) (value >> (8 * i)); }
+	}
+
+	inline unsigned long long readLittleEndian(const unsigned char* source, int numBytes)
+	{
+		unsigned long long value = 0;
+		for (int i = 0; i < numBytes; i++) { value |= (unsigned long long) source[i] << (8 * i); }
+		return value;
+	}
+
+	/// BC1 color block: endpoints along the principal axis of the texel colors, 4 color mode
+	void encodeColorBlock(const unsigned char block[16][4], unsigned char* target)
+	{
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++) { for (int c = 0; c < 3; c++) { mean[c] += block[i][c] / 16.0f; } }
+
+		float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // rr rg rb gg gb bb
+		for (int i = 0; i < 16; i++)
+		{
+			float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+			covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+			covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+		}
+
+		// power iteration, starting with the luminance direction
+		float axis[3] = { 0.3f, 0.6f, 0.1f };
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[3] = {
+				covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+				covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+				covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2] };
+			float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+			if ( length < 1e-6f ) { break; } // (almost) uniform block
+			for (int c = 0; c < 3; c++) { axis[c] = next[c] / length; }
+		}
+
+		float minProjection = 0.0f, maxProjection = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float projection = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+			minProjection = std::min(minProjection, projection);
+			maxProjection = std::max(maxProjection, projection);
+		}
+
+		float endpoint0[3], endpoint1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			endpoint0[c] = mean[c] + axis[c] * maxProjection;
+			endpoint1[c] = mean[c] + axis[c] * minProjection;
+		}
+		unsigned short color0 = packColor565(endpoint0);
+		unsigned short color1 = packColor565(endpoint1);
+		if ( color0 < color1 ) { std::swap(color0, color1); } // color0 > color1 selects the 4 color mode
+
+		int palette[4][3];
+		unpackColor565(color0, palette[0]);
+		unpackColor565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		unsigned int indices = 0;
+		if ( color0 != color1 )
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				int best = 0, bestDistance = 1 << 30;
+				for (int p = 0; p < 4; p++)
+				{
+					int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+					int distance = dr * dr + dg * dg + db * db;
+					if ( distance < bestDistance ) { bestDistance = distance; best = p; }
+				}
+				indices |= (unsigned int) best << (2 * i);
+			}
+		}
+
+		writeLittleEndian(target, color0, 2);
+		writeLittleEndian(target + 2, color1, 2);
+		writeLittleEndian(target + 4, indices, 4);
+	}
+
+	/// BC4 block of one channel: min and max as endpoints, 8 value mode
+	void encodeChannelBlock(const unsigned char block[16][4], int channel, unsigned char* target)
+	{
+		int maxValue = 0, minValue = 255;
+		for (int i = 0; i < 16; i++)
+		{
+			maxValue = std::max(maxValue, (int) block[i][channel]);
+			minValue = std::min(minValue, (int) block[i][channel]);
+		}
+
+		unsigned long long indices = 0;
+		if ( maxValue != minValue )
+		{
+			// palette index order: 0 = max, 1 = min, 2 .. 7 = interpolated from max to min
+			for (int i = 0; i < 16; i++)
+			{
+				int value = block[i][channel];
+				int step = ( (maxValue - value) * 7 + (maxValue - minValue) / 2 ) / (maxValue - minValue); // 0 = max .. 7 = min
+				int index = ( step == 0 ) ? 0 : ( step == 7 ) ? 1 : step + 1;
+				indices |= (unsigned long long) index << (3 * i);
+			}
+		}
+
+		target[0] = (unsigned char) maxValue;
+		target[1] = (unsigned char) minValue;
+		writeLittleEndian(target + 2, indices, 6);
+	}
+
+	void decodeColorBlock(const unsigned char* source, unsigned char block[16][4])
+	{
+		unsigned short color0 = (unsigned short) readLittleEndian(source, 2);
+		unsigned short color1 = (unsigned short) readLittleEndian(source + 2, 2);
+		unsigned int indices = (unsigned int) readLittleEndian(source + 4, 4);
+
+		int palette[4][4];
+		unpackColor565(color0, palette[0]);
+		unpackColor565(color1, palette[1]);
+		palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+		for (int c = 0; c < 3; c++)
+		{
+			if ( color0 > color1 )
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		if ( color0 <= color1 ) { palette[3][3] = 0; }
+
+		for (int i = 0; i < 16; i++)
+		{
+			int index = (indices >> (2 * i)) & 3;
+			for (int c = 0; c < 4; c++) { block[i][c] = (unsigned char) palette[index][c]; }
+		}
+	}
+
+	void decodeChannelBlock(const unsigned char* source, int channel, unsigned char block[16][4])
+	{
+		int value0 = source[0], value1 = source[1];
+		unsigned long long indices = readLittleEndian(source + 2, 6);
+
+		int palette[8] = { value0, value1 };
+		for (int p = 2; p < 8; p++)
+		{
+			if ( value0 > value1 ) { palette[p] = ((8 - p) * value0 + (p - 1) * value1) / 7; }
+			else                   { palette[p] = ( p < 6 ) ? ((6 - p) * value0 + (p - 1) * value1) / 5 : ( p == 6 ) ? 0 : 255; }
+		}
+		for (int i = 0; i < 16; i++) { block[i][channel] = (unsigned char) palette[(indices >> (3 * i)) & 7]; }
+	}
+
+	void encodeBlockRows(const unsigned char* rgba, int width, int height, TextureCooking::Format format, int firstRow, int endRow, unsigned char* target)
+	{
+		int blocksX = (width + 3) / 4;
+		int blockSize = TextureCooking::getBlockSize(format);
+		unsigned char block[16][4];
+		for (int by = firstRow; by < endRow; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				fetchBlock(rgba, width, height, bx, by, block);
+				unsigned char* blockTarget = target + ((size_t) by * blocksX + bx) * blockSize;
+				switch (format)
+				{
+				case TextureCooking::BC3:
+					encodeChannelBlock(block, 3, blockTarget);
+					encodeColorBlock(block, blockTarget + 8);
+					break;
+				case TextureCooking::BC5:
+					encodeChannelBlock(block, 0, blockTarget);
+					encodeChannelBlock(block, 1, blockTarget + 8);
+					break;
+				default:
+					encodeColorBlock(block, blockTarget);
+					break;
+				}
+			}
+		}
+	}
+
+	/// next mipmap level with a 2x2 box filter, odd sizes repeat the last row / column
+	std::vector<unsigned char> downsample(const std::vector<unsigned char>& rgba, int width, int height, int& nextWidth, int& nextHeight)
+	{
+		nextWidth = std::max(1, width / 2);
+		nextHeight = std::max(1, height / 2);
+		std::vector<unsigned char> result((size_t) nextWidth * nextHeight * 4);
+		for (int y = 0; y < nextHeight; y++)
+		{
+			for (int x = 0; x < nextWidth; x++)
+			{
+				int x0 = clampCoordinate(2 * x, width), x1 = clampCoordinate(2 * x + 1, width);
+				int y0 = clampCoordinate(2 * y, height), y1 = clampCoordinate(2 * y + 1, height);
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = rgba[((size_t) y0 * width + x0) * 4 + c] + rgba[((size_t) y0 * width + x1) * 4 + c]
+					        + rgba[((size_t) y1 * width + x0) * 4 + c] + rgba[((size_t) y1 * width + x1) * 4 + c];
+					result[((size_t) y * nextWidth + x) * 4 + c] = (unsigned char) ((sum + 2) / 4);
+				}
+			}
+		}
+		return result;
+	}
+
+	GLuint uploadLevels(TextureCooking::Format format, const std::vector<int>& widths, const std::vector<int>& heights, const std::vector<const unsigned char*>& data, const std::vector<unsigned int>& sizes)
+	{
+		GLuint handle = GLResources::createTexture2D(TextureCooking::getInternalFormat(format), widths[0], heights[0], (int) data.size());
+		for (unsigned int level = 0; level < data.size(); level++)
+		{
+			GLResources::uploadCompressedTexture2D(handle, (int) level, widths[level], heights[level], TextureCooking::getInternalFormat(format), (GLsizei) sizes[level], data[level]);
+		}
+		GLResources::setTextureParameter(handle, GL_TEXTURE_MAX_LEVEL, (GLint) data.size() - 1);
+		GLResources::setTextureParameter(handle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		GLResources::setTextureParameter(handle, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		GLResources::setTextureParameter(handle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		GLResources::setTextureParameter(handle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return handle;
+	}
+
+	/// upload straight from the mapped file, false if it is not a valid cooked file for this source
+	bool loadCached(const char* data, size_t size, unsigned long long sourceHash, TextureCooking::Format requestedFormat, GLuint& handle, TextureTools::TextureInfo* texInfo)
+	{
+		Header header;
+		if ( size < sizeof(Header) ) { return false; }
+		std::memcpy(&header, data, sizeof(Header));
+		if ( std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != TextureCooking::VERSION
+			|| header.requestedFormat != (int) requestedFormat || header.sourceHash != sourceHash || header.numLevels == 0 )
+		{
+			return false;
+		}
+
+		std::vector<int> widths, heights;
+		std::vector<const unsigned char*> levels;
+		std::vector<unsigned int> sizes;
+		size_t offset = sizeof(Header);
+		for (unsigned int level = 0; level < header.numLevels; level++)
+		{
+			LevelHeader levelHeader;
+			if ( size - offset < sizeof(LevelHeader) ) { return false; }
+			std::memcpy(&levelHeader, data + offset, sizeof(LevelHeader));
+			offset += sizeof(LevelHeader);
+			if ( size - offset < levelHeader.size ) { return false; }
+
+			widths.push_back(levelHeader.width);
+			heights.push_back(levelHeader.height);
+			sizes.push_back(levelHeader.size);
+			levels.push_back((const unsigned char*) data + offset);
+			offset += levelHeader.size;
+		}
+
+		handle = uploadLevels((TextureCooking::Format) header.format, widths, heights, levels, sizes);
+		if (texInfo != nullptr)
+		{
+			texInfo->handle = handle;
+			texInfo->width = header.width;
+			texInfo->height = header.height;
+			texInfo->bytesPerPixel = header.bytesPerPixel;
+		}
+		return true;
+	}
+}
+
+GLenum TextureCooking::getInternalFormat(Format format)
+{
+	switch (format)
+	{
+	case BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case BC5: return GL_COMPRESSED_RG_RGTC2;
+	default:  return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+}
+
+int TextureCooking::getBlockSize(Format format)
+{
+	return ( format == BC3 || format == BC5 ) ? 16 : 8;
+}
+
+std::vector<unsigned char> TextureCooking::toRGBA(const unsigned char* data, int width, int height, int bytesPerPixel)
+{
+	std::vector<unsigned char> result((size_t) width * height * 4);
+	for (size_t i = 0; i < (size_t) width * height; i++)
+	{
+		const unsigned char* texel = data + i * bytesPerPixel;
+		unsigned char* target = &result[i * 4];
+		switch (bytesPerPixel)
+		{
+		case 1:  target[0] = target[1] = target[2] = texel[0]; target[3] = 255; break;
+		case 2:  target[0] = target[1] = target[2] = texel[0]; target[3] = texel[1]; break; // grey, alpha
+		case 3:  target[0] = texel[0]; target[1] = texel[1]; target[2] = texel[2]; target[3] = 255; break;
+		default: std::memcpy(target, texel, 4); break;
+		}
+	}
+	return result;
+}
+
+std::vector<unsigned char> TextureCooking::compressLevel(const unsigned char* rgba, int width, int height, Format format, unsigned int numThreads)
+{
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	std::vector<unsigned char> result((size_t) blocksX * blocksY * getBlockSize(format));
+
+	if ( numThreads == 0 ) { numThreads = std::max(1u, std::thread::hardware_concurrency()); }
+	numThreads = std::min(numThreads, (unsigned int) blocksY);
+
+	// every thread encodes its own range of block rows
+	std::vector<std::thread> threads;
+	for (unsigned int t = 1; t < numThreads; t++)
+	{
+		int firstRow = (int) (blocksY * t / numThreads), endRow = (int) (blocksY * (t + 1) / numThreads);
+		threads.push_back(std::thread(encodeBlockRows, rgba, width, height, format, firstRow, endRow, &result[0]));
+	}
+	encodeBlockRows(rgba, width, height, format, 0, (int) (blocksY / numThreads), &result[0]);
+	for (unsigned int t = 0; t < threads.size(); t++) { threads[t].join(); }
+
+	return result;
+}
+
+std::vector<unsigned char> TextureCooking::decompressLevel(const unsigned char* blocks, int width, int height, Format format)
+{
+	std::vector<unsigned char> result((size_t) width * height * 4);
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	int blockSize = getBlockSize(format);
+	unsigned char block[16][4];
+	for (int by = 0; by < blocksY; by++)
+	{
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			const unsigned char* source = blocks + ((size_t) by * blocksX + bx) * blockSize;
+			switch (format)
+			{
+			case BC3:
+				decodeColorBlock(source + 8, block);
+				decodeChannelBlock(source, 3, block);
+				break;
+			case BC5:
+				for (int i = 0; i < 16; i++) { block[i][2] = 0; block[i][3] = 255; }
+				decodeChannelBlock(source, 0, block);
+				decodeChannelBlock(source + 8, 1, block);
+				break;
+			default:
+				decodeColorBlock(source, block);
+				break;
+			}
+
+			for (int y = 0; y < 4 && by * 4 + y < height; y++)
+			{
+				for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+				{
+					std::memcpy(&result[((size_t) (by * 4 + y) * width + bx * 4 + x) * 4], block[y * 4 + x], 4);
+				}
+			}
+		}
+	}
+	return result;
+}
+
+TextureCooking::CompressedTexture TextureCooking::compress(const unsigned char* rgba, int width, int height, Format format, unsigned int numThreads)
+{
+	if ( format == AUTO )
+	{
+		format = BC1;
+		for (size_t i = 0; i < (size_t) width * height; i++) { if ( rgba[i * 4 + 3] != 255 ) { format = BC3; break; } }
+	}
+
+	CompressedTexture result;
+	result.format = format;
+	result.width = width;
+	result.height = height;
+
+	std::vector<unsigned char> level(rgba, rgba + (size_t) width * height * 4);
+	int levelWidth = width, levelHeight = height;
+	while ( true )
+	{
+		result.levelWidths.push_back(levelWidth);
+		result.levelHeights.push_back(levelHeight);
+		result.levels.push_back(compressLevel(&level[0], levelWidth, levelHeight, format, numThreads));
+		if ( levelWidth == 1 && levelHeight == 1 ) { break; }
+		level = downsample(level, levelWidth, levelHeight, levelWidth, levelHeight);
+	}
+	return result;
+}
+
+std::string TextureCooking::getCachePath(const std::string& path)
+{
+	return path + ".ezrtex";
+}
+
+namespace
+{
+	bool saveWithKey(const std::string& path, const TextureCooking::CompressedTexture& texture, unsigned long long sourceHash, TextureCooking::Format requestedFormat, int bytesPerPixel)
+	{
+		std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if ( !file.is_open() ) { return false; }
+
+		Header header;
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = TextureCooking::VERSION;
+		header.requestedFormat = (int) requestedFormat;
+		header.format = (int) texture.format;
+		header.bytesPerPixel = bytesPerPixel;
+		header.sourceHash = sourceHash;
+		header.width = texture.width;
+		header.height = texture.height;
+		header.numLevels = (unsigned int) texture.levels.size();
+		file.write((const char*) &header, sizeof(Header));
+
+		for (unsigned int level = 0; level < texture.levels.size(); level++)
+		{
+			LevelHeader levelHeader = { texture.levelWidths[level], texture.levelHeights[level], (unsigned int) texture.levels[level].size() };
+			file.write((const char*) &levelHeader, sizeof(LevelHeader));
+			file.write((const char*) &texture.levels[level][0], texture.levels[level].size());
+		}
+		return file.good();
+	}
+}
+
+bool TextureCooking::save(const std::string& path, const CompressedTexture& texture, unsigned long long sourceHash)
+{
+	return saveWithKey(path, texture, sourceHash, texture.format, 4);
+}
+
+GLuint TextureCooking::upload(const CompressedTexture& texture)
+{
+	std::vector<const unsigned char*> levels;
+	std::vector<unsigned int> sizes;
+	for (unsigned int level = 0; level < texture.levels.size(); level++)
+	{
+		levels.push_back(&texture.levels[level][0]);
+		sizes.push_back((unsigned int) texture.levels[level].size());
+	}
+	return uploadLevels(texture.format, texture.levelWidths, texture.levelHeights, levels, sizes);
+}
+
+GLuint TextureCooking::loadTexture(const std::string& fileName, Format format, TextureTools::TextureInfo* texInfo)
+{
+	unsigned long long sourceHash = 0;
+	{
+		MeshCache::MappedFile source;
+		if ( !source.open(fileName) )
+		{
+			DEBUGLOG->log("ERROR : Unable to open image " + fileName);
+			return -1;
+		}
+		sourceHash = MeshCache::hashData(source.getData(), source.getSize());
+	}
+
+	std::string cachePath = getCachePath(fileName);
+	MeshCache::MappedFile cached;
+	GLuint handle;
+	if ( cached.open(cachePath) && loadCached(cached.getData(), cached.getSize(), sourceHash, format, handle, texInfo) )
+	{
+		DEBUGLOG->log("SUCCESS: cooked image loaded from " + cachePath);
+		return handle;
+	}
+	cached.close();
+
+	// cook
+	int width, height, bytesPerPixel;
+	unsigned char* data = TextureTools::decodeImage(fileName, width, height, bytesPerPixel, true);
+	if ( data == nullptr )
+	{
+		DEBUGLOG->log("ERROR : Unable to open image " + fileName);
+		return -1;
+	}
+	std::vector<unsigned char> rgba = toRGBA(data, width, height, bytesPerPixel);
+	TextureTools::freeImage(data);
+
+	CompressedTexture texture = compress(&rgba[0], width, height, format);
+	if ( saveWithKey(cachePath, texture, sourceHash, format, bytesPerPixel) )
+	{
+		DEBUGLOG->log("SUCCESS: image cooked to " + cachePath);
+	}
+	else
+	{
+		DEBUGLOG->log("WARNING: could not write " + cachePath);
+	}
+
+	handle = upload(texture);
+	if (texInfo != nullptr)
+	{
+		texInfo->handle = handle;
+		texInfo->width = width;
+		texInfo->height = height;
+		texInfo->bytesPerPixel = bytesPerPixel;
+	}
+	return handle;
+}
+
+GLuint TextureCooking::loadTextureFromResourceFolder(const std::string& fileName, Format format, TextureTools::TextureInfo* texInfo)
+{
+	return loadTexture(RESOURCES_PATH "/" + fileName, format, texInfo);
+}
@@ -0,0 +1,62 @@
+#ifndef TEXTURE_COOKING_H
+#define TEXTURE_COOKING_H
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include <Importing/TextureTools.h>
+
+/** @brief block compression of textures on the CPU and a cache of the cooked results (.ezrtex)
+ *
+ * Images are decoded with stb_image, the mipmap chain is built with a box filter and every level is compressed to BCn with
+ * several threads. Cooked textures are written next to the source file and memory mapped on later loads, the levels are uploaded
+ * with glCompressedTexSubImage2D into immutable storage, so no mipmaps are generated at runtime.
+ * BC1 needs 0.5 bytes per texel, BC3 and BC5 need 1 byte per texel (RGBA8: 4 bytes).
+ */
+namespace TextureCooking {
+
+	const unsigned int VERSION = 1; //!< increase whenever the encoder or the file layout changes
+
+	enum Format
+	{
+		AUTO, //!< BC1 for opaque images, BC3 if any texel has alpha < 255
+		BC1,  //!< RGB, 4 bits per texel (GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+		BC3,  //!< RGBA, 8 bits per texel (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+		BC5   //!< two channels (red and green) with 8 bits per texel each (GL_COMPRESSED_RG_RGTC2), e.g. tangent space normals with z reconstructed in the shader
+	};
+
+	struct CompressedTexture
+	{
+		Format format;
+		int width;
+		int height;
+		std::vector<int> levelWidths;
+		std::vector<int> levelHeights;
+		std::vector<std::vector<unsigned char> > levels; //!< compressed blocks, level 0 first
+	};
+
+	GLenum getInternalFormat(Format format);
+	int getBlockSize(Format format); //!< bytes per 4x4 block
+
+	/** @brief build the mipmap chain of an RGBA8 image and compress every level
+	 * @param numThreads 0 for one thread per core, the result does not depend on it
+	 */
+	CompressedTexture compress(const unsigned char* rgba, int width, int height, Format format, unsigned int numThreads = 0);
+	std::vector<unsigned char> compressLevel(const unsigned char* rgba, int width, int height, Format format, unsigned int numThreads = 0);
+	std::vector<unsigned char> decompressLevel(const unsigned char* blocks, int width, int height, Format format); //!< back to RGBA8, for testing
+	std::vector<unsigned char> toRGBA(const unsigned char* data, int width, int height, int bytesPerPixel); //!< expand 1 - 4 channel images
+
+	bool save(const std::string& path, const CompressedTexture& texture, unsigned long long sourceHash);
+	GLuint upload(const CompressedTexture& texture); //!< immutable storage, all levels
+
+	/** @brief like TextureTools::loadTexture, but cooks the image on the first load and uses the cache afterwards
+	 * @return the texture's handle or -1
+	 */
+	GLuint loadTexture(const std::string& fileName, Format format = AUTO, TextureTools::TextureInfo* texInfo = nullptr);
+	GLuint loadTextureFromResourceFolder(const std::string& fileName, Format format = AUTO, TextureTools::TextureInfo* texInfo = nullptr);
+
+	std::string getCachePath(const std::string& path); //!< path of the cooked file of an image
+}
+
+#endif
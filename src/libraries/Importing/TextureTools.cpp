@@ -1,4 +1,5 @@
 #include <iostream>
+#include <cstring>
 
 #define STB_IMAGE_IMPLEMENTATION
 
@@ -7,6 +8,7 @@
 
 #include "Core/DebugLog.h"
 #include "Rendering/OpenGLContext.h"
+#include "Rendering/GLResources.h"
 
 #include "Rendering/GLTools.h"
 
@@ -16,48 +18,67 @@ namespace TextureTools {
         return log( n ) / log( 2 );      // log(n)/log(2) is log_2. 
     }
 
+	unsigned char* decodeImage(const std::string& fileName, int& width, int& height, int& bytesPerPixel, bool flipVertically)
+	{
+		// stbi_set_flip_vertically_on_load is global, so rows are flipped here instead
+		unsigned char* data = stbi_load(fileName.c_str(), &width, &height, &bytesPerPixel, 0);
+		if (data != NULL && flipVertically)
+		{
+			size_t rowSize = (size_t) width * bytesPerPixel;
+			std::vector<unsigned char> row(rowSize);
+			for (int y = 0; y < height / 2; y++)
+			{
+				unsigned char* top = data + y * rowSize;
+				unsigned char* bottom = data + (height - 1 - y) * rowSize;
+				std::memcpy(&row[0], top, rowSize);
+				std::memcpy(top, bottom, rowSize);
+				std::memcpy(bottom, &row[0], rowSize);
+			}
+		}
+		return data;
+	}
+
+	void freeImage(unsigned char* data)
+	{
+		stbi_image_free(data);
+	}
+
 	GLuint loadTexture(std::string fileName, TextureInfo* texInfo){
 
     	std::string fileString = std::string(fileName);
     	fileString = fileString.substr(fileString.find_last_of("/"));
 
     	int width, height, bytesPerPixel;
-        stbi_set_flip_vertically_on_load(true);
-        unsigned char *data = stbi_load(fileName.c_str(), &width, &height, &bytesPerPixel, 0);
+        unsigned char *data = decodeImage(fileName, width, height, bytesPerPixel, true);
 
         if(data == NULL){
         	DEBUGLOG->log("ERROR : Unable to open image " + fileString);
         	  return -1;}
 
-        //create new texture
-        GLuint textureHandle;
-        glGenTextures(1, &textureHandle);
-     
-        //bind the texture
-		OPENGLCONTEXT->bindTexture(textureHandle);
-     
-        //send image data to the new texture
+        //send image data to a new texture with immutable storage for the full mipmap chain
+        GLenum format;
         if (bytesPerPixel < 3) {
         	DEBUGLOG->log("ERROR : Unable to open image " + fileString);
+            stbi_image_free(data);
             return -1;
         } else if (bytesPerPixel == 3){
-            glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+            format = GL_RGB;
         } else if (bytesPerPixel == 4) {
-            glTexImage2D(GL_TEXTURE_2D, 0,GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            format = GL_RGBA;
         } else {
         	DEBUGLOG->log("Unknown format for bytes per pixel... Changed to \"4\"");
-            glTexImage2D(GL_TEXTURE_2D, 0,GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+            format = GL_RGBA;
         }
 
+        GLuint textureHandle = GLResources::createTexture2D(GLResources::getSizedInternalFormat(format), width, height, 0);
+        GLResources::uploadTexture2D(textureHandle, 0, width, height, format, GL_UNSIGNED_BYTE, data);
+
         //texture settings
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, true);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		
-		OPENGLCONTEXT->bindTexture(0);
+        GLResources::generateMipmap(textureHandle);
+        GLResources::setTextureParameter(textureHandle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        GLResources::setTextureParameter(textureHandle, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        GLResources::setTextureParameter(textureHandle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        GLResources::setTextureParameter(textureHandle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
         stbi_image_free(data);
         DEBUGLOG->log( "SUCCESS: image loaded from " + fileString );
@@ -91,8 +112,7 @@ namespace TextureTools {
 	OPENGLCONTEXT->bindTexture(textureID, GL_TEXTURE_CUBE_MAP);
 	for(GLuint i = 0; i < faces.size(); i++)
 	{
-		stbi_set_flip_vertically_on_load(false);
-        image = stbi_load(faces[i].c_str(), &width, &height, &bytesPerPixel, 0);
+        image = decodeImage(faces[i], width, height, bytesPerPixel, false);
 		        //send image data to the new texture
         if (bytesPerPixel < 3) {
 			DEBUGLOG->log("ERROR : Unable to open image " + faces[i]);
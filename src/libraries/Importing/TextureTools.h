@@ -17,6 +17,12 @@ namespace TextureTools {
 		int bytesPerPixel; //!< the texture's amount of bytes saved per pixel, i.e. 3 for GL_RGB or 4 for GL_RGBA
 	};
 
+	/**@brief decode an image file into memory without touching OpenGL or global stb_image state, may be called from any thread
+	 * @param flipVertically flip rows so the first row is the bottom of the image (OpenGL convention)
+	 * @return the pixels (free with freeImage()) or nullptr */
+	unsigned char* decodeImage(const std::string& fileName, int& width, int& height, int& bytesPerPixel, bool flipVertically);
+	void freeImage(unsigned char* data);
+
 	/**@brief load an image file and upload it to the GPU, returning the texture's handle
 	 * @param fileName of the image file to be read
 	 * @param texInfo (optional) pointer to a TextureInfo instance which will be filled with the texture's properties
@@ -0,0 +1,382 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <Core/Camera.h>
+#include <Core/DebugLog.h>
+#include <Core/GPUProfiler.h>
+#include <Rendering/GoldenImages.h>
+
+namespace
+{
+	Benchmark::Settings s_settings = { false, false, Benchmark::NATIVE, 60, 300, 1.0 / 60.0, "", "", "", false };
+	GPUProfiler* s_profiler = nullptr;
+	GoldenImages* s_goldenImages = nullptr;
+	unsigned int s_frameIndex = 0;
+	int s_exitCode = 0;
+
+	struct Statistics
+	{
+		double min;
+		double avg;
+		double p50;
+		double p90;
+		double p95;
+		double p99;
+		double max;
+	};
+
+	Statistics computeStatistics(std::vector<double> values)
+	{
+		Statistics statistics = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+		if ( values.empty() ) { return statistics; }
+
+		// nearest rank percentiles
+		std::sort(values.begin(), values.end());
+		auto percentile = [&values](double p) { return values[std::max((size_t) std::ceil(p * (double) values.size()), (size_t) 1) - 1]; };
+
+		double sum = 0.0;
+		for (unsigned int i = 0; i < values.size(); i++) { sum += values[i]; }
+		statistics.min = values.front();
+		statistics.avg = sum / (double) values.size();
+		statistics.p50 = percentile(0.5);
+		statistics.p90 = percentile(0.9);
+		statistics.p95 = percentile(0.95);
+		statistics.p99 = percentile(0.99);
+		statistics.max = values.back();
+		return statistics;
+	}
+
+	std::string toJSON(const Statistics& s)
+	{
+		return "{\"min\":" + DebugLog::to_string(s.min) + ",\"avg\":" + DebugLog::to_string(s.avg) + ",\"p50\":" + DebugLog::to_string(s.p50)
+			+ ",\"p90\":" + DebugLog::to_string(s.p90) + ",\"p95\":" + DebugLog::to_string(s.p95) + ",\"p99\":" + DebugLog::to_string(s.p99)
+			+ ",\"max\":" + DebugLog::to_string(s.max) + "}";
+	}
+
+	std::string quote(const char* text)
+	{
+		std::string result = "\"";
+		for (const char* c = ( text != nullptr ) ? text : ""; *c != '\0'; c++)
+		{
+			if ( *c == '"' || *c == '\\' ) { result += '\\'; }
+			result += *c;
+		}
+		return result + "\"";
+	}
+
+	bool writeReport(GLFWwindow* window, const std::vector<double>& frameTimes, unsigned long long firstProfilerFrame)
+	{
+		std::ofstream file(s_settings.outputPath.c_str());
+		if ( !file.good() )
+		{
+			DEBUGLOG->log("ERROR: Benchmark: could not write " + s_settings.outputPath);
+			return false;
+		}
+
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+
+		file << "{\n";
+		file << "\t\"name\": " << quote(s_settings.name.c_str()) << ",\n";
+		file << "\t\"renderer\": " << quote((const char*) glGetString(GL_RENDERER)) << ",\n";
+		file << "\t\"version\": " << quote((const char*) glGetString(GL_VERSION)) << ",\n";
+		file << "\t\"resolution\": [" << width << ", " << height << "],\n";
+		file << "\t\"warmupFrames\": " << s_settings.warmupFrames << ",\n";
+		file << "\t\"frames\": " << frameTimes.size() << ",\n";
+		file << "\t\"frameTime\": " << toJSON(computeStatistics(frameTimes)) << ",\n";
+		file << "\t\"passes\": [";
+
+		// per scope, only samples of measured frames
+		bool first = true;
+		for (int i = 0; s_profiler != nullptr && i < (int) s_profiler->getScopes().size(); i++)
+		{
+			std::vector<GPUProfiler::Sample> history = s_profiler->getHistory(i);
+			std::vector<double> gpuTimes, cpuTimes;
+			for (unsigned int j = 0; j < history.size(); j++)
+			{
+				if ( history[j].frame < firstProfilerFrame ) { continue; }
+				gpuTimes.push_back(history[j].gpuTime);
+				cpuTimes.push_back(history[j].cpuTime);
+			}
+			if ( gpuTimes.empty() ) { continue; }
+
+			file << ( first ? "\n" : ",\n" );
+			file << "\t\t{\"path\": " << quote(s_profiler->getScopes()[i].path.c_str()) << ", \"frames\": " << gpuTimes.size()
+				<< ", \"gpu\": " << toJSON(computeStatistics(gpuTimes)) << ", \"cpu\": " << toJSON(computeStatistics(cpuTimes)) << "}";
+			first = false;
+		}
+		file << ( first ? "]" : "\n\t]" );
+
+		// golden image test results, if compared
+		if ( s_goldenImages != nullptr && !s_settings.goldenDirectory.empty() && !s_settings.updateGolden )
+		{
+			const std::vector<GoldenImages::Result>& results = s_goldenImages->getResults();
+			file << ",\n\t\"goldenImages\": [";
+			for (unsigned int i = 0; i < results.size(); i++)
+			{
+				file << ( i == 0 ? "\n" : ",\n" );
+				file << "\t\t{\"name\": " << quote(results[i].name.c_str()) << ", \"passed\": " << ( results[i].passed ? "true" : "false" )
+					<< ", \"missing\": " << ( results[i].missing ? "true" : "false" ) << ", \"rmse\": " << DebugLog::to_string(results[i].rmse)
+					<< ", \"maxError\": " << DebugLog::to_string(results[i].maxError) << ", \"failedPixels\": " << results[i].numFailedPixels
+					<< ", \"pixels\": " << results[i].numPixels << "}";
+			}
+			file << ( results.empty() ? "]" : "\n\t]" );
+		}
+		file << "\n}\n";
+		file.close();
+
+		DEBUGLOG->log("Benchmark: report written to " + s_settings.outputPath);
+		return true;
+	}
+}
+
+bool Benchmark::parseArguments(int argc, char** argv, const std::string& name)
+{
+	s_settings.name = name;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = ( i + 1 < argc && argv[i + 1][0] != '-' );
+		if ( std::strcmp(argv[i], "--benchmark") == 0 )
+		{
+			s_settings.enabled = true;
+			if ( hasValue ) { s_settings.numFrames = (unsigned int) std::max(std::atoi(argv[++i]), 1); }
+		}
+		else if ( std::strcmp(argv[i], "--warmup") == 0 && hasValue ) { s_settings.warmupFrames = (unsigned int) std::max(std::atoi(argv[++i]), 0); }
+		else if ( std::strcmp(argv[i], "--output") == 0 && hasValue ) { s_settings.outputPath = argv[++i]; }
+		else if ( std::strcmp(argv[i], "--golden") == 0 && hasValue ) { s_settings.goldenDirectory = argv[++i]; }
+		else if ( std::strcmp(argv[i], "--update-golden") == 0 ) { s_settings.updateGolden = true; }
+		else if ( std::strcmp(argv[i], "--headless") == 0 ) { s_settings.headless = true; }
+		else if ( std::strcmp(argv[i], "--egl") == 0 ) { s_settings.headless = true; s_settings.contextAPI = EGL; }
+		else if ( std::strcmp(argv[i], "--osmesa") == 0 ) { s_settings.headless = true; s_settings.contextAPI = OSMESA; }
+	}
+	if ( s_settings.outputPath.empty() ) { s_settings.outputPath = name + "_benchmark.json"; }
+
+	if ( s_settings.enabled )
+	{
+		DEBUGLOG->log("Benchmark: " + name + ", frames: " + DebugLog::to_string(s_settings.numFrames) + ", warmup: " + DebugLog::to_string(s_settings.warmupFrames)
+			+ ( s_settings.headless ? ", headless" : "" ));
+	}
+	return s_settings.enabled;
+}
+
+const Benchmark::Settings& Benchmark::getSettings()
+{
+	return s_settings;
+}
+
+bool Benchmark::isEnabled()
+{
+	return s_settings.enabled;
+}
+
+void Benchmark::setProfiler(GPUProfiler* profiler)
+{
+	s_profiler = profiler;
+	if ( s_profiler != nullptr && s_settings.enabled )
+	{
+		s_profiler->setHistorySize(s_settings.numFrames); // keep every measured frame
+	}
+}
+
+void Benchmark::setGoldenImages(GoldenImages* goldenImages)
+{
+	s_goldenImages = goldenImages;
+}
+
+int Benchmark::getExitCode()
+{
+	return s_exitCode;
+}
+
+double Benchmark::getTime()
+{
+	return s_settings.enabled ? s_frameIndex * s_settings.timeStep : glfwGetTime();
+}
+
+void Benchmark::applyWindowHints()
+{
+	if ( !s_settings.headless ) { return; }
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+
+	if ( s_settings.contextAPI == EGL )
+	{
+		#ifdef GLFW_EGL_CONTEXT_API
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+		#else
+		DEBUGLOG->log("WARNING: Benchmark: GLFW without EGL context creation, using a hidden window");
+		#endif
+	}
+	if ( s_settings.contextAPI == OSMESA )
+	{
+		#ifdef GLFW_OSMESA_CONTEXT_API
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+		#else
+		DEBUGLOG->log("WARNING: Benchmark: GLFW without OSMesa context creation, using a hidden window");
+		#endif
+	}
+}
+
+void Benchmark::configureContext()
+{
+	glfwSwapInterval(0); // measure the frame time, not the display's refresh rate
+	DEBUGLOG->log(std::string("Benchmark: renderer: ") + (const char*) glGetString(GL_RENDERER));
+}
+
+bool Benchmark::run(GLFWwindow* window, std::function<void (double)> loop)
+{
+	std::vector<double> frameTimes;
+	frameTimes.reserve(s_settings.numFrames);
+	unsigned long long firstProfilerFrame = 0;
+	auto last = std::chrono::high_resolution_clock::now();
+
+	unsigned int numFrames = s_settings.warmupFrames + s_settings.numFrames;
+	bool goldenTest = ( s_goldenImages != nullptr && !s_settings.goldenDirectory.empty() );
+	if ( !s_settings.goldenDirectory.empty() && s_goldenImages == nullptr )
+	{
+		DEBUGLOG->log("WARNING: Benchmark: --golden given, but " + s_settings.name + " does not register golden images");
+	}
+	for (s_frameIndex = 0; s_frameIndex < numFrames && !glfwWindowShouldClose(window); s_frameIndex++)
+	{
+		if ( s_frameIndex == s_settings.warmupFrames )
+		{
+			glFinish(); // nothing of the warmup is measured
+			last = std::chrono::high_resolution_clock::now();
+			if ( s_profiler != nullptr ) { firstProfilerFrame = s_profiler->getFrame() + 1; }
+		}
+
+		loop(s_settings.timeStep);
+
+		// before swapping, so the back buffer can be captured as well
+		if ( goldenTest && s_frameIndex + 1 == numFrames ) { s_goldenImages->capture(); }
+
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+
+		// time between two swaps, the driver throttles the CPU if the GPU falls behind
+		if ( s_frameIndex >= s_settings.warmupFrames )
+		{
+			auto now = std::chrono::high_resolution_clock::now();
+			frameTimes.push_back(std::chrono::duration<double, std::milli>(now - last).count());
+			last = now;
+		}
+	}
+
+	// read back the timings of the last frames
+	glFinish();
+	if ( s_profiler != nullptr ) { s_profiler->beginFrame(); }
+
+	// the scene only depends on the frame index, so the captured frame is the same in every run
+	bool goldenPassed = true;
+	if ( goldenTest )
+	{
+		if ( !s_goldenImages->fetch(true) )
+		{
+			DEBUGLOG->log("ERROR: Benchmark: no golden image capture, the window was closed early");
+			goldenPassed = false;
+		}
+		else if ( s_settings.updateGolden )
+		{
+			goldenPassed = s_goldenImages->write(s_settings.goldenDirectory);
+		}
+		else
+		{
+			// actual images of failed targets go next to the report
+			size_t separator = s_settings.outputPath.find_last_of("/\\");
+			std::string reportDirectory = ( separator != std::string::npos ) ? s_settings.outputPath.substr(0, separator) : ".";
+			goldenPassed = s_goldenImages->compare(s_settings.goldenDirectory, reportDirectory);
+		}
+	}
+
+	bool success = writeReport(window, frameTimes, firstProfilerFrame) && goldenPassed;
+	s_exitCode = success ? 0 : 1;
+	return success;
+}
+
+Benchmark::CameraPath::CameraPath(bool loop)
+	: m_loop(loop)
+{
+}
+
+void Benchmark::CameraPath::addKeyframe(double time, const glm::vec3& position, const glm::vec3& center)
+{
+	m_times.push_back(time);
+	m_positions.push_back(position);
+	m_centers.push_back(center);
+}
+
+glm::vec3 Benchmark::CameraPath::interpolate(const std::vector<glm::vec3>& values, double time) const
+{
+	if ( values.empty() ) { return glm::vec3(0.0f); }
+	int n = (int) values.size();
+	if ( n == 1 ) { return values[0]; }
+
+	// looping paths end with the first keyframe again
+	if ( m_loop && m_times.back() > m_times.front() )
+	{
+		time = m_times.front() + std::fmod(time - m_times.front(), m_times.back() - m_times.front());
+		if ( time < m_times.front() ) { time += m_times.back() - m_times.front(); }
+	}
+	time = std::min(std::max(time, m_times.front()), m_times.back());
+
+	int segment = 0;
+	while ( segment < n - 2 && time > m_times[segment + 1] ) { segment++; }
+	double duration = m_times[segment + 1] - m_times[segment];
+	float t = ( duration > 0.0 ) ? (float) ((time - m_times[segment]) / duration) : 0.0f;
+
+	// neighbours of the segment, wrapping around the duplicated keyframe of looping paths
+	auto index = [this, n](int i)
+	{
+		if ( m_loop ) { return ( i < 0 ) ? i + n - 1 : ( i >= n ) ? i - n + 1 : i; }
+		return std::min(std::max(i, 0), n - 1);
+	};
+	const glm::vec3& p0 = values[index(segment - 1)];
+	const glm::vec3& p1 = values[segment];
+	const glm::vec3& p2 = values[segment + 1];
+	const glm::vec3& p3 = values[index(segment + 2)];
+
+	// uniform Catmull-Rom
+	return 0.5f * ( 2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t * t + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t * t * t );
+}
+
+glm::vec3 Benchmark::CameraPath::getPosition(double time) const
+{
+	return interpolate(m_positions, time);
+}
+
+glm::vec3 Benchmark::CameraPath::getCenter(double time) const
+{
+	return interpolate(m_centers, time);
+}
+
+glm::mat4 Benchmark::CameraPath::getViewMatrix(double time) const
+{
+	return glm::lookAt(getPosition(time), getCenter(time), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+void Benchmark::CameraPath::apply(Camera& camera, double time) const
+{
+	camera.setPosition(getPosition(time));
+	camera.setCenter(getCenter(time));
+}
+
+Benchmark::CameraPath Benchmark::CameraPath::orbit(const glm::vec3& eye, const glm::vec3& center, double period, unsigned int numKeyframes)
+{
+	CameraPath path(true);
+	glm::vec3 offset = eye - center;
+	numKeyframes = std::max(numKeyframes, 3u);
+	for (unsigned int i = 0; i <= numKeyframes; i++)
+	{
+		float angle = 2.0f * glm::pi<float>() * (float) i / (float) numKeyframes;
+		glm::vec3 rotated(offset.x * std::cos(angle) + offset.z * std::sin(angle), offset.y, -offset.x * std::sin(angle) + offset.z * std::cos(angle));
+		path.addKeyframe(period * i / numKeyframes, center + rotated, center);
+	}
+	return path;
+}
@@ -0,0 +1,97 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+class Camera;
+class GPUProfiler;
+class GoldenImages;
+
+/** @brief unattended runs of the demo executables
+ *
+ * parseArguments switches the process into benchmark mode, after which generateWindow() creates a hidden window
+ * (or an EGL / OSMesa context, if GLFW supports it) without vsync and render() executes a fixed number of frames with a fixed
+ * time step instead of looping until the window is closed. Afterwards a JSON report with frame time percentiles and the
+ * per scope timings of a registered GPUProfiler is written.
+ *
+ * arguments: --benchmark [frames] --warmup <frames> --headless --egl --osmesa --output <file.json> --golden <directory> --update-golden
+ *
+ * With --golden, the targets of a registered GoldenImages object are captured in the last frame and compared against the
+ * golden images in that directory (or replace them, with --update-golden). Mismatches are part of the report and of getExitCode().
+ *
+ * Input callbacks are not called in benchmark mode, executables move their camera along a CameraPath instead.
+ * On machines without a GPU, Mesa's llvmpipe can be used (LIBGL_ALWAYS_SOFTWARE=1, under Xvfb for the GLX path).
+ */
+namespace Benchmark {
+
+	enum ContextAPI { NATIVE, EGL, OSMESA };
+
+	struct Settings
+	{
+		bool enabled;
+		bool headless;              //!< hidden window / offscreen context
+		ContextAPI contextAPI;
+		unsigned int warmupFrames;  //!< rendered but not measured (shader compilation, streaming uploads)
+		unsigned int numFrames;     //!< measured frames
+		double timeStep;            //!< dt passed to the render loop in seconds, so animations do not depend on the frame rate
+		std::string name;
+		std::string outputPath;
+		std::string goldenDirectory; //!< empty: no golden image test
+		bool updateGolden;           //!< write the golden images instead of comparing
+	};
+
+	/** @brief parse the benchmark arguments, the others are ignored
+	 * @param name of the executable, used in the report and for the default output path <name>_benchmark.json
+	 * @return whether benchmark mode is enabled
+	 */
+	bool parseArguments(int argc, char** argv, const std::string& name);
+	const Settings& getSettings();
+	bool isEnabled();
+
+	void setProfiler(GPUProfiler* profiler); //!< scopes of this profiler are reported per pass, the executable drives its beginFrame
+	void setGoldenImages(GoldenImages* goldenImages); //!< targets to capture in the last frame if --golden is given
+	int getExitCode(); //!< 0 unless the report could not be written or a golden image test failed
+	double getTime(); //!< seconds of scripted time since the first frame (frame index * time step)
+
+	void applyWindowHints();    //!< called by generateWindow() before the window is created
+	void configureContext();    //!< called by generateWindow() once the context is current
+
+	/** @brief called by render(): execute warmup and measured frames, then write the report
+	 * @return whether the report could be written and all golden image tests passed
+	 */
+	bool run(GLFWwindow* window, std::function<void (double)> loop);
+
+	/** @brief scripted camera movement through keyframes, interpolated with Catmull-Rom splines
+	 */
+	class CameraPath
+	{
+	public:
+		CameraPath(bool loop = true);
+
+		void addKeyframe(double time, const glm::vec3& position, const glm::vec3& center); //!< in ascending time order
+
+		glm::vec3 getPosition(double time) const;
+		glm::vec3 getCenter(double time) const;
+		glm::mat4 getViewMatrix(double time) const;
+		void apply(Camera& camera, double time) const; //!< set position and view direction
+
+		/** @brief circle around center at the height of eye, starting at eye */
+		static CameraPath orbit(const glm::vec3& eye, const glm::vec3& center, double period = 10.0, unsigned int numKeyframes = 8);
+
+	private:
+		glm::vec3 interpolate(const std::vector<glm::vec3>& values, double time) const;
+
+		bool m_loop;       //!< after the last keyframe, return to the first one
+		std::vector<double> m_times;
+		std::vector<glm::vec3> m_positions;
+		std::vector<glm::vec3> m_centers;
+	};
+}
+
+#endif
@@ -0,0 +1,417 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <Core/DebugLog.h>
+
+#include <algorithm>
+
+namespace
+{
+	const int MAX_LEAF_SIZE = 4;
+	const int NUM_BINS = 12;
+	const float TRAVERSAL_COST = 1.0f; //!< relative to the cost of testing one object box
+	const int INITIAL_STACK_SIZE = 64; //!< traversal stacks grow beyond this, degenerate trees can be deeper
+	const int ALL_PLANES = (1 << 6) - 1;
+
+	inline float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+	{
+		glm::vec3 e = max - min;
+		return e.x * e.y + e.y * e.z + e.z * e.x;
+	}
+
+	struct Bin
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		int count;
+	};
+
+	/// slab test, returns entry distance or FLT_MAX if missed
+	inline float intersectBox(const glm::vec3& origin, const glm::vec3& invDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance)
+	{
+		glm::vec3 t0 = (min - origin) * invDirection;
+		glm::vec3 t1 = (max - origin) * invDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar  = glm::max(t0, t1);
+		float tEnter = glm::max( glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f) );
+		float tExit  = glm::min( glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance) );
+		return (tEnter <= tExit) ? tEnter : FLT_MAX;
+	}
+}
+
+Culling::BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+{
+}
+
+void Culling::BoundingVolumeHierarchy::build(const std::vector<CullingInfo>& objects)
+{
+	m_objects = objects;
+	buildNodes();
+}
+
+void Culling::BoundingVolumeHierarchy::build(const std::vector<AssimpTools::RenderableInfo>& renderables, const std::vector<glm::mat4>& modelMatrices)
+{
+	if ( modelMatrices.size() != renderables.size() )
+	{
+		DEBUGLOG->log("WARNING: number of model matrices does not match number of renderables, identity matrix will be used for missing ones");
+	}
+
+	m_objects.resize(renderables.size());
+	for (size_t i = 0; i < renderables.size(); i++)
+	{
+		m_objects[i] = getCullingInfo( renderables[i], (i < modelMatrices.size()) ? modelMatrices[i] : glm::mat4(1.0f) ).second;
+	}
+	buildNodes();
+}
+
+void Culling::BoundingVolumeHierarchy::buildNodes()
+{
+	const size_t numObjects = m_objects.size();
+	m_objectMin.resize(numObjects);
+	m_objectMax.resize(numObjects);
+	m_objectCentroid.resize(numObjects);
+	m_objectIndices.resize(numObjects);
+	m_objectLeaf.resize(numObjects);
+	m_dirtyObjects.clear();
+	m_nodes.clear();
+	m_parents.clear();
+
+	if ( numObjects == 0 ) { return; }
+
+	glm::vec3 center;
+	glm::vec3 extent;
+	float radius;
+	for (size_t i = 0; i < numObjects; i++)
+	{
+		getWorldSpaceBounds(m_objects[i], center, extent, radius);
+		m_objectMin[i] = center - extent;
+		m_objectMax[i] = center + extent;
+		m_objectCentroid[i] = center;
+		m_objectIndices[i] = (unsigned int) i;
+	}
+
+	// a binary tree with at least one object per leaf never has more than 2n - 1 nodes
+	m_nodes.reserve(2 * numObjects);
+	m_parents.reserve(2 * numObjects);
+
+	Node root;
+	root.leftOrFirst = 0;
+	root.count = (int) numObjects;
+	m_nodes.push_back(root);
+	m_parents.push_back(-1);
+	updateNodeBounds(0);
+
+	subdivide(0);
+
+	for (int n = 0; n < (int) m_nodes.size(); n++)
+	{
+		for (int i = 0; i < m_nodes[n].count; i++)
+		{
+			m_objectLeaf[ m_objectIndices[m_nodes[n].leftOrFirst + i] ] = n;
+		}
+	}
+
+	m_objectCentroid.clear();
+	m_objectCentroid.shrink_to_fit();
+}
+
+void Culling::BoundingVolumeHierarchy::updateNodeBounds(int nodeIdx)
+{
+	Node& node = m_nodes[nodeIdx];
+	node.min = glm::vec3( FLT_MAX);
+	node.max = glm::vec3(-FLT_MAX);
+	for (int i = 0; i < node.count; i++)
+	{
+		unsigned int object = m_objectIndices[node.leftOrFirst + i];
+		node.min = glm::min(node.min, m_objectMin[object]);
+		node.max = glm::max(node.max, m_objectMax[object]);
+	}
+}
+
+void Culling::BoundingVolumeHierarchy::subdivide(int nodeIdx)
+{
+	const int first = m_nodes[nodeIdx].leftOrFirst;
+	const int count = m_nodes[nodeIdx].count;
+	if ( count <= 1 ) { return; }
+
+	// split along the longest axis of the centroid bounds
+	glm::vec3 centroidMin( FLT_MAX);
+	glm::vec3 centroidMax(-FLT_MAX);
+	for (int i = first; i < first + count; i++)
+	{
+		centroidMin = glm::min(centroidMin, m_objectCentroid[m_objectIndices[i]]);
+		centroidMax = glm::max(centroidMax, m_objectCentroid[m_objectIndices[i]]);
+	}
+	glm::vec3 centroidExtent = centroidMax - centroidMin;
+	int axis = 0;
+	if ( centroidExtent.y > centroidExtent[axis] ) { axis = 1; }
+	if ( centroidExtent.z > centroidExtent[axis] ) { axis = 2; }
+	if ( centroidExtent[axis] <= 0.0f ) { return; } // all centroids coincide, cannot be split
+
+	// binned SAH
+	Bin bins[NUM_BINS];
+	for (int b = 0; b < NUM_BINS; b++)
+	{
+		bins[b].min = glm::vec3( FLT_MAX);
+		bins[b].max = glm::vec3(-FLT_MAX);
+		bins[b].count = 0;
+	}
+	const float binScale = (float) NUM_BINS / centroidExtent[axis];
+	for (int i = first; i < first + count; i++)
+	{
+		unsigned int object = m_objectIndices[i];
+		int b = std::min(NUM_BINS - 1, (int) ((m_objectCentroid[object][axis] - centroidMin[axis]) * binScale));
+		bins[b].count++;
+		bins[b].min = glm::min(bins[b].min, m_objectMin[object]);
+		bins[b].max = glm::max(bins[b].max, m_objectMax[object]);
+	}
+
+	// sweep from both sides, cost of splitting after bin b
+	float leftArea[NUM_BINS - 1];
+	int leftCount[NUM_BINS - 1];
+	float cost[NUM_BINS - 1];
+	glm::vec3 boundsMin( FLT_MAX);
+	glm::vec3 boundsMax(-FLT_MAX);
+	int sum = 0;
+	for (int b = 0; b < NUM_BINS - 1; b++)
+	{
+		sum += bins[b].count;
+		boundsMin = glm::min(boundsMin, bins[b].min);
+		boundsMax = glm::max(boundsMax, bins[b].max);
+		leftCount[b] = sum;
+		leftArea[b] = (sum > 0) ? surfaceArea(boundsMin, boundsMax) : 0.0f;
+	}
+	boundsMin = glm::vec3( FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+	sum = 0;
+	for (int b = NUM_BINS - 1; b > 0; b--)
+	{
+		sum += bins[b].count;
+		boundsMin = glm::min(boundsMin, bins[b].min);
+		boundsMax = glm::max(boundsMax, bins[b].max);
+		float rightArea = (sum > 0) ? surfaceArea(boundsMin, boundsMax) : 0.0f;
+		cost[b - 1] = leftCount[b - 1] * leftArea[b - 1] + sum * rightArea;
+	}
+
+	int bestSplit = 0;
+	for (int b = 1; b < NUM_BINS - 1; b++)
+	{
+		if ( cost[b] < cost[bestSplit] ) { bestSplit = b; }
+	}
+
+	const Node& node = m_nodes[nodeIdx];
+	const float nodeArea = surfaceArea(node.min, node.max);
+	if ( count <= MAX_LEAF_SIZE && cost[bestSplit] + TRAVERSAL_COST * nodeArea >= count * nodeArea ) { return; }
+
+	unsigned int* begin = &m_objectIndices[first];
+	unsigned int* middle = std::partition(begin, begin + count, [&](unsigned int object) {
+		return std::min(NUM_BINS - 1, (int) ((m_objectCentroid[object][axis] - centroidMin[axis]) * binScale)) <= bestSplit;
+	});
+	int leftCountFinal = (int) (middle - begin);
+	if ( leftCountFinal == 0 || leftCountFinal == count ) // numerically degenerate, fall back to median split
+	{
+		leftCountFinal = count / 2;
+		std::nth_element(begin, begin + leftCountFinal, begin + count, [&](unsigned int a, unsigned int b) {
+			return m_objectCentroid[a][axis] < m_objectCentroid[b][axis];
+		});
+	}
+
+	int leftIdx = (int) m_nodes.size();
+	Node left;
+	left.leftOrFirst = first;
+	left.count = leftCountFinal;
+	Node right;
+	right.leftOrFirst = first + leftCountFinal;
+	right.count = count - leftCountFinal;
+	m_nodes.push_back(left);
+	m_nodes.push_back(right);
+	m_parents.push_back(nodeIdx);
+	m_parents.push_back(nodeIdx);
+
+	m_nodes[nodeIdx].leftOrFirst = leftIdx;
+	m_nodes[nodeIdx].count = 0;
+
+	updateNodeBounds(leftIdx);
+	updateNodeBounds(leftIdx + 1);
+	subdivide(leftIdx);
+	subdivide(leftIdx + 1);
+}
+
+void Culling::BoundingVolumeHierarchy::updateModelMatrix(unsigned int object, const glm::mat4& modelMatrix)
+{
+	if ( object >= m_objects.size() ) { return; }
+
+	m_objects[object].modelMatrix = modelMatrix;
+
+	glm::vec3 center;
+	glm::vec3 extent;
+	float radius;
+	getWorldSpaceBounds(m_objects[object], center, extent, radius);
+	m_objectMin[object] = center - extent;
+	m_objectMax[object] = center + extent;
+
+	m_dirtyObjects.push_back(object);
+}
+
+void Culling::BoundingVolumeHierarchy::refit()
+{
+	if ( m_dirtyObjects.empty() || m_nodes.empty() ) { return; }
+
+	if ( m_dirtyObjects.size() * 8 > m_objects.size() )
+	{
+		// many objects moved: children are always stored behind their parent, so a reverse sweep is bottom up
+		for (int n = (int) m_nodes.size() - 1; n >= 0; n--)
+		{
+			Node& node = m_nodes[n];
+			if ( node.count > 0 )
+			{
+				updateNodeBounds(n);
+			}
+			else
+			{
+				const Node& left = m_nodes[node.leftOrFirst];
+				const Node& right = m_nodes[node.leftOrFirst + 1];
+				node.min = glm::min(left.min, right.min);
+				node.max = glm::max(left.max, right.max);
+			}
+		}
+	}
+	else
+	{
+		// few objects moved: walk up from their leaves until bounds stop changing
+		for (unsigned int object : m_dirtyObjects)
+		{
+			int n = m_objectLeaf[object];
+			updateNodeBounds(n);
+			for (n = m_parents[n]; n >= 0; n = m_parents[n])
+			{
+				Node& node = m_nodes[n];
+				const Node& left = m_nodes[node.leftOrFirst];
+				const Node& right = m_nodes[node.leftOrFirst + 1];
+				glm::vec3 boundsMin = glm::min(left.min, right.min);
+				glm::vec3 boundsMax = glm::max(left.max, right.max);
+				if ( boundsMin == node.min && boundsMax == node.max ) { break; }
+				node.min = boundsMin;
+				node.max = boundsMax;
+			}
+		}
+	}
+
+	m_dirtyObjects.clear();
+}
+
+void Culling::BoundingVolumeHierarchy::queryFrustum(const CullingHelper& cullingHelper, std::vector<unsigned int>& result) const
+{
+	result.clear();
+	if ( m_nodes.empty() ) { return; }
+
+	const glm::vec4* planes = cullingHelper.getFrustumPlanes();
+
+	// planes a node is completely inside of are masked out for its subtree
+	std::vector<std::pair<int, int> > stack; // node, mask
+	stack.reserve(INITIAL_STACK_SIZE);
+	stack.push_back(std::make_pair(0, ALL_PLANES));
+
+	while ( !stack.empty() )
+	{
+		const int nodeIdx = stack.back().first;
+		int mask = stack.back().second;
+		stack.pop_back();
+		const Node& node = m_nodes[nodeIdx];
+
+		glm::vec3 center = 0.5f * (node.max + node.min);
+		glm::vec3 extent = 0.5f * (node.max - node.min);
+		bool outside = false;
+		for (int p = 0; p < 6; p++)
+		{
+			if ( !(mask & (1 << p)) ) { continue; }
+			float d = glm::dot(glm::vec3(planes[p]), center) + planes[p].w;
+			float r = glm::dot(glm::abs(glm::vec3(planes[p])), extent);
+			if ( d < -r ) { outside = true; break; }
+			if ( d >= r ) { mask &= ~(1 << p); }
+		}
+		if ( outside ) { continue; }
+
+		if ( mask == 0 || node.count > 0 ) // completely inside or leaf
+		{
+			if ( node.count > 0 && mask != 0 )
+			{
+				for (int i = 0; i < node.count; i++)
+				{
+					unsigned int object = m_objectIndices[node.leftOrFirst + i];
+					glm::vec3 objectCenter = 0.5f * (m_objectMax[object] + m_objectMin[object]);
+					glm::vec3 objectExtent = 0.5f * (m_objectMax[object] - m_objectMin[object]);
+					bool objectOutside = false;
+					for (int p = 0; p < 6 && !objectOutside; p++)
+					{
+						if ( !(mask & (1 << p)) ) { continue; }
+						float d = glm::dot(glm::vec3(planes[p]), objectCenter) + planes[p].w;
+						objectOutside = d < -glm::dot(glm::abs(glm::vec3(planes[p])), objectExtent);
+					}
+					if ( !objectOutside ) { result.push_back(object); }
+				}
+				continue;
+			}
+
+			// accept whole subtree, its objects are a contiguous range from the leftmost to the rightmost leaf
+			const Node* leftmost = &node;
+			const Node* rightmost = &node;
+			while ( leftmost->count == 0 )  { leftmost = &m_nodes[leftmost->leftOrFirst]; }
+			while ( rightmost->count == 0 ) { rightmost = &m_nodes[rightmost->leftOrFirst + 1]; }
+			result.insert(result.end(), m_objectIndices.begin() + leftmost->leftOrFirst, m_objectIndices.begin() + rightmost->leftOrFirst + rightmost->count);
+			continue;
+		}
+
+		stack.push_back(std::make_pair(node.leftOrFirst, mask));
+		stack.push_back(std::make_pair(node.leftOrFirst + 1, mask));
+	}
+}
+
+bool Culling::BoundingVolumeHierarchy::queryRay(const glm::vec3& origin, const glm::vec3& direction, unsigned int& hitObject, float& hitDistance, float maxDistance) const
+{
+	if ( m_nodes.empty() ) { return false; }
+
+	// division by zero yields +-inf, which the slab test handles
+	const glm::vec3 invDirection = 1.0f / direction;
+
+	bool hit = false;
+	float closest = maxDistance;
+
+	std::vector<int> stack;
+	stack.reserve(INITIAL_STACK_SIZE);
+	if ( intersectBox(origin, invDirection, m_nodes[0].min, m_nodes[0].max, closest) == FLT_MAX ) { return false; }
+	stack.push_back(0);
+
+	while ( !stack.empty() )
+	{
+		const Node& node = m_nodes[stack.back()];
+		stack.pop_back();
+		if ( node.count > 0 )
+		{
+			for (int i = 0; i < node.count; i++)
+			{
+				unsigned int object = m_objectIndices[node.leftOrFirst + i];
+				float t = intersectBox(origin, invDirection, m_objectMin[object], m_objectMax[object], closest);
+				if ( t != FLT_MAX && (!hit || t < closest) )
+				{
+					closest = t;
+					hitObject = object;
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		int nearChild = node.leftOrFirst;
+		int farChild = node.leftOrFirst + 1;
+		float tNear = intersectBox(origin, invDirection, m_nodes[nearChild].min, m_nodes[nearChild].max, closest);
+		float tFar  = intersectBox(origin, invDirection, m_nodes[farChild].min, m_nodes[farChild].max, closest);
+		if ( tFar < tNear ) { std::swap(nearChild, farChild); std::swap(tNear, tFar); }
+
+		// push the farther child first so the nearer one is visited first
+		if ( tFar != FLT_MAX )  { stack.push_back(farChild); }
+		if ( tNear != FLT_MAX ) { stack.push_back(nearChild); }
+	}
+
+	if ( hit ) { hitDistance = closest; }
+	return hit;
+}
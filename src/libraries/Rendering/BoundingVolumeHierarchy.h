@@ -0,0 +1,72 @@
+#ifndef BOUNDINGVOLUMEHIERARCHY_H
+#define BOUNDINGVOLUMEHIERARCHY_H
+
+#include <vector>
+#include <cfloat>
+#include <glm/glm.hpp>
+
+#include <Rendering/CullingTools.h>
+
+namespace Culling{
+
+/** @brief persistent bounding volume hierarchy over world space object boxes
+ * 
+ * built with binned SAH, objects keep their index, so results refer to the order of the input vector.
+ * Moving objects only requires updateModelMatrix() + refit(), a rebuild is only needed if the tree quality degrades a lot.
+ * Standalone alternative to the linear CullingHelper::cullAgainstFrustum for large scenes, CullingHelper only provides the frustum planes.
+ */
+class BoundingVolumeHierarchy
+{
+public:
+	struct Node
+	{
+		glm::vec3 min;
+		int leftOrFirst; //!< inner node: index of left child (right child follows), leaf: first entry in object index list
+		glm::vec3 max;
+		int count;       //!< number of objects if leaf, 0 for inner nodes
+	};
+
+	BoundingVolumeHierarchy();
+
+	void build(const std::vector<CullingInfo>& objects);
+	void build(const std::vector<AssimpTools::RenderableInfo>& renderables, const std::vector<glm::mat4>& modelMatrices); //!< one matrix per renderable
+
+	void updateModelMatrix(unsigned int object, const glm::mat4& modelMatrix); //!< recomputes the object's world bounds, takes effect on refit()
+	void refit(); //!< updates node bounds of all objects changed since the last refit, bottom up
+
+	/** @brief collect all objects whose box is not outside the frustum of cullingHelper
+	 * 
+	 * subtrees that are completely inside are added without further tests
+	 */
+	void queryFrustum(const CullingHelper& cullingHelper, std::vector<unsigned int>& result) const;
+
+	/** @brief closest object box hit by a ray
+	 * @return true if something was hit, object and distance (in units of direction) are written to hitObject and hitDistance
+	 */
+	bool queryRay(const glm::vec3& origin, const glm::vec3& direction, unsigned int& hitObject, float& hitDistance, float maxDistance = FLT_MAX) const;
+
+	inline unsigned int getNumObjects() const { return (unsigned int) m_objectMin.size(); }
+	inline unsigned int getNumNodes() const { return (unsigned int) m_nodes.size(); }
+	inline const std::vector<Node>& getNodes() const { return m_nodes; }
+
+private:
+	void buildNodes();
+	void subdivide(int nodeIdx);
+	void updateNodeBounds(int nodeIdx);
+
+	std::vector<CullingInfo> m_objects;       //!< local boxes and poses
+	std::vector<glm::vec3> m_objectMin;       //!< world space boxes
+	std::vector<glm::vec3> m_objectMax;
+	std::vector<glm::vec3> m_objectCentroid;  //!< only valid during build
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_parents;               //!< parent per node, -1 for root
+	std::vector<unsigned int> m_objectIndices; //!< leaves reference ranges of this list
+	std::vector<int> m_objectLeaf;            //!< leaf node per object
+
+	std::vector<unsigned int> m_dirtyObjects;
+};
+
+} // namespace Culling
+
+#endif
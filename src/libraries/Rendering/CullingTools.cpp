@@ -1,12 +1,184 @@
 #include "CullingTools.h"
+#include "OcclusionCulling.h"
+
+#include <cfloat>
+#include <algorithm>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define CULLING_USE_AVX
+#endif
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define CULLING_USE_SSE
+#endif
+
+namespace
+{
+	// turns the per-lane masks of a SIMD batch into Visibility values
+	inline void writeVisibility(int outsideMask, int intersectingMask, int numLanes, unsigned char* visibility)
+	{
+		for (int k = 0; k < numLanes; k++)
+		{
+			if ( (outsideMask >> k) & 1 )           { visibility[k] = Culling::CullingHelper::OUTSIDE; }
+			else if ( (intersectingMask >> k) & 1 ) { visibility[k] = Culling::CullingHelper::INTERSECTING; }
+			else                                    { visibility[k] = Culling::CullingHelper::INSIDE; }
+		}
+	}
+
+	// shared by sphere and box tests: a box is a sphere whose radius is its extent projected onto the plane normal
+	void classifyBatch(const glm::vec4* planes, int numPlanes, const Culling::CullingBatch& batch, bool boxes, size_t begin, size_t end, unsigned char* visibility)
+	{
+		size_t i = begin;
+
+#ifdef CULLING_USE_AVX
+		const __m256 signMask8 = _mm256_set1_ps(-0.0f);
+		for (; i + 8 <= end; i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(&batch.centerX[i]);
+			__m256 cy = _mm256_loadu_ps(&batch.centerY[i]);
+			__m256 cz = _mm256_loadu_ps(&batch.centerZ[i]);
+			__m256 ex, ey, ez, r;
+			if (boxes)
+			{
+				ex = _mm256_loadu_ps(&batch.extentX[i]);
+				ey = _mm256_loadu_ps(&batch.extentY[i]);
+				ez = _mm256_loadu_ps(&batch.extentZ[i]);
+			}
+			else
+			{
+				r = _mm256_loadu_ps(&batch.radius[i]);
+			}
+
+			__m256 outside = _mm256_setzero_ps();
+			__m256 intersecting = _mm256_setzero_ps();
+			for (int p = 0; p < numPlanes; p++)
+			{
+				__m256 px = _mm256_set1_ps(planes[p].x);
+				__m256 py = _mm256_set1_ps(planes[p].y);
+				__m256 pz = _mm256_set1_ps(planes[p].z);
+				__m256 d = _mm256_add_ps(
+					_mm256_add_ps(_mm256_mul_ps(px, cx), _mm256_mul_ps(py, cy)),
+					_mm256_add_ps(_mm256_mul_ps(pz, cz), _mm256_set1_ps(planes[p].w)));
+				if (boxes)
+				{
+					r = _mm256_add_ps(
+						_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask8, px), ex), _mm256_mul_ps(_mm256_andnot_ps(signMask8, py), ey)),
+						_mm256_mul_ps(_mm256_andnot_ps(signMask8, pz), ez));
+				}
+				outside      = _mm256_or_ps(outside,      _mm256_cmp_ps(d, _mm256_sub_ps(_mm256_setzero_ps(), r), _CMP_LT_OQ));
+				intersecting = _mm256_or_ps(intersecting, _mm256_cmp_ps(d, r, _CMP_LT_OQ));
+			}
+			writeVisibility(_mm256_movemask_ps(outside), _mm256_movemask_ps(intersecting), 8, &visibility[i]);
+		}
+#endif
+
+#ifdef CULLING_USE_SSE
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(&batch.centerX[i]);
+			__m128 cy = _mm_loadu_ps(&batch.centerY[i]);
+			__m128 cz = _mm_loadu_ps(&batch.centerZ[i]);
+			__m128 ex, ey, ez, r;
+			if (boxes)
+			{
+				ex = _mm_loadu_ps(&batch.extentX[i]);
+				ey = _mm_loadu_ps(&batch.extentY[i]);
+				ez = _mm_loadu_ps(&batch.extentZ[i]);
+			}
+			else
+			{
+				r = _mm_loadu_ps(&batch.radius[i]);
+			}
+
+			__m128 outside = _mm_setzero_ps();
+			__m128 intersecting = _mm_setzero_ps();
+			for (int p = 0; p < numPlanes; p++)
+			{
+				__m128 px = _mm_set1_ps(planes[p].x);
+				__m128 py = _mm_set1_ps(planes[p].y);
+				__m128 pz = _mm_set1_ps(planes[p].z);
+				__m128 d = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)),
+					_mm_add_ps(_mm_mul_ps(pz, cz), _mm_set1_ps(planes[p].w)));
+				if (boxes)
+				{
+					r = _mm_add_ps(
+						_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, px), ex), _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+						_mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+				}
+				outside      = _mm_or_ps(outside,      _mm_cmplt_ps(d, _mm_sub_ps(_mm_setzero_ps(), r)));
+				intersecting = _mm_or_ps(intersecting, _mm_cmplt_ps(d, r));
+			}
+			writeVisibility(_mm_movemask_ps(outside), _mm_movemask_ps(intersecting), 4, &visibility[i]);
+		}
+#endif
+
+		// remainder (or everything, if no SIMD is available)
+		for (; i < end; i++)
+		{
+			int result = Culling::CullingHelper::INSIDE;
+			for (int p = 0; p < numPlanes; p++)
+			{
+				const glm::vec4& plane = planes[p];
+				float d = plane.x * batch.centerX[i] + plane.y * batch.centerY[i] + plane.z * batch.centerZ[i] + plane.w;
+				float r = boxes ? (std::abs(plane.x) * batch.extentX[i] + std::abs(plane.y) * batch.extentY[i] + std::abs(plane.z) * batch.extentZ[i]) : batch.radius[i];
+				if ( d < -r ) { result = Culling::CullingHelper::OUTSIDE; break; }
+				if ( d <  r ) { result = Culling::CullingHelper::INTERSECTING; }
+			}
+			visibility[i] = (unsigned char) result;
+		}
+	}
+
+	void fillCullingBatchRange(const std::vector<Culling::CullingInfo>& instances, Culling::CullingBatch& batch, size_t begin, size_t end)
+	{
+		glm::vec3 center;
+		glm::vec3 extent;
+		float radius;
+		for (size_t i = begin; i < end; i++)
+		{
+			Culling::getWorldSpaceBounds(instances[i], center, extent, radius);
+			batch.centerX[i] = center.x;
+			batch.centerY[i] = center.y;
+			batch.centerZ[i] = center.z;
+			batch.extentX[i] = extent.x;
+			batch.extentY[i] = extent.y;
+			batch.extentZ[i] = extent.z;
+			batch.radius[i]  = radius;
+		}
+	}
+}
+
+static const size_t MIN_INSTANCES_PER_THREAD = 2048; //!< below this, waking workers costs more than it saves
+static const unsigned int MAX_CULLING_THREADS = 8;
 
 Culling::CullingHelper::CullingHelper(Camera* camera)
-	: m_camera(camera)
+	: m_camera(camera),
+	m_occlusionPyramid(nullptr),
+	m_workerGeneration(0),
+	m_workersPending(0),
+	m_workerPhase(CLASSIFY_CHUNK),
+	m_workersShutdown(false),
+	m_numThreads(1),
+	m_chunkInstances(nullptr),
+	m_chunkTarget(nullptr),
+	m_numChunks(1),
+	m_chunkSize(0)
 {
+	// until a frustum is known, every plane accepts everything
+	for (int p = 0; p < Frustum::NUM_PLANES; p++)
+	{
+		m_frustum.planes[p] = glm::vec4(0.0f, 0.0f, 0.0f, FLT_MAX);
+	}
+	updateFrustum();
+
+	setNumThreads( std::thread::hardware_concurrency() ); // the workers are started by the first call that needs them
 }
 
 Culling::CullingHelper::~CullingHelper()
 {
+	stopWorkers();
 }
 
 std::pair<Renderable*, Culling::CullingInfo> Culling::getCullingInfo(const AssimpTools::RenderableInfo& renderable, const glm::mat4& modelMatrix)
@@ -27,7 +199,8 @@ std::vector<std::pair<Renderable*, Culling::CullingInfo> > Culling::getCullingIn
 {
 	std::vector<std::pair<Renderable*, CullingInfo>> result;
 
-	for (auto r : renderables)
+	result.reserve(renderables.size());
+	for (const auto& r : renderables)
 	{
 		result.push_back( getCullingInfo( r, modelMatrix ) );	
 	}
@@ -50,118 +223,423 @@ std::vector<std::pair<Renderable*, Culling::CullingInfo> > Culling::getCullingIn
 		DEBUGLOG->log("WARNING: fewer matrices than renderables, matrices will be reused using modulo");
 	}
 
+	result.reserve(renderables.size());
 	unsigned int i = 0;
-	for (auto r : renderables)
+	for (const auto& r : renderables)
 	{
-		result.push_back( getCullingInfo( r, modelMatrices.at(i) ) );	
+		result.push_back( getCullingInfo( r, modelMatrices[i] ) );	
 		
-		i = (i++) % modelMatrices.size();
+		i = (i + 1) % modelMatrices.size();
 	}
 
 	return result;
 }
 
-std::vector<Renderable* > Culling::CullingHelper::cullAgainstFrustum( const std::vector<std::pair<Renderable*, Culling::CullingInfo> >& renderables )
+void Culling::CullingBatch::resize(size_t size)
+{
+	centerX.resize(size);
+	centerY.resize(size);
+	centerZ.resize(size);
+	extentX.resize(size);
+	extentY.resize(size);
+	extentZ.resize(size);
+	radius.resize(size);
+}
+
+void Culling::getWorldSpaceBounds(const CullingInfo& info, glm::vec3& center, glm::vec3& extent, float& radius)
+{
+	const glm::mat4& m = info.modelMatrix;
+	glm::vec3 localCenter = 0.5f * (info.boundingBox.max + info.boundingBox.min);
+	glm::vec3 localExtent = 0.5f * (info.boundingBox.max - info.boundingBox.min);
+
+	center = glm::vec3(m * glm::vec4(localCenter, 1.0f));
+
+	// extent of the transformed box projected onto the world axes
+	extent = glm::abs(glm::vec3(m[0])) * localExtent.x
+		   + glm::abs(glm::vec3(m[1])) * localExtent.y
+		   + glm::abs(glm::vec3(m[2])) * localExtent.z;
+
+	float maxScale = glm::max( glm::length(glm::vec3(m[0])), glm::max( glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])) ) );
+	radius = info.boundingRadius * maxScale;
+}
+
+void Culling::fillCullingBatch(const std::vector<CullingInfo>& instances, CullingBatch& batch)
+{
+	batch.resize(instances.size());
+	fillCullingBatchRange(instances, batch, 0, instances.size());
+}
+
+void Culling::extractFrustumPlanes(const glm::mat4& m, glm::vec4 planes[6])
+{
+	// Gribb / Hartmann: planes are sums and differences of the rows of the view-projection matrix (glm is column major)
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	planes[0] = row3 + row0; // left
+	planes[1] = row3 - row0; // right
+	planes[2] = row3 + row1; // bottom
+	planes[3] = row3 - row1; // top
+	planes[4] = row3 + row2; // near
+	planes[5] = row3 - row2; // far
+
+	for (int p = 0; p < 6; p++)
+	{
+		float length = glm::length(glm::vec3(planes[p]));
+		if (length > 0.0f)
+		{
+			planes[p] /= length;
+		}
+	}
+}
+
+std::vector<Renderable* > Culling::CullingHelper::cullAgainstFrustum( const std::vector<std::pair<Renderable*, Culling::CullingInfo> >& renderables, std::vector<std::pair<Renderable*, Culling::CullingInfo> >* visible )
 {
 	std::vector<Renderable* > result;	
-	if ( m_camera == nullptr)
+	if ( visible != nullptr ) { visible->clear(); }
+	if ( m_camera != nullptr)
 	{
-		DEBUGLOG->log("WARNING: no camera info. No renderables will be culled.");
-		for ( auto e : renderables ) {result.push_back(e.first);}
-		return result;
+		updateFrustum();
 	}
 
-	for ( auto e : renderables )
+	glm::vec3 center;
+	glm::vec3 extent;
+	float radius;
+	for ( const auto& e : renderables )
 	{
-		int visibility = OUTSIDE;
+		getWorldSpaceBounds(e.second, center, extent, radius);
+
+		int visibility = sphereInFrustum ( center, radius );
 		
-		glm::vec3 sphereCenter = glm::vec3(e.second.modelMatrix[3]) + (e.second.boundingBox.min + 0.5f * (e.second.boundingBox.max - e.second.boundingBox.min)); 
-		int sphereVisibility = sphereInFrustum ( sphereCenter, e.second.boundingRadius );
-		if ( sphereVisibility != OUTSIDE )
+		if ( visibility == INTERSECTING ) // sphere is only a coarse estimate, try the box
 		{
-			visibility = sphereVisibility;
+			visibility = boxInFrustum( center - extent, center + extent );
 		}
-		
-		if ( sphereVisibility == INTERSECTING )
+
+		if ( visibility != OUTSIDE)
 		{
+			result.push_back(e.first);
+			if ( visible != nullptr ) { visible->push_back(e); }
+		}
+	}
+
+	return result;
+}
+
+std::vector<glm::mat4 > Culling::CullingHelper::cullAgainstFrustum( const std::vector< Culling::CullingInfo>& instances )
+{
+	std::vector<glm::mat4 > result(instances.size());
+	if ( instances.empty() ) { return result; }
+
+	unsigned int numVisible = cullAgainstFrustum(instances, &result[0]);
+	result.resize(numVisible);
+	return result;
+}
+
+unsigned int Culling::CullingHelper::cullAgainstFrustum( const std::vector< Culling::CullingInfo>& instances, glm::mat4* visibleMatrices )
+{
+	if ( instances.empty() ) { return 0; }
+	if ( m_camera != nullptr)
+	{
+		updateFrustum();
+	}
+
+	// only grows, so steady instance counts do not allocate
+	m_batch.resize(instances.size());
+	m_visibility.resize(instances.size());
+
+	m_chunkInstances = &instances;
+	m_chunkTarget = visibleMatrices;
+	m_numChunks = (unsigned int) std::min<size_t>( getNumThreads(), std::max<size_t>(1, instances.size() / MIN_INSTANCES_PER_THREAD) );
+	m_chunkSize = (instances.size() + m_numChunks - 1) / m_numChunks;
+	m_chunkSize = (m_chunkSize + 7) & ~((size_t) 7); // keep chunk borders on full SIMD lanes
+	if ( m_numChunks > 1 && m_workers.empty() ) { startWorkers(); }
+
+	// 1. classify and count visible instances per chunk
+	runChunks(CLASSIFY_CHUNK);
+
+	// 2. chunk offsets into target buffer
+	unsigned int numVisible = 0;
+	for (unsigned int c = 0; c < m_numChunks; c++)
+	{
+		m_chunkOffset[c] = numVisible;
+		numVisible += m_chunkVisible[c];
+	}
 
+	// 3. copy visible matrices to their final position
+	runChunks(COMPACT_CHUNK);
+
+	m_chunkInstances = nullptr;
+	m_chunkTarget = nullptr;
+	return numVisible;
+}
+
+void Culling::CullingHelper::processChunk(unsigned int chunk, int phase)
+{
+	const std::vector<CullingInfo>& instances = *m_chunkInstances;
+	size_t begin = std::min(chunk * m_chunkSize, instances.size());
+	size_t end   = std::min(begin + m_chunkSize, instances.size());
+
+	if (phase == CLASSIFY_CHUNK)
+	{
+		fillCullingBatchRange(instances, m_batch, begin, end);
+		classifyBatch(m_frustum.planes, Frustum::NUM_PLANES, m_batch, false, begin, end, &m_visibility[0]);
+
+		unsigned int numVisible = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			if ( m_visibility[i] == INTERSECTING ) // sphere is only a coarse estimate, try the box
+			{
+				glm::vec3 center(m_batch.centerX[i], m_batch.centerY[i], m_batch.centerZ[i]);
+				glm::vec3 extent(m_batch.extentX[i], m_batch.extentY[i], m_batch.extentZ[i]);
+				m_visibility[i] = (unsigned char) boxInFrustum( center - extent, center + extent );
+			}
+			if ( m_visibility[i] != OUTSIDE ) { numVisible++; }
 		}
+		m_chunkVisible[chunk] = numVisible;
+	}
+	else if (phase == COMPACT_CHUNK)
+	{
+		glm::mat4* target = m_chunkTarget + m_chunkOffset[chunk];
+		for (size_t i = begin; i < end; i++)
+		{
+			if ( m_visibility[i] != OUTSIDE )
+			{
+				*target = instances[i].modelMatrix;
+				target++;
+			}
+		}
+	}
+}
 
-		if ( visibility != OUTSIDE)
+void Culling::CullingHelper::runChunks(int phase)
+{
+	if (m_numChunks > 1)
+	{
+		std::unique_lock<std::mutex> lock(m_workerMutex);
+		m_workerPhase = phase;
+		m_workersPending = m_numChunks - 1;
+		m_workerGeneration++;
+		m_workerWake.notify_all();
+	}
+
+	processChunk(0, phase);
+
+	if (m_numChunks > 1)
+	{
+		std::unique_lock<std::mutex> lock(m_workerMutex);
+		m_workerDone.wait(lock, [&](){ return m_workersPending == 0; });
+	}
+}
+
+void Culling::CullingHelper::workerLoop(unsigned int chunk, unsigned int generation)
+{
+	while (true)
+	{
+		int phase;
+		bool participates;
 		{
-			result.push_back(e.first);
+			std::unique_lock<std::mutex> lock(m_workerMutex);
+			m_workerWake.wait(lock, [&](){ return m_workersShutdown || m_workerGeneration != generation; });
+			if (m_workersShutdown) { return; }
+			generation = m_workerGeneration;
+			phase = m_workerPhase;
+			participates = chunk < m_numChunks;
 		}
 
+		if ( !participates ) { continue; } // fewer chunks than threads this time
+
+		processChunk(chunk, phase);
+
+		{
+			std::unique_lock<std::mutex> lock(m_workerMutex);
+			m_workersPending--;
+			if (m_workersPending == 0) { m_workerDone.notify_one(); }
+		}
 	}
+}
 
+void Culling::CullingHelper::setNumThreads(unsigned int numThreads)
+{
+	m_numThreads = std::max(1u, std::min(numThreads, MAX_CULLING_THREADS));
+	stopWorkers();
 
-	return result;
+	m_chunkVisible.resize(m_numThreads, 0);
+	m_chunkOffset.resize(m_numThreads, 0);
 }
 
-std::vector<glm::mat4 > Culling::CullingHelper::cullAgainstFrustum( const std::vector< Culling::CullingInfo>& instances )
+void Culling::CullingHelper::startWorkers()
 {
-	std::vector<glm::mat4 > result;
-	if ( m_camera == nullptr)
+	m_workersShutdown = false;
+	for (unsigned int i = 1; i < m_numThreads; i++)
 	{
-		DEBUGLOG->log("WARNING: no camera info. No instances will be culled.");
-		for ( auto e : instances ) {result.push_back(e.modelMatrix);}
-		return result;
+		m_workers.push_back( std::thread(&CullingHelper::workerLoop, this, i, m_workerGeneration) ); // a worker may start after the first phase was already dispatched
 	}
-	return result;
+}
+
+void Culling::CullingHelper::stopWorkers()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_workerMutex);
+		m_workersShutdown = true;
+		m_workerWake.notify_all();
+	}
+	for (auto& t : m_workers)
+	{
+		if (t.joinable()) { t.join(); }
+	}
+	m_workers.clear();
 }
 
 std::vector<Renderable* > Culling::CullingHelper::cullOccluded( const std::vector<std::pair<Renderable*, Culling::CullingInfo> >& renderables )
 {
 	std::vector<Renderable* > result;
-	if ( m_camera == nullptr)
+	if ( m_occlusionPyramid == nullptr)
 	{
-		DEBUGLOG->log("WARNING: no camera info. No renderables will be culled.");
+		DEBUGLOG->log("WARNING: no occlusion pyramid. No renderables will be culled.");
 		for ( auto e : renderables ) {result.push_back(e.first);}
 		return result;
 	}
+
+	glm::vec3 center;
+	glm::vec3 extent;
+	float radius;
+	for ( const auto& e : renderables )
+	{
+		getWorldSpaceBounds(e.second, center, extent, radius);
+		if ( !m_occlusionPyramid->isOccluded( center - extent, center + extent ) )
+		{
+			result.push_back(e.first);
+		}
+	}
 	return result;
 }
 
 std::vector<glm::mat4 > Culling::CullingHelper::cullOccluded( const std::vector< Culling::CullingInfo>& instances )
 {
 	std::vector<glm::mat4 > result;	
-	if ( m_camera == nullptr)
+	if ( m_occlusionPyramid == nullptr)
 	{
-		DEBUGLOG->log("WARNING: no camera info. No instances will be culled.");
+		DEBUGLOG->log("WARNING: no occlusion pyramid. No instances will be culled.");
 		for ( auto e : instances ) {result.push_back(e.modelMatrix);}
 		return result;
 	}
+
+	glm::vec3 center;
+	glm::vec3 extent;
+	float radius;
+	for ( const auto& e : instances )
+	{
+		getWorldSpaceBounds(e, center, extent, radius);
+		if ( !m_occlusionPyramid->isOccluded( center - extent, center + extent ) )
+		{
+			result.push_back(e.modelMatrix);
+		}
+	}
 	return result;
 }
 
+void Culling::CullingHelper::setOcclusionPyramid(const DepthPyramid* pyramid)
+{
+	m_occlusionPyramid = pyramid;
+}
+
 void Culling::CullingHelper::setCamera( Camera* camera )
 {
 	m_camera = camera;
 }
 
-int Culling::CullingHelper::sphereInFrustum(glm::vec3 point, float radius)
+void Culling::CullingHelper::updateFrustumShape()
 {
-	if ( m_camera == nullptr)
-	{
-		DEBUGLOG->log("WARNING: no camera info. Returning INSIDE");
-		return INSIDE;
-	}
+	if ( m_camera == nullptr ) { return; }
+
+	m_frustum.projection = m_camera->getProjectionMatrix();
+	extractPlanes( m_frustum.projection * m_frustum.view );
+}
+
+void Culling::CullingHelper::updateFrustumPosition()
+{
+	if ( m_camera == nullptr ) { return; }
 
-	glm::vec4 viewPoint = *(m_camera->getViewMatrixPointer()) * glm::vec4(point, 1.0f);
+	m_frustum.view = m_camera->getViewMatrix();
+	extractPlanes( m_frustum.projection * m_frustum.view );
+}
+
+void Culling::CullingHelper::updateFrustum()
+{
+	if ( m_camera == nullptr ) { return; }
 
-	if (viewPoint.z - radius > 0.0f) // behind camera
+	m_frustum.projection = m_camera->getProjectionMatrix();
+	m_frustum.view = m_camera->getViewMatrix();
+	extractPlanes( m_frustum.projection * m_frustum.view );
+}
+
+void Culling::CullingHelper::setViewProjectionMatrix(const glm::mat4& viewProjection)
+{
+	extractPlanes(viewProjection);
+}
+
+void Culling::CullingHelper::extractPlanes(const glm::mat4& m)
+{
+	extractFrustumPlanes(m, m_frustum.planes);
+}
+
+int Culling::CullingHelper::pointInFrustum(glm::vec3 point)
+{
+	for (int p = 0; p < Frustum::NUM_PLANES; p++)
 	{
-		if ( viewPoint.z - 2.0f * radius > 0.0f ) // full diameter distance to z == 0.0 
+		const glm::vec4& plane = m_frustum.planes[p];
+		if ( glm::dot(glm::vec3(plane), point) + plane.w < 0.0f )
 		{
 			return OUTSIDE;
 		}
-		else
-		{
-			return INTERSECTING;
-		}
 	}
+	return INSIDE;
+}
 
-	// TODO stuff
+int Culling::CullingHelper::boxInFrustum(glm::vec3 min, glm::vec3 max)
+{
+	glm::vec3 center = 0.5f * (max + min);
+	glm::vec3 extent = 0.5f * (max - min);
 
-	return INSIDE;
+	int result = INSIDE;
+	for (int p = 0; p < Frustum::NUM_PLANES; p++)
+	{
+		const glm::vec4& plane = m_frustum.planes[p];
+		float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+		float radius = glm::dot(glm::abs(glm::vec3(plane)), extent); // projected extent onto plane normal
+		
+		if ( distance < -radius ) { return OUTSIDE; }
+		if ( distance <  radius ) { result = INTERSECTING; }
+	}
+	return result;
+}
+
+int Culling::CullingHelper::sphereInFrustum(glm::vec3 point, float radius)
+{
+	int result = INSIDE;
+	for (int p = 0; p < Frustum::NUM_PLANES; p++)
+	{
+		const glm::vec4& plane = m_frustum.planes[p];
+		float distance = glm::dot(glm::vec3(plane), point) + plane.w;
+		
+		if ( distance < -radius ) { return OUTSIDE; }
+		if ( distance <  radius ) { result = INTERSECTING; }
+	}
+	return result;
+}
+
+void Culling::CullingHelper::spheresInFrustum(const CullingBatch& batch, std::vector<unsigned char>& visibility)
+{
+	visibility.resize(batch.size());
+	if ( batch.size() == 0 ) { return; }
+	classifyBatch(m_frustum.planes, Frustum::NUM_PLANES, batch, false, 0, batch.size(), &visibility[0]);
+}
+
+void Culling::CullingHelper::boxesInFrustum(const CullingBatch& batch, std::vector<unsigned char>& visibility)
+{
+	visibility.resize(batch.size());
+	if ( batch.size() == 0 ) { return; }
+	classifyBatch(m_frustum.planes, Frustum::NUM_PLANES, batch, true, 0, batch.size(), &visibility[0]);
 }
@@ -1,10 +1,25 @@
+#ifndef CULLINGTOOLS_H
+#define CULLINGTOOLS_H
+
 #include <Rendering/VertexArrayObjects.h>
 #include <Importing/AssimpTools.h>
 #include <Rendering/RenderPass.h>
 #include <Core/Camera.h>
 
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.thread.h>
+	#include <mingw-std-threads/mingw.mutex.h>
+	#include <mingw-std-threads/mingw.condition_variable.h>
+#else
+	#include <thread>
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
 namespace Culling{
 
+class DepthPyramid;
+
 struct CullingInfo
 {
 	AssimpTools::BoundingBox boundingBox; // local space
@@ -12,39 +27,120 @@ struct CullingInfo
 	glm::mat4 modelMatrix; // pose of center
 };
 
+/** @brief world space bounding volumes of many objects in structure-of-arrays layout, so that 4 (SSE) or 8 (AVX) objects can be tested at once */
+struct CullingBatch
+{
+	std::vector<float> centerX; //!< world space center of bounding box / sphere
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX; //!< world space half extent of axis aligned bounding box
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+	std::vector<float> radius;  //!< world space bounding sphere radius
+
+	void resize(size_t size);
+	inline size_t size() const { return radius.size(); }
+};
+
 std::pair<Renderable*, CullingInfo> getCullingInfo(const AssimpTools::RenderableInfo& renderable, const glm::mat4& modelMatrix);
 std::vector<std::pair<Renderable*, CullingInfo> > getCullingInfo(const std::vector<AssimpTools::RenderableInfo>& renderables, const glm::mat4& modelMatrix);
 std::vector<std::pair<Renderable*, CullingInfo> > getCullingInfo(const std::vector<AssimpTools::RenderableInfo>& renderables, const std::vector<glm::mat4> modelMatrices );
 
+void getWorldSpaceBounds(const CullingInfo& info, glm::vec3& center, glm::vec3& extent, float& radius); //!< transforms the local bounding box into a world space AABB (center / half extent) and bounding sphere
+void fillCullingBatch(const std::vector<CullingInfo>& instances, CullingBatch& batch); //!< (re)fills batch with the world space bounds of every instance, reusing its storage
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]); //!< the 6 normalized planes (left, right, bottom, top, near, far), point p is inside if dot(n,p) + d >= 0
+
 class CullingHelper{
 public:
 	CullingHelper(Camera* camera = nullptr);
 	~CullingHelper();
 
-	std::vector<Renderable* > cullAgainstFrustum( const std::vector<std::pair<Renderable*, CullingInfo> >& renderables);
+	/** @param visible if not null, receives the visible entries of renderables, e.g. to pass them on to cullOccluded() */
+	std::vector<Renderable* > cullAgainstFrustum( const std::vector<std::pair<Renderable*, CullingInfo> >& renderables, std::vector<std::pair<Renderable*, CullingInfo> >* visible = nullptr);
 	std::vector<glm::mat4 >   cullAgainstFrustum( const std::vector< CullingInfo>& instances);
 
+	/** @brief cull instances on all culling threads and write the model matrices of visible instances contiguously into visibleMatrices
+	 * 
+	 * visibleMatrices must provide space for instances.size() matrices, e.g. a pre-reserved vector or a mapped instance attribute buffer.
+	 * Internal buffers only grow, so nothing is allocated per frame once they fit the instance count.
+	 * @return number of visible instances written to visibleMatrices
+	 */
+	unsigned int cullAgainstFrustum( const std::vector< CullingInfo>& instances, glm::mat4* visibleMatrices);
+
+	/** @brief remove everything that is hidden according to the occlusion pyramid, see setOcclusionPyramid()
+	 * 
+	 * the pyramid is usually filled from the previous frame's depth by a HiZBuffer, or by a SoftwareRasterizer
+	 */
 	std::vector<Renderable* > cullOccluded( const std::vector<std::pair<Renderable*, CullingInfo> >& renderables);
 	std::vector<glm::mat4 > cullOccluded( const std::vector< CullingInfo>& instances);
+	void setOcclusionPyramid(const DepthPyramid* pyramid);
 
 	void setCamera(Camera* camera);
+	void setNumThreads(unsigned int numThreads); //!< threads used for instance culling, including the calling thread, workers are started on the first batch large enough to split
+	inline unsigned int getNumThreads() const { return m_numThreads; }
 
 	enum Visibility {OUTSIDE = 0, INTERSECTING, INSIDE};
 	int pointInFrustum(glm::vec3 point);
 	int boxInFrustum(glm::vec3 min, glm::vec3 max);
 	int sphereInFrustum(glm::vec3 point, float radius);
 
-	void updateFrustumShape();
-	void updateFrustumPosition();
+	/** @brief classify every object of a batch against the current frustum
+	 * 
+	 * uses AVX (if compiled with it) or SSE for 8 / 4 objects at once, remaining objects are tested one by one
+	 * @param batch world space bounds
+	 * @param visibility will be resized to batch.size() and hold one Visibility value per object
+	 */
+	void spheresInFrustum(const CullingBatch& batch, std::vector<unsigned char>& visibility);
+	void boxesInFrustum(const CullingBatch& batch, std::vector<unsigned char>& visibility);
+
+	void updateFrustumShape();    //!< read projection matrix from camera
+	void updateFrustumPosition(); //!< read view matrix from camera
 	void updateFrustum(); // both of above
+	void setViewProjectionMatrix(const glm::mat4& viewProjection); //!< extract frustum planes directly, e.g. for cameras that are not Camera objects
+	inline const glm::vec4* getFrustumPlanes() const { return m_frustum.planes; } //!< the 6 normalized planes (left, right, bottom, top, near, far) as of the last update
 
 protected:
 	Camera* m_camera;
+	const DepthPyramid* m_occlusionPyramid;
 
 	struct Frustum
 	{
-
+		enum Plane {LEFT = 0, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE, NUM_PLANES};
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec4 planes[NUM_PLANES]; //!< normalized (n.x, n.y, n.z, d), point p is inside if dot(n,p) + d >= 0
 	} m_frustum;
 
+	void extractPlanes(const glm::mat4& viewProjection);
+
+	CullingBatch m_batch; //!< reused storage for cullAgainstFrustum
+	std::vector<unsigned char> m_visibility;
+
+	// instance culling is split into chunks, the calling thread takes chunk 0, worker i takes chunk i+1
+	enum ChunkPhase {CLASSIFY_CHUNK = 0, COMPACT_CHUNK};
+	void processChunk(unsigned int chunk, int phase);
+	void runChunks(int phase);
+	void workerLoop(unsigned int chunk, unsigned int generation); // generation: value of m_workerGeneration when the worker was created
+	void startWorkers();
+	void stopWorkers();
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_workerMutex;
+	std::condition_variable m_workerWake;
+	std::condition_variable m_workerDone;
+	unsigned int m_workerGeneration;  //!< incremented for every phase dispatched to the workers
+	unsigned int m_workersPending;    //!< workers that have not yet finished the current phase
+	int  m_workerPhase;
+	bool m_workersShutdown;
+	unsigned int m_numThreads;        //!< including the calling thread, m_workers is empty until the first split cull
+
+	const std::vector<CullingInfo>* m_chunkInstances; //!< job of the current cullAgainstFrustum call
+	glm::mat4* m_chunkTarget;
+	unsigned int m_numChunks;
+	size_t m_chunkSize;
+	std::vector<unsigned int> m_chunkVisible; //!< visible instances per chunk
+	std::vector<unsigned int> m_chunkOffset;  //!< write offset per chunk into target buffer
 };
-} // namespace Culling
\ No newline at end of file
+} // namespace Culling
+
+#endif
@@ -2,11 +2,12 @@
 
 #include "Core/DebugLog.h"
 #include "Rendering/OpenGLContext.h"
+#include "Rendering/GLResources.h"
 
 GLenum FrameBufferObject::s_internalFormat  = GL_RGBA;	// default
 GLenum FrameBufferObject::s_format 			= GL_RGBA;	// default
 GLenum FrameBufferObject::s_type 			= GL_UNSIGNED_BYTE;	// default
-bool FrameBufferObject::s_useTexStorage2D	= false;	// default
+bool FrameBufferObject::s_useTexStorage2D	= true;	// default
 
 FrameBufferObject::FrameBufferObject(int width, int height)
 {
@@ -25,13 +26,11 @@ void FrameBufferObject::createDepthTexture()
 {
 	OPENGLCONTEXT->bindFBO(m_frameBufferHandle);
 
-	glGenTextures(1, &m_depthTextureHandle);
-	OPENGLCONTEXT->bindTexture(m_depthTextureHandle);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_width, m_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	m_depthTextureHandle = GLResources::createTexture2D(GL_DEPTH_COMPONENT24, m_width, m_height);
+	GLResources::setTextureParameter(m_depthTextureHandle, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	GLResources::setTextureParameter(m_depthTextureHandle, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	GLResources::setTextureParameter(m_depthTextureHandle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	GLResources::setTextureParameter(m_depthTextureHandle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTextureHandle, 0);
 
 	OPENGLCONTEXT->bindFBO(0);
@@ -40,26 +39,23 @@ void FrameBufferObject::createDepthTexture()
 GLuint FrameBufferObject::createFramebufferTexture()
 {
 	GLuint textureHandle;
-	glGenTextures(1, &textureHandle);
-	OPENGLCONTEXT->bindTexture(textureHandle);
-
 	if ( s_useTexStorage2D )
 	{
-		// for testing purposes
-		glTexStorage2D(GL_TEXTURE_2D, 1, s_internalFormat, m_width, m_height);	
+		textureHandle = GLResources::createTexture2D(GLResources::getSizedInternalFormat(s_internalFormat), m_width, m_height, 1);
 	}
 	else
 	{
+		glGenTextures(1, &textureHandle);
+		OPENGLCONTEXT->bindTexture(textureHandle);
 		glTexImage2D(GL_TEXTURE_2D, 0, s_internalFormat, m_width, m_height, 0, s_format, s_type, 0);	
 	}
 	
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-	OPENGLCONTEXT->bindTexture(0);
+	GLResources::setTextureParameter(textureHandle, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	GLResources::setTextureParameter(textureHandle, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	GLResources::setTextureParameter(textureHandle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	GLResources::setTextureParameter(textureHandle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GLResources::setTextureParameter(textureHandle, GL_TEXTURE_BASE_LEVEL, 0);
+	GLResources::setTextureParameter(textureHandle, GL_TEXTURE_MAX_LEVEL, 0);
 	return textureHandle;
 }
 
@@ -78,9 +74,8 @@ void FrameBufferObject::addColorAttachments(int amount)
 		{
 			GLuint textureHandle = createFramebufferTexture();
 			
-			OPENGLCONTEXT->bindTexture(textureHandle);
+			// attaching does not require the texture to be bound
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + m_numColorAttachments + i, GL_TEXTURE_2D, textureHandle, 0);
-			OPENGLCONTEXT->bindTexture(0);
 			
 			m_colorAttachments[GL_COLOR_ATTACHMENT0 + m_numColorAttachments + i] = textureHandle;
 			m_drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + m_numColorAttachments + i);
@@ -95,12 +90,9 @@ void FrameBufferObject::addColorAttachments(int amount)
 
 void FrameBufferObject::setColorAttachmentTextureHandle( GLenum attachment, GLuint textureHandle )
 {
-	OPENGLCONTEXT->bindTexture(textureHandle);
-	int width, height;
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+	glm::ivec2 size = GLResources::getTextureSize(textureHandle);
 
-	if (  width != m_width || height != m_height )
+	if (  size.x != m_width || size.y != m_height )
 	{
 		DEBUGLOG->log("ERROR : size of texture differs from frame buffer size");
 		return;
@@ -113,9 +105,7 @@ void FrameBufferObject::setColorAttachmentTextureHandle( GLenum attachment, GLui
 		m_colorAttachments[ attachment ] = textureHandle;
 		OPENGLCONTEXT->bindFBO(m_frameBufferHandle);
 		
-		OPENGLCONTEXT->bindTexture(textureHandle);
 		glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, textureHandle, 0);
-		OPENGLCONTEXT->bindTexture(0);
 	}
 	else
 	{
@@ -29,7 +29,7 @@ public:
 
 	static GLenum s_internalFormat; //!< used as parameter to allocate color attachment texture memory
 	static GLenum s_format; //!< used as parameter to allocate color attachment texture memory using glTexImage2D
-	static bool s_useTexStorage2D; //!< describes whether glTexStorage2D is used in favor of glTexImage2D (default: false)
+	static bool s_useTexStorage2D; //!< describes whether immutable storage (see GLResources) is used in favor of glTexImage2D (default: true), unsized formats are mapped to sized ones
 	static GLenum s_type; //!< used as parameter to allocate color attachment texture memory using glTexImage2D
 
 	FrameBufferObject(int width = 800, int height = 600); //!< creates a fbo containing a depth buffer but no color attachments
@@ -0,0 +1,241 @@
+#include "GLResources.h"
+
+#include <algorithm>
+
+#include <Rendering/OpenGLContext.h>
+
+namespace
+{
+	/// client format and type that glTexImage2D accepts together with a sized internal format when no data is given
+	void getAllocationFormat(GLenum internalFormat, GLenum& format, GLenum& type)
+	{
+		switch (internalFormat)
+		{
+		case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32: case GL_DEPTH_COMPONENT32F:
+			format = GL_DEPTH_COMPONENT; type = GL_FLOAT; break;
+		case GL_DEPTH24_STENCIL8:
+			format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; break;
+		case GL_DEPTH32F_STENCIL8:
+			format = GL_DEPTH_STENCIL; type = GL_FLOAT_32_UNSIGNED_INT_24_8_REV; break;
+		case GL_R32UI: case GL_RG32UI: case GL_RGBA32UI: case GL_R16UI: case GL_R8UI:
+			format = GL_RED_INTEGER; type = GL_UNSIGNED_INT; break;
+		case GL_R32I: case GL_RG32I: case GL_RGBA32I: case GL_R16I: case GL_R8I:
+			format = GL_RED_INTEGER; type = GL_INT; break;
+		default:
+			format = GL_RGBA; type = GL_UNSIGNED_BYTE; break;
+		}
+	}
+
+	bool hasBufferStorage() { return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage; }
+	bool hasTextureStorage() { return GLEW_VERSION_4_2 || GLEW_ARB_texture_storage; }
+}
+
+bool GLResources::isDSASupported()
+{
+	static const bool supported = GLEW_VERSION_4_5 || GLEW_ARB_direct_state_access;
+	return supported;
+}
+
+GLuint GLResources::createBuffer(GLsizeiptr size, const void* data, GLbitfield flags)
+{
+	GLuint buffer = 0;
+	if ( isDSASupported() )
+	{
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, size, data, flags);
+		return buffer;
+	}
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if ( hasBufferStorage() )
+	{
+		glBufferStorage(GL_COPY_WRITE_BUFFER, size, data, flags);
+	}
+	else
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, size, data, (flags & GL_DYNAMIC_STORAGE_BIT) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	return buffer;
+}
+
+void GLResources::updateBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	if ( isDSASupported() )
+	{
+		glNamedBufferSubData(buffer, offset, size, data);
+		return;
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GLuint GLResources::createVertexArray()
+{
+	GLuint vao = 0;
+	if ( isDSASupported() ) { glCreateVertexArrays(1, &vao); }
+	else { glGenVertexArrays(1, &vao); }
+	return vao;
+}
+
+void GLResources::setVertexAttribute(GLuint vao, GLuint attributeIndex, GLuint buffer, GLint dimensions, GLenum type, bool isInteger, bool normalized, GLsizei stride, GLuint offset)
+{
+	if ( isDSASupported() )
+	{
+		if ( stride == 0 )
+		{
+			GLsizei typeSize = 4;
+			if ( type == GL_BYTE || type == GL_UNSIGNED_BYTE ) { typeSize = 1; }
+			else if ( type == GL_SHORT || type == GL_UNSIGNED_SHORT || type == GL_HALF_FLOAT ) { typeSize = 2; }
+			else if ( type == GL_DOUBLE ) { typeSize = 8; }
+			bool isPacked = ( type == GL_INT_2_10_10_10_REV || type == GL_UNSIGNED_INT_2_10_10_10_REV ); // all components in 4 bytes
+			stride = isPacked ? 4 : dimensions * typeSize;
+		}
+
+		// one binding point per attribute, like glVertexAttribPointer does implicitly
+		glVertexArrayVertexBuffer(vao, attributeIndex, buffer, offset, stride);
+		if ( isInteger ) { glVertexArrayAttribIFormat(vao, attributeIndex, dimensions, type, 0); }
+		else { glVertexArrayAttribFormat(vao, attributeIndex, dimensions, type, normalized ? GL_TRUE : GL_FALSE, 0); }
+		glVertexArrayAttribBinding(vao, attributeIndex, attributeIndex);
+		glEnableVertexArrayAttrib(vao, attributeIndex);
+		return;
+	}
+
+	OPENGLCONTEXT->bindVAO(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if ( isInteger ) { glVertexAttribIPointer(attributeIndex, dimensions, type, stride, (GLvoid*) (size_t) offset); }
+	else { glVertexAttribPointer(attributeIndex, dimensions, type, normalized ? GL_TRUE : GL_FALSE, stride, (GLvoid*) (size_t) offset); }
+	glEnableVertexAttribArray(attributeIndex);
+}
+
+void GLResources::setIndexBuffer(GLuint vao, GLuint buffer)
+{
+	if ( isDSASupported() )
+	{
+		glVertexArrayElementBuffer(vao, buffer);
+		return;
+	}
+
+	OPENGLCONTEXT->bindVAO(vao);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+}
+
+GLuint GLResources::createTexture2D(GLenum internalFormat, int width, int height, int levels)
+{
+	if ( levels <= 0 ) { levels = getNumMipmapLevels(width, height); }
+
+	GLuint texture = 0;
+	if ( isDSASupported() )
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+		glTextureStorage2D(texture, levels, internalFormat, width, height);
+		return texture;
+	}
+
+	glGenTextures(1, &texture);
+	OPENGLCONTEXT->bindTexture(texture);
+	if ( hasTextureStorage() )
+	{
+		glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+	}
+	else
+	{
+		GLenum format, type;
+		getAllocationFormat(internalFormat, format, type);
+		for (int level = 0; level < levels; level++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, internalFormat, std::max(1, width >> level), std::max(1, height >> level), 0, format, type, NULL);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+	return texture;
+}
+
+void GLResources::uploadTexture2D(GLuint texture, int level, int width, int height, GLenum format, GLenum type, const void* data)
+{
+	if ( isDSASupported() )
+	{
+		glTextureSubImage2D(texture, level, 0, 0, width, height, format, type, data);
+		return;
+	}
+
+	OPENGLCONTEXT->bindTexture(texture);
+	glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, format, type, data);
+}
+
+void GLResources::uploadCompressedTexture2D(GLuint texture, int level, int width, int height, GLenum internalFormat, GLsizei imageSize, const void* data)
+{
+	if ( isDSASupported() )
+	{
+		glCompressedTextureSubImage2D(texture, level, 0, 0, width, height, internalFormat, imageSize, data);
+		return;
+	}
+
+	OPENGLCONTEXT->bindTexture(texture);
+	glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, internalFormat, imageSize, data);
+}
+
+void GLResources::setTextureParameter(GLuint texture, GLenum parameter, GLint value, GLenum target)
+{
+	if ( isDSASupported() )
+	{
+		glTextureParameteri(texture, parameter, value);
+		return;
+	}
+
+	OPENGLCONTEXT->bindTexture(texture, target);
+	glTexParameteri(target, parameter, value);
+}
+
+void GLResources::generateMipmap(GLuint texture, GLenum target)
+{
+	if ( isDSASupported() )
+	{
+		glGenerateTextureMipmap(texture);
+		return;
+	}
+
+	OPENGLCONTEXT->bindTexture(texture, target);
+	glGenerateMipmap(target);
+}
+
+glm::ivec2 GLResources::getTextureSize(GLuint texture, int level, GLenum target)
+{
+	glm::ivec2 size(0);
+	if ( isDSASupported() )
+	{
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_WIDTH, &size.x);
+		glGetTextureLevelParameteriv(texture, level, GL_TEXTURE_HEIGHT, &size.y);
+		return size;
+	}
+
+	OPENGLCONTEXT->bindTexture(texture, target);
+	glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &size.x);
+	glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &size.y);
+	return size;
+}
+
+int GLResources::getNumMipmapLevels(int width, int height)
+{
+	int levels = 1;
+	int size = std::max(width, height);
+	while ( size > 1 ) { size >>= 1; levels++; }
+	return levels;
+}
+
+GLenum GLResources::getSizedInternalFormat(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_RED:  return GL_R8;
+	case GL_RG:   return GL_RG8;
+	case GL_RGB:  return GL_RGB8;
+	case GL_RGBA: return GL_RGBA8;
+	case GL_DEPTH_COMPONENT: return GL_DEPTH_COMPONENT24;
+	case GL_DEPTH_STENCIL:   return GL_DEPTH24_STENCIL8;
+	default: return internalFormat;
+	}
+}
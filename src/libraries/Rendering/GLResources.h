@@ -0,0 +1,50 @@
+#ifndef GLRESOURCES_H
+#define GLRESOURCES_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/** @brief creation and editing of buffers, vertex arrays and textures without binding them (direct state access)
+ *
+ * with OpenGL 4.5 / ARB_direct_state_access every function works on the object name directly, so neither the OpenGLContext cache
+ * nor the currently bound VAO, texture or buffer is disturbed. Storage is immutable by default (glNamedBufferStorage, glTextureStorage2D).
+ * On older contexts the same functions fall back to binding through the OpenGLContext: buffers are edited through GL_COPY_WRITE_BUFFER,
+ * which no VAO or draw call depends on, and immutable storage is used where ARB_buffer_storage / ARB_texture_storage exist.
+ */
+namespace GLResources {
+
+	bool isDSASupported(); //!< queried once, whether the direct state access path is used
+
+	/** @brief create a buffer with immutable storage
+	 * @param flags storage flags, GL_DYNAMIC_STORAGE_BIT (default) allows later glBufferSubData/updateBuffer calls
+	 */
+	GLuint createBuffer(GLsizeiptr size, const void* data, GLbitfield flags = GL_DYNAMIC_STORAGE_BIT);
+	void updateBuffer(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data); //!< buffer must have GL_DYNAMIC_STORAGE_BIT
+
+	GLuint createVertexArray();
+
+	/** @brief source an attribute from buffer, each attribute uses the binding point of the same index
+	 * @param isInteger use the I variant, values stay integers in the shader
+	 * @param normalized fixed point values are mapped to [-1,1] or [0,1]
+	 * @param stride 0 for tightly packed
+	 * @param offset byte offset of the first element, e.g. within an interleaved vertex
+	 */
+	void setVertexAttribute(GLuint vao, GLuint attributeIndex, GLuint buffer, GLint dimensions, GLenum type = GL_FLOAT, bool isInteger = false, bool normalized = false, GLsizei stride = 0, GLuint offset = 0);
+	void setIndexBuffer(GLuint vao, GLuint buffer); //!< sets the element array buffer of the VAO
+
+	/** @brief create a 2D texture with immutable storage
+	 * @param internalFormat must be sized, see getSizedInternalFormat()
+	 * @param levels number of mipmap levels, 0 for a full chain
+	 */
+	GLuint createTexture2D(GLenum internalFormat, int width, int height, int levels = 1);
+	void uploadTexture2D(GLuint texture, int level, int width, int height, GLenum format, GLenum type, const void* data); //!< at offset 0,0
+	void uploadCompressedTexture2D(GLuint texture, int level, int width, int height, GLenum internalFormat, GLsizei imageSize, const void* data); //!< whole level of a texture with compressed internal format
+	void setTextureParameter(GLuint texture, GLenum parameter, GLint value, GLenum target = GL_TEXTURE_2D);
+	void generateMipmap(GLuint texture, GLenum target = GL_TEXTURE_2D);
+	glm::ivec2 getTextureSize(GLuint texture, int level = 0, GLenum target = GL_TEXTURE_2D);
+
+	int getNumMipmapLevels(int width, int height); //!< levels of a full chain down to 1x1
+	GLenum getSizedInternalFormat(GLenum internalFormat); //!< e.g. GL_RGBA -> GL_RGBA8, sized formats are returned as is
+}
+
+#endif
@@ -1,6 +1,10 @@
 #include "GLTools.h"
 
+#include <Rendering/Benchmark.h>
+#include <Rendering/ShaderProgram.h>
+
 static bool g_initialized = false;
+static const float SHADER_POLL_INTERVAL = 1.0f; //!< seconds between checks for modified shader files
 static glm::vec2 g_mainWindowSize = glm::vec2(0,0);
 
 GLFWwindow* generateWindow(int width, int height, int posX, int posY) {
@@ -16,6 +20,7 @@ GLFWwindow* generateWindow(int width, int height, int posX, int posY) {
 		glewExperimental = GL_TRUE;
 		#endif
 	}
+	Benchmark::applyWindowHints();
 	
 	GLFWwindow* window = glfwCreateWindow(width, height, "OpenGL Window", NULL, NULL);
 	glfwSetWindowPos(window, posX, posY);
@@ -34,6 +39,10 @@ GLFWwindow* generateWindow(int width, int height, int posX, int posY) {
 
 		g_initialized = true;
 	}
+	if (Benchmark::isEnabled())
+	{
+		Benchmark::configureContext();
+	}
 
 //	registerDefaultGLFWCallbacks(window);
 
@@ -66,9 +75,26 @@ void destroyWindow(GLFWwindow* window)
 }
 
 void render(GLFWwindow* window, std::function<void (double)> loop) {
+	if (Benchmark::isEnabled())
+	{
+		Benchmark::run(window, loop); // fixed number of frames, then the window is closed
+		glfwSetWindowShouldClose(window, GL_TRUE);
+		return;
+	}
+
 	float lastTime = 0.0;
+	float lastShaderPoll = 0.0;
 	while ( !glfwWindowShouldClose(window)) {
 		float currentTime =static_cast<float>(glfwGetTime());
+
+		// hot reload, not in benchmarks so their frames stay comparable
+		if ( currentTime - lastShaderPoll >= SHADER_POLL_INTERVAL )
+		{
+			int numReloaded = ShaderProgram::reloadChangedPrograms();
+			if ( numReloaded > 0 ) { DEBUGLOG->log("shader programs reloaded: ", numReloaded); }
+			lastShaderPoll = currentTime;
+		}
+
 		loop(currentTime - lastTime);
 		lastTime = currentTime;
 
@@ -286,4 +312,24 @@ void copyFBOContent(GLuint source, GLuint target, glm::vec2 sourceResolution, gl
 		0,0, (GLint) targetResolution.x, (GLint) targetResolution.y,
 		bitField, filter);
 	OPENGLCONTEXT->bindFBO(0);
-}
\ No newline at end of file
+}
+GLuint createVolumeTexture(unsigned int size_x, unsigned int size_y, unsigned int size_z, GLenum internalFormat)
+{
+	GLuint volumeTexture;
+
+	glEnable(GL_TEXTURE_3D);
+	OPENGLCONTEXT->activeTexture(GL_TEXTURE0);
+	glGenTextures(1, &volumeTexture);
+	OPENGLCONTEXT->bindTexture(volumeTexture, GL_TEXTURE_3D);
+
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
+
+	// allocate GPU memory
+	glTexStorage3D(GL_TEXTURE_3D, 1, internalFormat, size_x, size_y, size_z);
+
+	return volumeTexture;
+}
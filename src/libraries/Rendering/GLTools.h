@@ -4,6 +4,7 @@
 #include "Core/DebugLog.h"
 #include "Rendering/OpenGLContext.h"
 #include <Importing/Importer.h>
+#include <Importing/BrickedVolume.h>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -17,7 +18,7 @@ GLFWwindow* generateWindow(int width = 1280, int height = 720, int posX = 100, i
 bool shouldClose(GLFWwindow* window);
 void swapBuffers(GLFWwindow* window);
 void destroyWindow(GLFWwindow* window);
-void render(GLFWwindow* window, std::function<void (double)> loop); //!< keep executing the provided loop function until the window is closed, swapping buffers and computing frame time (passed as argument to loop function)
+void render(GLFWwindow* window, std::function<void (double)> loop); //!< keep executing the provided loop function until the window is closed, swapping buffers and computing frame time (passed as argument to loop function), reloads modified shaders about once per second
 GLenum checkGLError(bool printIfNoError = false); //!< check for OpenGL errors and also print it to the console (optionally even if no error occured)
 std::string decodeGLError(GLenum error); //!< return string corresponding to an OpenGL error code (use with checkGLError)
 
@@ -57,47 +58,74 @@ GLuint bufferData(const std::vector<T>& content, GLenum drawType = GL_STATIC_DRA
     return vbo;
 }
 
-/** upload the provided volume data to a 3D OpenGL texture object, i.e. CT-Data*/
+GLuint createVolumeTexture(unsigned int size_x, unsigned int size_y, unsigned int size_z, GLenum internalFormat = GL_R16I); //!< allocate an (empty) 3D texture object for volume data, linear filtering, clamped
+
+/** upload some slices of the provided volume data to a 3D texture created with createVolumeTexture, i.e. from the onSlab callback of Importer::load3DData */
 template <typename T>
-GLuint loadTo3DTexture(VolumeData<T>& volumeData, GLenum internalFormat = GL_R16I, GLenum format = GL_RED_INTEGER, GLenum type = GL_SHORT)
+void uploadVolumeSlab(GLuint volumeTexture, const VolumeData<T>& volumeData, unsigned int firstSlice, unsigned int numSlices, GLenum format = GL_RED_INTEGER, GLenum type = GL_SHORT)
 {
-	GLuint volumeTexture;
-
-	glEnable(GL_TEXTURE_3D);
-	OPENGLCONTEXT->activeTexture(GL_TEXTURE0);
-	glGenTextures(1, &volumeTexture);
 	OPENGLCONTEXT->bindTexture(volumeTexture, GL_TEXTURE_3D);
-
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
-
-	// allocate GPU memory
-	glTexStorage3D(GL_TEXTURE_3D
-		, 1
-		, internalFormat
-		, volumeData.size_x
-		, volumeData.size_y
-		, volumeData.size_z
-	);
-
-	// upload data
 	glTexSubImage3D(GL_TEXTURE_3D
 		, 0
 		, 0
 		, 0
-		, 0
+		, firstSlice
 		, volumeData.size_x
 		, volumeData.size_y
-		, volumeData.size_z
+		, numSlices
 		, format
 		, type
-		, &(volumeData.data[0])
+		, &(volumeData.data[(size_t) volumeData.size_x * volumeData.size_y * firstSlice])
 	);
+}
 
+/** upload the provided volume data to a 3D OpenGL texture object, i.e. CT-Data*/
+template <typename T>
+GLuint loadTo3DTexture(VolumeData<T>& volumeData, GLenum internalFormat = GL_R16I, GLenum format = GL_RED_INTEGER, GLenum type = GL_SHORT)
+{
+	GLuint volumeTexture = createVolumeTexture(volumeData.size_x, volumeData.size_y, volumeData.size_z, internalFormat);
+	uploadVolumeSlab(volumeTexture, volumeData, 0, volumeData.size_z, format, type);
 	return volumeTexture;
 }
 
+
+struct BrickedVolumeTextures
+{
+	GLuint atlas;      //!< occupied bricks, same format as a dense volume texture, nearest filtering
+	GLuint brickTable; //!< GL_RGBA16I, one texel per brick: atlas position in bricks (-1 if dropped) and the maximum value of the brick
+};
+
+/** upload a bricked volume for modelSpace/volumeBricked.frag, values must fit into 16 bit signed integers */
+template <typename T>
+BrickedVolumeTextures loadToBrickedTextures(BrickedVolumeData<T>& bricked, GLenum internalFormat = GL_R16I, GLenum format = GL_RED_INTEGER, GLenum type = GL_SHORT)
+{
+	BrickedVolumeTextures result;
+
+	VolumeData<T> atlas;
+	atlas.size_x = bricked.atlasBricks_x * bricked.brickSize;
+	atlas.size_y = bricked.atlasBricks_y * bricked.brickSize;
+	atlas.size_z = bricked.atlasBricks_z * bricked.brickSize;
+	atlas.data.swap(bricked.atlasData); // avoid a copy, given back below
+	result.atlas = loadTo3DTexture(atlas, internalFormat, format, type);
+	atlas.data.swap(bricked.atlasData);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // bricks are not padded
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	std::vector<GLshort> table(bricked.brickIndex.size() * 4);
+	for (unsigned int b = 0; b < bricked.brickIndex.size(); b++)
+	{
+		int index = bricked.brickIndex[b];
+		table[4 * b + 0] = (GLshort) ( (index < 0) ? -1 : (int) (index % bricked.atlasBricks_x) );
+		table[4 * b + 1] = (GLshort) ( (index < 0) ? -1 : (int) (index / bricked.atlasBricks_x % bricked.atlasBricks_y) );
+		table[4 * b + 2] = (GLshort) ( (index < 0) ? -1 : (int) (index / (bricked.atlasBricks_x * bricked.atlasBricks_y)) );
+		table[4 * b + 3] = (GLshort) bricked.brickMax[b];
+	}
+	result.brickTable = createVolumeTexture(bricked.numBricks_x, bricked.numBricks_y, bricked.numBricks_z, GL_RGBA16I);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, bricked.numBricks_x, bricked.numBricks_y, bricked.numBricks_z, GL_RGBA_INTEGER, GL_SHORT, &table[0]);
+
+	return result;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "GPUCulling.h"
+
+#include <algorithm>
+
+#include <Core/DebugLog.h>
+#include <Rendering/OpenGLContext.h>
+#include <Rendering/OcclusionCulling.h>
+
+static const GLuint LOCAL_SIZE_X = 64; // see instanceCulling.comp and instanceCount.comp
+
+Culling::GPUCulling::GPUCulling(const std::vector<Renderable*>& renderables, unsigned int maxInstances)
+	: m_cullingShader("/compute/instanceCulling.comp")
+	, m_countShader("/compute/instanceCount.comp")
+	, m_maxInstances(maxInstances)
+	, m_numInstances(0)
+	, m_hiZBuffer(nullptr)
+{
+	for (unsigned int i = 0; i < renderables.size(); i++)
+	{
+		if ( renderables[i]->m_indices.m_size == 0 )
+		{
+			DEBUGLOG->log("WARNING: GPUCulling: renderable without index buffer is ignored, index: ", (int) i);
+			continue;
+		}
+
+		DrawElementsIndirectCommand command = { renderables[i]->m_indices.m_size, 0, 0, 0, 0 };
+		m_renderables.push_back(renderables[i]);
+		m_commands.push_back(command);
+	}
+
+	glGenBuffers(1, &m_instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_maxInstances * sizeof(Instance), NULL, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_visibleBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_visibleBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, m_maxInstances * sizeof(glm::mat4), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glGenBuffers(1, &m_commandBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, std::max<size_t>(m_commands.size(), 1) * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+Culling::GPUCulling::~GPUCulling()
+{
+	glDeleteBuffers(1, &m_instanceBuffer);
+	glDeleteBuffers(1, &m_visibleBuffer);
+	glDeleteBuffers(1, &m_commandBuffer);
+}
+
+bool Culling::GPUCulling::isSupported()
+{
+	return GLEW_VERSION_4_3 || GLEW_ARB_compute_shader;
+}
+
+void Culling::GPUCulling::setInstances(const std::vector<CullingInfo>& instances)
+{
+	m_numInstances = (unsigned int) instances.size();
+	if ( m_numInstances > m_maxInstances )
+	{
+		DEBUGLOG->log("WARNING: GPUCulling: more instances than maxInstances, ignoring the rest: ", (int) m_numInstances);
+		m_numInstances = m_maxInstances;
+	}
+
+	m_instances.resize(m_numInstances);
+	for (unsigned int i = 0; i < m_numInstances; i++)
+	{
+		m_instances[i].model = instances[i].modelMatrix;
+		m_instances[i].localMin = glm::vec4(instances[i].boundingBox.min, 1.0f);
+		m_instances[i].localMax = glm::vec4(instances[i].boundingBox.max, 1.0f);
+	}
+
+	if ( m_numInstances == 0 ) { return; }
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_numInstances * sizeof(Instance), &m_instances[0]);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Culling::GPUCulling::setHiZBuffer(const HiZBuffer* hiZBuffer)
+{
+	m_hiZBuffer = hiZBuffer;
+}
+
+void Culling::GPUCulling::cull(const glm::mat4& viewProjection)
+{
+	if ( m_commands.empty() ) { return; }
+
+	// reset instance counts
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, m_commands.size() * sizeof(DrawElementsIndirectCommand), &m_commands[0]);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_visibleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_commandBuffer);
+
+	std::vector<glm::vec4> planes(6);
+	extractFrustumPlanes(viewProjection, &planes[0]);
+
+	m_cullingShader.update("numInstances", (int) m_numInstances);
+	m_cullingShader.update("frustumPlanes[0]", planes);
+	m_cullingShader.update("useHiZ", m_hiZBuffer != nullptr);
+	if ( m_hiZBuffer != nullptr )
+	{
+		m_cullingShader.updateAndBindTexture("hiZ", 0, m_hiZBuffer->getTextureHandle());
+		m_cullingShader.update("hiZViewProjection", m_hiZBuffer->getViewProjectionMatrix());
+	}
+
+	m_cullingShader.use();
+	glDispatchCompute((m_numInstances + LOCAL_SIZE_X - 1) / LOCAL_SIZE_X, 1, 1);
+
+	// only the first command was counted, one atomic per visible instance instead of one per command
+	if ( m_commands.size() > 1 )
+	{
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		m_countShader.update("numCommands", (int) m_commands.size());
+		m_countShader.use();
+		glDispatchCompute(((GLuint) m_commands.size() + LOCAL_SIZE_X - 1) / LOCAL_SIZE_X, 1, 1);
+	}
+
+	// commands are read by the indirect draws, matrices as vertex attributes or from shader storage
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void Culling::GPUCulling::draw()
+{
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	for (unsigned int i = 0; i < m_renderables.size(); i++)
+	{
+		m_renderables[i]->bind();
+		glDrawElementsIndirect(m_renderables[i]->m_mode, m_renderables[i]->m_indexType, (const GLvoid*) (i * sizeof(DrawElementsIndirectCommand)));
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	OPENGLCONTEXT->bindVAO(0);
+}
+
+void Culling::GPUCulling::attachInstanceAttribute(Renderable* renderable, GLuint location)
+{
+	renderable->bind();
+	glBindBuffer(GL_ARRAY_BUFFER, m_visibleBuffer);
+
+	// mat4 vertex attribute == 4 x vec4 attributes (consecutively)
+	GLsizei vec4Size = sizeof(glm::vec4);
+	for (GLuint i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(location + i);
+		glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (GLvoid*) (size_t) (i * vec4Size));
+		glVertexAttribDivisor(location + i, 1);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	renderable->unbind();
+}
+
+unsigned int Culling::GPUCulling::readVisibleCount()
+{
+	if ( m_commands.empty() ) { return 0; }
+
+	DrawElementsIndirectCommand command;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand), &command);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	return command.instanceCount;
+}
@@ -0,0 +1,77 @@
+#ifndef GPUCULLING_H
+#define GPUCULLING_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <Rendering/ShaderProgram.h>
+#include <Rendering/VertexArrayObjects.h>
+#include <Rendering/CullingTools.h>
+#include <Rendering/MeshPool.h>
+
+namespace Culling{
+
+class HiZBuffer;
+
+/** @brief frustum and Hi-Z culling of instances in a compute shader (requires OpenGL 4.3 or ARB_compute_shader)
+ *
+ * instance bounds are uploaded once with setInstances(). Every cull() compacts the model matrices of the visible instances into
+ * getVisibleMatrixBuffer() and writes one DrawElementsIndirectCommand per renderable into getCommandBuffer(), with instanceCount set
+ * to the number of visible instances. Drawing consumes these commands with glDrawElementsIndirect, so the CPU never touches per instance data.
+ * Use attachInstanceAttribute() to source a mat4 instance attribute from the visible matrices.
+ */
+class GPUCulling
+{
+public:
+	GPUCulling(const std::vector<Renderable*>& renderables, unsigned int maxInstances); //!< renderables must have an index buffer, they all share the same instances
+	~GPUCulling();
+
+	static bool isSupported(); //!< whether compute shaders and indirect draws are available in the current context
+
+	void setInstances(const std::vector<CullingInfo>& instances); //!< local bounds and model matrix of every instance, at most maxInstances
+	void setHiZBuffer(const HiZBuffer* hiZBuffer); //!< nullptr to only cull against the frustum
+
+	void cull(const glm::mat4& viewProjection); //!< dispatch the culling shader, must be called before draw() every frame
+	void draw(); //!< draws every renderable with its indirect command, binds the renderables VAOs
+
+	/** @brief source a mat4 attribute at location .. location+3 with divisor 1 from the visible matrices buffer
+	 *
+	 * call once per renderable, replaces whatever buffer was attached to these locations before
+	 */
+	void attachInstanceAttribute(Renderable* renderable, GLuint location = 4);
+
+	unsigned int readVisibleCount(); //!< reads back the count of the last cull(), waits for the GPU. Meant for debugging and statistics.
+
+	inline GLuint getCommandBuffer() const { return m_commandBuffer; }   //!< GL_DRAW_INDIRECT_BUFFER, one command per renderable in constructor order
+	inline GLuint getVisibleMatrixBuffer() const { return m_visibleBuffer; } //!< compacted mat4 model matrices of the visible instances
+	inline unsigned int getNumInstances() const { return m_numInstances; }
+	inline unsigned int getNumCommands() const { return (unsigned int) m_commands.size(); }
+
+private:
+	struct Instance //!< matches the std430 layout in instanceCulling.comp
+	{
+		glm::mat4 model;
+		glm::vec4 localMin;
+		glm::vec4 localMax;
+	};
+
+	ShaderProgram m_cullingShader;
+	ShaderProgram m_countShader; //!< copies the visible count of the first command into the others
+
+	std::vector<Renderable*> m_renderables;
+	std::vector<DrawElementsIndirectCommand> m_commands; //!< templates with instanceCount 0, copied into the command buffer every cull()
+	std::vector<Instance> m_instances;
+
+	unsigned int m_maxInstances;
+	unsigned int m_numInstances;
+	const HiZBuffer* m_hiZBuffer;
+
+	GLuint m_instanceBuffer;
+	GLuint m_visibleBuffer;
+	GLuint m_commandBuffer;
+};
+
+} // namespace Culling
+
+#endif
@@ -0,0 +1,304 @@
+#include "GoldenImages.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <Core/DebugLog.h>
+#include <Rendering/FrameBufferObject.h>
+#include <Rendering/OpenGLContext.h>
+
+namespace
+{
+	bool isLittleEndian()
+	{
+		unsigned short value = 1;
+		return *((unsigned char*) &value) == 1;
+	}
+}
+
+GoldenImages::GoldenImages(float tolerance, float maxFailedRatio)
+	: m_tolerance(tolerance)
+	, m_maxFailedRatio(maxFailedRatio)
+	, m_fence(0)
+	, m_fetched(false)
+{
+}
+
+GoldenImages::~GoldenImages()
+{
+	if ( m_fence != 0 ) { glDeleteSync(m_fence); }
+	for (unsigned int i = 0; i < m_targets.size(); i++)
+	{
+		glDeleteBuffers(1, &m_targets[i].packBuffer);
+	}
+}
+
+void GoldenImages::addTarget(const std::string& name, Source source, GLuint texture, int width, int height)
+{
+	Target target;
+	target.name = name;
+	target.source = source;
+	target.texture = texture;
+	target.width = width;
+	target.height = height;
+
+	// RGBA, even though only RGB is stored: float RGBA rows are always aligned
+	GLsizeiptr numBytes = width * height * ( source == DEPTH_TEXTURE ? 1 : 4 ) * sizeof(float);
+	glGenBuffers(1, &target.packBuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, target.packBuffer);
+	glBufferData(GL_PIXEL_PACK_BUFFER, numBytes, NULL, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_targets.push_back(target);
+}
+
+void GoldenImages::addTexture(const std::string& name, GLuint texture, int width, int height, bool depth)
+{
+	if ( texture == 0 )
+	{
+		DEBUGLOG->log("WARNING: GoldenImages: no texture for " + name);
+		return;
+	}
+	addTarget(name, depth ? DEPTH_TEXTURE : TEXTURE, texture, width, height);
+}
+
+void GoldenImages::addAttachment(const std::string& name, FrameBufferObject* fbo, const std::string& bufferName)
+{
+	addTexture(name, fbo->getBuffer(bufferName), fbo->getWidth(), fbo->getHeight());
+}
+
+void GoldenImages::addDepthAttachment(const std::string& name, FrameBufferObject* fbo)
+{
+	addTexture(name, fbo->getDepthTextureHandle(), fbo->getWidth(), fbo->getHeight(), true);
+}
+
+void GoldenImages::addScreen(const std::string& name, int width, int height)
+{
+	addTarget(name, SCREEN, 0, width, height);
+}
+
+void GoldenImages::capture()
+{
+	if ( m_fence != 0 ) { glDeleteSync(m_fence); } // previous capture was never fetched
+	m_fetched = false;
+
+	for (unsigned int i = 0; i < m_targets.size(); i++)
+	{
+		const Target& target = m_targets[i];
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, target.packBuffer);
+		if ( target.source == SCREEN )
+		{
+			OPENGLCONTEXT->bindFBO(0);
+			glReadBuffer(GL_BACK);
+			glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_FLOAT, 0);
+		}
+		else
+		{
+			OPENGLCONTEXT->bindTexture(target.texture);
+			glGetTexImage(GL_TEXTURE_2D, 0, ( target.source == DEPTH_TEXTURE ) ? GL_DEPTH_COMPONENT : GL_RGBA, GL_FLOAT, 0);
+			OPENGLCONTEXT->bindTexture(0);
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool GoldenImages::fetch(bool wait)
+{
+	if ( m_fetched ) { return true; }
+	if ( m_fence == 0 ) { return false; }
+
+	GLenum status = glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while ( wait && status == GL_TIMEOUT_EXPIRED )
+	{
+		status = glClientWaitSync(m_fence, 0, 1000000000); // 1 s
+	}
+	if ( status == GL_WAIT_FAILED )
+	{
+		DEBUGLOG->log("ERROR: GoldenImages: waiting for the readback failed");
+	}
+	if ( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED ) { return false; }
+	glDeleteSync(m_fence);
+	m_fence = 0;
+
+	for (unsigned int i = 0; i < m_targets.size(); i++)
+	{
+		Target& target = m_targets[i];
+		int numPixels = target.width * target.height;
+		int numChannels = getNumChannels(target);
+		int numSourceChannels = ( target.source == DEPTH_TEXTURE ) ? 1 : 4;
+		target.pixels.assign(numPixels * numChannels, 0.0f);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, target.packBuffer);
+		const float* data = (const float*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, numPixels * numSourceChannels * sizeof(float), GL_MAP_READ_BIT);
+		if ( data != nullptr )
+		{
+			// drop alpha
+			for (int p = 0; p < numPixels; p++)
+			{
+				for (int c = 0; c < numChannels; c++) { target.pixels[p * numChannels + c] = data[p * numSourceChannels + c]; }
+			}
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		else
+		{
+			DEBUGLOG->log("ERROR: GoldenImages: could not map the readback of " + target.name);
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_fetched = true;
+	return true;
+}
+
+bool GoldenImages::compare(const std::string& directory, const std::string& failureDirectory)
+{
+	m_results.clear();
+	if ( !m_fetched )
+	{
+		DEBUGLOG->log("ERROR: GoldenImages: nothing captured to compare");
+		return false;
+	}
+
+	bool allPassed = true;
+	for (unsigned int i = 0; i < m_targets.size(); i++)
+	{
+		const Target& target = m_targets[i];
+		Result result = { target.name, false, false, 0.0, 0.0, 0, (unsigned int) (target.width * target.height) };
+
+		int width, height, numChannels;
+		std::vector<float> golden;
+		if ( !readPFM(directory + "/" + target.name + ".pfm", width, height, numChannels, golden) )
+		{
+			result.missing = true;
+			result.numFailedPixels = result.numPixels;
+		}
+		else if ( width != target.width || height != target.height || numChannels != getNumChannels(target) )
+		{
+			DEBUGLOG->log("WARNING: GoldenImages: " + target.name + ": golden image is " + DebugLog::to_string(width) + "x" + DebugLog::to_string(height)
+				+ "x" + DebugLog::to_string(numChannels) + ", target is " + DebugLog::to_string(target.width) + "x" + DebugLog::to_string(target.height)
+				+ "x" + DebugLog::to_string(getNumChannels(target)));
+			result.numFailedPixels = result.numPixels;
+		}
+		else
+		{
+			double sumSquaredError = 0.0;
+			for (unsigned int p = 0; p < result.numPixels; p++)
+			{
+				bool pixelFailed = false;
+				for (int c = 0; c < numChannels; c++)
+				{
+					float a = target.pixels[p * numChannels + c];
+					float g = golden[p * numChannels + c];
+					if ( std::isnan(a) || std::isnan(g) )
+					{
+						pixelFailed |= ( std::isnan(a) != std::isnan(g) );
+						continue;
+					}
+
+					// relative above 1, absolute below
+					double error = std::abs(a - g) / std::max(1.0, (double) std::abs(g));
+					sumSquaredError += error * error;
+					result.maxError = std::max(result.maxError, error);
+					pixelFailed |= ( error > m_tolerance );
+				}
+				if ( pixelFailed ) { result.numFailedPixels++; }
+			}
+			result.rmse = std::sqrt(sumSquaredError / (double) std::max(result.numPixels * numChannels, 1u));
+		}
+		result.passed = result.missing || ( (float) result.numFailedPixels <= m_maxFailedRatio * (float) result.numPixels );
+
+		if ( result.missing )
+		{
+			DEBUGLOG->log("WARNING: GoldenImages: skipped: " + target.name + ", no golden image in " + directory + ", run \"make update_golden_images\" first");
+		}
+		else if ( result.passed )
+		{
+			DEBUGLOG->log("GoldenImages: passed: " + target.name + ", max error: " + DebugLog::to_string(result.maxError));
+		}
+		else
+		{
+			DEBUGLOG->log("ERROR: GoldenImages: failed: " + target.name + ", failed pixels: "
+				+ DebugLog::to_string(result.numFailedPixels) + " / " + DebugLog::to_string(result.numPixels) + ", max error: " + DebugLog::to_string(result.maxError));
+			if ( !failureDirectory.empty() )
+			{
+				writePFM(failureDirectory + "/" + target.name + "_actual.pfm", target.width, target.height, getNumChannels(target), &target.pixels[0]);
+			}
+		}
+		allPassed &= result.passed;
+		m_results.push_back(result);
+	}
+	return allPassed;
+}
+
+bool GoldenImages::write(const std::string& directory)
+{
+	if ( !m_fetched )
+	{
+		DEBUGLOG->log("ERROR: GoldenImages: nothing captured to write");
+		return false;
+	}
+
+	bool success = true;
+	for (unsigned int i = 0; i < m_targets.size(); i++)
+	{
+		const Target& target = m_targets[i];
+		success &= writePFM(directory + "/" + target.name + ".pfm", target.width, target.height, getNumChannels(target), &target.pixels[0]);
+	}
+	if ( success ) { DEBUGLOG->log("GoldenImages: updated golden images in " + directory); }
+	return success;
+}
+
+bool GoldenImages::writePFM(const std::string& path, int width, int height, int numChannels, const float* pixels)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if ( file == nullptr )
+	{
+		DEBUGLOG->log("ERROR: GoldenImages: could not write " + path);
+		return false;
+	}
+
+	// negative scale: little endian
+	fprintf(file, "%s\n%d %d\n%s\n", ( numChannels == 1 ) ? "Pf" : "PF", width, height, isLittleEndian() ? "-1.0" : "1.0");
+	size_t numValues = (size_t) width * height * numChannels;
+	bool success = ( fwrite(pixels, sizeof(float), numValues, file) == numValues );
+	fclose(file);
+	return success;
+}
+
+bool GoldenImages::readPFM(const std::string& path, int& width, int& height, int& numChannels, std::vector<float>& pixels)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if ( file == nullptr ) { return false; }
+
+	char type[3] = {0, 0, 0};
+	float scale = 0.0f;
+	if ( fscanf(file, "%2s %d %d %f", type, &width, &height, &scale) != 4 || type[0] != 'P' || (type[1] != 'F' && type[1] != 'f') || width <= 0 || height <= 0 )
+	{
+		DEBUGLOG->log("ERROR: GoldenImages: not a PFM file: " + path);
+		fclose(file);
+		return false;
+	}
+	fgetc(file); // single whitespace before the data
+	numChannels = ( type[1] == 'F' ) ? 3 : 1;
+
+	size_t numValues = (size_t) width * height * numChannels;
+	pixels.resize(numValues);
+	bool success = ( fread(&pixels[0], sizeof(float), numValues, file) == numValues );
+	fclose(file);
+
+	if ( ( scale < 0.0f ) != isLittleEndian() )
+	{
+		for (size_t i = 0; i < numValues; i++)
+		{
+			unsigned char* bytes = (unsigned char*) &pixels[i];
+			std::swap(bytes[0], bytes[3]);
+			std::swap(bytes[1], bytes[2]);
+		}
+	}
+	if ( !success ) { DEBUGLOG->log("ERROR: GoldenImages: truncated PFM file: " + path); }
+	return success;
+}
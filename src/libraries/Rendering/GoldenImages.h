@@ -0,0 +1,85 @@
+#ifndef GOLDEN_IMAGES_H
+#define GOLDEN_IMAGES_H
+
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+class FrameBufferObject;
+
+/** @brief compares selected render targets of a frame against stored reference images
+ *
+ * capture() copies every registered target into its own pixel pack buffer and sets a fence, fetch() maps the buffers once the
+ * fence is signaled, so the frame that is captured does not wait for the GPU. Afterwards the pixels are either compared
+ * against the golden images in a directory or written there as new golden images.
+ *
+ * Images are stored as little endian PFM (portable float map, viewable in most HDR image tools), RGB for color targets and
+ * grayscale for depth targets, bottom row first like OpenGL. Alpha is not stored.
+ * A pixel fails if one of its channels differs by more than tolerance, relative to the golden value if that is larger than 1
+ * (HDR and position buffers). A target fails if more than maxFailedRatio of its pixels fail.
+ */
+class GoldenImages
+{
+public:
+	struct Result
+	{
+		std::string name;
+		bool passed;
+		bool missing;             //!< no golden image found, the target is skipped and counts as passed
+		double rmse;
+		double maxError;
+		unsigned int numFailedPixels;
+		unsigned int numPixels;
+	};
+
+	GoldenImages(float tolerance = 0.02f, float maxFailedRatio = 0.001f);
+	~GoldenImages();
+
+	void addTexture(const std::string& name, GLuint texture, int width, int height, bool depth = false); //!< level 0 of a 2D texture
+	void addAttachment(const std::string& name, FrameBufferObject* fbo, const std::string& bufferName); //!< see FrameBufferObject::getBuffer
+	void addDepthAttachment(const std::string& name, FrameBufferObject* fbo);
+	void addScreen(const std::string& name, int width, int height); //!< back buffer of the default framebuffer, capture before swapping
+
+	void capture(); //!< start reading back all targets
+	bool fetch(bool wait = false); //!< @return true once the pixels of the last capture are available
+	inline bool isPending() const { return m_fence != 0; }
+
+	/** @brief compare the fetched pixels against <directory>/<name>.pfm
+	 * @param failureDirectory if not empty, the pixels of failed targets are written there as <name>_actual.pfm
+	 * @return whether all targets passed, targets without a golden image are skipped
+	 */
+	bool compare(const std::string& directory, const std::string& failureDirectory = "");
+	bool write(const std::string& directory); //!< store the fetched pixels as the new golden images
+
+	const std::vector<Result>& getResults() const { return m_results; } //!< of the last compare()
+
+	static bool writePFM(const std::string& path, int width, int height, int numChannels, const float* pixels);
+	static bool readPFM(const std::string& path, int& width, int& height, int& numChannels, std::vector<float>& pixels);
+
+private:
+	enum Source { TEXTURE, DEPTH_TEXTURE, SCREEN };
+
+	struct Target
+	{
+		std::string name;
+		Source source;
+		GLuint texture;
+		int width;
+		int height;
+		GLuint packBuffer;
+		std::vector<float> pixels; //!< RGB or depth, after fetch()
+	};
+
+	void addTarget(const std::string& name, Source source, GLuint texture, int width, int height);
+	int getNumChannels(const Target& target) const { return ( target.source == DEPTH_TEXTURE ) ? 1 : 3; }
+
+	float m_tolerance;
+	float m_maxFailedRatio;
+	GLsync m_fence;     //!< of the last capture, 0 if nothing is pending
+	bool m_fetched;     //!< pixels of all targets are available
+	std::vector<Target> m_targets;
+	std::vector<Result> m_results;
+};
+
+#endif
@@ -0,0 +1,248 @@
+#include "MeshPool.h"
+
+#include <Core/DebugLog.h>
+#include <Rendering/OpenGLContext.h>
+#include <Rendering/ShaderProgram.h>
+
+#include <algorithm>
+
+////////////////////////////// POOLED RENDERABLE ///////////////////////////////
+
+PooledRenderable::PooledRenderable(MeshPool* pool, GLuint firstIndex, GLint baseVertex)
+	: m_pool(pool),
+	m_firstIndex(firstIndex),
+	m_baseVertex(baseVertex)
+{
+	// buffers belong to the pool, so ~Renderable() must not delete anything
+	m_indices.m_vboHandle = 0;
+	m_positions.m_vboHandle = 0;
+	m_uvs.m_vboHandle = 0;
+	m_normals.m_vboHandle = 0;
+	m_tangents.m_vboHandle = 0;
+
+	m_vao = pool->getVAO();
+	m_mode = GL_TRIANGLES;
+}
+
+void PooledRenderable::draw()
+{
+	bind();
+	glDrawElementsBaseVertex(m_mode, m_indices.m_size, GL_UNSIGNED_INT, (void*) (m_firstIndex * sizeof(GLuint)), m_baseVertex);
+	unbind();
+}
+
+void PooledRenderable::drawInstanced(int numInstances)
+{
+	bind();
+	glDrawElementsInstancedBaseVertex(m_mode, m_indices.m_size, GL_UNSIGNED_INT, (void*) (m_firstIndex * sizeof(GLuint)), numInstances, m_baseVertex);
+	unbind();
+}
+
+DrawElementsIndirectCommand PooledRenderable::getDrawCommand(GLuint instanceCount, GLuint baseInstance) const
+{
+	DrawElementsIndirectCommand command;
+	command.count = m_indices.m_size;
+	command.instanceCount = instanceCount;
+	command.firstIndex = m_firstIndex;
+	command.baseVertex = m_baseVertex;
+	command.baseInstance = baseInstance;
+	return command;
+}
+
+////////////////////////////// MESH POOL ///////////////////////////////////////
+
+MeshPool::MeshPool(bool useUVs, bool useNormals, bool useTangents)
+	: m_useUVs(useUVs),
+	m_useNormals(useNormals),
+	m_useTangents(useTangents),
+	m_numDrawIndices(0),
+	m_commandBufferSize(0)
+{
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_indexBuffer);
+	glGenBuffers(4, m_vertexBuffers);
+	glGenBuffers(1, &m_drawIndexBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+
+	// attribute pointers stay valid when the buffers are reallocated later on
+	OPENGLCONTEXT->bindVAO(m_vao);
+	const GLint dimensions[4] = {3, 2, 3, 3};
+	const bool enabled[4] = {true, useUVs, useNormals, useTangents};
+	for (GLuint i = 0; i < 4; i++)
+	{
+		if ( !enabled[i] ) { continue; }
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffers[i]);
+		glVertexAttribPointer(i, dimensions[i], GL_FLOAT, GL_FALSE, 0, 0);
+		glEnableVertexAttribArray(i);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_drawIndexBuffer);
+	glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, 0, 0);
+	glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, 1);
+	glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	OPENGLCONTEXT->bindVAO(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	reserveDrawIndices(1);
+}
+
+MeshPool::~MeshPool()
+{
+	for (auto m : m_meshes)
+	{
+		delete m;
+	}
+	glDeleteBuffers(1, &m_commandBuffer);
+	glDeleteBuffers(1, &m_drawIndexBuffer);
+	glDeleteBuffers(4, m_vertexBuffers);
+	glDeleteBuffers(1, &m_indexBuffer);
+	glDeleteVertexArrays(1, &m_vao);
+}
+
+PooledRenderable* MeshPool::addMesh(const AssimpTools::VertexData& vertexData)
+{
+	const size_t numVertices = vertexData.positions.size() / 3;
+	if ( vertexData.indices.empty() || numVertices == 0 )
+	{
+		DEBUGLOG->log("WARNING: mesh pools only hold indexed triangle meshes, mesh is skipped");
+		return nullptr;
+	}
+
+	GLint baseVertex = (GLint) (m_positions.size() / 3);
+	PooledRenderable* renderable = new PooledRenderable(this, (GLuint) m_indices.size(), baseVertex);
+	renderable->m_indices.m_size = (GLuint) vertexData.indices.size();
+	renderable->m_positions.m_size = (GLuint) numVertices;
+
+	m_indices.insert(m_indices.end(), vertexData.indices.begin(), vertexData.indices.end());
+	m_positions.insert(m_positions.end(), vertexData.positions.begin(), vertexData.positions.begin() + numVertices * 3);
+
+	if ( m_useUVs )
+	{
+		if ( vertexData.uvs.size() == numVertices * 3 ) // 3D uvs, keep xy
+		{
+			for (size_t v = 0; v < numVertices; v++)
+			{
+				m_uvs.push_back(vertexData.uvs[v * 3]);
+				m_uvs.push_back(vertexData.uvs[v * 3 + 1]);
+			}
+		}
+		else if ( vertexData.uvs.size() == numVertices * 2 )
+		{
+			m_uvs.insert(m_uvs.end(), vertexData.uvs.begin(), vertexData.uvs.end());
+		}
+		else
+		{
+			m_uvs.resize(m_uvs.size() + numVertices * 2, 0.0f);
+		}
+		renderable->m_uvs.m_size = (GLuint) numVertices;
+	}
+
+	if ( m_useNormals )
+	{
+		if ( vertexData.normals.size() == numVertices * 3 ) { m_normals.insert(m_normals.end(), vertexData.normals.begin(), vertexData.normals.end()); }
+		else { m_normals.resize(m_normals.size() + numVertices * 3, 0.0f); }
+		renderable->m_normals.m_size = (GLuint) numVertices;
+	}
+
+	if ( m_useTangents )
+	{
+		if ( vertexData.tangents.size() == numVertices * 3 ) { m_tangents.insert(m_tangents.end(), vertexData.tangents.begin(), vertexData.tangents.end()); }
+		else { m_tangents.resize(m_tangents.size() + numVertices * 3, 0.0f); }
+		renderable->m_tangents.m_size = (GLuint) numVertices;
+	}
+
+	m_meshes.push_back(renderable);
+	return renderable;
+}
+
+std::vector<PooledRenderable*> MeshPool::addMeshes(const std::vector<AssimpTools::VertexData>& vertexDataInstances)
+{
+	std::vector<PooledRenderable*> result;
+	for (const auto& v : vertexDataInstances)
+	{
+		result.push_back( addMesh(v) );
+	}
+	return result;
+}
+
+void MeshPool::upload()
+{
+	if ( m_indices.empty() ) { return; }
+
+	const std::vector<float>* attributes[4] = {&m_positions, &m_uvs, &m_normals, &m_tangents};
+	for (int i = 0; i < 4; i++)
+	{
+		if ( attributes[i]->empty() ) { continue; }
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffers[i]);
+		glBufferData(GL_ARRAY_BUFFER, attributes[i]->size() * sizeof(float), &(*attributes[i])[0], GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	OPENGLCONTEXT->bindVAO(m_vao);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), &m_indices[0], GL_STATIC_DRAW);
+	OPENGLCONTEXT->bindVAO(0);
+
+	DEBUGLOG->log("mesh pool uploaded, meshes: ", (int) m_meshes.size());
+	DEBUGLOG->log("vertices: ", (int) getNumVertices());
+	DEBUGLOG->log("indices : ", (int) getNumIndices());
+}
+
+void MeshPool::reserveDrawIndices(GLuint numDrawIndices)
+{
+	if ( numDrawIndices <= m_numDrawIndices ) { return; }
+
+	GLuint newSize = std::max(numDrawIndices, 2 * m_numDrawIndices);
+	std::vector<GLuint> drawIndices(newSize);
+	for (GLuint i = 0; i < newSize; i++) { drawIndices[i] = i; }
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_drawIndexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, newSize * sizeof(GLuint), &drawIndices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	m_numDrawIndices = newSize;
+}
+
+void MeshPool::drawIndirect(const std::vector<PooledRenderable*>& renderables, int numInstances, ShaderProgram* shaderProgram)
+{
+	m_commands.clear();
+	for (auto r : renderables)
+	{
+		if ( r->getMeshPool() != this ) { DEBUGLOG->log("WARNING: renderable does not belong to this mesh pool, skipped"); continue; }
+		m_commands.push_back( r->getDrawCommand(numInstances, (GLuint) m_commands.size() * numInstances) );
+	}
+	if ( m_commands.empty() ) { return; }
+
+	reserveDrawIndices( (GLuint) m_commands.size() * numInstances );
+
+	OPENGLCONTEXT->bindVAO(m_vao);
+	if ( GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect )
+	{
+		GLsizeiptr bytes = m_commands.size() * sizeof(DrawElementsIndirectCommand);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+		if ( bytes > m_commandBufferSize ) { m_commandBufferSize = std::max(bytes, 2 * m_commandBufferSize); }
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, m_commandBufferSize, NULL, GL_STREAM_DRAW); // orphan, the previous frame may still read it
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, bytes, &m_commands[0]);
+
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, (GLsizei) m_commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else if ( GLEW_VERSION_4_2 || GLEW_ARB_base_instance )
+	{
+		for (const auto& c : m_commands)
+		{
+			glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, c.count, GL_UNSIGNED_INT, (void*) (c.firstIndex * sizeof(GLuint)), c.instanceCount, c.baseVertex, c.baseInstance);
+		}
+	}
+	else
+	{
+		// the draw index attribute restarts at 0 for every draw, the shader adds the offset
+		for (const auto& c : m_commands)
+		{
+			if ( shaderProgram != nullptr ) { shaderProgram->update("drawIndexOffset", (int) c.baseInstance); }
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, c.count, GL_UNSIGNED_INT, (void*) (c.firstIndex * sizeof(GLuint)), c.instanceCount, c.baseVertex);
+		}
+		if ( shaderProgram != nullptr ) { shaderProgram->update("drawIndexOffset", 0); }
+	}
+	OPENGLCONTEXT->bindVAO(0);
+}
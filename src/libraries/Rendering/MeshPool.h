@@ -0,0 +1,105 @@
+#ifndef MESHPOOL_H
+#define MESHPOOL_H
+
+#include <vector>
+#include <GL/glew.h>
+
+#include <Rendering/VertexArrayObjects.h>
+#include <Importing/AssimpTools.h>
+
+class MeshPool;
+class ShaderProgram;
+
+/** @brief layout of one command in a GL_DRAW_INDIRECT_BUFFER for glMultiDrawElementsIndirect */
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint  baseVertex;
+	GLuint baseInstance;
+};
+
+/** @brief a mesh that lives in the shared buffers of a MeshPool
+ * 
+ * can be drawn on its own like any Renderable, owned and deleted by its MeshPool
+ */
+class PooledRenderable : public Renderable
+{
+public:
+	PooledRenderable(MeshPool* pool, GLuint firstIndex, GLint baseVertex);
+
+	void draw() override;
+	void drawInstanced(int numInstances) override;
+
+	inline MeshPool* getMeshPool() const { return m_pool; }
+	DrawElementsIndirectCommand getDrawCommand(GLuint instanceCount = 1, GLuint baseInstance = 0) const;
+
+protected:
+	MeshPool* m_pool;
+	GLuint m_firstIndex; //!< offset into the shared index buffer
+	GLint m_baseVertex;  //!< offset into the shared vertex buffers
+};
+
+/** @brief packs the vertex and index data of many meshes into one set of buffers and one VAO
+ * 
+ * attributes use the same locations as Renderable (0 positions, 1 uvs, 2 normals, 3 tangents). All meshes share the attribute
+ * layout of the pool, missing attributes of a mesh are filled with zeros.
+ * Additionally an integer attribute at DRAW_INDEX_ATTRIBUTE holds the draw index in drawIndirect(), per-draw data (e.g. model matrices)
+ * can be fetched from a buffer with it. For instanced draws it holds drawIndex * numInstances + gl_InstanceID.
+ */
+class MeshPool
+{
+public:
+	static const GLuint DRAW_INDEX_ATTRIBUTE = 9;
+
+	MeshPool(bool useUVs = true, bool useNormals = true, bool useTangents = false);
+	~MeshPool();
+
+	PooledRenderable* addMesh(const AssimpTools::VertexData& vertexData); //!< stores the data on the CPU until upload(), returns nullptr if the mesh has no indexed triangles
+	std::vector<PooledRenderable*> addMeshes(const std::vector<AssimpTools::VertexData>& vertexDataInstances);
+
+	void upload(); //!< (re)creates the shared buffers from all meshes added so far
+
+	/** @brief draw all renderables with a single glMultiDrawElementsIndirect call
+	 * 
+	 * the renderables must belong to this pool, draw i gets draw index i.
+	 * Falls back to one glDrawElementsInstancedBaseVertexBaseInstance per renderable if ARB_multi_draw_indirect is not available.
+	 * Without ARB_base_instance either, the draw index attribute starts at 0 for every draw, so the offset of each draw is
+	 * uploaded to the int uniform "drawIndexOffset" of shaderProgram instead, which the shader has to add (reset to 0 afterwards).
+	 */
+	void drawIndirect(const std::vector<PooledRenderable*>& renderables, int numInstances = 1, ShaderProgram* shaderProgram = nullptr);
+
+	inline GLuint getVAO() const { return m_vao; }
+	inline unsigned int getNumMeshes() const { return (unsigned int) m_meshes.size(); }
+	inline unsigned int getNumVertices() const { return (unsigned int) (m_positions.size() / 3); }
+	inline unsigned int getNumIndices() const { return (unsigned int) m_indices.size(); }
+
+protected:
+	void reserveDrawIndices(GLuint numDrawIndices); //!< grows the draw index attribute buffer
+
+	bool m_useUVs;
+	bool m_useNormals;
+	bool m_useTangents;
+
+	std::vector<PooledRenderable*> m_meshes;
+
+	// CPU copies, kept so meshes can be added after upload()
+	std::vector<unsigned int> m_indices;
+	std::vector<float> m_positions;
+	std::vector<float> m_uvs;
+	std::vector<float> m_normals;
+	std::vector<float> m_tangents;
+
+	GLuint m_vao;
+	GLuint m_indexBuffer;
+	GLuint m_vertexBuffers[4]; //!< positions, uvs, normals, tangents
+	GLuint m_drawIndexBuffer;
+	GLuint m_numDrawIndices;
+
+	GLuint m_commandBuffer;
+	GLsizeiptr m_commandBufferSize; //!< in bytes
+	std::vector<DrawElementsIndirectCommand> m_commands;
+};
+
+#endif
@@ -0,0 +1,427 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+#include <Core/DebugLog.h>
+#include <Rendering/OpenGLContext.h>
+#include <Rendering/VertexArrayObjects.h>
+
+////////////////////////////// DEPTH PYRAMID //////////////////////////////////
+
+Culling::DepthPyramid::DepthPyramid(int width, int height)
+	: viewProjection(1.0f)
+{
+	if ( width > 0 && height > 0 )
+	{
+		resize(width, height);
+	}
+}
+
+void Culling::DepthPyramid::resize(int width, int height)
+{
+	if ( !m_levelSizes.empty() && m_levelSizes[0] == glm::ivec2(width, height) ) { return; }
+
+	m_levels.clear();
+	m_levelSizes.clear();
+
+	glm::ivec2 size(width, height);
+	while (true)
+	{
+		m_levelSizes.push_back(size);
+		m_levels.push_back( std::vector<float>(size.x * size.y, 1.0f) );
+		if ( size.x == 1 && size.y == 1 ) { break; }
+		size = glm::ivec2( std::max(1, size.x / 2), std::max(1, size.y / 2) ); // same as OpenGL mipmap sizes
+	}
+}
+
+void Culling::DepthPyramid::clear(float depth)
+{
+	if ( m_levels.empty() ) { return; }
+	std::fill(m_levels[0].begin(), m_levels[0].end(), depth);
+}
+
+void Culling::DepthPyramid::buildMipmaps()
+{
+	for (int level = 1; level < getNumLevels(); level++)
+	{
+		const std::vector<float>& src = m_levels[level - 1];
+		std::vector<float>& dst = m_levels[level];
+		const glm::ivec2 srcSize = m_levelSizes[level - 1];
+		const glm::ivec2 dstSize = m_levelSizes[level];
+
+		for (int y = 0; y < dstSize.y; y++)
+		{
+			// last texel also covers the remaining row / column of odd sizes
+			int y0 = std::min(2 * y, srcSize.y - 1);
+			int y1 = (y == dstSize.y - 1) ? srcSize.y - 1 : std::min(2 * y + 1, srcSize.y - 1);
+			for (int x = 0; x < dstSize.x; x++)
+			{
+				int x0 = std::min(2 * x, srcSize.x - 1);
+				int x1 = (x == dstSize.x - 1) ? srcSize.x - 1 : std::min(2 * x + 1, srcSize.x - 1);
+
+				float depth = 0.0f;
+				for (int sy = y0; sy <= y1; sy++)
+				{
+					for (int sx = x0; sx <= x1; sx++)
+					{
+						depth = std::max(depth, src[sy * srcSize.x + sx]);
+					}
+				}
+				dst[y * dstSize.x + x] = depth;
+			}
+		}
+	}
+}
+
+bool Culling::DepthPyramid::isOccluded(const glm::vec3& min, const glm::vec3& max) const
+{
+	if ( m_levels.empty() ) { return false; }
+
+	glm::vec3 ndcMin( FLT_MAX);
+	glm::vec3 ndcMax(-FLT_MAX);
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 corner( (i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z, 1.0f );
+		glm::vec4 clip = viewProjection * corner;
+		if ( clip.w <= 0.0f || clip.z < -clip.w ) { return false; } // crosses near plane
+
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		ndcMin = glm::min(ndcMin, ndc);
+		ndcMax = glm::max(ndcMax, ndc);
+	}
+
+	// parts outside of the screen are unknown to the depth buffer
+	if ( ndcMin.x < -1.0f || ndcMin.y < -1.0f || ndcMax.x > 1.0f || ndcMax.y > 1.0f ) { return false; }
+
+	const int width = getWidth(0);
+	const int height = getHeight(0);
+	int x0 = std::min( (int) ((ndcMin.x * 0.5f + 0.5f) * width),  width - 1);
+	int x1 = std::min( (int) ((ndcMax.x * 0.5f + 0.5f) * width),  width - 1);
+	int y0 = std::min( (int) ((ndcMin.y * 0.5f + 0.5f) * height), height - 1);
+	int y1 = std::min( (int) ((ndcMax.y * 0.5f + 0.5f) * height), height - 1);
+	float nearestDepth = ndcMin.z * 0.5f + 0.5f;
+
+	// pick the level on which the rectangle covers at most 3x3 texels
+	int extent = std::max(x1 - x0, y1 - y0) + 1;
+	int level = 0;
+	while ( (extent >> level) > 2 && level < getNumLevels() - 1 ) { level++; }
+
+	const glm::ivec2 size = m_levelSizes[level];
+	int tx0 = std::min(x0 >> level, size.x - 1);
+	int tx1 = std::min(x1 >> level, size.x - 1);
+	int ty0 = std::min(y0 >> level, size.y - 1);
+	int ty1 = std::min(y1 >> level, size.y - 1);
+
+	for (int y = ty0; y <= ty1; y++)
+	{
+		for (int x = tx0; x <= tx1; x++)
+		{
+			if ( nearestDepth <= getDepth(level, x, y) ) { return false; }
+		}
+	}
+	return true;
+}
+
+////////////////////////////// SOFTWARE RASTERIZER /////////////////////////////
+
+Culling::SoftwareRasterizer::SoftwareRasterizer(DepthPyramid* target)
+	: m_target(target),
+	m_viewProjection(1.0f)
+{
+}
+
+void Culling::SoftwareRasterizer::setTarget(DepthPyramid* target)
+{
+	m_target = target;
+}
+
+void Culling::SoftwareRasterizer::setViewProjectionMatrix(const glm::mat4& viewProjection)
+{
+	m_viewProjection = viewProjection;
+	if ( m_target != nullptr ) { m_target->viewProjection = viewProjection; }
+}
+
+void Culling::SoftwareRasterizer::clear()
+{
+	if ( m_target != nullptr ) { m_target->clear(1.0f); }
+}
+
+void Culling::SoftwareRasterizer::finish()
+{
+	if ( m_target != nullptr ) { m_target->buildMipmaps(); }
+}
+
+void Culling::SoftwareRasterizer::rasterizeTriangles(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& modelMatrix)
+{
+	glm::mat4 modelViewProjection = m_viewProjection * modelMatrix;
+
+	std::vector<glm::vec4> clip(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		clip[i] = modelViewProjection * glm::vec4(positions[i], 1.0f);
+	}
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		rasterizeTriangle(clip[indices[i]], clip[indices[i + 1]], clip[indices[i + 2]]);
+	}
+}
+
+void Culling::SoftwareRasterizer::rasterizeBox(const glm::vec3& min, const glm::vec3& max, const glm::mat4& modelMatrix)
+{
+	static const unsigned int boxIndices[36] = {
+		0,1,3, 0,3,2, // -z
+		4,6,7, 4,7,5, // +z
+		0,4,5, 0,5,1, // -y
+		2,3,7, 2,7,6, // +y
+		0,2,6, 0,6,4, // -x
+		1,5,7, 1,7,3  // +x
+	};
+
+	glm::mat4 modelViewProjection = m_viewProjection * modelMatrix;
+	glm::vec4 clip[8];
+	for (int i = 0; i < 8; i++)
+	{
+		clip[i] = modelViewProjection * glm::vec4( (i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z, 1.0f );
+	}
+
+	for (int i = 0; i < 36; i += 3)
+	{
+		rasterizeTriangle(clip[boxIndices[i]], clip[boxIndices[i + 1]], clip[boxIndices[i + 2]]);
+	}
+}
+
+void Culling::SoftwareRasterizer::rasterizeTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2)
+{
+	if ( m_target == nullptr || m_target->getNumLevels() == 0 ) { return; }
+
+	// no clipping: leaving out triangles only makes the occluder smaller
+	const float epsilon = 1e-5f;
+	if ( c0.w < epsilon || c1.w < epsilon || c2.w < epsilon ) { return; }
+	if ( c0.z < -c0.w || c1.z < -c1.w || c2.z < -c2.w ) { return; }
+
+	const int width = m_target->getWidth(0);
+	const int height = m_target->getHeight(0);
+	auto toScreen = [&](const glm::vec4& c)
+	{
+		return glm::vec3( (c.x / c.w * 0.5f + 0.5f) * width, (c.y / c.w * 0.5f + 0.5f) * height, c.z / c.w * 0.5f + 0.5f );
+	};
+	glm::vec3 v0 = toScreen(c0);
+	glm::vec3 v1 = toScreen(c1);
+	glm::vec3 v2 = toScreen(c2);
+
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if ( std::abs(area) < epsilon ) { return; }
+	if ( area < 0.0f ) // make counter clockwise, both windings are rasterized
+	{
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	int minX = std::max( 0,          (int) std::floor( std::min(v0.x, std::min(v1.x, v2.x)) ) );
+	int maxX = std::min( width - 1,  (int) std::ceil(  std::max(v0.x, std::max(v1.x, v2.x)) ) );
+	int minY = std::max( 0,          (int) std::floor( std::min(v0.y, std::min(v1.y, v2.y)) ) );
+	int maxY = std::min( height - 1, (int) std::ceil(  std::max(v0.y, std::max(v1.y, v2.y)) ) );
+	if ( minX > maxX || minY > maxY ) { return; }
+
+	// edge functions, evaluated incrementally at pixel centers
+	auto edge = [](const glm::vec3& a, const glm::vec3& b, float px, float py)
+	{
+		return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+	};
+	float px = minX + 0.5f;
+	float py = minY + 0.5f;
+	float e0Row = edge(v1, v2, px, py);
+	float e1Row = edge(v2, v0, px, py);
+	float e2Row = edge(v0, v1, px, py);
+	const float e0dx = -(v2.y - v1.y), e0dy = (v2.x - v1.x);
+	const float e1dx = -(v0.y - v2.y), e1dy = (v0.x - v2.x);
+	const float e2dx = -(v1.y - v0.y), e2dy = (v1.x - v0.x);
+	const float invArea = 1.0f / area;
+
+	float* depth = m_target->getLevelData(0);
+	for (int y = minY; y <= maxY; y++)
+	{
+		float e0 = e0Row, e1 = e1Row, e2 = e2Row;
+		for (int x = minX; x <= maxX; x++)
+		{
+			if ( e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f )
+			{
+				// z/w is affine in screen space
+				float z = (e0 * v0.z + e1 * v1.z + e2 * v2.z) * invArea;
+				float& d = depth[y * width + x];
+				if ( z < d && z <= 1.0f ) { d = z; }
+			}
+			e0 += e0dx; e1 += e1dx; e2 += e2dx;
+		}
+		e0Row += e0dy; e1Row += e1dy; e2Row += e2dy;
+	}
+}
+
+////////////////////////////// HI-Z BUFFER /////////////////////////////////////
+
+Culling::HiZBuffer::HiZBuffer(int width, int height, int readbackSize, Quad* quad)
+	: m_width(width),
+	m_height(height),
+	m_downsampleShader("/screenSpace/fullscreen.vert", "/screenSpace/hiZDownsample.frag"),
+	m_viewProjection(1.0f),
+	m_readbackLevel(0),
+	m_packIndex(0)
+{
+	if (quad == nullptr){
+		m_quad = new Quad();
+		ownQuad = true;
+	}else{
+		m_quad = quad;
+		ownQuad = false;
+	}
+
+	glm::ivec2 size(width, height);
+	while (true)
+	{
+		m_levelSizes.push_back(size);
+		if ( size.x == 1 && size.y == 1 ) { break; }
+		size = glm::ivec2( std::max(1, size.x / 2), std::max(1, size.y / 2) );
+	}
+	int numLevels = (int) m_levelSizes.size();
+
+	glGenTextures(1, &m_hiZTextureHandle);
+	OPENGLCONTEXT->bindTexture(m_hiZTextureHandle);
+	glTexStorage2D(GL_TEXTURE_2D, numLevels, GL_R32F, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	OPENGLCONTEXT->bindTexture(0);
+
+	m_mipmapFBOHandles.resize(numLevels);
+	glGenFramebuffers(numLevels, &m_mipmapFBOHandles[0]);
+	for ( int i = 0; i < numLevels; i++)
+	{
+		OPENGLCONTEXT->bindFBO(m_mipmapFBOHandles[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_hiZTextureHandle, i);
+		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+	}
+	OPENGLCONTEXT->bindFBO(0);
+
+	while ( m_readbackLevel < numLevels - 1 && std::max(m_levelSizes[m_readbackLevel].x, m_levelSizes[m_readbackLevel].y) > readbackSize )
+	{
+		m_readbackLevel++;
+	}
+	GLsizeiptr readbackBytes = m_levelSizes[m_readbackLevel].x * m_levelSizes[m_readbackLevel].y * sizeof(float);
+
+	glGenBuffers(2, m_packBuffers);
+	for (int i = 0; i < 2; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_packBuffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, readbackBytes, NULL, GL_STREAM_READ);
+		m_packFences[i] = 0;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+Culling::HiZBuffer::~HiZBuffer()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		if ( m_packFences[i] != 0 ) { glDeleteSync(m_packFences[i]); }
+	}
+	glDeleteBuffers(2, m_packBuffers);
+	glDeleteFramebuffers((GLsizei) m_mipmapFBOHandles.size(), &m_mipmapFBOHandles[0]);
+	glDeleteTextures(1, &m_hiZTextureHandle);
+	if (ownQuad) {delete m_quad;}
+}
+
+void Culling::HiZBuffer::update(GLuint depthTexture, const glm::mat4& viewProjection)
+{
+	m_viewProjection = viewProjection;
+
+	GLboolean depthTestEnableState = OPENGLCONTEXT->isEnabled(GL_DEPTH_TEST);
+	if (depthTestEnableState) {OPENGLCONTEXT->setEnabled(GL_DEPTH_TEST, false);}
+
+	m_downsampleShader.use();
+
+	// level 0: copy of the depth texture
+	OPENGLCONTEXT->bindFBO(m_mipmapFBOHandles[0]);
+	OPENGLCONTEXT->setViewport(0, 0, m_levelSizes[0].x, m_levelSizes[0].y);
+	m_downsampleShader.updateAndBindTexture("tex", 0, depthTexture);
+	m_downsampleShader.update("level", -1);
+	m_quad->draw();
+
+	// remaining levels: max of the level below
+	// only the source level is accessible while rendering, otherwise reading and writing the same texture is a feedback loop
+	m_downsampleShader.updateAndBindTexture("tex", 0, m_hiZTextureHandle);
+	for (int level = 1; level < getNumLevels(); level++)
+	{
+		OPENGLCONTEXT->bindTexture(m_hiZTextureHandle);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+
+		OPENGLCONTEXT->bindFBO(m_mipmapFBOHandles[level]);
+		OPENGLCONTEXT->setViewport(0, 0, m_levelSizes[level].x, m_levelSizes[level].y);
+		m_downsampleShader.update("level", level - 1);
+		m_quad->draw();
+	}
+	OPENGLCONTEXT->bindTexture(m_hiZTextureHandle);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, getNumLevels() - 1);
+	OPENGLCONTEXT->bindTexture(0);
+	OPENGLCONTEXT->bindFBO(0);
+	if (depthTestEnableState){OPENGLCONTEXT->setEnabled(GL_DEPTH_TEST, true);}
+
+	// asynchronous readback of a coarse level
+	if ( m_packFences[m_packIndex] != 0 ) { glDeleteSync(m_packFences[m_packIndex]); } // not fetched in time, drop it
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_packBuffers[m_packIndex]);
+	OPENGLCONTEXT->bindTexture(m_hiZTextureHandle);
+	glGetTexImage(GL_TEXTURE_2D, m_readbackLevel, GL_RED, GL_FLOAT, 0);
+	OPENGLCONTEXT->bindTexture(0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	m_packFences[m_packIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_packViewProjection[m_packIndex] = viewProjection;
+	m_packIndex = 1 - m_packIndex;
+}
+
+bool Culling::HiZBuffer::fetchReadback(DepthPyramid& pyramid)
+{
+	// newest first
+	for (int i = 1; i <= 2; i++)
+	{
+		int idx = (m_packIndex + i) % 2;
+		if ( m_packFences[idx] == 0 ) { continue; }
+
+		GLenum status = glClientWaitSync(m_packFences[idx], 0, 0);
+		if ( status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED ) { continue; }
+
+		const glm::ivec2 size = m_levelSizes[m_readbackLevel];
+		pyramid.resize(size.x, size.y);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_packBuffers[idx]);
+		float* data = (float*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size.x * size.y * sizeof(float), GL_MAP_READ_BIT);
+		if ( data != nullptr )
+		{
+			std::copy(data, data + size.x * size.y, pyramid.getLevelData(0));
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		// this and everything older is consumed
+		for (int k = 0; k < 2; k++)
+		{
+			if ( (k == idx || i == 1) && m_packFences[k] != 0 )
+			{
+				glDeleteSync(m_packFences[k]);
+				m_packFences[k] = 0;
+			}
+		}
+
+		if ( data == nullptr ) { return false; }
+
+		pyramid.viewProjection = m_packViewProjection[idx];
+		pyramid.buildMipmaps();
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,119 @@
+#ifndef OCCLUSIONCULLING_H
+#define OCCLUSIONCULLING_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <Rendering/ShaderProgram.h>
+
+class Quad;
+
+namespace Culling{
+
+/** @brief CPU side hierarchical depth buffer
+ * 
+ * level 0 holds window space depth [0,1] (row 0 is the bottom row, like OpenGL textures),
+ * every further level holds the maximum (farthest) depth of the 2x2 (or 3x3 at odd borders) texels below it.
+ * An object is occluded if its nearest depth is farther than the farthest depth in the region it covers.
+ */
+class DepthPyramid
+{
+public:
+	DepthPyramid(int width = 0, int height = 0);
+
+	void resize(int width, int height); //!< (re)allocates all levels, only allocates if size changed
+	void clear(float depth = 1.0f);     //!< sets level 0 to depth
+	void buildMipmaps();                //!< max-reduces level 0 into all coarser levels
+
+	/** @brief test a world space axis aligned box against the pyramid
+	 * 
+	 * conservative: boxes crossing the near plane or the screen border are never reported as occluded
+	 * @return true if the box is completely hidden
+	 */
+	bool isOccluded(const glm::vec3& min, const glm::vec3& max) const;
+
+	inline int getNumLevels() const { return (int) m_levels.size(); }
+	inline int getWidth(int level = 0)  const { return m_levelSizes[level].x; }
+	inline int getHeight(int level = 0) const { return m_levelSizes[level].y; }
+	inline float* getLevelData(int level) { return &m_levels[level][0]; }
+	inline float getDepth(int level, int x, int y) const { return m_levels[level][y * m_levelSizes[level].x + x]; }
+
+	glm::mat4 viewProjection; //!< the view-projection matrix that the depth was rendered with
+private:
+	std::vector<std::vector<float> > m_levels;
+	std::vector<glm::ivec2> m_levelSizes;
+};
+
+/** @brief renders occluder geometry into level 0 of a DepthPyramid on the CPU, usable without an OpenGL context
+ * 
+ * samples at pixel centers like a GPU depth buffer; triangles with a vertex behind the near plane are skipped,
+ * which only ever makes the result less occluding, never wrong.
+ */
+class SoftwareRasterizer
+{
+public:
+	SoftwareRasterizer(DepthPyramid* target = nullptr);
+
+	void setTarget(DepthPyramid* target);
+	void setViewProjectionMatrix(const glm::mat4& viewProjection); //!< also stored in the target
+	void clear();
+
+	void rasterizeTriangles(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& modelMatrix); //!< indices describe GL_TRIANGLES
+	void rasterizeBox(const glm::vec3& min, const glm::vec3& max, const glm::mat4& modelMatrix); //!< the box must lie completely inside the occluder it stands for
+
+	void finish(); //!< builds the coarser pyramid levels, call after all occluders were rasterized
+private:
+	void rasterizeTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2); // clip space vertices
+
+	DepthPyramid* m_target;
+	glm::mat4 m_viewProjection;
+};
+
+/** @brief builds a max-depth mipmap chain from a depth texture on the GPU and reads a coarse level back into a DepthPyramid
+ * 
+ * readback goes through alternating pixel pack buffers guarded by fences, so the CPU side pyramid lags behind by at least one frame but never stalls the pipeline.
+ */
+class HiZBuffer
+{
+public:
+	HiZBuffer(int width, int height, int readbackSize = 128, Quad* quad = nullptr);
+	~HiZBuffer();
+
+	/** @brief build the pyramid from depthTexture and start reading it back
+	 * @param depthTexture e.g. FrameBufferObject::getDepthTextureHandle() of the G-Buffer
+	 * @param viewProjection the matrix the depth texture was rendered with
+	 */
+	void update(GLuint depthTexture, const glm::mat4& viewProjection);
+
+	/** @brief copies the latest finished readback into pyramid, never waits for the GPU
+	 * @return true if pyramid was updated
+	 */
+	bool fetchReadback(DepthPyramid& pyramid);
+
+	inline GLuint getTextureHandle() const { return m_hiZTextureHandle; } //!< GL_R32F, max depth per mipmap level
+	inline int getNumLevels() const { return (int) m_mipmapFBOHandles.size(); }
+	inline const glm::mat4& getViewProjectionMatrix() const { return m_viewProjection; } //!< the matrix passed to the last update()
+
+	const int m_width;
+	const int m_height;
+private:
+	ShaderProgram m_downsampleShader;
+	GLuint m_hiZTextureHandle;
+	std::vector<GLuint> m_mipmapFBOHandles;
+	std::vector<glm::ivec2> m_levelSizes;
+	glm::mat4 m_viewProjection;
+
+	int m_readbackLevel;         //!< first level not larger than readbackSize
+	GLuint m_packBuffers[2];
+	GLsync m_packFences[2];
+	glm::mat4 m_packViewProjection[2];
+	int m_packIndex;             //!< buffer that will be written next
+
+	Quad* m_quad;
+	bool ownQuad;
+};
+
+} // namespace Culling
+
+#endif
@@ -2,9 +2,111 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+namespace
+{
+	const uint16_t ALL_CAPABILITIES = (1 << PipelineState::NUM_CAPABILITIES) - 1;
+	const uint32_t ALL_STATE_GROUPS = PipelineState::DIRTY_ALL & ~PipelineState::DIRTY_ENABLED;
+	const GLenum CAPABILITY_TARGETS[PipelineState::NUM_CAPABILITIES] = {
+		GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_STENCIL_TEST, GL_SCISSOR_TEST,
+		GL_POLYGON_OFFSET_FILL, GL_PROGRAM_POINT_SIZE, GL_DEPTH_CLAMP, GL_MULTISAMPLE };
+}
+
+////////////////////////////// PIPELINE STATE /////////////////////////////////
+
+PipelineState::PipelineState()
+	: enabled(MULTISAMPLE), // the only capability enabled by default
+	depthFunc(GL_LESS),
+	blendSrcRGB(GL_ONE),
+	blendDstRGB(GL_ZERO),
+	blendSrcAlpha(GL_ONE),
+	blendDstAlpha(GL_ZERO),
+	blendEquation(GL_FUNC_ADD),
+	cullFace(GL_BACK),
+	frontFace(GL_CCW),
+	polygonMode(GL_FILL),
+	colorMask(0xF),
+	depthMask(1)
+{
+}
+
+PipelineState& PipelineState::setEnabled(Capability capability, bool value)
+{
+	if ( value ) { enabled |= capability; }
+	else { enabled &= ~capability; }
+	return *this;
+}
+
+PipelineState& PipelineState::setBlendFunc(GLenum src, GLenum dst)
+{
+	return setBlendFunc(src, dst, src, dst);
+}
+
+PipelineState& PipelineState::setBlendFunc(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha)
+{
+	blendSrcRGB = (uint16_t) srcRGB;
+	blendDstRGB = (uint16_t) dstRGB;
+	blendSrcAlpha = (uint16_t) srcAlpha;
+	blendDstAlpha = (uint16_t) dstAlpha;
+	return *this;
+}
+
+PipelineState& PipelineState::setColorMask(bool r, bool g, bool b, bool a)
+{
+	colorMask = (uint8_t) ((r ? 1 : 0) | (g ? 2 : 0) | (b ? 4 : 0) | (a ? 8 : 0));
+	return *this;
+}
+
+uint64_t PipelineState::hash() const
+{
+	// field by field, padding bytes are not part of the hash
+	const uint16_t values[12] = { enabled, depthFunc, blendSrcRGB, blendDstRGB, blendSrcAlpha, blendDstAlpha,
+		blendEquation, cullFace, frontFace, polygonMode, colorMask, depthMask };
+
+	uint64_t h = 14695981039346656037ull;
+	for (int i = 0; i < 12; i++)
+	{
+		h = (h ^ (values[i] & 0xFF)) * 1099511628211ull;
+		h = (h ^ (values[i] >> 8)) * 1099511628211ull;
+	}
+	return h;
+}
+
+uint32_t PipelineState::diff(const PipelineState& other) const
+{
+	uint32_t dirty = 0;
+	if ( enabled != other.enabled ) { dirty |= DIRTY_ENABLED; }
+	if ( depthFunc != other.depthFunc ) { dirty |= DIRTY_DEPTH_FUNC; }
+	if ( depthMask != other.depthMask ) { dirty |= DIRTY_DEPTH_MASK; }
+	if ( blendSrcRGB != other.blendSrcRGB || blendDstRGB != other.blendDstRGB || blendSrcAlpha != other.blendSrcAlpha || blendDstAlpha != other.blendDstAlpha ) { dirty |= DIRTY_BLEND_FUNC; }
+	if ( blendEquation != other.blendEquation ) { dirty |= DIRTY_BLEND_EQUATION; }
+	if ( cullFace != other.cullFace ) { dirty |= DIRTY_CULL_FACE; }
+	if ( frontFace != other.frontFace ) { dirty |= DIRTY_FRONT_FACE; }
+	if ( polygonMode != other.polygonMode ) { dirty |= DIRTY_POLYGON_MODE; }
+	if ( colorMask != other.colorMask ) { dirty |= DIRTY_COLOR_MASK; }
+	return dirty;
+}
+
+PipelineState::Capability PipelineState::getCapability(GLenum target)
+{
+	for (int i = 0; i < NUM_CAPABILITIES; i++)
+	{
+		if ( CAPABILITY_TARGETS[i] == target ) { return (Capability) (1 << i); }
+	}
+	return (Capability) 0;
+}
+
+GLenum PipelineState::getTarget(int capabilityIndex)
+{
+	return CAPABILITY_TARGETS[capabilityIndex];
+}
+
+////////////////////////////// OPENGL CONTEXT /////////////////////////////////
+
 OpenGLContext::OpenGLContext()
 {
+	m_deferVAOUnbind = false;
 	clearCache();
+	resetBindCounters();
 }
 
 OpenGLContext::~OpenGLContext()
@@ -24,6 +126,23 @@ void OpenGLContext::clearCache()
 
 	cacheViewport = glm::ivec4(-1);
 	cacheWindowSize = glm::ivec2(-1);
+
+	invalidatePipelineStateCache();
+}
+
+void OpenGLContext::resetBindCounters()
+{
+	bindsIssued.vao = 0; bindsIssued.fbo = 0; bindsIssued.shader = 0; bindsIssued.texture = 0; bindsIssued.state = 0;
+	bindsAvoided.vao = 0; bindsAvoided.fbo = 0; bindsAvoided.shader = 0; bindsAvoided.texture = 0; bindsAvoided.state = 0;
+}
+
+void OpenGLContext::setDeferVAOUnbind(bool defer)
+{
+	m_deferVAOUnbind = defer;
+	if ( !defer )
+	{
+		bindVAO(0);
+	}
 }
 
 void OpenGLContext::updateCache()
@@ -31,6 +150,7 @@ void OpenGLContext::updateCache()
 	updateBindingCache();
 	updateWindowCache();
 	updateTextureCache();
+	updatePipelineStateCache();
 }
 
 void OpenGLContext::updateBindingCache()
@@ -121,10 +241,15 @@ void OpenGLContext::updateCurrentTextureCache()
 
 void OpenGLContext::bindVAO(GLuint vao)
 {
-	if ( cacheVAO != vao )
+	if ( cacheVAO != vao && !(vao == 0 && m_deferVAOUnbind) )
 	{
 		glBindVertexArray(vao);
 		cacheVAO = vao;
+		bindsIssued.vao++;
+	}
+	else
+	{
+		bindsAvoided.vao++;
 	}
 }
 
@@ -138,21 +263,27 @@ void OpenGLContext::bindFBO(GLuint fbo, GLenum type)
 			glBindFramebuffer(type, fbo);
 			cacheDrawFBO = fbo;
 			cacheReadFBO = fbo;
+			bindsIssued.fbo++;
 		}
+		else { bindsAvoided.fbo++; }
 		break;
 	case GL_DRAW_FRAMEBUFFER:
 		if ( cacheDrawFBO != fbo)
 		{
 			glBindFramebuffer(type, fbo);
 			cacheDrawFBO = fbo;
+			bindsIssued.fbo++;
 		}
+		else { bindsAvoided.fbo++; }
 		break;
 	case GL_READ_FRAMEBUFFER:
 		if ( cacheReadFBO != fbo )
 		{
 			glBindFramebuffer(type, fbo);
 			cacheReadFBO = fbo;
+			bindsIssued.fbo++;
 		}
+		else { bindsAvoided.fbo++; }
 		break;
 	}
 }
@@ -163,6 +294,11 @@ void OpenGLContext::useShader(GLuint shaderProgram)
 	{
 		glUseProgram(shaderProgram);
 		cacheShader = shaderProgram;
+		bindsIssued.shader++;
+	}
+	else
+	{
+		bindsAvoided.shader++;
 	}
 }
 
@@ -188,11 +324,33 @@ void OpenGLContext::bindTextureToUnit(GLuint texture, GLenum unit, GLenum type)
 		activeTexture(unit);
 		glBindTexture(type, texture);
 		cacheTextures[unit] = texture;
+		bindsIssued.texture++;
+	}
+	else
+	{
+		bindsAvoided.texture++;
 	}
 }
 
 void OpenGLContext::setEnabled(GLenum target, bool value)
 {
+	PipelineState::Capability capability = PipelineState::getCapability(target);
+	if ( capability != 0 )
+	{
+		if ( (m_knownCapabilities & capability) && m_pipelineState.isEnabled(capability) == value )
+		{
+			bindsAvoided.state++;
+			return;
+		}
+		if ( value ) { glEnable(target); }
+		else { glDisable(target); }
+		bindsIssued.state++;
+		m_pipelineState.setEnabled(capability, value);
+		m_knownCapabilities |= capability;
+		m_pipelineStateHash = m_pipelineState.hash();
+		return;
+	}
+
 	auto it = cacheInt.find(target);
 	if (  it == cacheInt.end() || (*it).second != (int) value)
 	{
@@ -211,6 +369,18 @@ void OpenGLContext::setEnabled(GLenum target, bool value)
 
 bool OpenGLContext::isEnabled(GLenum target)
  {
+	PipelineState::Capability capability = PipelineState::getCapability(target);
+	if ( capability != 0 )
+	{
+		if ( !(m_knownCapabilities & capability) )
+		{
+			m_pipelineState.setEnabled(capability, glIsEnabled(target) == GL_TRUE);
+			m_knownCapabilities |= capability;
+			m_pipelineStateHash = m_pipelineState.hash();
+		}
+		return m_pipelineState.isEnabled(capability);
+	}
+
  	auto it = cacheInt.find(target);
  	if (it == cacheInt.end()) //don't know lol
  	{
@@ -219,6 +389,85 @@ bool OpenGLContext::isEnabled(GLenum target)
 	return (bool) cacheInt[target];
  }
 
+void OpenGLContext::applyPipelineState(const PipelineState& state)
+{
+	applyPipelineState(state, state.hash());
+}
+
+void OpenGLContext::applyPipelineState(const PipelineState& state, uint64_t hash)
+{
+	bool fullyKnown = (m_knownCapabilities == ALL_CAPABILITIES) && (m_knownStateGroups == ALL_STATE_GROUPS);
+	if ( fullyKnown && hash == m_pipelineStateHash )
+	{
+		bindsAvoided.state++;
+		return;
+	}
+
+	uint32_t dirty = state.diff(m_pipelineState) | (ALL_STATE_GROUPS & ~m_knownStateGroups);
+
+	uint16_t toggled = (state.enabled ^ m_pipelineState.enabled) | (ALL_CAPABILITIES & ~m_knownCapabilities);
+	for (int i = 0; i < PipelineState::NUM_CAPABILITIES; i++)
+	{
+		if ( !(toggled & (1 << i)) ) { continue; }
+		if ( state.enabled & (1 << i) ) { glEnable(PipelineState::getTarget(i)); }
+		else { glDisable(PipelineState::getTarget(i)); }
+		bindsIssued.state++;
+	}
+
+	if ( dirty & PipelineState::DIRTY_DEPTH_FUNC ) { glDepthFunc(state.depthFunc); bindsIssued.state++; }
+	if ( dirty & PipelineState::DIRTY_DEPTH_MASK ) { glDepthMask(state.depthMask ? GL_TRUE : GL_FALSE); bindsIssued.state++; }
+	if ( dirty & PipelineState::DIRTY_BLEND_FUNC ) { glBlendFuncSeparate(state.blendSrcRGB, state.blendDstRGB, state.blendSrcAlpha, state.blendDstAlpha); bindsIssued.state++; }
+	if ( dirty & PipelineState::DIRTY_BLEND_EQUATION ) { glBlendEquation(state.blendEquation); bindsIssued.state++; }
+	if ( dirty & PipelineState::DIRTY_CULL_FACE ) { glCullFace(state.cullFace); bindsIssued.state++; }
+	if ( dirty & PipelineState::DIRTY_FRONT_FACE ) { glFrontFace(state.frontFace); bindsIssued.state++; }
+	if ( dirty & PipelineState::DIRTY_POLYGON_MODE ) { glPolygonMode(GL_FRONT_AND_BACK, state.polygonMode); bindsIssued.state++; }
+	if ( dirty & PipelineState::DIRTY_COLOR_MASK )
+	{
+		glColorMask( (state.colorMask & 1) != 0, (state.colorMask & 2) != 0, (state.colorMask & 4) != 0, (state.colorMask & 8) != 0 );
+		bindsIssued.state++;
+	}
+
+	m_pipelineState = state;
+	m_pipelineStateHash = hash;
+	m_knownCapabilities = ALL_CAPABILITIES;
+	m_knownStateGroups = ALL_STATE_GROUPS;
+}
+
+void OpenGLContext::updatePipelineStateCache()
+{
+	for (int i = 0; i < PipelineState::NUM_CAPABILITIES; i++)
+	{
+		m_pipelineState.setEnabled((PipelineState::Capability) (1 << i), glIsEnabled(PipelineState::getTarget(i)) == GL_TRUE);
+	}
+
+	GLint values[4];
+	glGetIntegerv(GL_DEPTH_FUNC, values);          m_pipelineState.depthFunc = (uint16_t) values[0];
+	glGetIntegerv(GL_BLEND_SRC_RGB, values);       m_pipelineState.blendSrcRGB = (uint16_t) values[0];
+	glGetIntegerv(GL_BLEND_DST_RGB, values);       m_pipelineState.blendDstRGB = (uint16_t) values[0];
+	glGetIntegerv(GL_BLEND_SRC_ALPHA, values);     m_pipelineState.blendSrcAlpha = (uint16_t) values[0];
+	glGetIntegerv(GL_BLEND_DST_ALPHA, values);     m_pipelineState.blendDstAlpha = (uint16_t) values[0];
+	glGetIntegerv(GL_BLEND_EQUATION_RGB, values);  m_pipelineState.blendEquation = (uint16_t) values[0];
+	glGetIntegerv(GL_CULL_FACE_MODE, values);      m_pipelineState.cullFace = (uint16_t) values[0];
+	glGetIntegerv(GL_FRONT_FACE, values);          m_pipelineState.frontFace = (uint16_t) values[0];
+
+	GLboolean masks[4];
+	glGetBooleanv(GL_DEPTH_WRITEMASK, masks);      m_pipelineState.depthMask = masks[0] ? 1 : 0;
+	glGetBooleanv(GL_COLOR_WRITEMASK, masks);
+	m_pipelineState.setColorMask(masks[0] != GL_FALSE, masks[1] != GL_FALSE, masks[2] != GL_FALSE, masks[3] != GL_FALSE);
+
+	// polygon mode can not be queried in every profile, it is set on the next apply
+	m_knownCapabilities = ALL_CAPABILITIES;
+	m_knownStateGroups = ALL_STATE_GROUPS & ~PipelineState::DIRTY_POLYGON_MODE;
+	m_pipelineStateHash = m_pipelineState.hash();
+}
+
+void OpenGLContext::invalidatePipelineStateCache()
+{
+	m_knownCapabilities = 0;
+	m_knownStateGroups = 0;
+	m_pipelineStateHash = 0;
+}
+
 void OpenGLContext::setViewport(int x, int y, int width, int height)
 {
 	setViewport(glm::ivec4(x,y,width,height));
@@ -3,11 +3,76 @@
 
 #include <string>
 #include <unordered_map>
+#include <stdint.h>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <Core/Singleton.h>
 
+/**
+* @brief packed fixed function state, applied as a whole with OpenGLContext::applyPipelineState()
+* 
+* default constructed it holds the OpenGL defaults. GLenums are stored in 16 bits, all used values fit.
+*/
+struct PipelineState
+{
+	enum Capability //!< bits of enabled, only these capabilities are part of the block
+	{
+		DEPTH_TEST          = 1 << 0,
+		BLEND               = 1 << 1,
+		CULL_FACE           = 1 << 2,
+		STENCIL_TEST        = 1 << 3,
+		SCISSOR_TEST        = 1 << 4,
+		POLYGON_OFFSET_FILL = 1 << 5,
+		PROGRAM_POINT_SIZE  = 1 << 6,
+		DEPTH_CLAMP         = 1 << 7,
+		MULTISAMPLE         = 1 << 8,
+		NUM_CAPABILITIES    = 9
+	};
+
+	enum DirtyBit //!< groups of state that differ between two blocks, see diff()
+	{
+		DIRTY_ENABLED        = 1 << 0,
+		DIRTY_DEPTH_FUNC     = 1 << 1,
+		DIRTY_DEPTH_MASK     = 1 << 2,
+		DIRTY_BLEND_FUNC     = 1 << 3,
+		DIRTY_BLEND_EQUATION = 1 << 4,
+		DIRTY_CULL_FACE      = 1 << 5,
+		DIRTY_FRONT_FACE     = 1 << 6,
+		DIRTY_POLYGON_MODE   = 1 << 7,
+		DIRTY_COLOR_MASK     = 1 << 8,
+		DIRTY_ALL            = (1 << 9) - 1
+	};
+
+	uint16_t enabled;       //!< Capability bits
+	uint16_t depthFunc;
+	uint16_t blendSrcRGB;
+	uint16_t blendDstRGB;
+	uint16_t blendSrcAlpha;
+	uint16_t blendDstAlpha;
+	uint16_t blendEquation;
+	uint16_t cullFace;
+	uint16_t frontFace;
+	uint16_t polygonMode;   //!< front and back
+	uint8_t  colorMask;     //!< bit 0..3: r, g, b, a
+	uint8_t  depthMask;
+
+	PipelineState();
+
+	PipelineState& setEnabled(Capability capability, bool value = true);
+	PipelineState& setBlendFunc(GLenum src, GLenum dst); //!< same for rgb and alpha
+	PipelineState& setBlendFunc(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+	PipelineState& setColorMask(bool r, bool g, bool b, bool a);
+	inline bool isEnabled(Capability capability) const { return (enabled & capability) != 0; }
+
+	uint64_t hash() const; //!< FNV-1a of the packed fields, compute once per block and pass to OpenGLContext::applyPipelineState()
+	uint32_t diff(const PipelineState& other) const; //!< DirtyBit mask of the groups that differ
+	bool operator==(const PipelineState& other) const { return diff(other) == 0; }
+
+	static Capability getCapability(GLenum target); //!< e.g. GL_BLEND -> BLEND, 0 if the target is not part of the block
+	static GLenum getTarget(int capabilityIndex);   //!< e.g. 1 -> GL_BLEND
+};
+
 /**
 * @brief a convenience class that caches the values of OpenGL
 */
@@ -31,6 +96,25 @@ public:
 	glm::ivec4 cacheViewport;
 	glm::ivec2 cacheWindowSize;
 
+	/** @brief number of binding calls, split into calls forwarded to OpenGL and calls filtered by the cache */
+	struct BindCounters
+	{
+		unsigned int vao;
+		unsigned int fbo;
+		unsigned int shader;
+		unsigned int texture;
+		unsigned int state; //!< fixed function state calls, e.g. glEnable or glBlendFunc
+	};
+	BindCounters bindsIssued;
+	BindCounters bindsAvoided;
+	void resetBindCounters(); // e.g. once per frame
+
+	/** @brief while set, bindVAO(0) is skipped so consecutive draws of the same VAO do not rebind it
+	 * 
+	 * setting it to false binds VAO 0 for real. Buffer bindings issued in between will affect the still bound VAO!
+	 */
+	void setDeferVAOUnbind(bool defer);
+
 	void clearCache();
 	void updateCache(); // retrieve most commonly used OpenGL values and add to cache
 	void updateBindingCache(); //retrieve currently bound FBO, VAO, ShaderProgram
@@ -51,9 +135,26 @@ public:
 	void setWindowSize(GLFWwindow* window, int width, int height);
 	void setWindowSize(GLFWwindow* window, glm::vec2 windowSize);
 	void setWindowSize(GLFWwindow* window, glm::ivec2 windowSize);
-	void setEnabled(GLenum target, bool value);
+	void setEnabled(GLenum target, bool value); //!< capabilities of PipelineState are tracked in its bit mask, others in cacheInt
 
 	bool isEnabled(GLenum target);
+
+	/** @brief make the given state current with the minimal set of OpenGL calls
+	 * @param hash state.hash(), so applying the current block again costs one comparison
+	 */
+	void applyPipelineState(const PipelineState& state, uint64_t hash);
+	void applyPipelineState(const PipelineState& state); //!< computes the hash
+	inline const PipelineState& getPipelineState() const { return m_pipelineState; } //!< only meaningful for the parts that are known
+	void updatePipelineStateCache(); //!< retrieve the full PipelineState from OpenGL
+	void invalidatePipelineStateCache(); //!< e.g. after code that changes state behind the cache's back (ImGui), the next apply sets everything
+
+private:
+	bool m_deferVAOUnbind;
+
+	PipelineState m_pipelineState; //!< current state as far as known
+	uint64_t m_pipelineStateHash;  //!< hash of m_pipelineState, only valid if all of it is known
+	uint16_t m_knownCapabilities;  //!< Capability bits that are known
+	uint32_t m_knownStateGroups;   //!< DirtyBit groups (except DIRTY_ENABLED) that are known
 };
 
 // for convenient access
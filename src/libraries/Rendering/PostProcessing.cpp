@@ -13,7 +13,24 @@
 namespace{float log_2( float n )  
 {  
     return log( n ) / log( 2 );      // log(n)/log(2) is log_2. 
-}}
+}
+
+std::vector<std::pair<GLenum, std::string> > dofCompStages()
+{
+	std::vector<std::pair<GLenum, std::string> > stages;
+	stages.push_back(std::make_pair(GL_VERTEX_SHADER, std::string("/screenSpace/fullscreen.vert")));
+	stages.push_back(std::make_pair(GL_FRAGMENT_SHADER, std::string("/screenSpace/postProcessDOFCompositing.frag")));
+	return stages;
+}
+
+std::vector<std::string> dofCompFeatures()
+{
+	std::vector<std::string> features;
+	features.push_back("DISABLE_NEAR_FIELD");
+	features.push_back("DISABLE_FAR_FIELD");
+	return features;
+}
+}
 
 PostProcessing::BoxBlur::BoxBlur(int width, int height, Quad* quad)
 	: m_pushShaderProgram("/screenSpace/fullscreen.vert", "/screenSpace/pushBoxBlur.frag" )
@@ -86,7 +103,7 @@ PostProcessing::BoxBlur::~BoxBlur()
 PostProcessing::DepthOfField::DepthOfField(int width, int height, Quad* quad)
 	: m_calcCoCShader("/screenSpace/fullscreen.vert", "/screenSpace/postProcessCircleOfConfusion.frag")
 	, m_dofShader("/screenSpace/fullscreen.vert", "/screenSpace/postProcessDOF.frag")
-	, m_dofCompShader("/screenSpace/fullscreen.vert", "/screenSpace/postProcessDOFCompositing.frag")
+	, m_dofCompShaders(dofCompStages(), dofCompFeatures())
 	, m_width(width)
 	, m_height(height)
 	, m_focusPlaneDepths(2.0,4.0,7.0,10.0)
@@ -108,7 +125,8 @@ PostProcessing::DepthOfField::DepthOfField(int width, int height, Quad* quad)
 	m_hDofFBO 	 = new FrameBufferObject(m_dofShader.getOutputInfoMap(), width / 4, height );
 	m_vDofFBO 	 = new FrameBufferObject(m_dofShader.getOutputInfoMap(), width / 4, height / 4);
 	FrameBufferObject::s_internalFormat = GL_RGBA;
-	m_dofCompFBO = new FrameBufferObject(m_dofCompShader.getOutputInfoMap(), width, height );
+	m_dofCompShaders.compileAll(); // only 4, toggling a checkbox should not stall on a compile
+	m_dofCompFBO = new FrameBufferObject(m_dofCompShaders.get(0)->getOutputInfoMap(), width, height );
 	
 	for ( auto t : m_vDofFBO->getColorAttachments() )
 	{
@@ -117,9 +135,12 @@ PostProcessing::DepthOfField::DepthOfField(int width, int height, Quad* quad)
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	}
 	
-	m_dofCompShader.bindTextureOnUse("sharpFocusField", m_cocFBO->getBuffer("fragmentColor"));
-	m_dofCompShader.bindTextureOnUse("blurryNearField", m_vDofFBO->getBuffer("nearResult"));
-	m_dofCompShader.bindTextureOnUse("blurryFarField" , m_vDofFBO->getBuffer("blurResult"));
+	for (auto variant : m_dofCompShaders.getVariants())
+	{
+		variant.second->bindTextureOnUse("sharpFocusField", m_cocFBO->getBuffer("fragmentColor"));
+		variant.second->bindTextureOnUse("blurryNearField", m_vDofFBO->getBuffer("nearResult"));
+		variant.second->bindTextureOnUse("blurryFarField" , m_vDofFBO->getBuffer("blurResult"));
+	}
 
 	// default settings
 	m_calcCoCShader.update("focusPlaneDepths", m_focusPlaneDepths);
@@ -129,8 +150,11 @@ PostProcessing::DepthOfField::DepthOfField(int width, int height, Quad* quad)
 	m_dofShader.update("nearBlurRadiusPixels", (int) m_focusPlaneRadi.x);
 	m_dofShader.update("invNearBlurRadiusPixels", 1.0f / m_focusPlaneRadi.x);
 
-	m_dofCompShader.update("maxCoCRadiusPixels", m_focusPlaneRadi.x);
-	m_dofCompShader.update("farRadiusRescale" , m_farRadiusRescale);
+	for (auto variant : m_dofCompShaders.getVariants())
+	{
+		variant.second->update("maxCoCRadiusPixels", m_focusPlaneRadi.x);
+		variant.second->update("farRadiusRescale" , m_farRadiusRescale);
+	}
 }
 
 PostProcessing::DepthOfField::~DepthOfField()
@@ -141,8 +165,8 @@ PostProcessing::DepthOfField::~DepthOfField()
 void PostProcessing::DepthOfField::execute(GLuint positionMap, GLuint colorMap)
 {
 	// setup
-	GLboolean depthTestEnableState = glIsEnabled(GL_DEPTH_TEST);
-	if (depthTestEnableState) {glDisable(GL_DEPTH_TEST);}
+	GLboolean depthTestEnableState = OPENGLCONTEXT->isEnabled(GL_DEPTH_TEST);
+	if (depthTestEnableState) {OPENGLCONTEXT->setEnabled(GL_DEPTH_TEST, false);}
 
 	// compute COC map
 	OPENGLCONTEXT->setViewport(0,0,m_width, m_height);
@@ -170,7 +194,7 @@ void PostProcessing::DepthOfField::execute(GLuint positionMap, GLuint colorMap)
 	m_quad->draw();
 
 	m_dofCompFBO->bind();
-	m_dofCompShader.use();
+	getDofCompShader()->use();
 	m_quad->draw();
 } 
 
@@ -195,11 +219,19 @@ void PostProcessing::DepthOfField::updateUniforms()
 	m_dofShader.update("nearBlurRadiusPixels", (int) m_focusPlaneRadi.x);
 	m_dofShader.update("invNearBlurRadiusPixels", 1.0f / m_focusPlaneRadi.x);
 
-	m_dofCompShader.update("maxCoCRadiusPixels", m_focusPlaneRadi.x);
-	m_dofCompShader.update("farRadiusRescale" , m_farRadiusRescale);
+	for (auto variant : m_dofCompShaders.getVariants())
+	{
+		variant.second->update("maxCoCRadiusPixels", m_focusPlaneRadi.x);
+		variant.second->update("farRadiusRescale" , m_farRadiusRescale);
+	}
+}
 
-	m_dofCompShader.update("disableNearField", m_disable_near_field);
-	m_dofCompShader.update("disableFarField" , m_disable_far_field);
+ShaderProgram* PostProcessing::DepthOfField::getDofCompShader()
+{
+	unsigned int mask = 0;
+	if (m_disable_near_field) { mask |= m_dofCompShaders.getMask("DISABLE_NEAR_FIELD"); }
+	if (m_disable_far_field)  { mask |= m_dofCompShaders.getMask("DISABLE_FAR_FIELD"); }
+	return m_dofCompShaders.get(mask);
 }
 
 PostProcessing::SkyboxRendering::SkyboxRendering(std::string fShader, std::string vShader, Renderable* skybox)
@@ -239,8 +271,15 @@ void PostProcessing::SkyboxRendering::render(GLuint cubeMapTexture, FrameBufferO
 	OPENGLCONTEXT->setEnabled(GL_DEPTH_TEST, false);
 }
 
-PostProcessing::SunOcclusionQuery::SunOcclusionQuery(GLuint depthTexture, glm::vec2 textureSize, Renderable* sun)
-	: m_occlusionShader("/screenSpace/postProcessSunOcclusionTest.vert", "/screenSpace/postProcessSunOcclusionTest.frag")
+PostProcessing::SunOcclusionQuery::SunOcclusionQuery(GLuint depthTexture, glm::vec2 textureSize, Renderable* sun, int numQueriesInFlight)
+	: lastNumVisiblePixels(0)
+	, m_occlusionShader("/screenSpace/postProcessSunOcclusionTest.vert", "/screenSpace/postProcessSunOcclusionTest.frag")
+	, m_queries(std::max(numQueriesInFlight, 1), 0)
+	, m_pending(m_queries.size(), false)
+	, m_nextQuery(0)
+	, m_lastIssuedQuery(-1)
+	, m_conditionalRenderActive(false)
+	, m_numSkippedQueries(0)
 {
 	m_occlusionFBO = new FrameBufferObject(m_occlusionShader.getOutputInfoMap(),16,16);
 	if (sun == nullptr)
@@ -253,7 +292,7 @@ PostProcessing::SunOcclusionQuery::SunOcclusionQuery(GLuint depthTexture, glm::v
 		ownRenderable = false;
 	}
 
-	glGenQueries(1, &mQueryId);
+	glGenQueries((GLsizei) m_queries.size(), &m_queries[0]);
 
 	if (depthTexture != -1)
 	{
@@ -264,33 +303,76 @@ PostProcessing::SunOcclusionQuery::SunOcclusionQuery(GLuint depthTexture, glm::v
 
 PostProcessing::SunOcclusionQuery::~SunOcclusionQuery()
 {
- 	glDeleteQueries(1, &mQueryId);
+	glDeleteQueries((GLsizei) m_queries.size(), &m_queries[0]);
 	delete m_occlusionFBO;
 }
 
 
+void PostProcessing::SunOcclusionQuery::collectResults()
+{
+	// queries complete in the order they were issued, so stop at the first pending one
+	for (unsigned int i = 0; i < m_queries.size(); i++)
+	{
+		int slot = (m_nextQuery + i) % m_queries.size();
+		if ( !m_pending[slot] ) { continue; }
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if ( available != GL_TRUE ) { break; }
+
+		glGetQueryObjectuiv(m_queries[slot], GL_QUERY_RESULT, &lastNumVisiblePixels);
+		m_pending[slot] = false;
+	}
+}
+
 GLuint PostProcessing::SunOcclusionQuery::performQuery(const glm::vec4& sunScreenPos)
 {
+	collectResults();
+
+	// all queries still pending: don't wait, keep the last result
+	if ( m_pending[m_nextQuery] )
+	{
+		m_numSkippedQueries++;
+		return lastNumVisiblePixels;
+	}
+
 	m_occlusionShader.update("lightData", sunScreenPos);
 
-	glBeginQuery(GL_SAMPLES_PASSED, mQueryId);
+	glBeginQuery(GL_SAMPLES_PASSED, m_queries[m_nextQuery]);
 	
 	m_occlusionShader.use();
 	m_occlusionFBO->bind();
 	glClear(GL_COLOR_BUFFER_BIT);
 	m_sun->draw();
 
-	GLuint queryState = GL_FALSE;
 	glEndQuery(GL_SAMPLES_PASSED);
-	while ( queryState != GL_TRUE)
-	{
-		glGetQueryObjectuiv(mQueryId, GL_QUERY_RESULT_AVAILABLE, &queryState);
-	}
-	glGetQueryObjectuiv(mQueryId, GL_QUERY_RESULT, &lastNumVisiblePixels);
+
+	m_pending[m_nextQuery] = true;
+	m_lastIssuedQuery = m_nextQuery;
+	m_nextQuery = (m_nextQuery + 1) % m_queries.size();
 
 	return lastNumVisiblePixels;
 }
 
+void PostProcessing::SunOcclusionQuery::beginConditionalRender(GLenum mode)
+{
+	if ( m_lastIssuedQuery < 0 || m_conditionalRenderActive ) { return; }
+	glBeginConditionalRender(m_queries[m_lastIssuedQuery], mode);
+	m_conditionalRenderActive = true;
+}
+
+void PostProcessing::SunOcclusionQuery::endConditionalRender()
+{
+	if ( !m_conditionalRenderActive ) { return; }
+	glEndConditionalRender();
+	m_conditionalRenderActive = false;
+}
+
+int PostProcessing::SunOcclusionQuery::getNumQueriesInFlight() const
+{
+	return (int) std::count(m_pending.begin(), m_pending.end(), true);
+}
+
 #include <Importing/stb_image.h>
 //#include <Rendering/GLTools.h>
 GLuint PostProcessing::LensFlare::loadLensColorTexture()
@@ -394,13 +476,22 @@ PostProcessing::LensFlare::~LensFlare()
 	delete m_featuresFBO;
 }
 
-void PostProcessing::LensFlare::renderLensFlare(GLuint sourceTexture, FrameBufferObject* target)
+void PostProcessing::LensFlare::renderLensFlare(GLuint sourceTexture, FrameBufferObject* target, SunOcclusionQuery* sunOcclusionQuery)
 {
 	GLint temp_viewport[4];
 	if ( target == 0)
 	{
 		glGetIntegerv( GL_VIEWPORT, temp_viewport );
 	}
+
+	if ( sunOcclusionQuery != nullptr )
+	{
+		// clear the blurred flares, so nothing is blended if the following passes are discarded
+		OPENGLCONTEXT->bindFBO(m_boxBlur->m_mipmapFBOHandles[0]);
+		glClear(GL_COLOR_BUFFER_BIT);
+		sunOcclusionQuery->beginConditionalRender();
+	}
+
 	// downsample
 	m_downSampleFBO->bind();
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -426,6 +517,11 @@ void PostProcessing::LensFlare::renderLensFlare(GLuint sourceTexture, FrameBuffe
 	m_boxBlur->pull();
 	m_boxBlur->push( m_blur_strength );
 
+	if ( sunOcclusionQuery != nullptr )
+	{
+		sunOcclusionQuery->endConditionalRender();
+	}
+
 	// render to target fbo
 	if ( target != nullptr )
 	{
@@ -1,4 +1,5 @@
 #include <Rendering/RenderPass.h>
+#include <Rendering/ShaderPermutations.h>
 class Quad;
 
 namespace PostProcessing
@@ -39,7 +40,7 @@ namespace PostProcessing
 
 		ShaderProgram m_calcCoCShader;
 		ShaderProgram m_dofShader;
-		ShaderProgram m_dofCompShader;
+		ShaderPermutations m_dofCompShaders; //!< variants with DISABLE_NEAR_FIELD / DISABLE_FAR_FIELD compiled out, see getDofCompShader()
 
 		void execute(GLuint positionMap, GLuint colorMap); 
 		
@@ -53,6 +54,7 @@ namespace PostProcessing
 
 		bool m_disable_near_field;
 		bool m_disable_far_field;
+		ShaderProgram* getDofCompShader(); //!< variant matching the disable flags
 
 		// Imgui
 		void imguiInterfaceEditParameters();
@@ -77,21 +79,39 @@ namespace PostProcessing
 		bool ownSkybox;
 	};
 
+	/* counts the visible pixels of the sun with occlusion queries, without waiting for the GPU:
+	 * up to numQueriesInFlight queries are pending at once and performQuery returns the most recent completed result,
+	 * i.e. the count lags a few frames behind. Use beginConditionalRender to decide on the GPU in the same frame */
 	class SunOcclusionQuery
 	{
 	public:
-		GLuint mQueryId;
-		GLuint lastNumVisiblePixels;
+		GLuint lastNumVisiblePixels; // most recent completed result, 0 until the first query completes
 
-		SunOcclusionQuery(GLuint depthTexture = -1, glm::vec2 textureSize = glm::vec2(1.0f,1.0f), Renderable* sun = nullptr);
+		SunOcclusionQuery(GLuint depthTexture = -1, glm::vec2 textureSize = glm::vec2(1.0f,1.0f), Renderable* sun = nullptr, int numQueriesInFlight = 3);
 		~SunOcclusionQuery();
 
-		GLuint performQuery(const glm::vec4& sunScreenPos);
+		GLuint performQuery(const glm::vec4& sunScreenPos); // issue a query (unless all are pending) and return lastNumVisiblePixels
+
+		// rendering commands in between are discarded by the GPU if no sample passed the most recently issued query
+		void beginConditionalRender(GLenum mode = GL_QUERY_WAIT);
+		void endConditionalRender();
+
+		int getNumQueriesInFlight() const; // currently pending queries
+		unsigned int getNumSkippedQueries() const { return m_numSkippedQueries; } // queries not issued because all were pending
 
 		ShaderProgram m_occlusionShader;
 		FrameBufferObject* m_occlusionFBO;
 
 	private:
+		void collectResults(); // read the results of completed queries, oldest first
+
+		std::vector<GLuint> m_queries; // ring buffer of query objects
+		std::vector<bool> m_pending;   // per query: issued, but result not read yet
+		int m_nextQuery;               // the slot to issue next, which is also the oldest one
+		int m_lastIssuedQuery;         // -1 before the first query
+		bool m_conditionalRenderActive;
+		unsigned int m_numSkippedQueries;
+
 		Renderable* m_sun;
 		bool ownRenderable;
 
@@ -107,7 +127,8 @@ namespace PostProcessing
 		LensFlare(int width, int height);
 		~LensFlare();
 
-		void renderLensFlare(GLuint sourceTexture, FrameBufferObject* target = nullptr);
+		// if an occlusion query is provided, the flare passes are skipped on the GPU while the sun is occluded
+		void renderLensFlare(GLuint sourceTexture, FrameBufferObject* target = nullptr, SunOcclusionQuery* sunOcclusionQuery = nullptr);
 
 		GLuint m_lensColorTexture;
 		GLuint m_lensStarTexture;
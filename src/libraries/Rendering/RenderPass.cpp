@@ -2,6 +2,62 @@
 
 #include "Rendering/OpenGLContext.h"
 
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+	const int SHADER_KEY_SHIFT  = 52; // 12 bit
+	const int TEXTURE_KEY_SHIFT = 36; // 16 bit
+	const uint64_t DEPTH_KEY_MASK = (1u << 20) - 1;
+
+	// the lower 36 bits hold vao (16 bit) and depth (20 bit), their order depends on the SortOrder
+	const int STATE_FIRST_VAO_SHIFT   = 20;
+	const int STATE_FIRST_DEPTH_SHIFT = 0;
+	const int DEPTH_FIRST_VAO_SHIFT   = 0;
+	const int DEPTH_FIRST_DEPTH_SHIFT = 16;
+
+	/// for non-negative floats the bit pattern has the same order as the value, the top 20 bits keep about 3 decimal digits
+	inline uint64_t depthKey(float depth)
+	{
+		if ( !(depth > 0.0f) ) { return 0; } // also catches NaN
+		uint32_t bits;
+		std::memcpy(&bits, &depth, sizeof(float));
+		return (bits >> 11) & DEPTH_KEY_MASK;
+	}
+
+	/// LSD radix sort with 8 bit digits, digits that are equal for all keys are skipped
+	void radixSort(std::vector<uint64_t>& keys, std::vector<unsigned int>& values, std::vector<uint64_t>& tempKeys, std::vector<unsigned int>& tempValues)
+	{
+		const size_t n = keys.size();
+		tempKeys.resize(n);
+		tempValues.resize(n);
+
+		for (int shift = 0; shift < 64; shift += 8)
+		{
+			unsigned int offsets[256] = {0};
+			for (size_t i = 0; i < n; i++) { offsets[(keys[i] >> shift) & 0xFF]++; }
+			if ( offsets[(keys[0] >> shift) & 0xFF] == n ) { continue; } // all keys share this digit
+
+			unsigned int sum = 0;
+			for (int d = 0; d < 256; d++)
+			{
+				unsigned int count = offsets[d];
+				offsets[d] = sum;
+				sum += count;
+			}
+			for (size_t i = 0; i < n; i++)
+			{
+				unsigned int target = offsets[(keys[i] >> shift) & 0xFF]++;
+				tempKeys[target] = keys[i];
+				tempValues[target] = values[i];
+			}
+			keys.swap(tempKeys);
+			values.swap(tempValues);
+		}
+	}
+}
+
 RenderPass::RenderPass(ShaderProgram* shaderProgram, FrameBufferObject* fbo)
 {
 	m_shaderProgram = shaderProgram;
@@ -9,6 +65,13 @@ RenderPass::RenderPass(ShaderProgram* shaderProgram, FrameBufferObject* fbo)
 	m_viewport = glm::vec4(-1.0f);
 	
 	p_perRenderableFunction = nullptr;
+	p_sortInfoFunction = nullptr;
+	m_sortedSubmission = false;
+	m_sortOrder = SORT_DEPTH_FIRST;
+	m_meshPool = nullptr;
+	m_pipelineStateHash = 0;
+	m_hasPipelineState = false;
+	std::memset(&m_statistics, 0, sizeof(SubmissionStatistics));
 
 	m_clearColor = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
 	if (fbo)
@@ -106,17 +169,7 @@ void RenderPass::render()
 	disableStates();
 
 	preRender();
-	for(unsigned int i = 0; i < m_renderables.size(); i++)
-	{
-		uploadUniforms();
-
-		if (p_perRenderableFunction != nullptr)
-		{
-			(*p_perRenderableFunction)(m_renderables[i]);
-		}
-
-		m_renderables[i]->draw();
-	}
+	drawRenderables(-1);
 	postRender();
 
 	restoreStates();
@@ -141,6 +194,28 @@ void RenderPass::renderInstanced(int numInstances)
 	disableStates();
 
 	preRender();
+	drawRenderables(numInstances);
+
+	postRender();
+	restoreStates();
+}
+
+void RenderPass::renderIndirect(GLuint indirectBuffer, unsigned int firstCommand)
+{
+	if (m_fbo){OPENGLCONTEXT->bindFBO(m_fbo->getFramebufferHandle( ) );}
+	else{OPENGLCONTEXT->bindFBO(0); }
+
+	m_shaderProgram->use();
+	if (m_viewport != glm::ivec4(-1)){ OPENGLCONTEXT->setViewport( (GLint) m_viewport.x, (GLint) m_viewport.y, (GLsizei) m_viewport.z, (GLsizei) m_viewport.w); }
+
+	clearBits();
+
+	enableStates();
+	disableStates();
+
+	preRender();
+	std::memset(&m_statistics, 0, sizeof(SubmissionStatistics));
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
 	for(unsigned int i = 0; i < m_renderables.size(); i++)
 	{
 		uploadUniforms();
@@ -148,13 +223,137 @@ void RenderPass::renderInstanced(int numInstances)
 		{
 			(*p_perRenderableFunction)(m_renderables[i]);
 		}
-		m_renderables[i]->drawInstanced( numInstances );
+
+		m_renderables[i]->bind();
+		glDrawElementsIndirect(m_renderables[i]->m_mode, m_renderables[i]->m_indexType, (const GLvoid*) ((firstCommand + i) * sizeof(DrawElementsIndirectCommand)));
 	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	OPENGLCONTEXT->bindVAO(0);
+	m_statistics.numDraws = (unsigned int) m_renderables.size();
+	m_statistics.numIndirectCommands = (unsigned int) m_renderables.size();
 
 	postRender();
 	restoreStates();
 }
 
+void RenderPass::drawRenderables(int numInstances)
+{
+	OpenGLContext::BindCounters issued = OPENGLCONTEXT->bindsIssued;
+	OpenGLContext::BindCounters avoided = OPENGLCONTEXT->bindsAvoided;
+	std::memset(&m_statistics, 0, sizeof(SubmissionStatistics));
+
+	if ( m_meshPool != nullptr )
+	{
+		m_pooledRenderables.clear();
+		for(unsigned int i = 0; i < m_renderables.size(); i++)
+		{
+			PooledRenderable* pooled = dynamic_cast<PooledRenderable*>(m_renderables[i]);
+			if ( pooled != nullptr && pooled->getMeshPool() == m_meshPool )
+			{
+				m_pooledRenderables.push_back(pooled);
+				continue;
+			}
+
+			uploadUniforms();
+			if (p_perRenderableFunction != nullptr)
+			{
+				(*p_perRenderableFunction)(m_renderables[i]);
+			}
+
+			if ( numInstances < 0 ) { m_renderables[i]->draw(); }
+			else { m_renderables[i]->drawInstanced( numInstances ); }
+			m_statistics.numDraws++;
+		}
+
+		if ( !m_pooledRenderables.empty() )
+		{
+			uploadUniforms();
+			m_meshPool->drawIndirect(m_pooledRenderables, std::max(numInstances, 1), m_shaderProgram);
+			m_statistics.numDraws++;
+			m_statistics.numIndirectCommands = (unsigned int) m_pooledRenderables.size();
+			m_statistics.uniformUploadsAvoided = (unsigned int) ((m_pooledRenderables.size() - 1) * m_uniforms.size());
+		}
+	}
+	else if ( !m_sortedSubmission )
+	{
+		for(unsigned int i = 0; i < m_renderables.size(); i++)
+		{
+			uploadUniforms();
+			if (p_perRenderableFunction != nullptr)
+			{
+				(*p_perRenderableFunction)(m_renderables[i]);
+			}
+
+			if ( numInstances < 0 ) { m_renderables[i]->draw(); }
+			else { m_renderables[i]->drawInstanced( numInstances ); }
+		}
+	}
+	else
+	{
+		sortRenderables();
+
+		// uniforms do not depend on the Renderable, so once is enough
+		uploadUniforms();
+		if ( !m_renderables.empty() )
+		{
+			m_statistics.uniformUploadsAvoided = (unsigned int) ((m_renderables.size() - 1) * m_uniforms.size());
+		}
+
+		OPENGLCONTEXT->setDeferVAOUnbind(true);
+		for(unsigned int i = 0; i < m_sortedOrder.size(); i++)
+		{
+			Renderable* renderable = m_renderables[ m_sortedOrder[i] ];
+			if (p_perRenderableFunction != nullptr)
+			{
+				(*p_perRenderableFunction)(renderable);
+			}
+
+			if ( numInstances < 0 ) { renderable->draw(); }
+			else { renderable->drawInstanced( numInstances ); }
+		}
+		OPENGLCONTEXT->setDeferVAOUnbind(false);
+	}
+
+	if ( m_meshPool == nullptr )
+	{
+		m_statistics.numDraws = (unsigned int) m_renderables.size();
+	}
+	m_statistics.vaoBindsIssued      = OPENGLCONTEXT->bindsIssued.vao      - issued.vao;
+	m_statistics.vaoBindsAvoided     = OPENGLCONTEXT->bindsAvoided.vao     - avoided.vao;
+	m_statistics.textureBindsIssued  = OPENGLCONTEXT->bindsIssued.texture  - issued.texture;
+	m_statistics.textureBindsAvoided = OPENGLCONTEXT->bindsAvoided.texture - avoided.texture;
+	m_statistics.shaderBindsAvoided  = OPENGLCONTEXT->bindsAvoided.shader  - avoided.shader;
+}
+
+void RenderPass::sortRenderables()
+{
+	const size_t n = m_renderables.size();
+	m_sortKeys.resize(n);
+	m_sortedOrder.resize(n);
+	if ( n == 0 ) { return; }
+
+	uint64_t shaderKey = (m_shaderProgram) ? ((uint64_t) (m_shaderProgram->getShaderProgramHandle() & 0xFFF) << SHADER_KEY_SHIFT) : 0;
+	int vaoShift   = (m_sortOrder == SORT_DEPTH_FIRST) ? DEPTH_FIRST_VAO_SHIFT   : STATE_FIRST_VAO_SHIFT;
+	int depthShift = (m_sortOrder == SORT_DEPTH_FIRST) ? DEPTH_FIRST_DEPTH_SHIFT : STATE_FIRST_DEPTH_SHIFT;
+	SortInfo sortInfo = {0, 0.0f};
+	for (size_t i = 0; i < n; i++)
+	{
+		if ( p_sortInfoFunction != nullptr )
+		{
+			sortInfo = (*p_sortInfoFunction)(m_renderables[i]);
+		}
+
+		// handles are truncated, collisions only cost sorting quality
+		m_sortKeys[i] = shaderKey
+			| ((uint64_t) (sortInfo.texture & 0xFFFF) << TEXTURE_KEY_SHIFT)
+			| ((uint64_t) (m_renderables[i]->m_vao & 0xFFFF) << vaoShift)
+			| (depthKey(sortInfo.depth) << depthShift);
+		m_sortedOrder[i] = (unsigned int) i;
+	}
+
+	radixSort(m_sortKeys, m_sortedOrder, m_sortKeysTemp, m_sortedOrderTemp);
+}
+
 void RenderPass::postRender()
 {
 }
@@ -162,6 +361,43 @@ void RenderPass::postRender()
 void RenderPass::setPerRenderableFunction(std::function<void(Renderable*)>* perRenderableFunction)
 {p_perRenderableFunction = perRenderableFunction;}
 
+void RenderPass::setSortedSubmission(bool enabled)
+{m_sortedSubmission = enabled;}
+
+bool RenderPass::getSortedSubmission() const
+{return m_sortedSubmission;}
+
+void RenderPass::setSortOrder(SortOrder sortOrder)
+{m_sortOrder = sortOrder;}
+
+RenderPass::SortOrder RenderPass::getSortOrder() const
+{return m_sortOrder;}
+
+void RenderPass::setSortInfoFunction(std::function<SortInfo(Renderable*)>* sortInfoFunction)
+{p_sortInfoFunction = sortInfoFunction;}
+
+const RenderPass::SubmissionStatistics& RenderPass::getSubmissionStatistics() const
+{return m_statistics;}
+
+void RenderPass::setMeshPool(MeshPool* meshPool)
+{m_meshPool = meshPool;}
+
+MeshPool* RenderPass::getMeshPool()
+{return m_meshPool;}
+
+void RenderPass::setPipelineState(const PipelineState& pipelineState)
+{
+	m_pipelineState = pipelineState;
+	m_pipelineStateHash = pipelineState.hash();
+	m_hasPipelineState = true;
+}
+
+void RenderPass::clearPipelineState()
+{m_hasPipelineState = false;}
+
+const PipelineState* RenderPass::getPipelineState() const
+{return m_hasPipelineState ? &m_pipelineState : nullptr;}
+
 void RenderPass::addRenderable(Renderable* renderable)
 {
 	m_renderables.push_back(renderable);
@@ -199,9 +435,14 @@ void RenderPass::addDisable(GLenum state)
 
 void RenderPass::enableStates()
 {
+	if ( m_hasPipelineState )
+	{
+		OPENGLCONTEXT->applyPipelineState(m_pipelineState, m_pipelineStateHash);
+	}
+
 	for (unsigned int i = 0; i < m_enable.size(); i++)
 	{
-		m_enableTEMP[i] = OPENGLCONTEXT->isEnabled(i);	
+		m_enableTEMP[i] = OPENGLCONTEXT->isEnabled(m_enable[i]);
 		OPENGLCONTEXT->setEnabled(m_enable[i], true);
 	}
 }
@@ -210,7 +451,7 @@ void RenderPass::disableStates()
 {
 	for (unsigned int i = 0; i < m_disable.size(); i++)
 	{
-		m_disableTEMP[i] = OPENGLCONTEXT->isEnabled(i);
+		m_disableTEMP[i] = OPENGLCONTEXT->isEnabled(m_disable[i]);
 		OPENGLCONTEXT->setEnabled(m_disable[i], false);
 	}
 }
@@ -5,14 +5,45 @@
 #include "Rendering/FrameBufferObject.h"
 #include "Rendering/ShaderProgram.h"
 #include "Rendering/Uniform.h"
+#include "Rendering/MeshPool.h"
+#include "Rendering/OpenGLContext.h"
 
 #include <vector>
 #include <functional>
+#include <cstdint>
 
 // template<typename T>
 // struct vecUniform : public std::vector< Uniform<T>* > {};
 
 class RenderPass{
+public:
+	/** @brief per-Renderable information used to build the sort keys of sorted submission */
+	struct SortInfo
+	{
+		GLuint texture; //!< the texture that is most expensive to rebind (e.g. albedo), 0 if none
+		float depth;    //!< e.g. view space distance, smaller values are drawn first
+	};
+
+	/** @brief bit layout of the sort keys below shader and texture, both keep renderables with the same shader and texture together */
+	enum SortOrder
+	{
+		SORT_DEPTH_FIRST, //!< shader | texture | depth | vao: front-to-back within a material, for opaque passes (default)
+		SORT_STATE_FIRST  //!< shader | texture | vao | depth: fewest VAO binds, depth only orders draws of the same VAO
+	};
+
+	/** @brief state changes caused by the last render() or renderInstanced() call, filtered binds are those the OpenGLContext cache skipped */
+	struct SubmissionStatistics
+	{
+		unsigned int numDraws;              //!< draw calls issued, a multi draw counts once
+		unsigned int numIndirectCommands;   //!< renderables drawn by the multi draw
+		unsigned int vaoBindsIssued;
+		unsigned int vaoBindsAvoided;
+		unsigned int textureBindsIssued;
+		unsigned int textureBindsAvoided;
+		unsigned int shaderBindsAvoided;
+		unsigned int uniformUploadsAvoided; //!< uploadUniforms() calls saved by sorted submission
+	};
+
 protected:
 	glm::ivec4 m_viewport;
 	glm::vec4 m_clearColor;
@@ -29,10 +60,29 @@ protected:
 	std::vector< bool > m_enableTEMP;
 	std::vector< bool > m_disableTEMP;
 
+	PipelineState m_pipelineState;
+	uint64_t m_pipelineStateHash; //!< hashed once in setPipelineState
+	bool m_hasPipelineState;
+
 	std::vector< Uploadable* > m_uniforms;
 
 	std::function<void(Renderable* ) >* p_perRenderableFunction;
 
+	bool m_sortedSubmission;
+	std::function<SortInfo(Renderable* ) >* p_sortInfoFunction;
+	SortOrder m_sortOrder;
+	std::vector< uint64_t > m_sortKeys;        //!< rebuilt every frame, see SortOrder
+	std::vector< unsigned int > m_sortedOrder; //!< indices into m_renderables in key order
+	std::vector< uint64_t > m_sortKeysTemp;    //!< radix sort ping-pong buffers
+	std::vector< unsigned int > m_sortedOrderTemp;
+	SubmissionStatistics m_statistics;
+
+	MeshPool* m_meshPool;
+	std::vector< PooledRenderable* > m_pooledRenderables; //!< rebuilt every frame
+
+	void sortRenderables(); //!< builds keys and radix sorts them into m_sortedOrder
+	void drawRenderables(int numInstances); //!< draws all renderables in insertion or key order, numInstances < 0 uses draw() instead of drawInstanced()
+
 public:
 	/**
 	 * @param shader ShaderProgram to be used with this RenderPass
@@ -49,11 +99,47 @@ public:
 	virtual void uploadUniforms(); //!< @deprecated calls all Uniform objects omitted using addUniform to upload their values, executed per Renderable. Currently kinda outdated/deprecated, should be revised
 	virtual void render(); //!< execute this renderpass
 	virtual void renderInstanced(int numInstances); //!< like render(), but every renderable is drawn usin drawInstanced(numInstances)
+
+	/** @brief like render(), but the k-th renderable is drawn with glDrawElementsIndirect using command firstCommand + k of indirectBuffer
+	 * 
+	 * e.g. with the commands written by Culling::GPUCulling. Renderables must be indexed, sorting and mesh pool do not apply.
+	 */
+	virtual void renderIndirect(GLuint indirectBuffer, unsigned int firstCommand = 0);
 	virtual void postRender(); //!< executed after looping over all Renderables, virtual method that may be overridden in a derived class
 	virtual void restoreStates(); //!< resores all OpenGL states that were altered by enableStates and disableStates
 
 	void setPerRenderableFunction(std::function<void(Renderable*)>* perRenderableFunction); //!< set pointer to a std::function object that will be called with each Renderable before calling its draw() method
 
+	/** @brief opt-in: draw renderables ordered by shader, texture, front-to-back depth and VAO instead of insertion order (see setSortOrder)
+	 * 
+	 * uniforms added via addUniform are uploaded once per pass instead of per Renderable and VAOs stay bound between draws of the same VAO,
+	 * so the per renderable function should not bind element array buffers.
+	 */
+	void setSortedSubmission(bool enabled);
+	bool getSortedSubmission() const;
+	void setSortOrder(SortOrder sortOrder); //!< whether depth or VAO is sorted first among renderables with the same shader and texture
+	SortOrder getSortOrder() const;
+	void setSortInfoFunction(std::function<SortInfo(Renderable*)>* sortInfoFunction); //!< set pointer to a std::function object that provides texture and depth for sort keys, if not set only VAOs are sorted
+	const SubmissionStatistics& getSubmissionStatistics() const; //!< counters of the last render() call
+
+	/** @brief opt-in: draw all renderables of this pool with one glMultiDrawElementsIndirect call
+	 * 
+	 * pooled renderables are drawn in insertion order, the n-th one gets draw index n (see MeshPool). Per renderable function,
+	 * sorting and per renderable uniform uploads do not apply to them. Other renderables are drawn as usual before the multi draw.
+	 * @param meshPool nullptr to disable
+	 */
+	void setMeshPool(MeshPool* meshPool);
+	MeshPool* getMeshPool();
+
+	/** @brief opt-in: apply a complete PipelineState block in enableStates() instead of individual glEnable/glDisable calls
+	 * 
+	 * the OpenGLContext only issues the calls for state that differs from the previous block, states added via addEnable/addDisable
+	 * are applied afterwards. The block is not restored by restoreStates(), the next pass simply applies its own block.
+	 */
+	void setPipelineState(const PipelineState& pipelineState);
+	void clearPipelineState(); //!< back to addEnable/addDisable only
+	const PipelineState* getPipelineState() const; //!< nullptr if none is set
+
 	void setViewport(int x, int y, int width, int height); //!< if set, glViewport will be called with these values before rendering (if RenderPass is constructed with a FBO, it is initialized to the FBO's dimensions)
 	void setClearColor(float r, float g, float b, float a = 1.0f); //!< if GL_COLOR_BUFFER_BIT is omitted to addClearBit, this color is omitted to glClearColor before glClear is called
 
@@ -0,0 +1,146 @@
+#include "RingBuffer.h"
+
+#include <cstring>
+
+#include <Core/DebugLog.h>
+
+static const GLuint64 FENCE_TIMEOUT = 1000000000; // 1 second in nanoseconds, per wait
+
+RingBuffer::RingBuffer(GLsizeiptr frameSize, GLenum target, unsigned int numFrames)
+	: m_target(target),
+	m_buffer(0),
+	m_alignment(256),
+	m_numFrames(numFrames > 0 ? numFrames : 1),
+	m_persistent(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage),
+	m_mapped(nullptr),
+	m_flushedUpTo(0),
+	m_frame(0),
+	m_frameStarted(false),
+	m_frameBegin(0),
+	m_head(0),
+	m_numStalls(0)
+{
+	glGetIntegerv( (target == GL_SHADER_STORAGE_BUFFER) ? GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT : GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_alignment);
+	if ( m_alignment <= 0 ) { m_alignment = 256; }
+
+	// every slot starts aligned
+	m_frameSize = ((frameSize + m_alignment - 1) / m_alignment) * m_alignment;
+	m_fences.resize(m_numFrames, 0);
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(m_target, m_buffer);
+	if ( m_persistent )
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(m_target, m_frameSize * m_numFrames, NULL, flags);
+		m_mapped = (char*) glMapBufferRange(m_target, 0, m_frameSize * m_numFrames, flags);
+		if ( m_mapped == nullptr )
+		{
+			DEBUGLOG->log("WARNING: RingBuffer: persistent mapping failed, falling back to glBufferSubData");
+			m_persistent = false;
+			glDeleteBuffers(1, &m_buffer); // storage is immutable, start over
+			glGenBuffers(1, &m_buffer);
+			glBindBuffer(m_target, m_buffer);
+		}
+	}
+	if ( !m_persistent )
+	{
+		glBufferData(m_target, m_frameSize * m_numFrames, NULL, GL_DYNAMIC_DRAW);
+		m_staging.resize(m_frameSize);
+	}
+	glBindBuffer(m_target, 0);
+}
+
+RingBuffer::~RingBuffer()
+{
+	for (unsigned int i = 0; i < m_fences.size(); i++)
+	{
+		if ( m_fences[i] != 0 ) { glDeleteSync(m_fences[i]); }
+	}
+	if ( m_mapped != nullptr )
+	{
+		glBindBuffer(m_target, m_buffer);
+		glUnmapBuffer(m_target);
+		glBindBuffer(m_target, 0);
+	}
+	glDeleteBuffers(1, &m_buffer);
+}
+
+void RingBuffer::beginFrame()
+{
+	if ( m_frameStarted )
+	{
+		flushStaging();
+
+		// everything submitted so far may read the current slot
+		if ( m_fences[m_frame] != 0 ) { glDeleteSync(m_fences[m_frame]); }
+		m_fences[m_frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_frame = (m_frame + 1) % m_numFrames;
+	}
+	m_frameStarted = true;
+
+	GLsync& fence = m_fences[m_frame];
+	if ( fence != 0 )
+	{
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if ( status == GL_TIMEOUT_EXPIRED )
+		{
+			m_numStalls++;
+			do {
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+			} while ( status == GL_TIMEOUT_EXPIRED );
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	m_frameBegin = m_frame * m_frameSize;
+	m_head = m_frameBegin;
+	m_flushedUpTo = m_frameBegin;
+}
+
+RingBuffer::Allocation RingBuffer::allocate(GLsizeiptr size)
+{
+	Allocation allocation = { nullptr, 0, 0 };
+	if ( !m_frameStarted ) { beginFrame(); }
+
+	GLintptr offset = ((m_head + m_alignment - 1) / m_alignment) * m_alignment;
+	if ( offset + size > m_frameBegin + m_frameSize )
+	{
+		DEBUGLOG->log("WARNING: RingBuffer: frame slot is full, bytes requested: ", (int) size);
+		return allocation;
+	}
+
+	m_head = offset + size;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.data = ( m_persistent ) ? (void*) (m_mapped + offset) : (void*) (&m_staging[0] + (offset - m_frameBegin));
+	return allocation;
+}
+
+RingBuffer::Allocation RingBuffer::upload(const void* data, GLsizeiptr size)
+{
+	Allocation allocation = allocate(size);
+	if ( allocation.data != nullptr )
+	{
+		std::memcpy(allocation.data, data, size);
+	}
+	return allocation;
+}
+
+void RingBuffer::bindRange(GLuint bindingPoint, const Allocation& allocation)
+{
+	if ( allocation.data == nullptr ) { return; }
+	flushStaging();
+	glBindBufferRange(m_target, bindingPoint, m_buffer, allocation.offset, allocation.size);
+}
+
+void RingBuffer::flushStaging()
+{
+	if ( m_persistent || m_head <= m_flushedUpTo ) { return; }
+
+	glBindBuffer(m_target, m_buffer);
+	glBufferSubData(m_target, m_flushedUpTo, m_head - m_flushedUpTo, &m_staging[0] + (m_flushedUpTo - m_frameBegin));
+	glBindBuffer(m_target, 0);
+	m_flushedUpTo = m_head;
+}
@@ -0,0 +1,66 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <vector>
+#include <GL/glew.h>
+
+/** @brief per-frame allocator for uniform or shader storage data in one persistently mapped buffer
+ *
+ * the buffer is split into numFrames slots (triple buffering by default). Every frame allocates from its own slot and
+ * binds the allocations with glBindBufferRange. Before a slot is reused, beginFrame() waits for the fence placed after the frame
+ * that last wrote it, so the CPU never overwrites data the GPU still reads and the driver never has to copy.
+ * Without OpenGL 4.4 / ARB_buffer_storage, allocations are staged on the CPU and uploaded with glBufferSubData in bindRange().
+ */
+class RingBuffer
+{
+public:
+	struct Allocation
+	{
+		void* data;        //!< write the data here before bindRange(), nullptr if the allocation failed
+		GLintptr offset;   //!< byte offset in the buffer
+		GLsizeiptr size;   //!< byte size
+	};
+
+	/**
+	 * @param frameSize bytes available per frame
+	 * @param target GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER, determines the offset alignment
+	 * @param numFrames number of frames that may be in flight
+	 */
+	RingBuffer(GLsizeiptr frameSize, GLenum target = GL_UNIFORM_BUFFER, unsigned int numFrames = 3);
+	~RingBuffer();
+
+	void beginFrame(); //!< fences the commands of the previous frame and switches to the next slot, waits if the GPU still uses it
+
+	Allocation allocate(GLsizeiptr size); //!< aligned sub-allocation in the current slot
+	Allocation upload(const void* data, GLsizeiptr size); //!< allocate() and copy data into it
+	void bindRange(GLuint bindingPoint, const Allocation& allocation); //!< glBindBufferRange on the buffer target
+
+	inline GLuint getBufferHandle() const { return m_buffer; }
+	inline bool isPersistent() const { return m_persistent; }
+	inline GLsizeiptr getFrameSize() const { return m_frameSize; }
+	inline GLsizeiptr getUsedSize() const { return m_head - m_frameBegin; } //!< bytes allocated in the current frame
+	inline unsigned int getNumStalls() const { return m_numStalls; } //!< how often beginFrame() had to wait for the GPU
+
+private:
+	void flushStaging(); //!< uploads staged allocations that were not uploaded yet (non persistent mode only)
+
+	GLenum m_target;
+	GLuint m_buffer;
+	GLsizeiptr m_frameSize;
+	GLint m_alignment;
+	unsigned int m_numFrames;
+	bool m_persistent;
+
+	char* m_mapped;               //!< persistent mapping of the whole buffer
+	std::vector<char> m_staging;  //!< CPU copy of the current slot without persistent mapping
+	GLintptr m_flushedUpTo;       //!< absolute offset up to which staged data was uploaded
+
+	std::vector<GLsync> m_fences;
+	unsigned int m_frame;         //!< current slot
+	bool m_frameStarted;
+	GLintptr m_frameBegin;        //!< absolute offset of the current slot
+	GLintptr m_head;              //!< next free absolute offset
+	unsigned int m_numStalls;
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
 
 Shader::Shader(const GLuint &type)
 {
@@ -54,6 +55,17 @@ void Shader::loadFromString(const std::string &sourceString)
 }
     
 void Shader::loadFromFile(const std::string &filename)
+{
+    readFile(filename, m_source);
+    
+    // Get the source string as a pointer to an array of characters
+    const char *sourceChars = m_source.c_str();
+    
+    // Associate the source with the shader id
+    glShaderSource(m_id, 1, &sourceChars, NULL);
+}
+
+bool Shader::readFile(const std::string &filename, std::string &source)
 {
     std::ifstream file;
         
@@ -62,7 +74,8 @@ void Shader::loadFromFile(const std::string &filename)
     if (!file.good() )
     {
 		DEBUGLOG->log("ERROR: Failed to open file: " + filename);
-        // exit(-1);
+        source.clear();
+        return false;
     }
     
     // Create a string stream
@@ -75,20 +88,24 @@ void Shader::loadFromFile(const std::string &filename)
     file.close();
         
     // Convert the StringStream into a string
-    m_source = stream.str();
-    
-    // Get the source string as a pointer to an array of characters
-    const char *sourceChars = m_source.c_str();
-    
-    // Associate the source with the shader id
-    glShaderSource(m_id, 1, &sourceChars, NULL);
+    source = stream.str();
+    return true;
 }
 
-void Shader::compile()
+bool Shader::compile()
+{
+    startCompile();
+    return checkCompileStatus();
+}
+
+void Shader::startCompile()
 {
     // Compile the shader
     glCompileShader(m_id);
-    
+}
+
+bool Shader::checkCompileStatus()
+{
     // Check the compilation status and report any errors
     GLint shaderStatus;
     glGetShaderiv(m_id, GL_COMPILE_STATUS, &shaderStatus);
@@ -104,10 +121,94 @@ void Shader::compile()
         
 		DEBUGLOG->log(m_typeString + " shader compilation failed: " + strInfoLog );
         delete[] strInfoLog;
-        glfwTerminate();
+        return false;
     }
-    else
+
+	DEBUGLOG->log(m_typeString + " shader compilation OK" );
+    return true;
+}
+
+namespace
+{
+    std::string getDirectory(const std::string &filename)
     {
-		DEBUGLOG->log(m_typeString + " shader compilation OK" );
+        size_t separator = filename.find_last_of("/\\");
+        return ( separator == std::string::npos ) ? std::string() : filename.substr(0, separator + 1);
     }
+
+    /// the file name of an #include "file" directive, empty if the line is none
+    std::string parseInclude(const std::string &line)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if ( start == std::string::npos || line.compare(start, 8, "#include") != 0 ) { return std::string(); }
+        size_t open = line.find('"', start + 8);
+        size_t close = ( open == std::string::npos ) ? open : line.find('"', open + 1);
+        if ( close == std::string::npos ) { return std::string(); }
+        return line.substr(open + 1, close - open - 1);
+    }
+
+    bool isVersionLine(const std::string &line)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        return start != std::string::npos && line.compare(start, 8, "#version") == 0;
+    }
+
+    bool expandIncludes(const std::string &filename, const std::vector<std::string> &defines, std::vector<std::string> &files, std::stringstream &result)
+    {
+        std::string source;
+        if ( !Shader::readFile(filename, source) ) { return false; }
+
+        bool ok = true;
+        int fileIndex = (int) files.size() - 1;
+        bool isRoot = ( fileIndex == 0 );
+        bool definesInserted = false;
+        std::stringstream lines(source);
+        std::string line;
+        int lineNumber = 0;
+
+        // without #version, the defines go first
+        if ( isRoot && source.find("#version") == std::string::npos )
+        {
+            for (unsigned int i = 0; i < defines.size(); i++) { result << "#define " << defines[i] << "\n"; }
+            result << "#line 1 0\n";
+            definesInserted = true;
+        }
+
+        while ( std::getline(lines, line) )
+        {
+            lineNumber++;
+            std::string include = parseInclude(line);
+            if ( !include.empty() )
+            {
+                std::string path = ( include[0] == '/' ) ? SHADERS_PATH + include : getDirectory(filename) + include;
+                if ( std::find(files.begin(), files.end(), path) == files.end() )
+                {
+                    files.push_back(path);
+                    result << "#line 1 " << files.size() - 1 << "\n";
+                    ok = expandIncludes(path, defines, files, result) && ok;
+                }
+                result << "#line " << lineNumber + 1 << " " << fileIndex << "\n";
+                continue;
+            }
+
+            result << line << "\n";
+            if ( isRoot && !definesInserted && isVersionLine(line) )
+            {
+                for (unsigned int i = 0; i < defines.size(); i++) { result << "#define " << defines[i] << "\n"; }
+                result << "#line " << lineNumber + 1 << " 0\n";
+                definesInserted = true;
+            }
+        }
+        return ok;
+    }
+}
+
+bool Shader::preprocess(const std::string &filename, const std::vector<std::string> &defines, std::string &result, std::vector<std::string>* includedFiles)
+{
+    std::vector<std::string> files(1, filename);
+    std::stringstream stream;
+    bool ok = expandIncludes(filename, defines, files, stream);
+    result = stream.str();
+    if ( includedFiles != nullptr ) { *includedFiles = files; }
+    return ok;
 }
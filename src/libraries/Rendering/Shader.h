@@ -2,6 +2,7 @@
 #define SHADER_H
 
 #include <string>
+#include <vector>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
@@ -39,8 +40,36 @@ public:
     /**
     * @brief Compile a shader and display any problems if compilation fails.
     * 
+    * @return true if the shader compiled
     */
-    void compile();
+    bool compile();
+
+    void startCompile(); //!< issue the compilation without waiting for it, see checkCompileStatus()
+    bool checkCompileStatus(); //!< waits for the compilation and displays any problems, true if the shader compiled
+
+    /**
+    * @brief Reads a whole text file
+    * 
+    * @param filename filename of the shader
+    * @param source target string
+    * @return false if the file could not be opened
+    */
+    static bool readFile(const std::string &filename, std::string &source);
+
+    /**
+    * @brief Reads a shader file and resolves its #include "file" directives
+    * 
+    * Included paths are relative to the including file or, starting with '/', to SHADERS_PATH. Every file is included once.
+    * The defines are inserted after the #version line. #line directives keep the line numbers of compile errors,
+    * the source string number is the index of the file in includedFiles.
+    * 
+    * @param filename filename of the shader
+    * @param defines i.e. "USE_SHADOWS" or "NUM_LIGHTS 4"
+    * @param result target string
+    * @param includedFiles (optional) filename first, then every included file
+    * @return false if a file could not be opened
+    */
+    static bool preprocess(const std::string &filename, const std::vector<std::string> &defines, std::string &result, std::vector<std::string>* includedFiles = nullptr);
 
     inline GLuint getId()           {return m_id;}  //!< Get the shader id (handle).
     inline std::string getSource()  {return m_source;} //!< get the shader source code as string.
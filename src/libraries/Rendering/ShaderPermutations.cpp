@@ -0,0 +1,93 @@
+#include "ShaderPermutations.h"
+
+#include "Core/DebugLog.h"
+
+ShaderPermutations::ShaderPermutations(const std::vector<std::pair<GLenum, std::string> >& stages, const std::vector<std::string>& features)
+	: m_stages(stages)
+	, m_features(features)
+{
+#ifdef GL_KHR_parallel_shader_compile
+	if ( GLEW_KHR_parallel_shader_compile )
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF); // as many as the driver likes
+	}
+#endif
+}
+
+ShaderPermutations::~ShaderPermutations()
+{
+	for (auto variant : m_variants)
+	{
+		delete variant.second;
+	}
+}
+
+ShaderProgram* ShaderPermutations::get(unsigned int mask)
+{
+	auto it = m_variants.find(mask);
+	if ( it != m_variants.end() )
+	{
+		return it->second;
+	}
+
+	std::vector<unsigned int> masks(1, mask);
+	compile(masks);
+	return m_variants[mask];
+}
+
+void ShaderPermutations::compile(const std::vector<unsigned int>& masks)
+{
+	// issue every compilation first ...
+	std::vector<ShaderProgram*> started;
+	for (unsigned int i = 0; i < masks.size(); i++)
+	{
+		if ( m_variants.find(masks[i]) != m_variants.end() ) { continue; }
+		ShaderProgram* variant = new ShaderProgram(m_stages, getDefines(masks[i]), true);
+		m_variants[masks[i]] = variant;
+		started.push_back(variant);
+	}
+
+	// ... then collect them, those that are done first
+	while ( !started.empty() )
+	{
+		unsigned int next = 0;
+		while ( next < started.size() && !started[next]->isBuildComplete() ) { next++; }
+		if ( next == started.size() ) { next = 0; } // none done yet, wait for the first
+
+		if ( !started[next]->finishBuild() )
+		{
+			DEBUGLOG->log("ERROR: shader variant failed: " + m_stages[0].second);
+		}
+		started.erase(started.begin() + next);
+	}
+}
+
+void ShaderPermutations::compileAll()
+{
+	std::vector<unsigned int> masks;
+	for (unsigned int mask = 0; mask < (1u << m_features.size()); mask++)
+	{
+		masks.push_back(mask);
+	}
+	compile(masks);
+}
+
+unsigned int ShaderPermutations::getMask(const std::string& feature) const
+{
+	for (unsigned int i = 0; i < m_features.size(); i++)
+	{
+		if ( m_features[i] == feature ) { return 1u << i; }
+	}
+	DEBUGLOG->log("ERROR: unknown shader feature: " + feature);
+	return 0;
+}
+
+std::vector<std::string> ShaderPermutations::getDefines(unsigned int mask) const
+{
+	std::vector<std::string> defines;
+	for (unsigned int i = 0; i < m_features.size(); i++)
+	{
+		if ( mask & (1u << i) ) { defines.push_back(m_features[i]); }
+	}
+	return defines;
+}
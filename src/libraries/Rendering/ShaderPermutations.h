@@ -0,0 +1,44 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include "ShaderProgram.h"
+
+#include <unordered_map>
+#include <vector>
+#include <string>
+
+/** @brief variants of one shader program, specialized with #defines instead of branching on uniforms
+ *
+ * Every feature is a bit of a mask; the variant of a mask is compiled with "#define <feature>" for every set bit, so the
+ * shaders can use #ifdef <feature>. Variants are created on first use, or up front with compile(), which issues all
+ * compilations before waiting for any of them so drivers with GL_KHR_parallel_shader_compile build them in parallel.
+ * Each variant is an ordinary ShaderProgram (binary cache, hot reload). Uniform values and textures are per variant.
+ */
+class ShaderPermutations
+{
+public:
+	/**
+	 * @param stages shader type (i.e. GL_VERTEX_SHADER) and path of every shader
+	 * @param features names of the defines, feature i is bit (1 << i)
+	 */
+	ShaderPermutations(const std::vector<std::pair<GLenum, std::string> >& stages, const std::vector<std::string>& features);
+	~ShaderPermutations(); //!< deletes all variants
+
+	ShaderProgram* get(unsigned int mask); //!< the variant, compiled now if it does not exist yet
+	void compile(const std::vector<unsigned int>& masks); //!< create several variants at once
+	void compileAll(); //!< every combination of features
+
+	unsigned int getMask(const std::string& feature) const; //!< bit of a feature, 0 if unknown
+	std::vector<std::string> getDefines(unsigned int mask) const;
+	inline const std::unordered_map<unsigned int, ShaderProgram*>& getVariants() const { return m_variants; }
+
+private:
+	ShaderPermutations(const ShaderPermutations&);            // owns programs
+	ShaderPermutations& operator=(const ShaderPermutations&);
+
+	std::vector<std::pair<GLenum, std::string> > m_stages;
+	std::vector<std::string> m_features;
+	std::unordered_map<unsigned int, ShaderProgram*> m_variants;
+};
+
+#endif
@@ -8,181 +8,378 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <sys/stat.h>
 #include <glm/gtc/type_ptr.hpp>
 
 using namespace std;
 
-ShaderProgram::ShaderProgram(std::string vertexshader, std::string fragmentshader) 
+namespace
 {
-    // Initially, we have zero shaders attached to the program
-	m_shaderCount = 0;
+	const char BINARY_MAGIC[8] = { 'E', 'Z', 'R', 'P', 'R', 'O', 'G', '\0' };
+	const unsigned int BINARY_VERSION = 1;
 
-	// Generate a unique Id / handle for the shader program
-	// Note: We MUST have a valid rendering context before generating
-	// the m_shaderProgramHandle or it causes a segfault!
-	m_shaderProgramHandle = glCreateProgram();
+	struct BinaryHeader
+	{
+		char magic[8];
+		unsigned int version;
+		unsigned long long key; //!< hash of the driver and all sources
+		GLenum binaryFormat;
+		GLint length;
+	};
+
+	unsigned long long hashString(const std::string& string, unsigned long long hash = 14695981039346656037ULL) // FNV-1a
+	{
+		for (size_t i = 0; i < string.size(); i++)
+		{
+			hash ^= (unsigned char) string[i];
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	long long getModificationTime(const std::string& path)
+	{
+		struct stat info;
+		if ( stat(path.c_str(), &info) != 0 ) { return 0; }
+		return (long long) info.st_mtime;
+	}
+
+	bool isBinaryCacheSupported()
+	{
+		static GLint numFormats = -1;
+		if ( numFormats < 0 ) { glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats); }
+		return numFormats > 0;
+	}
 
-    //Set up fragment shader
-    Shader vertexShader(GL_VERTEX_SHADER);
-	vertexShader.loadFromFile(SHADERS_PATH + vertexshader);
-	vertexShader.compile();
+	/// a binary only matches the driver it was created with
+	std::string getDriverString()
+	{
+		const char* vendor = (const char*) glGetString(GL_VENDOR);
+		const char* renderer = (const char*) glGetString(GL_RENDERER);
+		const char* version = (const char*) glGetString(GL_VERSION);
+		return std::string(vendor ? vendor : "") + "|" + (renderer ? renderer : "") + "|" + (version ? version : "");
+	}
 
- 	//Set up fragment shader
-	Shader fragmentShader(GL_FRAGMENT_SHADER);
-	fragmentShader.loadFromFile(SHADERS_PATH + fragmentshader);
-	fragmentShader.compile();
+	bool loadProgramBinary(GLuint program, const std::string& path, unsigned long long key)
+	{
+		std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+		if ( !file.is_open() ) { return false; }
 
-	//readOutputs(fragmentShader);
+		BinaryHeader header;
+		file.read((char*) &header, sizeof(BinaryHeader));
+		if ( !file || memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) != 0 || header.version != BINARY_VERSION || header.key != key || header.length <= 0 )
+		{
+			return false;
+		}
 
-	// Set up shader program
-	attachShader(vertexShader);
-	attachShader(fragmentShader);
-	link();
+		std::vector<char> binary(header.length);
+		file.read(&binary[0], header.length);
+		if ( !file ) { return false; }
 
-    mapShaderProperties(GL_UNIFORM, &m_uniformMap);
-    mapShaderProperties(GL_PROGRAM_INPUT, &m_inputMap);
-    mapShaderProperties(GL_PROGRAM_OUTPUT, &m_outputMap);
+		glProgramBinary(program, header.binaryFormat, &binary[0], header.length);
+		GLint linkStatus;
+		glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+		return linkStatus == GL_TRUE; // e.g. the driver was updated
+	}
 
-	// readUniforms();
+	void storeProgramBinary(GLuint program, const std::string& path, unsigned long long key)
+	{
+		BinaryHeader header;
+		memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+		header.version = BINARY_VERSION;
+		header.key = key;
+		header.length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &header.length);
+		if ( header.length <= 0 ) { return; }
+
+		std::vector<char> binary(header.length);
+		glGetProgramBinary(program, header.length, NULL, &header.binaryFormat, &binary[0]);
+
+		std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+		if ( !file.is_open() )
+		{
+			DEBUGLOG->log("WARNING: could not write shader program binary: " + path);
+			return;
+		}
+		file.write((const char*) &header, sizeof(BinaryHeader));
+		file.write(&binary[0], header.length);
+	}
 }
 
+std::vector<ShaderProgram*> ShaderProgram::s_programs;
+bool ShaderProgram::s_useBinaryCache = true;
 
-ShaderProgram::ShaderProgram(std::string vertexshader, std::string fragmentshader, std::string geometryshader) 
+ShaderProgram::ShaderProgram(std::string vertexshader, std::string fragmentshader) 
 {
-    
-    // Initially, we have zero shaders attached to the program
-	m_shaderCount = 0;
+	addStage(GL_VERTEX_SHADER, vertexshader);
+	addStage(GL_FRAGMENT_SHADER, fragmentshader);
+	initialize();
+}
 
-	// Generate a unique Id / handle for the shader program
-	// Note: We MUST have a valid rendering context before generating
-	// the m_shaderProgramHandle or it causes a segfault!
-	m_shaderProgramHandle = glCreateProgram();
+ShaderProgram::ShaderProgram(std::string vertexshader, std::string fragmentshader, std::string geometryshader) 
+{
+	addStage(GL_VERTEX_SHADER, vertexshader);
+	addStage(GL_FRAGMENT_SHADER, fragmentshader);
+	addStage(GL_GEOMETRY_SHADER, geometryshader);
+	initialize();
+}
 
-    Shader vertexShader(GL_VERTEX_SHADER);
-	vertexShader.loadFromFile(SHADERS_PATH + vertexshader);
-	vertexShader.compile();
+ShaderProgram::ShaderProgram(std::string vertexshader, std::string fragmentshader, std::string tessellationcontrollshader, std::string tessellationevaluationshader, std::string geometryshader) 
+{
+	addStage(GL_VERTEX_SHADER, vertexshader);
+	addStage(GL_TESS_CONTROL_SHADER, tessellationcontrollshader);
+	addStage(GL_TESS_EVALUATION_SHADER, tessellationevaluationshader);
+	addStage(GL_GEOMETRY_SHADER, geometryshader);
+	addStage(GL_FRAGMENT_SHADER, fragmentshader);
+	initialize();
+}
 
-	//Set up fragment shader
-	Shader fragmentShader(GL_FRAGMENT_SHADER);
-	fragmentShader.loadFromFile(SHADERS_PATH + fragmentshader);
-	fragmentShader.compile();
+ShaderProgram::ShaderProgram(std::string vertexshader, std::string fragmentshader, std::string tessellationcontrollshader, std::string tessellationevaluationshader) 
+{
+	addStage(GL_VERTEX_SHADER, vertexshader);
+	addStage(GL_TESS_CONTROL_SHADER, tessellationcontrollshader);
+	addStage(GL_TESS_EVALUATION_SHADER, tessellationevaluationshader);
+	addStage(GL_FRAGMENT_SHADER, fragmentshader);
+	initialize();
+}
 
-	//readOutputs(fragmentShader);
+ShaderProgram::ShaderProgram(std::string computeshader) 
+{
+	addStage(GL_COMPUTE_SHADER, computeshader);
+	initialize();
+}
 
-	Shader geometryShader(GL_GEOMETRY_SHADER);
-	geometryShader.loadFromFile(SHADERS_PATH + geometryshader);
-	geometryShader.compile();
+ShaderProgram::~ShaderProgram()
+{
+	s_programs.erase(std::remove(s_programs.begin(), s_programs.end(), this), s_programs.end());
 
-	// Set up shader program
-	attachShader(vertexShader);
-	attachShader(fragmentShader);
-	attachShader(geometryShader);
-    link();
+	// Delete the shader program from the graphics card memory to
+	// free all the resources it's been using
+	glDeleteProgram(m_shaderProgramHandle);
+}
 
-    mapShaderProperties(GL_UNIFORM, &m_uniformMap);
-    mapShaderProperties(GL_PROGRAM_INPUT, &m_inputMap);
-    mapShaderProperties(GL_PROGRAM_OUTPUT, &m_outputMap);
-	//readUniforms();
+ShaderProgram::ShaderProgram(const std::vector<std::pair<GLenum, std::string> >& stages, const std::vector<std::string>& defines)
+	: ShaderProgram(stages, defines, false)
+{
 }
 
-//ShaderProgram::ShaderProgram(std::string vertexshader, std::string fragmentshader, std::string tessellationcontrollshader, std::string tessellationevaluationshader) 
-ShaderProgram::ShaderProgram(std::string vertexshader, std::string fragmentshader, std::string tessellationcontrollshader, std::string tessellationevaluationshader, std::string geometryshader) 
+ShaderProgram::ShaderProgram(const std::vector<std::pair<GLenum, std::string> >& stages, const std::vector<std::string>& defines, bool deferBuild)
+	: m_defines(defines)
 {
-    // Initially, we have zero shaders attached to the program
+	for (unsigned int i = 0; i < stages.size(); i++) { addStage(stages[i].first, stages[i].second); }
+	if ( !deferBuild )
+	{
+		initialize();
+		return;
+	}
+
+	// finishBuild() is called by the owner
+	m_shaderProgramHandle = 0;
 	m_shaderCount = 0;
+	beginBuild();
+	s_programs.push_back(this);
+}
+
+void ShaderProgram::addStage(GLenum type, const std::string& path)
+{
+	Stage stage;
+	stage.type = type;
+	stage.path = SHADERS_PATH + path;
+	m_stages.push_back(stage);
+}
 
-	// Generate a unique Id / handle for the shader program
+void ShaderProgram::initialize()
+{
 	// Note: We MUST have a valid rendering context before generating
 	// the m_shaderProgramHandle or it causes a segfault!
-	m_shaderProgramHandle = glCreateProgram();
+	m_shaderProgramHandle = 0;
+	m_shaderCount = 0;
+	beginBuild();
+	if ( !finishBuild() )
+	{
+		glfwTerminate();
+	}
+	s_programs.push_back(this);
+}
 
-    Shader vertexShader(GL_VERTEX_SHADER);
-	vertexShader.loadFromFile(SHADERS_PATH + vertexshader);
-	vertexShader.compile();
+void ShaderProgram::beginBuild()
+{
+	m_pending = PendingBuild();
+	m_pending.active = true;
+	m_pending.previousProgram = m_shaderProgramHandle;
+
+	// the preprocessed sources (and the driver) are the key of the binary cache
+	m_pending.key = hashString(getDriverString());
+	std::string programName;
+	bool sourcesRead = true;
+	for (unsigned int i = 0; i < m_stages.size(); i++)
+	{
+		Stage& stage = m_stages[i];
+		sourcesRead = Shader::preprocess(stage.path, m_defines, stage.source, &stage.files) && sourcesRead;
+		stage.modificationTimes.clear();
+		for (unsigned int f = 0; f < stage.files.size(); f++) { stage.modificationTimes.push_back(getModificationTime(stage.files[f])); }
+		m_pending.key = hashString(DebugLog::to_string(stage.type) + stage.source, m_pending.key);
+		programName += stage.path + "|";
+	}
+	for (unsigned int i = 0; i < m_defines.size(); i++) { programName += m_defines[i] + "|"; }
 
-	Shader tessControllShader(GL_TESS_CONTROL_SHADER);
-	tessControllShader.loadFromFile(SHADERS_PATH + tessellationcontrollshader );
-	tessControllShader.compile();
-	
-	Shader tessEvalShader(GL_TESS_EVALUATION_SHADER);
-	tessEvalShader.loadFromFile(SHADERS_PATH + tessellationevaluationshader );
-	tessEvalShader.compile();
+	if ( !sourcesRead && m_pending.previousProgram != 0 ) // keep the current program
+	{
+		m_pending.failed = true;
+		return;
+	}
 
-	Shader geometryShader(GL_GEOMETRY_SHADER);
-	geometryShader.loadFromFile(SHADERS_PATH + geometryshader);
-	geometryShader.compile();
+	char nameHash[17];
+	snprintf(nameHash, sizeof(nameHash), "%08x", (unsigned int) hashString(programName));
+	m_pending.binaryPath = m_stages[0].path + "." + nameHash + ".ezrprog";
+	m_pending.useBinaryCache = s_useBinaryCache && isBinaryCacheSupported();
 
-	//Set up fragment shader
-	Shader fragmentShader(GL_FRAGMENT_SHADER);
-	fragmentShader.loadFromFile(SHADERS_PATH + fragmentshader);
-	fragmentShader.compile();
+	m_shaderProgramHandle = glCreateProgram();
+	m_shaderCount = 0;
 
-	//readOutputs(fragmentShader);
+	m_pending.fromBinary = m_pending.useBinaryCache && loadProgramBinary(m_shaderProgramHandle, m_pending.binaryPath, m_pending.key);
+	if ( m_pending.fromBinary )
+	{
+		return;
+	}
 
-	// Set up shader program
-	attachShader(vertexShader);
-	attachShader(tessControllShader);
-	attachShader(tessEvalShader);
-	attachShader(geometryShader);
-	attachShader(fragmentShader);
+	// only issue the commands here, drivers with parallel shader compilation work on them until finishBuild()
+	for (unsigned int i = 0; i < m_stages.size(); i++)
+	{
+		Shader shader(m_stages[i].type);
+		shader.loadFromString(m_stages[i].source);
+		shader.startCompile();
+		attachShader(shader);
+		m_pending.shaders.push_back(shader);
+	}
 
-    link();
+	if ( m_pending.useBinaryCache ) { glProgramParameteri(m_shaderProgramHandle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE); }
+	glLinkProgram(m_shaderProgramHandle);
+}
 
-    mapShaderProperties(GL_UNIFORM, &m_uniformMap);
-    mapShaderProperties(GL_PROGRAM_INPUT, &m_inputMap);
-    mapShaderProperties(GL_PROGRAM_OUTPUT, &m_outputMap);
-	//readUniforms();
+bool ShaderProgram::isBuildComplete() const
+{
+	if ( !m_pending.active || m_pending.failed || m_pending.fromBinary ) { return true; }
+#ifdef GL_KHR_parallel_shader_compile
+	if ( GLEW_KHR_parallel_shader_compile )
+	{
+		GLint completed = GL_TRUE;
+		glGetProgramiv(m_shaderProgramHandle, GL_COMPLETION_STATUS_KHR, &completed);
+		return completed == GL_TRUE;
+	}
+#endif
+	return true; // the status queries of finishBuild() will block
 }
 
-ShaderProgram::ShaderProgram(std::string vertexshader, std::string fragmentshader, std::string tessellationcontrollshader, std::string tessellationevaluationshader) 
+bool ShaderProgram::finishBuild()
 {
-    // Initially, we have zero shaders attached to the program
-	m_shaderCount = 0;
+	if ( !m_pending.active ) { return true; }
+	m_pending.active = false;
+	if ( m_pending.failed ) { return false; }
 
-	// Generate a unique Id / handle for the shader program
-	// Note: We MUST have a valid rendering context before generating
-	// the m_shaderProgramHandle or it causes a segfault!
-	m_shaderProgramHandle = glCreateProgram();
+	bool ok = m_pending.fromBinary;
+	if ( ok )
+	{
+		DEBUGLOG->log("Shader program loaded from binary: " + m_pending.binaryPath);
+	}
+	else
+	{
+		bool compiled = true;
+		for (unsigned int i = 0; i < m_pending.shaders.size(); i++)
+		{
+			if ( !m_pending.shaders[i].checkCompileStatus() )
+			{
+				compiled = false;
+				for (unsigned int f = 1; f < m_stages[i].files.size(); f++)
+				{
+					DEBUGLOG->log("source string " + DebugLog::to_string(f) + ": " + m_stages[i].files[f]);
+				}
+			}
+		}
 
-    Shader vertexShader(GL_VERTEX_SHADER);
-	vertexShader.loadFromFile(SHADERS_PATH + vertexshader);
-	vertexShader.compile();
+		int minShaderCount = (m_stages[0].type == GL_COMPUTE_SHADER) ? 1 : 2; // compute programs consist of a single shader
+		if ( m_shaderCount < minShaderCount )
+		{
+			DEBUGLOG->log("Can't link shaders - you need at least " + DebugLog::to_string(minShaderCount) + ", but attached shader count is only: " + DebugLog::to_string(m_shaderCount));
+		}
+		ok = compiled && m_shaderCount >= minShaderCount && checkLinkStatus();
 
-	Shader tessControllShader(GL_TESS_CONTROL_SHADER);
-	tessControllShader.loadFromFile(SHADERS_PATH + tessellationcontrollshader );
-	tessControllShader.compile();
-	
-	Shader tessEvalShader(GL_TESS_EVALUATION_SHADER);
-	tessEvalShader.loadFromFile(SHADERS_PATH + tessellationevaluationshader );
-	tessEvalShader.compile();
+		for (unsigned int i = 0; i < m_pending.shaders.size(); i++)
+		{
+			glDetachShader(m_shaderProgramHandle, m_pending.shaders[i].getId());
+			glDeleteShader(m_pending.shaders[i].getId());
+		}
+		m_pending.shaders.clear();
+		if ( ok && m_pending.useBinaryCache ) { storeProgramBinary(m_shaderProgramHandle, m_pending.binaryPath, m_pending.key); }
+	}
 
-	//Set up fragment shader
-	Shader fragmentShader(GL_FRAGMENT_SHADER);
-	fragmentShader.loadFromFile(SHADERS_PATH + fragmentshader);
-	fragmentShader.compile();
+	GLuint previousProgram = m_pending.previousProgram;
+	if ( !ok && previousProgram != 0 )
+	{
+		// hot reload failed, keep using the previous program
+		glDeleteProgram(m_shaderProgramHandle);
+		m_shaderProgramHandle = previousProgram;
+		return false;
+	}
 
-	//readOutputs(fragmentShader);
+	if ( previousProgram != 0 )
+	{
+		if ( OPENGLCONTEXT->cacheShader == previousProgram ) { OPENGLCONTEXT->useShader(m_shaderProgramHandle); }
+		glDeleteProgram(previousProgram);
+	}
 
-	// Set up shader program
-	attachShader(vertexShader);
-	attachShader(tessControllShader);
-	attachShader(tessEvalShader);
-	attachShader(fragmentShader);
-    link();
+	m_uniformMap.clear();
+	m_inputMap.clear();
+	m_outputMap.clear();
+	mapShaderProperties(GL_UNIFORM, &m_uniformMap);
+	createUniformHandles();
+	if ( m_stages[0].type != GL_COMPUTE_SHADER )
+	{
+		mapShaderProperties(GL_PROGRAM_INPUT, &m_inputMap);
+		mapShaderProperties(GL_PROGRAM_OUTPUT, &m_outputMap);
+	}
+	return ok;
+}
 
-    mapShaderProperties(GL_UNIFORM, &m_uniformMap);
-    mapShaderProperties(GL_PROGRAM_INPUT, &m_inputMap);
-    mapShaderProperties(GL_PROGRAM_OUTPUT, &m_outputMap);
-	//readUniforms();
+bool ShaderProgram::reload()
+{
+	DEBUGLOG->log("Reloading shader program " + m_stages[0].path); DEBUGLOG->indent();
+	finishBuild(); // a build that is still running
+	beginBuild();
+	bool ok = finishBuild();
+	if ( !ok ) { DEBUGLOG->log("ERROR: reload failed, keeping the previous version"); }
+	DEBUGLOG->outdent();
+	return ok;
 }
 
+bool ShaderProgram::hasChangedOnDisk() const
+{
+	for (unsigned int i = 0; i < m_stages.size(); i++)
+	{
+		for (unsigned int f = 0; f < m_stages[i].files.size(); f++)
+		{
+			if ( getModificationTime(m_stages[i].files[f]) != m_stages[i].modificationTimes[f] ) { return true; }
+		}
+	}
+	return false;
+}
 
+int ShaderProgram::reloadChangedPrograms()
+{
+	int numReloaded = 0;
+	for (unsigned int i = 0; i < s_programs.size(); i++)
+	{
+		if ( s_programs[i]->hasChangedOnDisk() && s_programs[i]->reload() ) { numReloaded++; }
+	}
+	return numReloaded;
+}
 
-ShaderProgram::~ShaderProgram()
+void ShaderProgram::setUseBinaryCache(bool use)
 {
-	// Delete the shader program from the graphics card memory to
-	// free all the resources it's been using
-	glDeleteProgram(m_shaderProgramHandle);
+	s_useBinaryCache = use;
 }
 
 GLint ShaderProgram::getShaderProgramHandle()
@@ -200,32 +397,33 @@ void ShaderProgram::attachShader(Shader shader)
 
 }
 
-void ShaderProgram::link()
+bool ShaderProgram::link(int minShaderCount)
 {
 	// If we have at least two shaders (like a vertex shader and a fragment shader)...
-	if (m_shaderCount >= 2)
+	if (m_shaderCount >= minShaderCount)
 	{
 		// Perform the linking process
 		glLinkProgram(m_shaderProgramHandle);
-		// Check the status
-		GLint linkStatus;
-		glGetProgramiv(m_shaderProgramHandle, GL_LINK_STATUS, &linkStatus);
-		if (linkStatus == GL_FALSE)
-		{
-			DEBUGLOG->log("ERROR: Shader program linking failed.");
-			printShaderProgramInfoLog();
-			glfwTerminate();
-		}
-		else
-		{
-			DEBUGLOG->log("Shader program linking OK.");
-		}
+		return checkLinkStatus();
 	}
-	else
+
+	DEBUGLOG->log("Can't link shaders - you need at least " + DebugLog::to_string(minShaderCount) + ", but attached shader count is only: " + DebugLog::to_string(m_shaderCount));
+	return false;
+}
+
+bool ShaderProgram::checkLinkStatus()
+{
+	// Check the status
+	GLint linkStatus;
+	glGetProgramiv(m_shaderProgramHandle, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus == GL_FALSE)
 	{
-		DEBUGLOG->log("Can't link shaders - you need at least 2, but attached shader count is only: " + DebugLog::to_string(m_shaderCount));
-		glfwTerminate();
+		DEBUGLOG->log("ERROR: Shader program linking failed.");
+		printShaderProgramInfoLog();
+		return false;
 	}
+	DEBUGLOG->log("Shader program linking OK.");
+	return true;
 }
 
 void ShaderProgram::printShaderProgramInfoLog() {
@@ -315,209 +513,273 @@ GLuint ShaderProgram::texture(const std::string &texture)
 	}
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, bool value) 
+ShaderProgram* ShaderProgram::update(const std::string& name, bool value) 
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.ints.find(name) ==  m_uniformCache.ints.end() || m_uniformCache.ints.at(name) != (int) value)
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform1i(u, value); 
-			m_uniformCache.ints[name] = (int) value;
-		}
-	return this;
+	return update(getUniformHandle(name), value);
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, int value) 
+ShaderProgram* ShaderProgram::update(const std::string& name, int value) 
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.ints.find(name) ==  m_uniformCache.ints.end() || m_uniformCache.ints.at(name) != value)
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform1i(u, value);
-			m_uniformCache.ints[name] = value;
-		}
-	return this;
+	return update(getUniformHandle(name), value);
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, float value) 
+ShaderProgram* ShaderProgram::update(const std::string& name, float value) 
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.floats.find(name) ==  m_uniformCache.floats.end() || m_uniformCache.floats.at(name) != value)
+	return update(getUniformHandle(name), value);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, double value) 
+{
+	return update(getUniformHandle(name), (float) value);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, const glm::ivec2& vector) 
+{
+	return update(getUniformHandle(name), vector);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, const glm::ivec3& vector) 
+{
+	return update(getUniformHandle(name), vector);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, const glm::ivec4& vector) 
+{
+	return update(getUniformHandle(name), vector);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, const glm::vec2& vector) 
+{
+	return update(getUniformHandle(name), vector);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, const glm::vec3& vector) 
+{
+	return update(getUniformHandle(name), vector);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, const glm::vec4& vector) 
+{
+	return update(getUniformHandle(name), vector);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, const glm::mat2& matrix) 
+{
+	return update(getUniformHandle(name), matrix);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, const glm::mat3& matrix) 
+{
+	return update(getUniformHandle(name), matrix);
+}
+
+ShaderProgram* ShaderProgram::update(const std::string& name, const glm::mat4& matrix) 
+{
+	return update(getUniformHandle(name), matrix);
+}
+
+UniformHandle ShaderProgram::getUniformHandle(const std::string& name) const
+{
+	auto it = m_uniformHandles.find(name);
+	if ( it != m_uniformHandles.end() )
+	{
+		return UniformHandle(it->second);
+	}
+	DEBUGLOG->log("ERROR: Could not find uniform in shader program: " + name);
+	return UniformHandle();
+}
+
+void ShaderProgram::createUniformHandles()
+{
+	// after a reload, names keep their index so handles stay valid; uniforms that are gone keep an inactive slot
+	for ( auto& slot : m_uniformSlots )
+	{
+		slot.location = -1;
+	}
+
+	for ( auto u : m_uniformMap )
+	{
+		auto it = m_uniformHandles.find(u.first);
+		if ( it != m_uniformHandles.end() )
 		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform1f(u, value); 
-			m_uniformCache.floats[name] = value;
+			m_uniformSlots[it->second].location = (GLint) u.second.location;
+			m_uniformSlots[it->second].type = u.second.type;
+			restoreUniform(UniformHandle(it->second));
+			continue;
 		}
 
+		UniformSlot slot;
+		slot.location = (GLint) u.second.location;
+		slot.type = u.second.type;
+		slot.valueType = 0;
+		memset(&slot.value, 0, sizeof(slot.value));
+
+		m_uniformHandles[u.first] = (int) m_uniformSlots.size();
+		m_uniformSlots.push_back(slot);
+	}
+}
+
+void ShaderProgram::restoreUniform(UniformHandle handle)
+{
+	UniformSlot& slot = m_uniformSlots[handle.index];
+	GLenum valueType = slot.valueType;
+	UniformSlot previous = slot;
+	slot.valueType = 0; // force the upload
+	const GLint* i = previous.value.i;
+	const GLfloat* f = previous.value.f;
+	switch (valueType)
+	{
+	case GL_INT:        update(handle, i[0]); break;
+	case GL_FLOAT:      update(handle, f[0]); break;
+	case GL_INT_VEC2:   update(handle, glm::make_vec2(i)); break;
+	case GL_INT_VEC3:   update(handle, glm::make_vec3(i)); break;
+	case GL_INT_VEC4:   update(handle, glm::make_vec4(i)); break;
+	case GL_FLOAT_VEC2: update(handle, glm::make_vec2(f)); break;
+	case GL_FLOAT_VEC3: update(handle, glm::make_vec3(f)); break;
+	case GL_FLOAT_VEC4: update(handle, glm::make_vec4(f)); break;
+	case GL_FLOAT_MAT2: update(handle, glm::make_mat2(f)); break;
+	case GL_FLOAT_MAT3: update(handle, glm::make_mat3(f)); break;
+	case GL_FLOAT_MAT4: update(handle, glm::make_mat4(f)); break;
+	default: break; // nothing was uploaded yet
+	}
+}
+
+void ShaderProgram::clearCache()
+{
+	for ( auto& slot : m_uniformSlots )
+	{
+		slot.valueType = 0;
+	}
+}
+
+ShaderProgram::UniformSlot* ShaderProgram::changedSlot(UniformHandle handle, GLenum valueType, const void* value, size_t size)
+{
+	if ( handle.index < 0 || handle.index >= (int) m_uniformSlots.size() ) { return nullptr; }
+
+	UniformSlot& slot = m_uniformSlots[handle.index];
+	if ( slot.location < 0 ) { return nullptr; } // e.g. member of a uniform block
+	if ( slot.valueType == valueType && memcmp(&slot.value, value, size) == 0 ) { return nullptr; }
+
+	slot.valueType = valueType;
+	memcpy(&slot.value, value, size);
+	return &slot;
+}
+
+ShaderProgram* ShaderProgram::update(UniformHandle handle, bool value)
+{
+	return update(handle, (int) value);
+}
+
+ShaderProgram* ShaderProgram::update(UniformHandle handle, int value)
+{
+	UniformSlot* slot = changedSlot(handle, GL_INT, &value, sizeof(value));
+	if ( slot != nullptr ) { glProgramUniform1i(m_shaderProgramHandle, slot->location, value); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, double value) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, float value)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.floats.find(name) ==  m_uniformCache.floats.end() || m_uniformCache.floats.at(name) != (float) value)
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform1f(u, (GLfloat) value);
-			m_uniformCache.floats[name] = (float) value;
-		}
+	UniformSlot* slot = changedSlot(handle, GL_FLOAT, &value, sizeof(value));
+	if ( slot != nullptr ) { glProgramUniform1f(m_shaderProgramHandle, slot->location, value); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const glm::ivec2& vector) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, const glm::ivec2& vector)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.ivecs.find(name) ==  m_uniformCache.ivecs.end() || m_uniformCache.ivecs.at(name) != glm::ivec4(vector,0,0))
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform2iv(u, 1, glm::value_ptr(vector)); 
-			m_uniformCache.ivecs[name] = glm::ivec4(vector,0,0);
-		}
+	UniformSlot* slot = changedSlot(handle, GL_INT_VEC2, glm::value_ptr(vector), sizeof(vector));
+	if ( slot != nullptr ) { glProgramUniform2iv(m_shaderProgramHandle, slot->location, 1, glm::value_ptr(vector)); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const glm::ivec3& vector) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, const glm::ivec3& vector)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.ivecs.find(name) ==  m_uniformCache.ivecs.end() || m_uniformCache.ivecs.at(name) != glm::ivec4(vector,0))
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform3iv(u, 1, glm::value_ptr(vector));
-			m_uniformCache.ivecs[name] = glm::ivec4(vector,0);
-		}
+	UniformSlot* slot = changedSlot(handle, GL_INT_VEC3, glm::value_ptr(vector), sizeof(vector));
+	if ( slot != nullptr ) { glProgramUniform3iv(m_shaderProgramHandle, slot->location, 1, glm::value_ptr(vector)); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name,const glm::ivec4& vector) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, const glm::ivec4& vector)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.ivecs.find(name) ==  m_uniformCache.ivecs.end() || m_uniformCache.ivecs.at(name) != vector)
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform4iv(u, 1, glm::value_ptr(vector));
-			m_uniformCache.ivecs[name] = vector;
-		}
+	UniformSlot* slot = changedSlot(handle, GL_INT_VEC4, glm::value_ptr(vector), sizeof(vector));
+	if ( slot != nullptr ) { glProgramUniform4iv(m_shaderProgramHandle, slot->location, 1, glm::value_ptr(vector)); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const glm::vec2& vector) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, const glm::vec2& vector)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.vecs.find(name) ==  m_uniformCache.vecs.end() || m_uniformCache.vecs.at(name) != glm::vec4(vector, 0.0f, 0.0f))
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform2fv(u, 1, glm::value_ptr(vector)); 
-			m_uniformCache.vecs[name] = glm::vec4(vector,0,0);
-		}
+	UniformSlot* slot = changedSlot(handle, GL_FLOAT_VEC2, glm::value_ptr(vector), sizeof(vector));
+	if ( slot != nullptr ) { glProgramUniform2fv(m_shaderProgramHandle, slot->location, 1, glm::value_ptr(vector)); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const glm::vec3& vector) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, const glm::vec3& vector)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.vecs.find(name) ==  m_uniformCache.vecs.end() || m_uniformCache.vecs.at(name) != glm::vec4(vector, 0.0f))
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform3fv(uniform(name), 1, glm::value_ptr(vector)); 
-			m_uniformCache.vecs[name] = glm::vec4(vector,0);
-		}
+	UniformSlot* slot = changedSlot(handle, GL_FLOAT_VEC3, glm::value_ptr(vector), sizeof(vector));
+	if ( slot != nullptr ) { glProgramUniform3fv(m_shaderProgramHandle, slot->location, 1, glm::value_ptr(vector)); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const glm::vec4& vector) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, const glm::vec4& vector)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.vecs.find(name) ==  m_uniformCache.vecs.end() || m_uniformCache.vecs.at(name) != vector)
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniform4fv(u, 1, glm::value_ptr(vector));
-			m_uniformCache.vecs[name] = vector;
-		}
+	UniformSlot* slot = changedSlot(handle, GL_FLOAT_VEC4, glm::value_ptr(vector), sizeof(vector));
+	if ( slot != nullptr ) { glProgramUniform4fv(m_shaderProgramHandle, slot->location, 1, glm::value_ptr(vector)); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const glm::mat2& matrix) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, const glm::mat2& matrix)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.mats.find(name) ==  m_uniformCache.mats.end() || m_uniformCache.mats.at(name) != glm::mat4(matrix))
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniformMatrix2fv(u, 1, GL_FALSE, glm::value_ptr(matrix)); 
-			m_uniformCache.mats[name] = glm::mat4(matrix);
-		}
+	UniformSlot* slot = changedSlot(handle, GL_FLOAT_MAT2, glm::value_ptr(matrix), sizeof(matrix));
+	if ( slot != nullptr ) { glProgramUniformMatrix2fv(m_shaderProgramHandle, slot->location, 1, GL_FALSE, glm::value_ptr(matrix)); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const glm::mat3& matrix) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, const glm::mat3& matrix)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.mats.find(name) == m_uniformCache.mats.end() || m_uniformCache.mats.at(name) != glm::mat4(matrix))
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniformMatrix3fv(u, 1, GL_FALSE, glm::value_ptr(matrix));
-			m_uniformCache.mats[name] = glm::mat4(matrix);
-		}
+	UniformSlot* slot = changedSlot(handle, GL_FLOAT_MAT3, glm::value_ptr(matrix), sizeof(matrix));
+	if ( slot != nullptr ) { glProgramUniformMatrix3fv(m_shaderProgramHandle, slot->location, 1, GL_FALSE, glm::value_ptr(matrix)); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const glm::mat4& matrix) 
+ShaderProgram* ShaderProgram::update(UniformHandle handle, const glm::mat4& matrix)
 {
-	auto u = uniform(name);
-	if ( u != (GLuint) -1)
-		if (m_uniformCache.mats.find(name) == m_uniformCache.mats.end() || m_uniformCache.mats.at(name) != matrix)
-		{
-			OPENGLCONTEXT->useShader(m_shaderProgramHandle);
-			glUniformMatrix4fv(u, 1, GL_FALSE, glm::value_ptr(matrix));
-			m_uniformCache.mats[name] = glm::mat4(matrix);
-		}
+	UniformSlot* slot = changedSlot(handle, GL_FLOAT_MAT4, glm::value_ptr(matrix), sizeof(matrix));
+	if ( slot != nullptr ) { glProgramUniformMatrix4fv(m_shaderProgramHandle, slot->location, 1, GL_FALSE, glm::value_ptr(matrix)); }
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const std::vector<int>& vector)
+ShaderProgram* ShaderProgram::update(const std::string& name, const std::vector<int>& vector)
 {
 	OPENGLCONTEXT->useShader(m_shaderProgramHandle);
 	auto u = uniform(name);
 	if ( u != (GLuint) -1)
-		glUniform1iv(u, sizeof(vector), &vector[0]);
+		glUniform1iv(u, (GLsizei) vector.size(), &vector[0]);
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const std::vector<glm::vec2>& vector) 
+ShaderProgram* ShaderProgram::update(const std::string& name, const std::vector<glm::vec2>& vector) 
 {
 	OPENGLCONTEXT->useShader(m_shaderProgramHandle);
 	auto u = uniform(name);
 	if ( u != (GLuint) -1)
-	glUniform2fv(u, sizeof(vector), glm::value_ptr((&vector[0])[0]));
+	glUniform2fv(u, (GLsizei) vector.size(), glm::value_ptr((&vector[0])[0]));
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const std::vector<glm::vec3>& vector) 
+ShaderProgram* ShaderProgram::update(const std::string& name, const std::vector<glm::vec3>& vector) 
 {
 	OPENGLCONTEXT->useShader(m_shaderProgramHandle);
 	auto u = uniform(name);
 	if ( u != (GLuint) -1)
-	glUniform3fv(u, sizeof(vector), glm::value_ptr((&vector[0])[0]));
+	glUniform3fv(u, (GLsizei) vector.size(), glm::value_ptr((&vector[0])[0]));
 	return this;
 }
 
-ShaderProgram* ShaderProgram::update(std::string name, const std::vector<glm::vec4>& vector) 
+ShaderProgram* ShaderProgram::update(const std::string& name, const std::vector<glm::vec4>& vector) 
 {
 	OPENGLCONTEXT->useShader(m_shaderProgramHandle);
 	auto u = uniform(name);
 	if ( u != (GLuint) -1)
-	glUniform4fv(u, sizeof(vector), glm::value_ptr((&vector[0])[0]));
+	glUniform4fv(u, (GLsizei) vector.size(), glm::value_ptr((&vector[0])[0]));
 	return this;
 }
 
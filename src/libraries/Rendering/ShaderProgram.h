@@ -9,16 +9,13 @@
 #include <glm/glm.hpp>
 
 /**
-* @brief a simple struct that holds maps to cache current uniforms
+* @brief dense index of an active uniform of one ShaderProgram, see ShaderProgram::getUniformHandle()
 */
-struct UniformCache
+struct UniformHandle
 {
-	std::unordered_map<std::string, float> floats;
-	std::unordered_map<std::string, glm::vec4> vecs;
-	std::unordered_map<std::string, glm::ivec4> ivecs;
-	std::unordered_map<std::string, glm::mat4> mats;
-	std::unordered_map<std::string, int> ints;
-	void clearCache(){ floats.clear(); vecs.clear(); ivecs.clear(); mats.clear(); ints.clear(); }
+	int index; //!< index into the uniform shadow array, -1 if invalid
+	explicit UniformHandle(int index = -1) : index(index) {}
+	inline bool isValid() const { return index >= 0; }
 };
 
 class ShaderProgram
@@ -58,12 +55,48 @@ public:
 	ShaderProgram(std::string vertexshader, std::string fragmentshader, std::string tessellationcontrollshader, std::string tessellationevaluationshader);
 
 
+	/**
+	 * @brief Constructor for compute programs
+	 * 
+	 * @param computeshader path to the computeshader
+	 * 
+	 */
+	explicit ShaderProgram(std::string computeshader);
+
+	/**
+	 * @brief Constructor for any combination of shaders, with a list of defines (see Shader::preprocess)
+	 * 
+	 * @param stages shader type (i.e. GL_VERTEX_SHADER) and path of every shader
+	 * @param defines i.e. "USE_SHADOWS" or "NUM_LIGHTS 4"
+	 * 
+	 */
+	ShaderProgram(const std::vector<std::pair<GLenum, std::string> >& stages, const std::vector<std::string>& defines = std::vector<std::string>());
+
 	/**
 	 * @brief Destructor
 	 * 
 	 */
 	~ShaderProgram();
 
+	/**
+	 * @brief reads the shader files again and rebuilds the program
+	 * @details if anything fails (i.e. a compile error), the previous program is kept. Uniform handles stay valid and
+	 * uniform values set with update() are uploaded to the new program again. Uniform block bindings that were
+	 * set from the application (instead of a layout qualifier) have to be set again.
+	 * @return true if the new program is in use
+	 */
+	bool reload();
+	bool hasChangedOnDisk() const; //!< true if a shader file (or an included file) was modified since the last (re)load
+	bool isBuildComplete() const; //!< false while the driver is still compiling in the background (GL_KHR_parallel_shader_compile)
+	static int reloadChangedPrograms(); //!< reload every existing program with modified shader files (hot reload), returns the number of programs reloaded. render() (GLTools.h) calls it about once per second
+
+	/**
+	 * @brief use the program binary cache (default: on)
+	 * @details linked programs are stored with glGetProgramBinary next to their first shader file (*.ezrprog) and loaded with
+	 * glProgramBinary as long as the sources and the driver did not change, compiling is skipped then
+	 */
+	static void setUseBinaryCache(bool use);
+
 	GLint getShaderProgramHandle(); //!< returns the program handle
 
 	/**
@@ -74,7 +107,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, bool value);
+	ShaderProgram* update(const std::string& name, bool value);
 	/**
 	 * @brief Updates an integer uniform variable
 	 * 
@@ -83,7 +116,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, int value);
+	ShaderProgram* update(const std::string& name, int value);
 	/**
 	 * @brief Updates a float uniform variable
 	 * 
@@ -92,7 +125,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, float value);
+	ShaderProgram* update(const std::string& name, float value);
 	/**
 	 * @brief Updates a double uniform variable
 	 * 
@@ -101,7 +134,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, double value);
+	ShaderProgram* update(const std::string& name, double value);
 	/**
 	 * @brief Updates a 2D integer vector uniform variable
 	 * 
@@ -110,7 +143,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const glm::ivec2& vector);
+	ShaderProgram* update(const std::string& name, const glm::ivec2& vector);
 	/**
 	 * @brief Updates a 3D integer vector uniform variable
 	 * 
@@ -119,7 +152,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const glm::ivec3& vector);
+	ShaderProgram* update(const std::string& name, const glm::ivec3& vector);
 	/**
 	 * @brief Updates a 4D integer vector uniform variable
 	 * 
@@ -128,7 +161,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const glm::ivec4& vector);
+	ShaderProgram* update(const std::string& name, const glm::ivec4& vector);
 	/**
 	 * @brief Updates a 2D float vector uniform variable
 	 * 
@@ -137,7 +170,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const glm::vec2& vector);
+	ShaderProgram* update(const std::string& name, const glm::vec2& vector);
 	/**
 	 * @brief Updates a 3D float vector uniform variable
 	 * 
@@ -146,7 +179,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const glm::vec3& vector);
+	ShaderProgram* update(const std::string& name, const glm::vec3& vector);
 	/**
 	 * @brief Updates a 4D float vector uniform variable
 	 * 
@@ -155,7 +188,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const glm::vec4& vector);
+	ShaderProgram* update(const std::string& name, const glm::vec4& vector);
 	/**
 	 * @brief Updates a 2x2 matrix uniform variable
 	 * 
@@ -164,7 +197,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const glm::mat2& matrix);
+	ShaderProgram* update(const std::string& name, const glm::mat2& matrix);
 	/**
 	 * @brief Updates a 3x3 matrix uniform variable
 	 * 
@@ -173,7 +206,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const glm::mat3& matrix);
+	ShaderProgram* update(const std::string& name, const glm::mat3& matrix);
 	/**
 	 * @brief Updates a 4x4 matrix uniform variable
 	 * 
@@ -182,7 +215,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const glm::mat4& matrix);
+	ShaderProgram* update(const std::string& name, const glm::mat4& matrix);
 	/**
 	 * @brief Updates a list of 2D vector uniform variables
 	 *
@@ -191,7 +224,7 @@ public:
 	 *
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const std::vector<int>& vector);
+	ShaderProgram* update(const std::string& name, const std::vector<int>& vector);
 	/**
 	 * @brief Updates a list of 2D vector uniform variables
 	 * 
@@ -200,7 +233,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const std::vector<glm::vec2>& vector);
+	ShaderProgram* update(const std::string& name, const std::vector<glm::vec2>& vector);
 	/**
 	 * @brief Updates a list of 3D vector uniform variables
 	 * 
@@ -209,7 +242,7 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const std::vector<glm::vec3>& vector);
+	ShaderProgram* update(const std::string& name, const std::vector<glm::vec3>& vector);
 	/**
 	 * @brief Updates a list of 4D vector uniform variables
 	 * 
@@ -218,7 +251,40 @@ public:
 	 * 
 	 * @return The shader program
 	 */
-	ShaderProgram* update(std::string name, const std::vector<glm::vec4>& vector);
+	ShaderProgram* update(const std::string& name, const std::vector<glm::vec4>& vector);
+
+	/**
+	 * @brief resolves a uniform name to a handle, meant to be called once after construction
+	 * 
+	 * @param name 	Name of the uniform variable in GLSL, array uniforms are named like "name[0]"
+	 * 
+	 * @return the handle, invalid if the uniform is not active in this program
+	 */
+	UniformHandle getUniformHandle(const std::string& name) const;
+
+	/**
+	 * @brief Updates a uniform variable through a handle of this program
+	 * 
+	 * no string work is done; the value is compared with a shadow copy and only uploaded (with glProgramUniform*) if it changed.
+	 * Updates through invalid handles are ignored.
+	 * 
+	 * @param handle handle from getUniformHandle()
+	 * @param value The value to update the unform with
+	 * 
+	 * @return The shader program
+	 */
+	ShaderProgram* update(UniformHandle handle, bool value);
+	ShaderProgram* update(UniformHandle handle, int value);
+	ShaderProgram* update(UniformHandle handle, float value);
+	ShaderProgram* update(UniformHandle handle, const glm::ivec2& vector);
+	ShaderProgram* update(UniformHandle handle, const glm::ivec3& vector);
+	ShaderProgram* update(UniformHandle handle, const glm::ivec4& vector);
+	ShaderProgram* update(UniformHandle handle, const glm::vec2& vector);
+	ShaderProgram* update(UniformHandle handle, const glm::vec3& vector);
+	ShaderProgram* update(UniformHandle handle, const glm::vec4& vector);
+	ShaderProgram* update(UniformHandle handle, const glm::mat2& matrix);
+	ShaderProgram* update(UniformHandle handle, const glm::mat3& matrix);
+	ShaderProgram* update(UniformHandle handle, const glm::mat4& matrix);
 
 	/**
 	 * @brief binds a texture to a OpenGL texture unit and updates the corresponding uniform
@@ -262,8 +328,7 @@ public:
 	inline std::unordered_map<std::string, Info>* getOutputInfoMap(){return &m_outputMap;} //!< returns the Texturemap
 	inline std::unordered_map<std::string, Info>* getInputInfoMap(){return &m_inputMap;} //!< returns the Texturemap
 	inline std::unordered_map<std::string, GLuint>* getTextureMap()	{return &m_textureMap;} //!< returns the Texturemap
-	inline UniformCache* uniformCache(){return &m_uniformCache;}; // returns the Uniform Cache
-	inline void clearCache(){ m_uniformCache.clearCache(); };
+	void clearCache(); //!< forget all shadowed uniform values, so the next update of every uniform is uploaded
 	/**
 	 * @brief Logs all active bound uniforms to the console
 	 */
@@ -333,9 +398,54 @@ protected:
 	 * @brief Method to link the shader program and display the link status
 	 * 
 	 * @param shader shader to attach
-	 * 
+	 * @return true if linking succeeded
+	 */
+	bool link(int minShaderCount = 2); //!< compute programs consist of a single shader
+
+	/**
+	 * @brief a shader file of this program
+	 */
+	struct Stage
+	{
+		GLenum type;
+		std::string path;                         //!< including SHADERS_PATH
+		std::string source;                       //!< as last read, preprocessed
+		std::vector<std::string> files;           //!< path and included files
+		std::vector<long long> modificationTimes; //!< of the files when they were last read
+	};
+
+	/**
+	 * @brief state between beginBuild() and finishBuild()
 	 */
-	void link();
+	struct PendingBuild
+	{
+		bool active;
+		bool failed;                 //!< sources could not be read
+		bool fromBinary;
+		bool useBinaryCache;
+		GLuint previousProgram;      //!< 0 for the first build
+		std::vector<Shader> shaders; //!< compiling
+		std::string binaryPath;
+		unsigned long long key;
+		PendingBuild() : active(false), failed(false), fromBinary(false), useBinaryCache(false), previousProgram(0), key(0) {}
+	};
+
+	friend class ShaderPermutations;
+	ShaderProgram(const std::vector<std::pair<GLenum, std::string> >& stages, const std::vector<std::string>& defines, bool deferBuild); //!< if deferBuild, finishBuild() has to be called before use
+
+	bool checkLinkStatus(); //!< waits for linking and displays any problems
+
+	void addStage(GLenum type, const std::string& path); //!< path relative to SHADERS_PATH
+	void initialize(); //!< first build, called by the constructors
+	void beginBuild(); //!< preprocesses the stage files and starts creating the program, from the binary cache if possible
+	bool finishBuild(); //!< waits for compiling and linking, replaces the current program if it succeeded
+
+	std::vector<Stage> m_stages;
+	std::vector<std::string> m_defines;
+	PendingBuild m_pending;
+
+	static std::vector<ShaderProgram*> s_programs; //!< all existing programs, for reloadChangedPrograms()
+	static bool s_useBinaryCache;
 
 	// Handle of the shader program
 	GLuint m_shaderProgramHandle;
@@ -359,8 +469,28 @@ protected:
 	// Map of texture handles that will be bound to the associated (sampler-) name when use() is called
 	std::unordered_map<std::string, GLuint> m_textureMap;
 
-	// contains maps to check for old uniforms before issuing OpenGL commands
-	UniformCache m_uniformCache;
+	/**
+	 * @brief shadow copy of a uniform value, checked before issuing OpenGL commands
+	 */
+	struct UniformSlot
+	{
+		GLint location;
+		GLenum type;      //!< type of the uniform in GLSL
+		GLenum valueType; //!< type of the last uploaded value, 0 if nothing was uploaded since linking or clearCache()
+		union { GLint i[4]; GLfloat f[16]; } value;
+	};
+
+	/**
+	 * @brief compares a value with the shadow copy of a uniform and stores it
+	 * @return the slot if the value has to be uploaded, nullptr if it did not change or the handle is invalid
+	 */
+	UniformSlot* changedSlot(UniformHandle handle, GLenum valueType, const void* value, size_t size);
+
+	void createUniformHandles(); //!< fills the shadow array from m_uniformMap
+	void restoreUniform(UniformHandle handle); //!< uploads the shadowed value again, after a reload
+
+	std::vector<UniformSlot> m_uniformSlots;
+	std::unordered_map<std::string, int> m_uniformHandles; //!< name to index into m_uniformSlots
 
 public:
 	static std::string getTypeString(GLenum type);
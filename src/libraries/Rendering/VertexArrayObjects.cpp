@@ -2,6 +2,7 @@
 
 #include "Core/DebugLog.h"
 #include "Rendering/OpenGLContext.h"
+#include "Rendering/GLResources.h"
 
 Renderable::Renderable()
 {
@@ -10,6 +11,7 @@ Renderable::Renderable()
 	m_normals.m_size = 0;
 	m_uvs.m_size = 0;
 	m_tangents.m_size = 0;
+	m_indexType = GL_UNSIGNED_INT;
 }
 
 Renderable::~Renderable()
@@ -24,21 +26,18 @@ Renderable::~Renderable()
     glDeleteBuffersARB(buffers.size(), &buffers[0]);
 }
 
-GLuint Renderable::createVbo(std::vector<float> content, GLuint dimensions, GLuint vertexAttributePointer)
+GLuint Renderable::createVbo(const std::vector<float>& content, GLuint dimensions, GLuint vertexAttributePointer)
 {
+	return createVbo<float>(content, dimensions, vertexAttributePointer, GL_FLOAT);
+}
 
-    GLuint vbo = 0;
-
-	if ( content.size() != 0 )// && content.size() % dimensions == 0 )
-	{
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, content.size() * sizeof(float), &content[0], GL_STATIC_DRAW);
-        glVertexAttribPointer(vertexAttributePointer, dimensions, GL_FLOAT, 0, 0, 0);
-		glEnableVertexAttribArray(vertexAttributePointer);
-	}
+GLuint Renderable::createVbo(const void* data, GLsizeiptr size, GLuint dimensions, GLuint vertexAttributePointer, GLenum type, bool isIntegerAttribute)
+{
+	if ( size == 0 ) { return 0; }
 
-    return vbo;
+	GLuint vbo = GLResources::createBuffer(size, data, 0);
+	GLResources::setVertexAttribute(OPENGLCONTEXT->cacheVAO, vertexAttributePointer, vbo, dimensions, type, isIntegerAttribute);
+	return vbo;
 }
 
 void Renderable::draw()
@@ -46,7 +45,7 @@ void Renderable::draw()
     bind();
 	if (m_indices.m_size != 0) // indices have been provided, use these
 	{
-		glDrawElements(m_mode, m_indices.m_size, GL_UNSIGNED_INT, 0);
+		glDrawElements(m_mode, m_indices.m_size, m_indexType, 0);
 	}
 	else // no index buffer has been provided, lets assume this has to be rendered in vertex order
 	{
@@ -62,7 +61,7 @@ void Renderable::drawInstanced(int numInstances)
 
 	if (m_indices.m_size != 0) // indices have been provided, use these
 	{
-		glDrawElementsInstanced( m_mode, m_indices.m_size, GL_UNSIGNED_INT, 0, numInstances );
+		glDrawElementsInstanced( m_mode, m_indices.m_size, m_indexType, 0, numInstances );
 	}
 	else // no index buffer has been provided, lets assume this has to be rendered in vertex order
 	{
@@ -72,15 +71,21 @@ void Renderable::drawInstanced(int numInstances)
 }
 
 
-GLuint Renderable::createIndexVbo(std::vector<unsigned int> content) 
+GLuint Renderable::createIndexVbo(const std::vector<unsigned int>& content) 
 {
-    
-	GLuint vbo = 0;
-	
-	glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, content.size() * sizeof(unsigned int), &content[0], GL_STATIC_DRAW);
+	if ( content.empty() ) { return 0; }
+
+	GLuint vbo = GLResources::createBuffer(content.size() * sizeof(unsigned int), &content[0], 0);
+	GLResources::setIndexBuffer(OPENGLCONTEXT->cacheVAO, vbo);
+	return vbo;
+}
+
+GLuint Renderable::createIndexVbo(const std::vector<unsigned short>& content) 
+{
+	if ( content.empty() ) { return 0; }
 
+	GLuint vbo = GLResources::createBuffer(content.size() * sizeof(unsigned short), &content[0], 0);
+	GLResources::setIndexBuffer(OPENGLCONTEXT->cacheVAO, vbo);
 	return vbo;
 }
 
@@ -33,11 +33,14 @@ public:
     void setDrawMode(GLenum type); //!< sets the mode the Renderable will be drawn with (e.g. GL_TRIANLGES)
 
 public:
+	// the following attach the new buffer to the VAO currently bound via OPENGLCONTEXT->bindVAO(), without binding the buffer (see GLResources)
 	template <class T>
-	static GLuint createVbo(std::vector<T> content, GLuint dimensions, GLuint vertexAttributePointer, GLenum type, bool isIntegerAttribute = false); //!< implementation at end of file
+	static GLuint createVbo(const std::vector<T>& content, GLuint dimensions, GLuint vertexAttributePointer, GLenum type, bool isIntegerAttribute = false); //!< implementation at end of file
 
-    static GLuint createVbo(std::vector<float> content, GLuint dimensions, GLuint vertexAttributePointer);
-	static GLuint createIndexVbo(std::vector<unsigned int> content);
+    static GLuint createVbo(const std::vector<float>& content, GLuint dimensions, GLuint vertexAttributePointer);
+	static GLuint createIndexVbo(const std::vector<unsigned int>& content);
+	static GLuint createIndexVbo(const std::vector<unsigned short>& content); //!< set m_indexType to GL_UNSIGNED_SHORT when using this
+	static GLuint createVbo(const void* data, GLsizeiptr size, GLuint dimensions, GLuint vertexAttributePointer, GLenum type, bool isIntegerAttribute); //!< immutable buffer, 0 if size is 0
 
 public:
 
@@ -50,6 +53,7 @@ public:
 
     GLuint m_vao; //!< VertexArrayObject handle
     GLenum m_mode; //!< the mode the Renderable will be drawn with (e.g. GL_TRIANGLES)
+	GLenum m_indexType; //!< type of the index buffer, GL_UNSIGNED_INT (default) or GL_UNSIGNED_SHORT
 };
 
 class Skybox : public Renderable {
@@ -150,24 +154,10 @@ protected:
 };
 
 template <class T>
-GLuint Renderable::createVbo(std::vector<T> content, GLuint dimensions, GLuint vertexAttributePointer, GLenum type, bool isIntegerAttribute)
+GLuint Renderable::createVbo(const std::vector<T>& content, GLuint dimensions, GLuint vertexAttributePointer, GLenum type, bool isIntegerAttribute)
 {
-    GLuint vbo = 0;
-	if ( content.size() != 0 )// && content.size() % dimensions == 0 )
-	{
-		glGenBuffers(1, &vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, vbo);
-		glBufferData(GL_ARRAY_BUFFER, content.size() * sizeof(T), &content[0], GL_STATIC_DRAW);
-		if ( isIntegerAttribute)
-		{
-			glVertexAttribIPointer( vertexAttributePointer, dimensions, type, 0,0); // will be left as integer values in shader
-		}else
-		{
-	        glVertexAttribPointer(vertexAttributePointer, dimensions, type, 0, 0, 0);
-		}
-		glEnableVertexAttribArray(vertexAttributePointer);
-	}
-    return vbo;
+	if ( content.empty() ) { return 0; }
+	return createVbo(&content[0], content.size() * sizeof(T), dimensions, vertexAttributePointer, type, isIntegerAttribute); // integer attributes are left as integer values in shader
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,335 @@
+#include "VertexFormat.h"
+
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include <Core/DebugLog.h>
+#include <Rendering/VertexArrayObjects.h>
+#include <Rendering/GLResources.h>
+#include <Rendering/OpenGLContext.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	const float SNORM16_MAX = 32767.0f;
+	const float SNORM10_MAX = 511.0f;
+
+	inline void write(std::vector<unsigned char>& data, size_t offset, const void* value, size_t size)
+	{
+		std::memcpy(&data[offset], value, size);
+	}
+
+	inline void read(const std::vector<unsigned char>& data, size_t offset, void* value, size_t size)
+	{
+		std::memcpy(value, &data[offset], size);
+	}
+
+	inline short toSnorm16(float value)
+	{
+		return (short) std::floor(std::max(-1.0f, std::min(1.0f, value)) * SNORM16_MAX + 0.5f);
+	}
+}
+
+VertexFormat::VertexFormat(PositionEncoding positions, UVEncoding uvs, DirectionEncoding directions)
+	: m_positions(positions)
+	, m_uvs(uvs)
+	, m_directions(directions)
+{
+}
+
+VertexFormat VertexFormat::uncompressed()
+{
+	return VertexFormat(POSITION_FLOAT, UV_FLOAT, DIRECTION_FLOAT);
+}
+
+GLsizei VertexFormat::getStride(int uvComponents, bool hasNormals, bool hasTangents) const
+{
+	GLsizei stride = ( m_positions == POSITION_SNORM16 ) ? 4 * sizeof(short) : 3 * sizeof(float);
+	if ( uvComponents != 0 )
+	{
+		// half uvs are padded to a multiple of 4 bytes
+		stride += ( m_uvs == UV_HALF ) ? ((uvComponents == 3) ? 4 : 2) * sizeof(unsigned short) : uvComponents * sizeof(float);
+	}
+	GLsizei directionSize = ( m_directions == DIRECTION_INT_2_10_10_10 ) ? sizeof(GLuint) : 3 * sizeof(float);
+	if ( hasNormals ) { stride += directionSize; }
+	if ( hasTangents ) { stride += directionSize; }
+	return stride;
+}
+
+VertexFormat::InterleavedVertices VertexFormat::pack(const std::vector<float>& positions, const std::vector<float>& uvs, int uvComponents, const std::vector<float>& normals, const std::vector<float>& tangents) const
+{
+	InterleavedVertices result;
+	result.numVertices = (unsigned int) positions.size() / 3;
+	result.uvComponents = ( uvs.size() >= result.numVertices * std::max(uvComponents, 1) && result.numVertices != 0 ) ? uvComponents : 0;
+	result.hasNormals  = normals.size()  >= result.numVertices * 3 && result.numVertices != 0;
+	result.hasTangents = tangents.size() >= result.numVertices * 3 && result.numVertices != 0;
+	result.stride = getStride(result.uvComponents, result.hasNormals, result.hasTangents);
+	result.dequantization = glm::mat4(1.0f);
+
+	if ( !uvs.empty() && result.uvComponents == 0 ) { DEBUGLOG->log("WARNING: VertexFormat: uv count does not match vertex count, uvs are ignored"); }
+
+	// attribute offsets in declaration order
+	result.positionOffset = 0;
+	GLuint offset = ( m_positions == POSITION_SNORM16 ) ? 4 * sizeof(short) : 3 * sizeof(float);
+	result.uvOffset = offset;
+	if ( result.uvComponents != 0 ) { offset += ( m_uvs == UV_HALF ) ? ((result.uvComponents == 3) ? 8 : 4) : result.uvComponents * sizeof(float); }
+	result.normalOffset = offset;
+	if ( result.hasNormals ) { offset += ( m_directions == DIRECTION_INT_2_10_10_10 ) ? sizeof(GLuint) : 3 * sizeof(float); }
+	result.tangentOffset = offset;
+
+	result.data.resize((size_t) result.stride * result.numVertices, 0);
+
+	// quantization: uniform scale around the bounds center, so the dequantization matrix keeps normals intact
+	glm::vec3 center(0.0f);
+	float halfExtent = 1.0f;
+	if ( m_positions == POSITION_SNORM16 && result.numVertices != 0 )
+	{
+		glm::vec3 min( FLT_MAX);
+		glm::vec3 max(-FLT_MAX);
+		for (unsigned int v = 0; v < result.numVertices; v++)
+		{
+			glm::vec3 p(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]);
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		center = (min + max) * 0.5f;
+		glm::vec3 extent = (max - min) * 0.5f;
+		halfExtent = std::max(extent.x, std::max(extent.y, extent.z));
+		if ( halfExtent <= 0.0f ) { halfExtent = 1.0f; }
+		result.dequantization = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(halfExtent));
+	}
+
+	for (unsigned int v = 0; v < result.numVertices; v++)
+	{
+		size_t base = (size_t) v * result.stride;
+
+		if ( m_positions == POSITION_SNORM16 )
+		{
+			short q[4];
+			for (int c = 0; c < 3; c++) { q[c] = toSnorm16((positions[3 * v + c] - center[c]) / halfExtent); }
+			q[3] = (short) SNORM16_MAX; // w = 1
+			write(result.data, base + result.positionOffset, q, sizeof(q));
+		}
+		else
+		{
+			write(result.data, base + result.positionOffset, &positions[3 * v], 3 * sizeof(float));
+		}
+
+		if ( result.uvComponents != 0 )
+		{
+			const float* uv = &uvs[result.uvComponents * v];
+			if ( m_uvs == UV_HALF )
+			{
+				unsigned short h[4] = { 0, 0, 0, 0 };
+				for (int c = 0; c < result.uvComponents; c++) { h[c] = floatToHalf(uv[c]); }
+				write(result.data, base + result.uvOffset, h, ((result.uvComponents == 3) ? 4 : 2) * sizeof(unsigned short));
+			}
+			else
+			{
+				write(result.data, base + result.uvOffset, uv, result.uvComponents * sizeof(float));
+			}
+		}
+
+		const std::vector<float>* directions[2] = { &normals, &tangents };
+		const bool hasDirection[2] = { result.hasNormals, result.hasTangents };
+		const GLuint directionOffset[2] = { result.normalOffset, result.tangentOffset };
+		for (int d = 0; d < 2; d++)
+		{
+			if ( !hasDirection[d] ) { continue; }
+			const float* n = &(*directions[d])[3 * v];
+			if ( m_directions == DIRECTION_INT_2_10_10_10 )
+			{
+				GLuint packed = packDirection(glm::vec3(n[0], n[1], n[2]));
+				write(result.data, base + directionOffset[d], &packed, sizeof(GLuint));
+			}
+			else
+			{
+				write(result.data, base + directionOffset[d], n, 3 * sizeof(float));
+			}
+		}
+	}
+
+	return result;
+}
+
+void VertexFormat::unpack(const InterleavedVertices& vertices, std::vector<float>& positions, std::vector<float>& uvs, std::vector<float>& normals, std::vector<float>& tangents) const
+{
+	positions.clear(); uvs.clear(); normals.clear(); tangents.clear();
+
+	for (unsigned int v = 0; v < vertices.numVertices; v++)
+	{
+		size_t base = (size_t) v * vertices.stride;
+
+		glm::vec3 p;
+		if ( m_positions == POSITION_SNORM16 )
+		{
+			short q[4];
+			read(vertices.data, base + vertices.positionOffset, q, sizeof(q));
+			glm::vec3 normalized(std::max(q[0] / SNORM16_MAX, -1.0f), std::max(q[1] / SNORM16_MAX, -1.0f), std::max(q[2] / SNORM16_MAX, -1.0f));
+			p = glm::vec3(vertices.dequantization * glm::vec4(normalized, 1.0f));
+		}
+		else
+		{
+			read(vertices.data, base + vertices.positionOffset, &p[0], 3 * sizeof(float));
+		}
+		positions.push_back(p.x); positions.push_back(p.y); positions.push_back(p.z);
+
+		if ( vertices.uvComponents != 0 )
+		{
+			float uv[3];
+			if ( m_uvs == UV_HALF )
+			{
+				unsigned short h[4];
+				read(vertices.data, base + vertices.uvOffset, h, ((vertices.uvComponents == 3) ? 4 : 2) * sizeof(unsigned short));
+				for (int c = 0; c < vertices.uvComponents; c++) { uv[c] = halfToFloat(h[c]); }
+			}
+			else
+			{
+				read(vertices.data, base + vertices.uvOffset, uv, vertices.uvComponents * sizeof(float));
+			}
+			uvs.insert(uvs.end(), uv, uv + vertices.uvComponents);
+		}
+
+		std::vector<float>* directions[2] = { &normals, &tangents };
+		const bool hasDirection[2] = { vertices.hasNormals, vertices.hasTangents };
+		const GLuint directionOffset[2] = { vertices.normalOffset, vertices.tangentOffset };
+		for (int d = 0; d < 2; d++)
+		{
+			if ( !hasDirection[d] ) { continue; }
+			glm::vec3 n;
+			if ( m_directions == DIRECTION_INT_2_10_10_10 )
+			{
+				GLuint packed;
+				read(vertices.data, base + directionOffset[d], &packed, sizeof(GLuint));
+				n = unpackDirection(packed);
+			}
+			else
+			{
+				read(vertices.data, base + directionOffset[d], &n[0], 3 * sizeof(float));
+			}
+			directions[d]->push_back(n.x); directions[d]->push_back(n.y); directions[d]->push_back(n.z);
+		}
+	}
+}
+
+Renderable* VertexFormat::createRenderable(const InterleavedVertices& vertices, const std::vector<unsigned int>& indices) const
+{
+	Renderable* renderable = new Renderable;
+	renderable->m_positions.m_vboHandle = 0;
+	renderable->m_uvs.m_vboHandle = 0;
+	renderable->m_normals.m_vboHandle = 0;
+	renderable->m_tangents.m_vboHandle = 0;
+	renderable->m_indices.m_vboHandle = 0;
+	renderable->m_vao = GLResources::createVertexArray();
+	renderable->setDrawMode(GL_TRIANGLES);
+
+	if ( vertices.numVertices == 0 ) { return renderable; }
+
+	// one buffer for all attributes, it is deleted through m_positions
+	GLuint vbo = GLResources::createBuffer(vertices.data.size(), &vertices.data[0], 0);
+	GLuint vao = renderable->m_vao;
+	if ( m_positions == POSITION_SNORM16 ) { GLResources::setVertexAttribute(vao, 0, vbo, 4, GL_SHORT, false, true, vertices.stride, vertices.positionOffset); }
+	else { GLResources::setVertexAttribute(vao, 0, vbo, 3, GL_FLOAT, false, false, vertices.stride, vertices.positionOffset); }
+	renderable->m_positions.m_vboHandle = vbo;
+	renderable->m_positions.m_size = vertices.numVertices;
+
+	if ( vertices.uvComponents != 0 )
+	{
+		GLResources::setVertexAttribute(vao, 1, vbo, vertices.uvComponents, (m_uvs == UV_HALF) ? GL_HALF_FLOAT : GL_FLOAT, false, false, vertices.stride, vertices.uvOffset);
+		renderable->m_uvs.m_size = vertices.numVertices;
+	}
+
+	const bool hasDirection[2] = { vertices.hasNormals, vertices.hasTangents };
+	const GLuint directionOffset[2] = { vertices.normalOffset, vertices.tangentOffset };
+	VertexBufferObject* directionBuffers[2] = { &renderable->m_normals, &renderable->m_tangents };
+	for (int d = 0; d < 2; d++)
+	{
+		if ( !hasDirection[d] ) { continue; }
+		if ( m_directions == DIRECTION_INT_2_10_10_10 ) { GLResources::setVertexAttribute(vao, 2 + d, vbo, 4, GL_INT_2_10_10_10_REV, false, true, vertices.stride, directionOffset[d]); }
+		else { GLResources::setVertexAttribute(vao, 2 + d, vbo, 3, GL_FLOAT, false, false, vertices.stride, directionOffset[d]); }
+		directionBuffers[d]->m_size = vertices.numVertices;
+	}
+
+	if ( !indices.empty() )
+	{
+		renderable->m_indices.m_vboHandle = GLResources::createBuffer(indices.size() * sizeof(unsigned int), &indices[0], 0);
+		GLResources::setIndexBuffer(vao, renderable->m_indices.m_vboHandle);
+		renderable->m_indices.m_size = (GLuint) indices.size();
+	}
+
+	OPENGLCONTEXT->bindVAO(0);
+	return renderable;
+}
+
+unsigned short VertexFormat::floatToHalf(float value)
+{
+	GLuint bits;
+	std::memcpy(&bits, &value, sizeof(float));
+
+	unsigned short sign = (unsigned short) ((bits >> 16) & 0x8000);
+	GLuint absBits = bits & 0x7FFFFFFF;
+	if ( absBits > 0x7F800000 ) { return sign | 0x7E00; } // NaN
+
+	int exponent = (int) (absBits >> 23) - 127 + 15;
+	GLuint mantissa = absBits & 0x7FFFFF;
+	if ( exponent >= 31 ) { return sign | 0x7C00; } // overflow to infinity
+	if ( exponent <= 0 ) // denormal or zero
+	{
+		if ( exponent < -10 ) { return sign; }
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		unsigned short half = (unsigned short) (mantissa >> shift);
+		if ( (mantissa >> (shift - 1)) & 1 ) { half++; } // round, may carry into the exponent which is correct
+		return sign | half;
+	}
+
+	unsigned short half = (unsigned short) ((exponent << 10) | (mantissa >> 13));
+	if ( mantissa & 0x1000 ) { half++; }
+	return sign | half;
+}
+
+float VertexFormat::halfToFloat(unsigned short value)
+{
+	GLuint sign = (GLuint) (value & 0x8000) << 16;
+	GLuint exponent = (value >> 10) & 0x1F;
+	GLuint mantissa = value & 0x3FF;
+
+	GLuint bits;
+	if ( exponent == 0 )
+	{
+		float denormal = (float) mantissa / 1024.0f / 16384.0f; // 2^-14
+		return ( sign ) ? -denormal : denormal;
+	}
+	else if ( exponent == 31 ) { bits = sign | 0x7F800000 | (mantissa << 13); }
+	else { bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13); }
+
+	float result;
+	std::memcpy(&result, &bits, sizeof(float));
+	return result;
+}
+
+GLuint VertexFormat::packDirection(const glm::vec3& direction)
+{
+	GLuint packed = 0;
+	for (int c = 0; c < 3; c++)
+	{
+		int q = (int) std::floor(std::max(-1.0f, std::min(1.0f, direction[c])) * SNORM10_MAX + 0.5f);
+		packed |= ((GLuint) q & 0x3FF) << (10 * c);
+	}
+	return packed;
+}
+
+glm::vec3 VertexFormat::unpackDirection(GLuint packed)
+{
+	glm::vec3 direction;
+	for (int c = 0; c < 3; c++)
+	{
+		int q = (int) ((packed >> (10 * c)) & 0x3FF);
+		if ( q & 0x200 ) { q -= 0x400; } // sign extend
+		direction[c] = std::max((float) q / SNORM10_MAX, -1.0f);
+	}
+	return direction;
+}
@@ -0,0 +1,75 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class Renderable;
+
+/** @brief describes how positions, uvs, normals and tangents are encoded in one interleaved vertex buffer
+ *
+ * attribute locations stay the same as with separate buffers (0 positions, 1 uvs, 2 normals, 3 tangents) and every encoding is
+ * read through normalized or half float attributes, so shaders declaring vec3/vec2 inputs work unchanged.
+ * The one exception is POSITION_SNORM16: positions are stored relative to the mesh bounds, the returned dequantization matrix
+ * has to be multiplied onto the model matrix (it only contains a translation and a uniform scale, so normals are unaffected).
+ *
+ * bytes per vertex with uvs, normals and tangents: 44 uncompressed(), 24 with the default format, 20 with quantized positions
+ */
+class VertexFormat
+{
+public:
+	enum PositionEncoding { POSITION_FLOAT, POSITION_SNORM16 };   //!< 12 or 8 bytes
+	enum UVEncoding { UV_FLOAT, UV_HALF };                        //!< 8 or 4 bytes (2 components)
+	enum DirectionEncoding { DIRECTION_FLOAT, DIRECTION_INT_2_10_10_10 }; //!< 12 or 4 bytes, for normals and tangents
+
+	/** @brief CPU side result of pack(), ready to be uploaded with createRenderable() */
+	struct InterleavedVertices
+	{
+		std::vector<unsigned char> data;
+		GLsizei stride;
+		GLuint positionOffset;
+		GLuint uvOffset;          //!< only valid if uvComponents != 0
+		GLuint normalOffset;      //!< only valid if hasNormals
+		GLuint tangentOffset;     //!< only valid if hasTangents
+		unsigned int numVertices;
+		int uvComponents;         //!< 0, 2 or 3
+		bool hasNormals;
+		bool hasTangents;
+		glm::mat4 dequantization; //!< identity unless positions are quantized
+	};
+
+	VertexFormat(PositionEncoding positions = POSITION_FLOAT, UVEncoding uvs = UV_HALF, DirectionEncoding directions = DIRECTION_INT_2_10_10_10);
+	static VertexFormat uncompressed(); //!< interleaved, but every attribute stays float
+
+	/** @brief interleave and encode the attribute streams, every stream but positions may be empty
+	 * @param uvComponents 2 or 3 components per uv
+	 */
+	InterleavedVertices pack(const std::vector<float>& positions, const std::vector<float>& uvs, int uvComponents, const std::vector<float>& normals, const std::vector<float>& tangents) const;
+
+	/** @brief decode back to float streams, e.g. to measure the encoding error (positions include the dequantization) */
+	void unpack(const InterleavedVertices& vertices, std::vector<float>& positions, std::vector<float>& uvs, std::vector<float>& normals, std::vector<float>& tangents) const;
+
+	/** @brief upload the vertices into one immutable buffer and set up a VAO for it, draw mode is GL_TRIANGLES
+	 * @param indices may be empty
+	 */
+	Renderable* createRenderable(const InterleavedVertices& vertices, const std::vector<unsigned int>& indices) const;
+
+	GLsizei getStride(int uvComponents, bool hasNormals, bool hasTangents) const; //!< bytes per vertex
+
+	inline PositionEncoding getPositionEncoding() const { return m_positions; }
+	inline UVEncoding getUVEncoding() const { return m_uvs; }
+	inline DirectionEncoding getDirectionEncoding() const { return m_directions; }
+
+	static unsigned short floatToHalf(float value);
+	static float halfToFloat(unsigned short value);
+	static GLuint packDirection(const glm::vec3& direction); //!< GL_INT_2_10_10_10_REV, w = 0
+	static glm::vec3 unpackDirection(GLuint packed);
+
+private:
+	PositionEncoding m_positions;
+	UVEncoding m_uvs;
+	DirectionEncoding m_directions;
+};
+
+#endif
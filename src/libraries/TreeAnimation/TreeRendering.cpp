@@ -8,6 +8,7 @@
 #include <glm/gtx/transform.hpp>
 
 #include "Rendering/OpenGLContext.h"
+#include "Rendering/GPUCulling.h"
 
 Renderable* TreeAnimation::generateRenderable(TreeAnimation::Tree::Branch* branch, const aiScene* branchModel)
 {
@@ -299,23 +300,45 @@ void TreeAnimation::generateBranchVertexData(TreeAnimation::Tree::Branch* branch
 {
 	if (scene != NULL)
 	{
-		glm::mat4 transform = glm::scale( glm::vec3(branch->thickness / 2.0f, branch->length, branch->thickness / 2.0f) );
+		auto vertexData = AssimpTools::createVertexDataInstancesFromScene(scene)[0];
+		generateBranchVertexData(branch, target, &vertexData);
+	}else{
+		generateBranchVertexData(branch, target, (const AssimpTools::VertexData*) nullptr);
+	}
+}
+
+void TreeAnimation::generateBranchVertexData(TreeAnimation::Tree::Branch* branch, TreeAnimation::BranchesVertexData& target, const AssimpTools::VertexData* mesh)
+{
+	if (mesh != nullptr)
+	{
+		// same result as createVertexDataInstancesFromScene with this transform: normals and tangents use the inverse scale
+		glm::vec3 scale(branch->thickness / 2.0f, branch->length, branch->thickness / 2.0f);
 		
 		int indexOffset = target.positions.size() / 3;
 
-		auto vertexData = AssimpTools::createVertexDataInstancesFromScene(scene, transform)[0];
-		target.positions.insert(target.positions.end(), vertexData.positions.begin(), vertexData.positions.end());
-		target.uvs.insert(target.uvs.end(), vertexData.uvs.begin(), vertexData.uvs.end());
-		target.normals.insert(target.normals.end(), vertexData.normals.begin(), vertexData.normals.end());
-		target.tangents.insert(target.tangents.end(), vertexData.tangents.begin(), vertexData.tangents.end());
+		for (unsigned int v = 0; v + 2 < mesh->positions.size(); v = v + 3)
+		{
+			glm::vec3 position = scale * glm::vec3(mesh->positions[v], mesh->positions[v + 1], mesh->positions[v + 2]);
+			target.positions.insert(target.positions.end(), &position[0], &position[0] + 3);
+		}
+		target.uvs.insert(target.uvs.end(), mesh->uvs.begin(), mesh->uvs.end());
+		for (unsigned int n = 0; n + 2 < mesh->normals.size(); n = n + 3)
+		{
+			glm::vec3 normal = glm::normalize(glm::vec3(mesh->normals[n], mesh->normals[n + 1], mesh->normals[n + 2]) / scale);
+			target.normals.insert(target.normals.end(), &normal[0], &normal[0] + 3);
+		}
+		for (unsigned int t = 0; t + 2 < mesh->tangents.size(); t = t + 3)
+		{
+			glm::vec3 tangent = glm::normalize(glm::vec3(mesh->tangents[t], mesh->tangents[t + 1], mesh->tangents[t + 2]) / scale);
+			target.tangents.insert(target.tangents.end(), &tangent[0], &tangent[0] + 3);
+		}
 
-		for (unsigned int i = 0; i < vertexData.indices.size(); i++)
+		for (unsigned int i = 0; i < mesh->indices.size(); i++)
 		{
-			vertexData.indices[i] += indexOffset;
+			target.indices.push_back(mesh->indices[i] + indexOffset);
 		}
-		target.indices.insert(target.indices.end(), vertexData.indices.begin(), vertexData.indices.end());
 
-		for (unsigned int v = 0; v < vertexData.positions.size(); v = v + 3)
+		for (unsigned int v = 0; v < mesh->positions.size(); v = v + 3)
 		{
 			TreeAnimation::Tree::hierarchy(branch, &target.hierarchy);
 		}
@@ -442,6 +465,10 @@ TreeAnimation::TreeRendering::TreeRendering()
 	branchShader = nullptr;
 	branchShadowMapShader = nullptr;
 	foliageShadowMapShader = nullptr;
+	instanceAttributeLocation = 5;
+	uniformRingBuffer = nullptr;
+	firstUniformBindingPoint = 1;
+	usingCulledInstances = false;
 }
 
 TreeAnimation::TreeRendering::~TreeRendering()
@@ -450,9 +477,22 @@ TreeAnimation::TreeRendering::~TreeRendering()
 	delete branchShader;
 	delete foliageShadowMapShader;
 	delete branchShadowMapShader;
+	for ( auto c : gpuCullings ) { delete c; }
+	delete uniformRingBuffer;
 }
 
 void TreeAnimation::TreeRendering::generateAndConfigureTreeEntities(int numTreeVariants, float treeHeight, float treeWidth, int numMainBranches, int numSubBranches, int numFoliageQuadsPerBranch, const aiScene* trunkModel, const aiScene* branchModel)
+{
+	// convert once instead of once per branch
+	AssimpTools::VertexData trunkMesh, branchMesh;
+	if (trunkModel != NULL) { trunkMesh = AssimpTools::createVertexDataInstancesFromScene(trunkModel)[0]; }
+	if (branchModel != NULL) { branchMesh = AssimpTools::createVertexDataInstancesFromScene(branchModel)[0]; }
+
+	generateAndConfigureTreeEntities(numTreeVariants, treeHeight, treeWidth, numMainBranches, numSubBranches, numFoliageQuadsPerBranch,
+		(trunkModel != NULL) ? &trunkMesh : nullptr, (branchModel != NULL) ? &branchMesh : nullptr);
+}
+
+void TreeAnimation::TreeRendering::generateAndConfigureTreeEntities(int numTreeVariants, float treeHeight, float treeWidth, int numMainBranches, int numSubBranches, int numFoliageQuadsPerBranch, const AssimpTools::VertexData* trunkMesh, const AssimpTools::VertexData* branchMesh)
 {
 	treeEntities.resize(numTreeVariants);
 	for (int i = 0; i < numTreeVariants; i++)
@@ -466,15 +506,15 @@ void TreeAnimation::TreeRendering::generateAndConfigureTreeEntities(int numTreeV
 		TreeAnimation::FoliageVertexData fData;
 		TreeAnimation::BranchesVertexData bData;
 		
-		TreeAnimation::generateBranchVertexData(&tree->m_trunk, bData, trunkModel);
+		TreeAnimation::generateBranchVertexData(&tree->m_trunk, bData, trunkMesh);
 		for (auto b : tree->m_trunk.children)
 		{
-			TreeAnimation::generateBranchVertexData(b, bData, branchModel);
+			TreeAnimation::generateBranchVertexData(b, bData, branchMesh);
 			TreeAnimation::generateFoliageGeometryShaderVertexData(b, numFoliageQuadsPerBranch, fData);
 			for ( auto c : b->children)
 			{
 				TreeAnimation::generateFoliageGeometryShaderVertexData(c, numFoliageQuadsPerBranch, fData);
-				TreeAnimation::generateBranchVertexData(c, bData, branchModel);
+				TreeAnimation::generateBranchVertexData(c, bData, branchMesh);
 			}
 		}
 
@@ -528,10 +568,23 @@ void TreeAnimation::TreeRendering::createInstanceMatrixAttributes(int attributeL
 	if ( treeEntities.empty()){ DEBUGLOG->log("ERROR: Create TreeEntities first!"); return;}
 	if ( treeEntities.size() != modelMatrices.size()){ DEBUGLOG->log("ERROR: Create model matrices first!"); return;}
 
-	// generate Instance-buffer for renderables of this treeVariant
+	// create vbo from treemodelmatrices and assing to all renderables
+	instanceAttributeLocation = attributeLocation;
+	instanceModelBuffers.resize(treeEntities.size());
+	for (unsigned int i = 0; i < treeEntities.size(); i++)
+	{
+		instanceModelBuffers[i] = bufferData<glm::mat4>(modelMatrices[i], GL_STATIC_DRAW);
+		attachInstanceBuffer(i, instanceModelBuffers[i]);
+	}
+	usingCulledInstances = false;
+}
+
+void TreeAnimation::TreeRendering::attachInstanceBuffer(int treeVariant, GLuint buffer)
+{
 	auto mat4VertexAttribute = [&](Renderable*r, int attributeLocation)
 	{
 		r->bind();
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
 		// mat4 Vertex Attribute == 4 x vec4 attributes (consecutively)
 		GLsizei vec4Size = sizeof(glm::vec4);
 		glEnableVertexAttribArray(attributeLocation); 
@@ -548,23 +601,74 @@ void TreeAnimation::TreeRendering::createInstanceMatrixAttributes(int attributeL
 		glVertexAttribDivisor(attributeLocation+1, 1);
 		glVertexAttribDivisor(attributeLocation+2, 1);
 		glVertexAttribDivisor(attributeLocation+3, 1);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		r->unbind();
 	};
 
-	// create vbo from treemodelmatrices and assing to all renderables
-	unsigned int i = 0;
-	for ( auto t : treeEntities)
+	for ( auto b : treeEntities[treeVariant]->branchRenderables) {
+		mat4VertexAttribute(b, instanceAttributeLocation);
+	}
+	for ( auto f : treeEntities[treeVariant]->foliageRenderables) {
+		mat4VertexAttribute(f, instanceAttributeLocation);
+	}
+}
+
+void TreeAnimation::TreeRendering::createGPUCulling(const AssimpTools::BoundingBox& treeBounds)
+{
+	if ( instanceModelBuffers.size() != treeEntities.size()){ DEBUGLOG->log("ERROR: Create instance matrix attributes first!"); return;}
+	if ( !Culling::GPUCulling::isSupported() ) { DEBUGLOG->log("WARNING: compute shaders not supported, trees will not be culled"); return; }
+
+	for ( auto c : gpuCullings ) { delete c; }
+	gpuCullings.resize(treeEntities.size());
+	for (unsigned int i = 0; i < treeEntities.size(); i++)
 	{
-		GLuint instanceModelBufferHandle = bufferData<glm::mat4>(modelMatrices[i], GL_STATIC_DRAW);	
-	
-		for ( auto b : t->branchRenderables) {
-			mat4VertexAttribute(b, attributeLocation);
-		}
-		for ( auto f : t->foliageRenderables) {
-			mat4VertexAttribute(f, attributeLocation);
+		// branch commands first, foliage commands after them
+		std::vector<Renderable*> renderables = treeEntities[i]->branchRenderables;
+		renderables.insert(renderables.end(), treeEntities[i]->foliageRenderables.begin(), treeEntities[i]->foliageRenderables.end());
+		gpuCullings[i] = new Culling::GPUCulling(renderables, (unsigned int) modelMatrices[i].size());
+
+		std::vector<Culling::CullingInfo> instances(modelMatrices[i].size());
+		for (unsigned int j = 0; j < instances.size(); j++)
+		{
+			instances[j].boundingBox = treeBounds;
+			instances[j].boundingRadius = glm::length(treeBounds.max - treeBounds.min) * 0.5f;
+			instances[j].modelMatrix = modelMatrices[i][j];
 		}
-		i++;
+		gpuCullings[i]->setInstances(instances);
+	}
+}
+
+void TreeAnimation::TreeRendering::cullOnGPU(const glm::mat4& viewProjection, const Culling::HiZBuffer* hiZBuffer)
+{
+	for (unsigned int i = 0; i < gpuCullings.size(); i++)
+	{
+		gpuCullings[i]->setHiZBuffer(hiZBuffer);
+		gpuCullings[i]->cull(viewProjection);
+		if ( !usingCulledInstances ) { attachInstanceBuffer(i, gpuCullings[i]->getVisibleMatrixBuffer()); }
 	}
+	usingCulledInstances = !gpuCullings.empty();
+}
+
+void TreeAnimation::TreeRendering::useAllInstances()
+{
+	if ( !usingCulledInstances ) { return; }
+	for (unsigned int i = 0; i < instanceModelBuffers.size(); i++)
+	{
+		attachInstanceBuffer(i, instanceModelBuffers[i]);
+	}
+	usingCulledInstances = false;
+}
+
+void TreeAnimation::TreeRendering::renderBranches(int treeVariant)
+{
+	if ( usingCulledInstances ) { branchRenderpasses[treeVariant]->renderIndirect(gpuCullings[treeVariant]->getCommandBuffer(), 0); }
+	else { branchRenderpasses[treeVariant]->renderInstanced((int) modelMatrices[treeVariant].size()); }
+}
+
+void TreeAnimation::TreeRendering::renderFoliage(int treeVariant)
+{
+	if ( usingCulledInstances ) { foliageRenderpasses[treeVariant]->renderIndirect(gpuCullings[treeVariant]->getCommandBuffer(), (unsigned int) treeEntities[treeVariant]->branchRenderables.size()); }
+	else { foliageRenderpasses[treeVariant]->renderInstanced((int) modelMatrices[treeVariant].size()); }
 }
 
 void TreeAnimation::TreeRendering::createAndConfigureShaders(std::string branchFragmentShader, std::string foliageFragmentShader)
@@ -590,6 +694,7 @@ void TreeAnimation::TreeRendering::createAndConfigureUniformBlocksAndBuffers(int
 	if (branchShaderUniformBlockInfoMap.find("Simulation") == branchShaderUniformBlockInfoMap.end() || foliageShaderUniformBlockInfoMap.find("Simulation") == foliageShaderUniformBlockInfoMap.end() ) {
 		DEBUGLOG->log("ERROR: At least one Shader has no Uniform Block called 'Simulation'"); return;};
 
+	firstUniformBindingPoint = firstBindingPointIdx;
 	simulationUniformBlockInfo = branchShaderUniformBlockInfoMap.at("Simulation");
 	treeUniformBlockInfo	   = branchShaderUniformBlockInfoMap.at("Tree");
 
@@ -699,8 +804,51 @@ void TreeAnimation::TreeRendering::imguiInterfaceSimulationProperties()
 		updateFrequencies = true;
 	}else{ updateFrequencies =false; }
 }
+void TreeAnimation::TreeRendering::createUniformRingBuffer()
+{
+	if ( simulationBufferDataVector.empty() || treeBufferDataVectors.size() != treeEntities.size() ) { DEBUGLOG->log("ERROR: Create uniform blocks first!"); return;}
+
+	// generous padding per block for the offset alignment
+	GLsizeiptr frameSize = simulationUniformBlockInfo.byteSize + 256;
+	for ( unsigned int i = 0; i < treeBufferDataVectors.size(); i++)
+	{
+		frameSize += treeUniformBlockInfo.byteSize + 256;
+	}
+
+	delete uniformRingBuffer;
+	uniformRingBuffer = new RingBuffer(frameSize, GL_UNIFORM_BUFFER);
+}
+
+void TreeAnimation::TreeRendering::updateUniformBlocks()
+{
+	if ( uniformRingBuffer == nullptr ) { return; }
+	uniformRingBuffer->beginFrame();
+
+	TreeAnimation::updateSimulationUniformsInBufferData(simulationProperties, simulationUniformBlockInfo, simulationBufferDataVector);
+	RingBuffer::Allocation simulation = uniformRingBuffer->upload(&simulationBufferDataVector[0], simulationUniformBlockInfo.byteSize);
+	uniformRingBuffer->bindRange(firstUniformBindingPoint, simulation);
+
+	// trees are static, their data is cached in treeBufferDataVectors, see updateTreeUniformBlock()
+	for ( unsigned int i = 0 ; i < treeEntities.size(); i++)
+	{
+		RingBuffer::Allocation tree = uniformRingBuffer->upload(&treeBufferDataVectors[i][0], treeUniformBlockInfo.byteSize);
+		uniformRingBuffer->bindRange(i + (firstUniformBindingPoint + 1), tree);
+	}
+}
+
+void TreeAnimation::TreeRendering::updateTreeUniformBlock(int treeVariant)
+{
+	if ( treeVariant < 0 || treeVariant >= (int) treeBufferDataVectors.size() ) { DEBUGLOG->log("ERROR: Create uniform blocks first!"); return;}
+
+	TreeAnimation::updateTreeUniformsInBufferData(treeEntities[treeVariant]->tree, treeUniformBlockInfo, treeBufferDataVectors[treeVariant]);
+	glBindBuffer(GL_UNIFORM_BUFFER, treeUniformBlockBuffers[treeVariant]);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, treeUniformBlockInfo.byteSize, &treeBufferDataVectors[treeVariant][0]);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
 void TreeAnimation::TreeRendering::updateActiveImguiInterfaces()
 {
+	if ( uniformRingBuffer != nullptr ) { return; } // updateUniformBlocks() uploads the simulation properties every frame
 	if (updateAngleShifts){
 		ShaderProgram::updateValueInBuffer("vAngleShiftFront", glm::value_ptr(simulationProperties.angleshifts[0]),3, simulationUniformBlockInfo, simulationUniformBlockBuffer); //front
 		ShaderProgram::updateValueInBuffer("vAngleShiftBack", glm::value_ptr(simulationProperties.angleshifts[1]),3, simulationUniformBlockInfo, simulationUniformBlockBuffer); // back
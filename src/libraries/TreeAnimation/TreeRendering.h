@@ -6,8 +6,12 @@
 
 #include "Tree.h"
 #include <Rendering/RenderPass.h>
+#include <Rendering/RingBuffer.h>
+#include <Importing/AssimpTools.h>
 #include <assimp/Importer.hpp>
 
+namespace Culling { class GPUCulling; class HiZBuffer; }
+
 namespace TreeAnimation
 {
 
@@ -62,6 +66,7 @@ struct BranchesVertexData
 };
 
 void generateBranchVertexData(TreeAnimation::Tree::Branch* branch, BranchesVertexData& target, const aiScene* scene = NULL);
+void generateBranchVertexData(TreeAnimation::Tree::Branch* branch, BranchesVertexData& target, const AssimpTools::VertexData* mesh); //!< mesh in branch space (e.g. from MeshCache), nullptr for a Truncated Cone
 Renderable* generateBranchesRenderable(BranchesVertexData& source); // use this source to generate a single renderable
 
 struct TreeEntity { 
@@ -100,20 +105,49 @@ public:
 	std::vector<std::vector<float>> treeBufferDataVectors;
 	std::vector<float> simulationBufferDataVector;
 
+	RingBuffer* uniformRingBuffer; //!< optional, see createUniformRingBuffer()
+	int firstUniformBindingPoint;
+
 	SimulationProperties simulationProperties;
 
+	std::vector<GLuint> instanceModelBuffers; //!< all model matrices of a tree variant
+	int instanceAttributeLocation;
+	std::vector<Culling::GPUCulling* > gpuCullings; //!< one per tree variant, empty if not created or not supported
+	bool usingCulledInstances; //!< whether the renderables currently source their instance matrices from gpuCullings
+
 	TreeRendering();
 	~TreeRendering();
 	void generateAndConfigureTreeEntities(int numTreeVariants, float treeHeight, float treeWidth, int numMainBranches, int numSubBranches, int numFoliageQuadsPerBranch,  const aiScene* trunkModel, const aiScene* branchModel);
+	void generateAndConfigureTreeEntities(int numTreeVariants, float treeHeight, float treeWidth, int numMainBranches, int numSubBranches, int numFoliageQuadsPerBranch,  const AssimpTools::VertexData* trunkMesh, const AssimpTools::VertexData* branchMesh); //!< nullptr for Truncated Cones
 	void generateModelMatrices(int numTreesPerTreeVariant, float xMin, float xMax, float zMin, float zMax);
 	void createInstanceMatrixAttributes(int attributeLocation = 5);
+
+	/** @brief optional: cull tree instances on the GPU, see Culling::GPUCulling
+	 * @param treeBounds local bounds of a tree, must include the displacement applied in the vertex shader (e.g. heightmap)
+	 */
+	void createGPUCulling(const AssimpTools::BoundingBox& treeBounds);
+	void cullOnGPU(const glm::mat4& viewProjection, const Culling::HiZBuffer* hiZBuffer = nullptr); //!< culls all tree variants, following renderBranches() / renderFoliage() only draw visible instances
+	void useAllInstances(); //!< switch back to all instances, e.g. for shadow map passes that need trees outside of the view
+	void renderBranches(int treeVariant); //!< indirect draw of visible instances after cullOnGPU(), else instanced draw of all instances
+	void renderFoliage(int treeVariant);
 	void createAndConfigureShaders(std::string branchFragmentShader = "/modelSpace/GBuffer.frag", std::string foliageFragmentShader = "/treeAnim/foliage.frag");
 	void createAndConfigureUniformBlocksAndBuffers(int firstBindingPointIdx = 1);
+
+	/** @brief optional: upload the Simulation and Tree blocks through a persistently mapped RingBuffer every frame, instead of the static buffers
+	 *
+	 * call after createAndConfigureUniformBlocksAndBuffers(), then updateUniformBlocks() once per frame before rendering
+	 */
+	void createUniformRingBuffer();
+	void updateUniformBlocks(); //!< writes the current simulation properties and the cached tree data to the ring buffer and binds the ranges
+	void updateTreeUniformBlock(int treeVariant); //!< call after changing the Tree of a variant, rebuilds its cached Tree block data and static buffer
 	void createAndConfigureRenderpasses(FrameBufferObject* targetBranchFBO, FrameBufferObject* targetFoliageFBO, FrameBufferObject* targetShadowMapFBO = nullptr);
 
 	// Imgui
 	void imguiInterfaceSimulationProperties();
 	void updateActiveImguiInterfaces();
+
+private:
+	void attachInstanceBuffer(int treeVariant, GLuint buffer); //!< sources the instance matrix attribute of all renderables of a variant from buffer
 };
 
 } // namespace TreeAnimation
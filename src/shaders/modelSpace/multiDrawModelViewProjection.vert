@@ -0,0 +1,44 @@
+#version 430
+ 
+ /**
+ * Like modelViewProjection.vert, but the model matrix is fetched per draw from a buffer (see MeshPool).
+ */
+
+ //!< in-variables
+layout(location = 0) in vec4 positionAttribute;
+layout(location = 1) in vec2 uvCoordAttribute;
+layout(location = 2) in vec4 normalAttribute;
+layout(location = 9) in uint drawIndexAttribute; //!< MeshPool::DRAW_INDEX_ATTRIBUTE
+
+//!< buffers
+layout(std430, binding = 0) readonly buffer ModelMatrixBuffer
+{
+	mat4 modelMatrices[];
+};
+
+//!< uniforms
+uniform int drawIndexOffset; //!< added to the draw index, for pooled renderables that are drawn one by one
+uniform mat4 view;
+uniform mat4 projection;
+
+//!< out-variables
+out vec3 passWorldPosition;
+out vec3 passPosition;
+out vec2 passUVCoord;
+out vec3 passWorldNormal;
+out vec3 passNormal;
+
+void main(){
+	mat4 model = modelMatrices[int(drawIndexAttribute) + drawIndexOffset];
+
+    passUVCoord = uvCoordAttribute;
+    vec4 worldPos = (model * positionAttribute);
+
+    passWorldPosition = worldPos.xyz;
+    passPosition = (view * worldPos).xyz;
+    
+    gl_Position =  projection * view * worldPos;
+
+    passWorldNormal = normalize( ( transpose( inverse( model ) ) * normalAttribute).xyz );
+	passNormal = normalize( ( transpose( inverse( view * model ) ) * normalAttribute ).xyz );
+}
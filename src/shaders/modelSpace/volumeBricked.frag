@@ -0,0 +1,96 @@
+#version 430
+
+// textures
+uniform isampler3D volume_atlas;   // occupied bricks of the volume, see loadToBrickedTextures
+uniform isampler3D brick_table;    // per brick: atlas position in bricks (-1: dropped) and maximum value
+
+// bricked volume related uniforms
+uniform ivec3 uVolumeSize; // in voxels
+uniform int   uBrickSize;  // edge length of a brick in voxels
+
+#include "volumeCommon.glsl"
+
+// see volumeCommon.glsl, samples through the brick table and skips bricks that cannot change the result
+VolumeSample mip(vec3 startUVW, vec3 endUVW, float stepSize, int thresholdLMIP, int minStepsLMIP, int minValueThreshold, int maxValueThreshold)
+{
+	float parameterStepSize = stepSize / length(endUVW - startUVW); // necessary parametric steps to get from start to end
+
+	VolumeSample curMax;	 // result variable
+	curMax.value = -10000;   // initialized to arbitrary value out of CT/MRT range
+	curMax.uvw   = startUVW; // initialized to arbitrary uvw coordinates
+
+	int stepsSinceLM = 0; 	 // used in conjunction with experimental minStepsLMIP parameter
+
+	// ray in voxel space
+	vec3 startVoxel = startUVW * vec3(uVolumeSize);
+	vec3 rayVoxel   = (endUVW - startUVW) * vec3(uVolumeSize);
+
+	// traversa ray, perform mip
+	for (float t = 0.0; t < 1.0 + (0.5 * parameterStepSize); t += parameterStepSize)
+	{
+		vec3 curUVW = mix( startUVW, endUVW, t);
+		ivec3 voxel = clamp( ivec3( curUVW * vec3(uVolumeSize) ), ivec3(0), uVolumeSize - 1 );
+		ivec3 brick = voxel / uBrickSize;
+		ivec4 brickEntry = texelFetch(brick_table, brick, 0);
+
+		// empty space skipping: no sample of this brick can be a new maximum, i.e. all would be ignored, the brick was dropped
+		// or its maximum does not exceed the current one while LMIP is not satisfied
+		if ( brickEntry.x < 0 || brickEntry.w < minValueThreshold || ( brickEntry.w <= curMax.value && curMax.value <= thresholdLMIP ) )
+		{
+			// continue with the first sample behind the brick
+			vec3 exitVoxel = vec3(brick * uBrickSize) + mix( vec3(0.0), vec3(uBrickSize), greaterThan(rayVoxel, vec3(0.0)) );
+			vec3 tExit = mix( vec3(1e20), (exitVoxel - startVoxel) / rayVoxel, notEqual(rayVoxel, vec3(0.0)) ); // axis parallel rays never leave through that axis
+			float tBrickExit = min( tExit.x, min( tExit.y, tExit.z ) );
+			float tLast = max( t, parameterStepSize * ceil( tBrickExit / parameterStepSize ) - parameterStepSize ); // last sample inside the brick
+
+			// once LMIP is satisfied, the skipped samples that would not be ignored still count as steps since the local maximum
+			if ( curMax.value > thresholdLMIP && brickEntry.w >= minValueThreshold )
+			{
+				stepsSinceLM += int( round( (tLast - t) / parameterStepSize ) ) + 1;
+				if (stepsSinceLM > minStepsLMIP)
+				{
+					break;
+				}
+			}
+
+			t = tLast; // incremented by the loop
+			continue;
+		}
+
+		// retrieve current sample
+		VolumeSample curSample;
+		curSample.value = texelFetch(volume_atlas, brickEntry.xyz * uBrickSize + voxel % uBrickSize, 0).r;
+		curSample.uvw   = curUVW;
+
+		/// experimental: ignore values exceeding or deceeding some thresholds
+		if ( curSample.value > maxValueThreshold || curSample.value < minValueThreshold)
+		{
+			continue;
+		}
+
+		// found new maximum
+		if ( curSample.value > curMax.value)
+		{
+			curMax = curSample;
+
+			stepsSinceLM = 0; // always reset while approaching local maximum, see usage below
+		}
+		else // leaving local maximum
+		{
+			// LMIP is satisfied
+			if ( curMax.value > thresholdLMIP ) 
+			{
+				stepsSinceLM++; // increment steps since departing last local maximum
+
+				/// experimental: minimal offset to local maximum with no new maximum
+				if (stepsSinceLM > minStepsLMIP) 
+				{
+					break; // current max sample is a local maximum AND greater than LMIP threshold
+				}
+			}
+		}		
+	}
+
+	// return maximum sample with maximum intensity
+	return curMax;
+}
@@ -0,0 +1,53 @@
+#version 430
+
+/*
+* Builds one level of a hierarchical depth buffer.
+* Every texel stores the farthest depth of the texels it covers in the level below,
+* for odd sizes the last texel also covers the remaining row / column.
+* level < 0 copies the depth texture bound to tex into level 0.
+* Otherwise the source level is the only accessible level of tex (GL_TEXTURE_BASE_LEVEL = GL_TEXTURE_MAX_LEVEL = level),
+* so it is fetched as lod 0 and the level that is rendered to is never sampled.
+*/
+
+uniform sampler2D tex;
+uniform int level; //!< source level, < 0 to copy
+
+out float fragmentDepth;
+
+float fetchDepth(ivec2 coord, ivec2 size)
+{
+	return texelFetch(tex, min(coord, size - 1), 0).r;
+}
+
+void main() {
+	ivec2 coord = ivec2(gl_FragCoord.xy);
+
+	if ( level < 0 )
+	{
+		fragmentDepth = texelFetch(tex, coord, 0).r;
+		return;
+	}
+
+	ivec2 size = textureSize(tex, 0);
+	ivec2 src = coord * 2;
+
+	float depth = max( max( fetchDepth(src, size), fetchDepth(src + ivec2(1,0), size) ),
+	                   max( fetchDepth(src + ivec2(0,1), size), fetchDepth(src + ivec2(1,1), size) ) );
+
+	bool extraColumn = (size.x % 2 == 1) && (src.x + 3 == size.x);
+	bool extraRow    = (size.y % 2 == 1) && (src.y + 3 == size.y);
+	if ( extraColumn )
+	{
+		depth = max( depth, max( fetchDepth(src + ivec2(2,0), size), fetchDepth(src + ivec2(2,1), size) ) );
+	}
+	if ( extraRow )
+	{
+		depth = max( depth, max( fetchDepth(src + ivec2(0,2), size), fetchDepth(src + ivec2(1,2), size) ) );
+	}
+	if ( extraColumn && extraRow )
+	{
+		depth = max( depth, fetchDepth(src + ivec2(2,2), size) );
+	}
+
+	fragmentDepth = depth;
+}
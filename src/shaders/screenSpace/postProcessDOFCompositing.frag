@@ -9,8 +9,7 @@ uniform sampler2D  blurryFarField;  // quarter res
 uniform float maxCoCRadiusPixels;
 uniform float farRadiusRescale;
 
-uniform bool disableFarField;
-uniform bool disableNearField;
+// DISABLE_FAR_FIELD, DISABLE_NEAR_FIELD: defined per variant, see PostProcessing::DepthOfField
 
 out vec4 fragmentColor;
 
@@ -52,14 +51,12 @@ void main() {
     }
 
     vec3 sharp = sharpColor.rgb;
-    if (!disableFarField)
-    {
-        sharp = mix(sharp, blurred, abs(normRadius));         
-    }
-    if (!disableNearField)
-    {
-        sharp = sharp * (1.0 - blurryNearColor.a) + blurryNearColor.rgb;
-    }
+#ifndef DISABLE_FAR_FIELD
+    sharp = mix(sharp, blurred, abs(normRadius));         
+#endif
+#ifndef DISABLE_NEAR_FIELD
+    sharp = sharp * (1.0 - blurryNearColor.a) + blurryNearColor.rgb;
+#endif
 
     fragmentColor = vec4(sharp,1.0) ;
 }
\ No newline at end of file